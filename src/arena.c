@@ -0,0 +1,141 @@
+/*
+ * Copyright (C) 2018-2021 IoT.bzh Company
+ * Author: José Bollo <jose.bollo@iot.bzh>
+ * Author: Arthur Guyader <arthur.guyader@iot.bzh>
+ *
+ * $RP_BEGIN_LICENSE$
+ * Commercial License Usage
+ *  Licensees holding valid commercial IoT.bzh licenses may use this file in
+ *  accordance with the commercial license agreement provided with the
+ *  Software or, alternatively, in accordance with the terms contained in
+ *  a written agreement between you and The IoT.bzh Company. For licensing terms
+ *  and conditions see https://www.iot.bzh/terms-conditions. For further
+ *  information use the contact form at https://www.iot.bzh/contact.
+ *
+ * GNU General Public License Usage
+ *  Alternatively, this file may be used under the terms of the GNU General
+ *  Public license version 3. This license is as published by the Free Software
+ *  Foundation and appearing in the file LICENSE.GPLv3 included in the packaging
+ *  of this file. Please review the following information to ensure the GNU
+ *  General Public License requirements will be met
+ *  https://www.gnu.org/licenses/gpl-3.0.html.
+ * $RP_END_LICENSE$
+ */
+
+#include "arena.h"
+
+#include <stdalign.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_ALIGN (alignof(max_align_t))
+#define MIN_ARENA_CHUNK_SIZE 4096
+
+/**
+ * @brief Structure of a chunk of memory of an arena
+ */
+struct arena_chunk {
+    /** next chunk */
+    arena_chunk_t *next;
+
+    /** size of the chunk memory */
+    size_t size;
+
+    /** the memory */
+    alignas(ARENA_ALIGN) char memory[];
+};
+
+/***********************/
+/*** PRIVATE METHODS ***/
+/***********************/
+
+/**
+ * @brief Get a chunk able to hold 'size' bytes after the current one
+ * Chunks kept by a reset are reused before allocating new ones.
+ *
+ * @param[in] arena arena handler
+ * @param[in] size the size needed
+ * @return the chunk or NULL if out of memory
+ */
+__nonnull() __wur static arena_chunk_t *next_chunk(arena_t *arena, size_t size) {
+    arena_chunk_t *chunk, **prev;
+    size_t chunk_size;
+
+    /* search a kept chunk big enough */
+    prev = arena->current ? &arena->current->next : &arena->first;
+    for (chunk = *prev; chunk && chunk->size < size; chunk = *prev) prev = &chunk->next;
+    if (chunk) {
+        *prev = chunk->next;
+    } else {
+        chunk_size = arena->current ? 2 * arena->current->size : MIN_ARENA_CHUNK_SIZE;
+        while (chunk_size < size) chunk_size *= 2;
+        chunk = malloc(sizeof(arena_chunk_t) + chunk_size);
+        if (chunk == NULL)
+            return NULL;
+        chunk->size = chunk_size;
+    }
+
+    /* insert it after the current chunk */
+    prev = arena->current ? &arena->current->next : &arena->first;
+    chunk->next = *prev;
+    *prev = chunk;
+    return chunk;
+}
+
+/**********************/
+/*** PUBLIC METHODS ***/
+/**********************/
+
+/* see arena.h */
+void init_arena(arena_t *arena) {
+    arena->first = NULL;
+    arena->current = NULL;
+    arena->offset = 0;
+}
+
+/* see arena.h */
+void free_arena(arena_t *arena) {
+    arena_chunk_t *chunk;
+
+    while ((chunk = arena->first) != NULL) {
+        arena->first = chunk->next;
+        free(chunk);
+    }
+    init_arena(arena);
+}
+
+/* see arena.h */
+void arena_reset(arena_t *arena) {
+    arena->current = arena->first;
+    arena->offset = 0;
+}
+
+/* see arena.h */
+void *arena_alloc(arena_t *arena, size_t size) {
+    arena_chunk_t *chunk;
+    void *result;
+
+    size = (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+    chunk = arena->current;
+    if (chunk == NULL || chunk->size - arena->offset < size) {
+        chunk = next_chunk(arena, size);
+        if (chunk == NULL)
+            return NULL;
+        arena->current = chunk;
+        arena->offset = 0;
+    }
+
+    result = &chunk->memory[arena->offset];
+    arena->offset += size;
+    return result;
+}
+
+/* see arena.h */
+char *arena_strndup(arena_t *arena, const char *string, size_t length) {
+    char *copy = arena_alloc(arena, length + 1);
+    if (copy) {
+        memcpy(copy, string, length);
+        copy[length] = '\0';
+    }
+    return copy;
+}
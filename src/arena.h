@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2018-2021 IoT.bzh Company
+ * Author: José Bollo <jose.bollo@iot.bzh>
+ * Author: Arthur Guyader <arthur.guyader@iot.bzh>
+ *
+ * $RP_BEGIN_LICENSE$
+ * Commercial License Usage
+ *  Licensees holding valid commercial IoT.bzh licenses may use this file in
+ *  accordance with the commercial license agreement provided with the
+ *  Software or, alternatively, in accordance with the terms contained in
+ *  a written agreement between you and The IoT.bzh Company. For licensing terms
+ *  and conditions see https://www.iot.bzh/terms-conditions. For further
+ *  information use the contact form at https://www.iot.bzh/contact.
+ *
+ * GNU General Public License Usage
+ *  Alternatively, this file may be used under the terms of the GNU General
+ *  Public license version 3. This license is as published by the Free Software
+ *  Foundation and appearing in the file LICENSE.GPLv3 included in the packaging
+ *  of this file. Please review the following information to ensure the GNU
+ *  General Public License requirements will be met
+ *  https://www.gnu.org/licenses/gpl-3.0.html.
+ * $RP_END_LICENSE$
+ */
+
+#ifndef SEC_LSM_MANAGER_ARENA_H
+#define SEC_LSM_MANAGER_ARENA_H
+
+#include <stddef.h>
+#include <sys/cdefs.h>
+
+typedef struct arena_chunk arena_chunk_t;
+
+/**
+ * @brief Structure of arena
+ * An arena is a bump allocator: its memory is allocated by chunks of growing
+ * size and released all at once. The chunks are kept when the arena is reset
+ * so that refilling it doesn't allocate again.
+ *
+ */
+typedef struct arena {
+    arena_chunk_t *first;
+    arena_chunk_t *current;
+    size_t offset;
+} arena_t;
+
+/**
+ * @brief Initialize the fields 'first', 'current' and 'offset'
+ *
+ * @param[in] arena arena handler
+ */
+extern void init_arena(arena_t *arena) __nonnull();
+
+/**
+ * @brief Free the chunks of the arena
+ * The pointer is not free
+ *
+ * @param[in] arena arena handler
+ */
+extern void free_arena(arena_t *arena) __nonnull();
+
+/**
+ * @brief Forget all the allocations of the arena but keep its chunks
+ *
+ * @param[in] arena arena handler
+ */
+extern void arena_reset(arena_t *arena) __nonnull();
+
+/**
+ * @brief Allocate memory in the arena
+ * The memory is aligned for any type and lives until the arena is reset or freed
+ *
+ * @param[in] arena arena handler
+ * @param[in] size the size to allocate
+ * @return the allocated memory or NULL if out of memory
+ */
+extern void *arena_alloc(arena_t *arena, size_t size) __wur __nonnull();
+
+/**
+ * @brief Copy a string in the arena
+ *
+ * @param[in] arena arena handler
+ * @param[in] string the string to copy
+ * @param[in] length the length of the string
+ * @return the copy or NULL if out of memory
+ */
+extern char *arena_strndup(arena_t *arena, const char *string, size_t length) __wur __nonnull();
+
+#endif
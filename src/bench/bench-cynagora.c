@@ -0,0 +1,131 @@
+/*
+ * Copyright (C) 2020-2021 IoT.bzh Company
+ * Author: Arthur Guyader <arthur.guyader@iot.bzh>
+ *
+ * $RP_BEGIN_LICENSE$
+ * Commercial License Usage
+ *  Licensees holding valid commercial IoT.bzh licenses may use this file in
+ *  accordance with the commercial license agreement provided with the
+ *  Software or, alternatively, in accordance with the terms contained in
+ *  a written agreement between you and The IoT.bzh Company. For licensing terms
+ *  and conditions see https://www.iot.bzh/terms-conditions. For further
+ *  information use the contact form at https://www.iot.bzh/contact.
+ *
+ * GNU General Public License Usage
+ *  Alternatively, this file may be used under the terms of the GNU General
+ *  Public license version 3. This license is as published by the Free Software
+ *  Foundation and appearing in the file LICENSE.GPLv3 included in the packaging
+ *  of this file. Please review the following information to ensure the GNU
+ *  General Public License requirements will be met
+ *  https://www.gnu.org/licenses/gpl-3.0.html.
+ * $RP_END_LICENSE$
+ */
+
+
+/*
+ * Benchmark of the update of the cynagora policies of an install
+ *
+ * The policies of an app with N permissions are installed R times against
+ * the simulation of cynagora, each request waiting the latency given as
+ * argument (microseconds, default 100). The former way drops the policies
+ * and sets the new ones in two transactions. The synced way replaces them
+ * in one transaction sending only the changes: it is measured for a
+ * reinstall of the same permissions and for reinstalls alternating two
+ * sets that differ by one permission. The time and the count of writes
+ * (set, drop and commit) of an install are reported. The simulation traces
+ * its calls on stdout, they are discarded.
+ */
+
+#if !defined(SIMULATE_CYNAGORA)
+#define SIMULATE_CYNAGORA
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../arena.c"
+#include "../cynagora-interface.c"
+#include "../hash-index.c"
+#include "../log.c"
+#include "../permissions.c"
+#include "../simulation/cynagora/cynagora.c"
+
+static const size_t bench_permissions[] = {1, 10, 50};
+
+#define REPLACES 20
+
+/**
+ * @brief Get the elapsed milliseconds since 'start'
+ */
+static double elapsed_ms(const struct timespec *start) {
+    struct timespec stop;
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+    return (double)(stop.tv_sec - start->tv_sec) * 1e3 + (double)(stop.tv_nsec - start->tv_nsec) * 1e-6;
+}
+
+int main(int ac, char **av) {
+    const char *latency = ac > 1 ? av[1] : "100";
+    cynagora_t *cynagora = NULL;
+    struct timespec start;
+    arena_t arena;
+    permission_set_t permission_sets[2];
+    const char *methods[3] = {"separate", "unchanged", "changed"};
+    char permission[64];
+    int rc = 0;
+
+    setenv("SIMULATE_CYNAGORA_LATENCY", latency, 1);
+    FILE *out = fdopen(dup(STDOUT_FILENO), "w");
+    if (out == NULL || freopen("/dev/null", "w", stdout) == NULL)
+        return 1;
+
+    if (cynagora_create(&cynagora, cynagora_Admin, 1, 0) < 0)
+        return 1;
+
+    fprintf(out, "latency %s us\n", latency);
+    fprintf(out, "%-12s %-10s %14s %10s\n", "permissions", "method", "install ms", "writes");
+    for (size_t i = 0; rc >= 0 && i < sizeof(bench_permissions) / sizeof(*bench_permissions); i++) {
+        init_arena(&arena);
+        init_permission_set(&permission_sets[0], &arena);
+        init_permission_set(&permission_sets[1], &arena);
+        for (size_t j = 0; rc >= 0 && j < bench_permissions[i]; j++) {
+            snprintf(permission, sizeof(permission), "urn:AGL:permission:bench:%zu", j);
+            rc = permission_set_add_permission(&permission_sets[0], permission);
+            if (j == 0)
+                snprintf(permission, sizeof(permission), "urn:AGL:permission:bench:other");
+            if (rc >= 0)
+                rc = permission_set_add_permission(&permission_sets[1], permission);
+        }
+
+        for (int method = 0; rc >= 0 && method < 3; method++) {
+            rc = cynagora_replace_policies(cynagora, "bench-app", &permission_sets[0]);
+            unsigned long writes = simulation_writes;
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            for (size_t r = 0; rc >= 0 && r < REPLACES; r++) {
+                if (method == 0) {
+                    rc = cynagora_drop_policies(cynagora, "bench-app");
+                    if (rc >= 0)
+                        rc = cynagora_set_policies(cynagora, "bench-app", &permission_sets[0]);
+                } else {
+                    size_t set = method == 2 ? (r + 1) % 2 : 0;
+                    rc = cynagora_replace_policies(cynagora, "bench-app", &permission_sets[set]);
+                }
+            }
+            fprintf(out, "%-12zu %-10s %14.3f %10.1f\n", bench_permissions[i], methods[method],
+                    elapsed_ms(&start) / REPLACES, (double)(simulation_writes - writes) / REPLACES);
+        }
+
+        free_permission_set(&permission_sets[0]);
+        free_permission_set(&permission_sets[1]);
+        free_arena(&arena);
+    }
+
+    cynagora_destroy(cynagora);
+    if (rc < 0) {
+        fprintf(stderr, "bench failed : %d\n", rc);
+        return 1;
+    }
+    fclose(out);
+    return 0;
+}
@@ -0,0 +1,164 @@
+/*
+ * Copyright (C) 2018-2021 IoT.bzh Company
+ * Author: José Bollo <jose.bollo@iot.bzh>
+ * Author: Arthur Guyader <arthur.guyader@iot.bzh>
+ *
+ * $RP_BEGIN_LICENSE$
+ * Commercial License Usage
+ *  Licensees holding valid commercial IoT.bzh licenses may use this file in
+ *  accordance with the commercial license agreement provided with the
+ *  Software or, alternatively, in accordance with the terms contained in
+ *  a written agreement between you and The IoT.bzh Company. For licensing terms
+ *  and conditions see https://www.iot.bzh/terms-conditions. For further
+ *  information use the contact form at https://www.iot.bzh/contact.
+ *
+ * GNU General Public License Usage
+ *  Alternatively, this file may be used under the terms of the GNU General
+ *  Public license version 3. This license is as published by the Free Software
+ *  Foundation and appearing in the file LICENSE.GPLv3 included in the packaging
+ *  of this file. Please review the following information to ensure the GNU
+ *  General Public License requirements will be met
+ *  https://www.gnu.org/licenses/gpl-3.0.html.
+ * $RP_END_LICENSE$
+ */
+
+/*
+ * Benchmark of the throughput of the installation of manifests
+ *
+ * A manifest of BENCH_PATHS paths and BENCH_PERMISSIONS permissions is sent
+ * to a running sec-lsm-manager daemon with one round-trip per request
+ * (synchronous mode), with pipelined requests and with a single manifest
+ * request. Each mode is measured without and with the install/uninstall of
+ * the manifest.
+ *
+ * usage: bench-manifest [socket-spec]
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../sec-lsm-manager.h"
+
+#define BENCH_PATHS 500
+#define BENCH_PERMISSIONS 20
+#define BENCH_ROUNDS 20
+#define BENCH_ID "bench-manifest"
+
+/** modes of sending the manifest */
+enum mode { mode_synchronous, mode_pipelined, mode_bulk };
+
+/** names of the modes */
+static const char *mode_names[] = {"synchronous", "pipelined", "manifest"};
+
+/** directory of the files of the manifest */
+static char bench_dir[] = "/tmp/bench-manifest-XXXXXX";
+
+/** paths, path types and permissions of the manifest */
+static char paths[BENCH_PATHS][256];
+static const char *path_pointers[BENCH_PATHS];
+static const char *path_types[BENCH_PATHS];
+static char permissions[BENCH_PERMISSIONS][64];
+static const char *permission_pointers[BENCH_PERMISSIONS];
+
+/**
+ * @brief Send the manifest and optionally install and uninstall it
+ *
+ * @param[in] client the client
+ * @param[in] mode the mode of sending
+ * @param[in] install install and uninstall the manifest if not 0
+ * @return 0 in case of success or a negative -errno value
+ */
+static int send_manifest(sec_lsm_manager_t *client, enum mode mode, int install) {
+    int i, rc;
+
+    if (mode == mode_bulk) {
+        rc = sec_lsm_manager_set_manifest(client, BENCH_ID, BENCH_PATHS, path_pointers, path_types,
+                                          BENCH_PERMISSIONS, permission_pointers);
+    } else {
+        rc = sec_lsm_manager_clear(client);
+        if (rc >= 0)
+            rc = sec_lsm_manager_set_id(client, BENCH_ID);
+        for (i = 0; rc >= 0 && i < BENCH_PATHS; i++) rc = sec_lsm_manager_add_path(client, paths[i], path_types[i]);
+        for (i = 0; rc >= 0 && i < BENCH_PERMISSIONS; i++) rc = sec_lsm_manager_add_permission(client, permissions[i]);
+    }
+    if (rc >= 0 && install) {
+        rc = sec_lsm_manager_install(client);
+        if (rc >= 0)
+            rc = sec_lsm_manager_uninstall(client);
+    } else if (rc >= 0) {
+        /* get the status of the manifest */
+        rc = sec_lsm_manager_log(client, 0, 0);
+    }
+    return rc;
+}
+
+/**
+ * @brief Measure a mode
+ *
+ * @param[in] client the client
+ * @param[in] mode the mode of sending
+ * @param[in] install install and uninstall the manifest if not 0
+ * @return 0 in case of success or a negative -errno value
+ */
+static int bench(sec_lsm_manager_t *client, enum mode mode, int install) {
+    struct timespec start, stop;
+    double duration;
+    int i, rc;
+
+    rc = sec_lsm_manager_set_pipelining(client, mode == mode_pipelined);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; rc >= 0 && i < BENCH_ROUNDS; i++) rc = send_manifest(client, mode, install);
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+    if (rc < 0) {
+        fprintf(stderr, "bench failed : %d %s\n", -rc, strerror(-rc));
+        return rc;
+    }
+
+    duration = (double)(stop.tv_sec - start.tv_sec) + (double)(stop.tv_nsec - start.tv_nsec) * 1e-9;
+    printf("%-12s %-8s %12.1f %12.3f\n", mode_names[mode], install ? "yes" : "no",
+           BENCH_ROUNDS / duration, duration * 1000 / BENCH_ROUNDS);
+    return 0;
+}
+
+int main(int ac, char **av) {
+    sec_lsm_manager_t *client = NULL;
+    FILE *file;
+    int i, rc;
+
+    if (mkdtemp(bench_dir) == NULL) {
+        fprintf(stderr, "can't create %s : %m\n", bench_dir);
+        return 1;
+    }
+    for (i = 0; i < BENCH_PATHS; i++) {
+        snprintf(paths[i], sizeof(paths[i]), "%s/file-%d", bench_dir, i);
+        path_pointers[i] = paths[i];
+        path_types[i] = "data";
+        file = fopen(paths[i], "w");
+        if (file)
+            fclose(file);
+    }
+    for (i = 0; i < BENCH_PERMISSIONS; i++) {
+        snprintf(permissions[i], sizeof(permissions[i]), "urn:AGL:permission:bench:%d", i);
+        permission_pointers[i] = permissions[i];
+    }
+
+    rc = sec_lsm_manager_create(&client, ac > 1 ? av[1] : NULL);
+    if (rc < 0) {
+        fprintf(stderr, "sec_lsm_manager_create : %d %s\n", -rc, strerror(-rc));
+        return 1;
+    }
+
+    printf("manifest of %d paths and %d permissions, %d rounds\n", BENCH_PATHS, BENCH_PERMISSIONS, BENCH_ROUNDS);
+    printf("%-12s %-8s %12s %12s\n", "mode", "install", "manifests/s", "ms/manifest");
+    rc = 0;
+    for (i = 0; rc == 0 && i < 6; i++) rc = bench(client, (enum mode)(i % 3), i / 3);
+
+    sec_lsm_manager_destroy(client);
+    for (i = 0; i < BENCH_PATHS; i++) unlink(paths[i]);
+    rmdir(bench_dir);
+    return rc ? 1 : 0;
+}
@@ -0,0 +1,207 @@
+/*
+ * Copyright (C) 2018-2021 IoT.bzh Company
+ * Author: José Bollo <jose.bollo@iot.bzh>
+ * Author: Arthur Guyader <arthur.guyader@iot.bzh>
+ *
+ * $RP_BEGIN_LICENSE$
+ * Commercial License Usage
+ *  Licensees holding valid commercial IoT.bzh licenses may use this file in
+ *  accordance with the commercial license agreement provided with the
+ *  Software or, alternatively, in accordance with the terms contained in
+ *  a written agreement between you and The IoT.bzh Company. For licensing terms
+ *  and conditions see https://www.iot.bzh/terms-conditions. For further
+ *  information use the contact form at https://www.iot.bzh/contact.
+ *
+ * GNU General Public License Usage
+ *  Alternatively, this file may be used under the terms of the GNU General
+ *  Public license version 3. This license is as published by the Free Software
+ *  Foundation and appearing in the file LICENSE.GPLv3 included in the packaging
+ *  of this file. Please review the following information to ensure the GNU
+ *  General Public License requirements will be met
+ *  https://www.gnu.org/licenses/gpl-3.0.html.
+ * $RP_END_LICENSE$
+ */
+
+/*
+ * Benchmark of the dispatching of the epoll events
+ *
+ * Simulated clients connected through socket pairs send requests that are
+ * answered by pollitem handlers. For each count of clients, the requests
+ * are dispatched with one event per wait and then with batches of events.
+ * The count of system calls made by the server side (epoll_wait, read and
+ * write) is reported per request.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../pollitem.c"
+
+#define BENCH_REQUESTS 100000
+#define BENCH_BATCH 64
+
+static const int bench_clients[] = {1, 64, 1000};
+
+/** structure of a simulated connection */
+typedef struct {
+    /** pollitem of the server side */
+    pollitem_t pollitem;
+
+    /** file descriptor of the client side */
+    int clifd;
+} connection_t;
+
+/** counters of the server side */
+static unsigned long count_waits, count_reads, count_writes, count_requests;
+
+/**
+ * @brief Answer the requests of a connection
+ *
+ * @param[in] pollitem pollitem of the connection
+ * @param[in] events events receive
+ * @param[in] pollfd pollfd
+ */
+static void on_request(pollitem_t *pollitem, uint32_t events, int pollfd) {
+    char buffer[256];
+    ssize_t n, i;
+    (void)pollfd;
+
+    if (!(events & EPOLLIN))
+        return;
+
+    n = read(pollitem->fd, buffer, sizeof(buffer));
+    count_reads++;
+    for (i = 0; i < n; i++) {
+        if (buffer[i] == '\n') {
+            count_requests++;
+            if (write(pollitem->fd, "done\n", 5) == 5)
+                count_writes++;
+        }
+    }
+}
+
+/**
+ * @brief Raise the limit of file descriptors to its maximum
+ */
+static void raise_nofile(void) {
+    struct rlimit rlim;
+    if (getrlimit(RLIMIT_NOFILE, &rlim) == 0 && rlim.rlim_cur < rlim.rlim_max) {
+        rlim.rlim_cur = rlim.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rlim);
+    }
+}
+
+/**
+ * @brief Run the benchmark for a count of clients and a size of batch
+ *
+ * @param[in] nclients count of simulated clients
+ * @param[in] maxevents count of events per wait
+ * @return 0 in case of success or a negative -errno value
+ */
+static int bench(int nclients, int maxevents) {
+    int rc = 0, i, pollfd, rounds, round, fds[2];
+    char reply[8];
+    unsigned long expected;
+    struct epoll_event *events = NULL;
+    connection_t *connections = NULL;
+    struct timespec start, stop;
+    double duration;
+
+    pollfd = epoll_create1(EPOLL_CLOEXEC);
+    events = calloc((size_t)maxevents, sizeof(*events));
+    connections = calloc((size_t)nclients, sizeof(*connections));
+    if (pollfd < 0 || events == NULL || connections == NULL) {
+        rc = -errno;
+        nclients = 0;
+        goto end;
+    }
+
+    for (i = 0; i < nclients; i++) {
+        if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) < 0) {
+            rc = -errno;
+            fprintf(stderr, "socketpair : %d %s\n", -rc, strerror(-rc));
+            nclients = i;
+            goto end;
+        }
+        fcntl(fds[0], F_SETFL, O_NONBLOCK);
+        connections[i].pollitem.handler = on_request;
+        connections[i].pollitem.closure = &connections[i];
+        connections[i].pollitem.fd = fds[0];
+        connections[i].clifd = fds[1];
+        pollitem_add(&connections[i].pollitem, EPOLLIN, pollfd);
+    }
+
+    count_waits = count_reads = count_writes = count_requests = 0;
+    rounds = BENCH_REQUESTS / nclients;
+    expected = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (round = 0; round < rounds; round++) {
+        /* all the clients send a request */
+        for (i = 0; i < nclients; i++) {
+            if (write(connections[i].clifd, "log\n", 4) != 4) {
+                rc = -errno;
+                goto end;
+            }
+        }
+        expected += (unsigned long)nclients;
+
+        /* the server answers them */
+        while (count_requests < expected) {
+            if (pollitem_wait_dispatch_batch(pollfd, 1000, events, maxevents) <= 0) {
+                rc = -ETIMEDOUT;
+                goto end;
+            }
+            count_waits++;
+        }
+
+        /* the clients get the replies */
+        for (i = 0; i < nclients; i++)
+            if (read(connections[i].clifd, reply, sizeof(reply)) < 0) {
+                rc = -errno;
+                goto end;
+            }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+
+    duration = (double)(stop.tv_sec - start.tv_sec) * 1e9 + (double)(stop.tv_nsec - start.tv_nsec);
+    printf("%7d %9d %9lu %12.3f %12.3f %10.0f\n", nclients, maxevents, count_requests,
+           (double)count_waits / (double)count_requests,
+           (double)(count_waits + count_reads + count_writes) / (double)count_requests,
+           duration / (double)count_requests);
+
+end:
+    if (rc < 0)
+        fprintf(stderr, "bench %d clients %d events : %d %s\n", nclients, maxevents, -rc, strerror(-rc));
+    for (i = 0; i < nclients; i++) {
+        close(connections[i].pollitem.fd);
+        close(connections[i].clifd);
+    }
+    free(connections);
+    free(events);
+    if (pollfd >= 0)
+        close(pollfd);
+    return rc;
+}
+
+int main(void) {
+    size_t i;
+    int rc = 0;
+
+    raise_nofile();
+
+    printf("%7s %9s %9s %12s %12s %10s\n", "clients", "maxevents", "requests", "waits/req", "syscalls/req",
+           "ns/req");
+    for (i = 0; i < sizeof(bench_clients) / sizeof(bench_clients[0]); i++) {
+        rc = bench(bench_clients[i], 1) ?: rc;
+        rc = bench(bench_clients[i], BENCH_BATCH) ?: rc;
+    }
+    return rc ? 1 : 0;
+}
@@ -0,0 +1,175 @@
+/*
+ * Copyright (C) 2018-2021 IoT.bzh Company
+ * Author: José Bollo <jose.bollo@iot.bzh>
+ * Author: Arthur Guyader <arthur.guyader@iot.bzh>
+ *
+ * $RP_BEGIN_LICENSE$
+ * Commercial License Usage
+ *  Licensees holding valid commercial IoT.bzh licenses may use this file in
+ *  accordance with the commercial license agreement provided with the
+ *  Software or, alternatively, in accordance with the terms contained in
+ *  a written agreement between you and The IoT.bzh Company. For licensing terms
+ *  and conditions see https://www.iot.bzh/terms-conditions. For further
+ *  information use the contact form at https://www.iot.bzh/contact.
+ *
+ * GNU General Public License Usage
+ *  Alternatively, this file may be used under the terms of the GNU General
+ *  Public license version 3. This license is as published by the Free Software
+ *  Foundation and appearing in the file LICENSE.GPLv3 included in the packaging
+ *  of this file. Please review the following information to ensure the GNU
+ *  General Public License requirements will be met
+ *  https://www.gnu.org/licenses/gpl-3.0.html.
+ * $RP_END_LICENSE$
+ */
+
+/*
+ * Benchmark of the building of a secure app
+ *
+ * A secure app of N paths and N permissions is built with the hashed
+ * duplicate detection of path_set_t and permission_set_t and, for reference,
+ * with the former linear scan of the entries before each insert. Then the
+ * sections of a template are looked up as a compiled template does.
+ * The count of chunks allocated by the arena of the secure app is reported
+ * for a first build and for a rebuild after a clear.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../arena.c"
+#include "../hash-index.c"
+#include "../log.c"
+#include "../paths.c"
+#include "../permissions.c"
+#include "../secure-app.c"
+#include "../template.c"
+#include "../utils.c"
+
+static const size_t bench_counts[] = {100, 1000, 10000};
+
+/**
+ * @brief Get the elapsed milliseconds since 'start'
+ */
+static double elapsed_ms(const struct timespec *start) {
+    struct timespec stop;
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+    return (double)(stop.tv_sec - start->tv_sec) * 1e3 + (double)(stop.tv_nsec - start->tv_nsec) * 1e-6;
+}
+
+/**
+ * @brief Count the chunks of an arena
+ */
+static size_t count_chunks(const arena_t *arena) {
+    size_t count = 0;
+    for (const arena_chunk_t *chunk = arena->first; chunk; chunk = chunk->next) count++;
+    return count;
+}
+
+/**
+ * @brief Add the entries with the former linear duplicate detection
+ */
+static int linear_build(secure_app_t *secure_app, size_t count) {
+    char buffer[64];
+    int rc = 0;
+
+    for (size_t i = 0; rc >= 0 && i < count; i++) {
+        snprintf(buffer, sizeof(buffer), "/usr/share/bench/file-%zu", i);
+        for (size_t j = 0; j < secure_app->path_set.size; j++)
+            if (!strcmp(secure_app->path_set.paths[j]->path, buffer))
+                return -EINVAL;
+        rc = path_set_add_path(&secure_app->path_set, buffer, type_data);
+    }
+    for (size_t i = 0; rc >= 0 && i < count; i++) {
+        snprintf(buffer, sizeof(buffer), "urn:AGL:permission:bench:%zu", i);
+        for (size_t j = 0; j < secure_app->permission_set.size; j++)
+            if (!strcmp(secure_app->permission_set.permissions[j], buffer))
+                return -EINVAL;
+        rc = permission_set_add_permission(&secure_app->permission_set, buffer);
+    }
+    return rc;
+}
+
+/**
+ * @brief Add the entries with the hashed duplicate detection
+ */
+static int hashed_build(secure_app_t *secure_app, size_t count) {
+    char buffer[64];
+    int rc = 0;
+
+    for (size_t i = 0; rc >= 0 && i < count; i++) {
+        snprintf(buffer, sizeof(buffer), "/usr/share/bench/file-%zu", i);
+        rc = secure_app_add_path(secure_app, buffer, type_data);
+    }
+    for (size_t i = 0; rc >= 0 && i < count; i++) {
+        snprintf(buffer, sizeof(buffer), "urn:AGL:permission:bench:%zu", i);
+        rc = secure_app_add_permission(secure_app, buffer);
+    }
+    return rc;
+}
+
+/**
+ * @brief Look up the permissions as template sections, in upper case
+ */
+static size_t lookup_sections(secure_app_t *secure_app, size_t count, bool linear) {
+    char buffer[64];
+    size_t found = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        snprintf(buffer, sizeof(buffer), "URN:AGL:PERMISSION:BENCH:%zu", i);
+        if (!linear) {
+            found += (size_t)permission_set_has_permission(&secure_app->permission_set, buffer, true);
+            continue;
+        }
+        for (size_t j = 0; j < secure_app->permission_set.size; j++) {
+            if (!strcasecmp(buffer, secure_app->permission_set.permissions[j])) {
+                found++;
+                break;
+            }
+        }
+    }
+    return found;
+}
+
+int main(void) {
+    secure_app_t *secure_app = NULL;
+    struct timespec start;
+    double build_ms, lookup_ms;
+    size_t found, chunks, rechunks;
+    int rc;
+
+    printf("%-8s %-8s %12s %12s %8s %8s\n", "entries", "method", "build ms", "lookup ms", "chunks", "rebuild");
+    for (size_t i = 0; i < sizeof(bench_counts) / sizeof(*bench_counts); i++) {
+        for (int linear = 1; linear >= 0; linear--) {
+            rc = create_secure_app(&secure_app);
+            if (rc < 0)
+                return 1;
+
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            rc = linear ? linear_build(secure_app, bench_counts[i]) : hashed_build(secure_app, bench_counts[i]);
+            build_ms = elapsed_ms(&start);
+
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            found = lookup_sections(secure_app, bench_counts[i], linear);
+            lookup_ms = elapsed_ms(&start);
+
+            /* a rebuild after a clear reuses the chunks of the arena */
+            chunks = count_chunks(&secure_app->arena);
+            free_secure_app(secure_app);
+            if (rc >= 0)
+                rc = linear ? linear_build(secure_app, bench_counts[i]) : hashed_build(secure_app, bench_counts[i]);
+            rechunks = count_chunks(&secure_app->arena) - chunks;
+
+            destroy_secure_app(secure_app);
+            if (rc < 0 || found != bench_counts[i]) {
+                fprintf(stderr, "bench failed : %d, %zu found\n", rc, found);
+                return 1;
+            }
+            printf("%-8zu %-8s %12.3f %12.3f %8zu %8zu\n", bench_counts[i], linear ? "linear" : "hashed", build_ms,
+                   lookup_ms, chunks, rechunks);
+        }
+    }
+    return 0;
+}
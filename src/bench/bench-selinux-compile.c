@@ -0,0 +1,395 @@
+/*
+ * Copyright (C) 2018-2021 IoT.bzh Company
+ * Author: José Bollo <jose.bollo@iot.bzh>
+ * Author: Arthur Guyader <arthur.guyader@iot.bzh>
+ *
+ * $RP_BEGIN_LICENSE$
+ * Commercial License Usage
+ *  Licensees holding valid commercial IoT.bzh licenses may use this file in
+ *  accordance with the commercial license agreement provided with the
+ *  Software or, alternatively, in accordance with the terms contained in
+ *  a written agreement between you and The IoT.bzh Company. For licensing terms
+ *  and conditions see https://www.iot.bzh/terms-conditions. For further
+ *  information use the contact form at https://www.iot.bzh/contact.
+ *
+ * GNU General Public License Usage
+ *  Alternatively, this file may be used under the terms of the GNU General
+ *  Public license version 3. This license is as published by the Free Software
+ *  Foundation and appearing in the file LICENSE.GPLv3 included in the packaging
+ *  of this file. Please review the following information to ensure the GNU
+ *  General Public License requirements will be met
+ *  https://www.gnu.org/licenses/gpl-3.0.html.
+ * $RP_END_LICENSE$
+ */
+
+/*
+ * Benchmark of the compilation of selinux modules (simulation)
+ *
+ * A fake policy development tree (build.conf, m4 support macros and interface
+ * files) and stand-ins of checkmodule and semodule_package are written under
+ * BENCH_DIR. The modules of several apps are then compiled as the daemon did
+ * before, by forking build-module.sh which runs make with a Makefile reduced
+ * to the rules of the devel Makefile, and with compile_selinux_module.
+ * The stand-ins only copy their inputs: what is measured is the cost of the
+ * processes spawned and of the m4 expansions.
+ *
+ * The modules are then compiled again by several threads through the compile
+ * jobs scheduler, with as many slots as threads, to show how the compile stage
+ * of a bulk install scales with the processors.
+ */
+
+#define BENCH_DIR "/tmp/bench-selinux-compile"
+
+#if !defined(SIMULATE_SELINUX)
+#define SIMULATE_SELINUX
+#endif
+
+// the devel tree of the build is replaced by the fake one of the bench
+#undef SELINUX_DEVEL_DIR
+#define SELINUX_DEVEL_DIR BENCH_DIR "/devel"
+#define SELINUX_CHECKMODULE BENCH_DIR "/bin/checkmodule"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../log.c"
+#include "../selinux-compile-jobs.c"
+#include "../selinux-compile.c"
+#include "../utils.c"
+
+#define INTERFACE_FILES 200
+#define INTERFACES_PER_FILE 10
+#define APPS 20
+
+/**
+ * @brief Module package of the libsepol stand-in: the module followed by the file contexts
+ */
+struct sepol_module_package {
+    char *module;
+    char *file_contexts;
+};
+
+struct sepol_policy_file {
+    FILE *fp;
+};
+
+sepol_policydb_t *sepol_module_package_get_policy(sepol_module_package_t *p) { return (sepol_policydb_t *)p; }
+
+int sepol_module_package_create(sepol_module_package_t **p) {
+    *p = calloc(1, sizeof(**p));
+    return *p ? 0 : -1;
+}
+
+void sepol_module_package_free(sepol_module_package_t *p) {
+    free(p->module);
+    free(p->file_contexts);
+    free(p);
+}
+
+int sepol_module_package_set_file_contexts(sepol_module_package_t *p, char *data, size_t len) {
+    p->file_contexts = strndup(data, len);
+    return p->file_contexts ? 0 : -1;
+}
+
+int sepol_module_package_write(sepol_module_package_t *p, sepol_policy_file_t *file) {
+    return fputs(p->module, file->fp) < 0 || fputs(p->file_contexts, file->fp) < 0 ? -1 : 0;
+}
+
+int sepol_policy_file_create(sepol_policy_file_t **pf) {
+    *pf = calloc(1, sizeof(**pf));
+    return *pf ? 0 : -1;
+}
+
+void sepol_policy_file_set_fp(sepol_policy_file_t *pf, FILE *fp) { pf->fp = fp; }
+
+void sepol_policy_file_free(sepol_policy_file_t *pf) { free(pf); }
+
+int sepol_policydb_read(sepol_policydb_t *p, sepol_policy_file_t *pf) {
+    sepol_module_package_t *package = (sepol_module_package_t *)p;
+    size_t size = 0;
+    return getdelim(&package->module, &size, '\0', pf->fp) < 0 ? -1 : 0;
+}
+
+static const char makefile[] =
+    "include $(HEADERDIR)/build.conf\n"
+    "M4PARAM := -D hide_broken_symptoms -D enable_$(TYPE) -D distro_$(DISTRO) -D mls_num_sens=$(MLS_SENS) "
+    "-D mls_num_cats=$(MLS_CATS) -D mcs_num_cats=$(MCS_CATS)\n"
+    "M4SUPPORT := $(wildcard $(HEADERDIR)/support/*.spt)\n"
+    "DETECTED_IFS := $(wildcard $(HEADERDIR)/*/*.if)\n"
+    "LOCAL_IFS := $(wildcard *.if)\n"
+    "tmp/all_interfaces.conf: $(M4SUPPORT) $(DETECTED_IFS) $(LOCAL_IFS)\n"
+    "\t@test -d tmp || mkdir -p tmp\n"
+    "\t@echo \"ifdef(\\`__if_error',\\`m4exit(1)')\" > tmp/iferror.m4\n"
+    "\t@echo \"divert(-1)\" > $@\n"
+    "\t@m4 $^ tmp/iferror.m4 | sed -e s/dollarsstar/\\$$\\*/g >> $@\n"
+    "\t@echo \"divert\" >> $@\n"
+    "tmp/%.mod: $(M4SUPPORT) tmp/all_interfaces.conf %.te\n"
+    "\t@m4 $(M4PARAM) -s $^ > $(@:.mod=.tmp)\n"
+    "\t@$(BINDIR)/checkmodule -M -m $(@:.mod=.tmp) -o $@\n"
+    "tmp/%.mod.fc: $(M4SUPPORT) %.fc\n"
+    "\t@m4 $(M4PARAM) $^ > $@\n"
+    "%.pp: tmp/%.mod tmp/%.mod.fc\n"
+    "\t@$(BINDIR)/semodule_package -o $@ -m $< -f $<.fc\n";
+
+static const char build_module[] =
+    "#!/bin/bash\n"
+    "if [[ \"$1\" =~ ^[a-zA-Z0-9_-]+$ ]]\n"
+    "then\n"
+    "    make -s -f " BENCH_DIR "/devel/Makefile HEADERDIR=" BENCH_DIR "/devel/include BINDIR=" BENCH_DIR
+    "/bin -C " BENCH_DIR "/rules-make \"$1.pp\"\n"
+    "else\n"
+    "    exit 1\n"
+    "fi\n";
+
+static const char checkmodule[] =
+    "#!/bin/sh\n"
+    "while [ $# -gt 0 ]; do case \"$1\" in -o) out=\"$2\"; shift;; -M|-m) ;; *) in=\"$1\";; esac; shift; done\n"
+    "exec cp \"$in\" \"$out\"\n";
+
+static const char semodule_package[] =
+    "#!/bin/sh\n"
+    "while [ $# -gt 0 ]; do case \"$1\" in -o) out=\"$2\"; shift;; -m) mod=\"$2\"; shift;; -f) fc=\"$2\"; "
+    "shift;; esac; shift; done\n"
+    "exec cat \"$mod\" \"$fc\" > \"$out\"\n";
+
+static const char support[] =
+    "define(`interface',``define(`$1',`$2')'')\n"
+    "define(`gen_require',`$1')\n"
+    "define(`policy_module',`module $1 $2;')\n"
+    "define(`gen_context',`$1')\n";
+
+/**
+ * @brief Get the elapsed milliseconds since 'start'
+ */
+static double elapsed_ms(const struct timespec *start) {
+    struct timespec stop;
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+    return (double)(stop.tv_sec - start->tv_sec) * 1e3 + (double)(stop.tv_nsec - start->tv_nsec) * 1e-6;
+}
+
+/**
+ * @brief Write a file made of a formatted content
+ */
+__attribute__((format(printf, 3, 4))) static int write_bench_file(const char *path, mode_t mode, const char *format,
+                                                                   ...) {
+    va_list args;
+    FILE *f = fopen(path, "w");
+    if (f == NULL)
+        return -errno;
+    va_start(args, format);
+    vfprintf(f, format, args);
+    va_end(args);
+    fclose(f);
+    return chmod(path, mode) < 0 ? -errno : 0;
+}
+
+/**
+ * @brief Write the fake development tree, the stand-ins and the rules directories
+ */
+static int setup_bench_dir(void) {
+    char path[SEC_LSM_MANAGER_MAX_SIZE_PATH];
+    int rc = 0;
+
+    if (system("rm -rf " BENCH_DIR " && mkdir -p " BENCH_DIR "/bin " BENCH_DIR "/devel/include/support " BENCH_DIR
+               "/rules-make " BENCH_DIR "/rules-engine") != 0)
+        return -EIO;
+
+    rc = rc ?: write_bench_file(BENCH_DIR "/bin/checkmodule", 0755, "%s", checkmodule);
+    rc = rc ?: write_bench_file(BENCH_DIR "/bin/semodule_package", 0755, "%s", semodule_package);
+    rc = rc ?: write_bench_file(BENCH_DIR "/bin/build-module.sh", 0755, "%s", build_module);
+    rc = rc ?: write_bench_file(BENCH_DIR "/devel/Makefile", 0644, "%s", makefile);
+    rc = rc ?: write_bench_file(BENCH_DIR "/devel/include/build.conf", 0644,
+                                "TYPE = mcs\nDISTRO = redhat\nMLS_SENS = 16\nMLS_CATS = 1024\nMCS_CATS = 1024\n");
+    rc = rc ?: write_bench_file(BENCH_DIR "/devel/include/support/misc_macros.spt", 0644, "%s", support);
+
+    for (int i = 0; rc == 0 && i < INTERFACE_FILES; i++) {
+        snprintf(path, sizeof(path), BENCH_DIR "/devel/include/layer%d", i % 8);
+        mkdir(path, 0755);
+        snprintf(path, sizeof(path), BENCH_DIR "/devel/include/layer%d/module%d.if", i % 8, i);
+        FILE *f = fopen(path, "w");
+        if (f == NULL)
+            return -errno;
+        for (int j = 0; j < INTERFACES_PER_FILE; j++)
+            fprintf(f,
+                    "interface(`module%d_read_%d',`\n\tgen_require(`\n\t\ttype module%d_t;\n\t')\n"
+                    "\tallow dollarsstar module%d_t:file read;\n')\n",
+                    i, j, i, i);
+        fclose(f);
+    }
+    return rc;
+}
+
+/**
+ * @brief Write the te, if and fc files of an app in a rules directory
+ */
+static int write_app_files(const char *rules_dir, int app) {
+    char path[SEC_LSM_MANAGER_MAX_SIZE_PATH];
+    int rc;
+
+    snprintf(path, sizeof(path), "%s/app%d.te", rules_dir, app);
+    rc = write_bench_file(path, 0644, "policy_module(app%d,1.0)\ntype app%d_t;\nmodule%d_read_0(app%d_t)\napp%d_manage(app%d_t)\n",
+                          app, app, app % INTERFACE_FILES, app, app, app);
+    snprintf(path, sizeof(path), "%s/app%d.if", rules_dir, app);
+    rc = rc ?: write_bench_file(path, 0644, "interface(`app%d_manage',`\n\tallow $1 app%d_t:file manage;\n')\n", app, app);
+    snprintf(path, sizeof(path), "%s/app%d.fc", rules_dir, app);
+    rc = rc ?: write_bench_file(path, 0644, "/opt/app%d(/.*)? gen_context(system_u:object_r:app%d_t,s0)\n", app, app);
+    return rc;
+}
+
+/**
+ * @brief Compile as the daemon did before: fork build-module.sh, which runs make
+ */
+static int launch_compile_script(int app) {
+    char id[32];
+    int status = 0;
+
+    snprintf(id, sizeof(id), "app%d", app);
+    pid_t pid = vfork();
+    if (pid == 0) {
+        execl(BENCH_DIR "/bin/build-module.sh", "build-module.sh", id, NULL);
+        _exit(EXIT_FAILURE);
+    }
+    if (pid < 0 || waitpid(pid, &status, 0) < 0)
+        return -errno;
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0 ? 0 : -ECHILD;
+}
+
+/**
+ * @brief Compile with the engine of the daemon
+ */
+static int compile_engine(int app) {
+    char te[SEC_LSM_MANAGER_MAX_SIZE_PATH];
+    char ifs[SEC_LSM_MANAGER_MAX_SIZE_PATH];
+    char fc[SEC_LSM_MANAGER_MAX_SIZE_PATH];
+    char pp[SEC_LSM_MANAGER_MAX_SIZE_PATH];
+
+    snprintf(te, sizeof(te), BENCH_DIR "/rules-engine/app%d.te", app);
+    snprintf(ifs, sizeof(ifs), BENCH_DIR "/rules-engine/app%d.if", app);
+    snprintf(fc, sizeof(fc), BENCH_DIR "/rules-engine/app%d.fc", app);
+    snprintf(pp, sizeof(pp), BENCH_DIR "/rules-engine/app%d.pp", app);
+    return compile_selinux_module(te, ifs, fc, pp, NULL);
+}
+
+/** next app to compile by the threads */
+static int next_app = 0;
+
+/** result of the compilations of the threads */
+static int threads_rc = 0;
+
+/**
+ * @brief Compile apps as the workers of the daemon: through the scheduler, installed in order
+ */
+static void *compile_thread(void *arg) {
+    char te[SEC_LSM_MANAGER_MAX_SIZE_PATH];
+    char ifs[SEC_LSM_MANAGER_MAX_SIZE_PATH];
+    char fc[SEC_LSM_MANAGER_MAX_SIZE_PATH];
+    char pp[SEC_LSM_MANAGER_MAX_SIZE_PATH];
+    compile_job_t job;
+    int rc = 0;
+
+    (void)arg;
+    for (int app = __atomic_fetch_add(&next_app, 1, __ATOMIC_RELAXED); rc == 0 && app < APPS;
+         app = __atomic_fetch_add(&next_app, 1, __ATOMIC_RELAXED)) {
+        snprintf(te, sizeof(te), BENCH_DIR "/rules-engine/app%d.te", app);
+        snprintf(ifs, sizeof(ifs), BENCH_DIR "/rules-engine/app%d.if", app);
+        snprintf(fc, sizeof(fc), BENCH_DIR "/rules-engine/app%d.fc", app);
+        snprintf(pp, sizeof(pp), BENCH_DIR "/rules-engine/app%d.pp", app);
+        compile_job_submit(&job, NULL);
+        rc = compile_job_start(&job);
+        if (rc == 0) {
+            rc = compile_selinux_module(te, ifs, fc, pp, &job);
+            compile_job_stop(&job);
+        }
+        rc = rc ?: compile_job_wait_turn(&job);
+        compile_job_end(&job);
+    }
+    if (rc < 0)
+        threads_rc = rc;
+    return NULL;
+}
+
+/**
+ * @brief Compile all the apps with some threads
+ *
+ * @return the time spent in ms or a negative value on error
+ */
+static double compile_threads(unsigned count) {
+    pthread_t threads[count];
+    struct timespec start;
+
+    next_app = 0;
+    max_running_jobs = count;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (unsigned i = 0; i < count; i++)
+        pthread_create(&threads[i], NULL, compile_thread, NULL);
+    for (unsigned i = 0; i < count; i++)
+        pthread_join(threads[i], NULL);
+    return threads_rc < 0 ? -1 : elapsed_ms(&start);
+}
+
+int main(void) {
+    struct timespec start;
+    double script_ms = 0, engine_ms = 0, first_ms = 0, ms;
+    int rc = setup_bench_dir();
+
+    setenv("SELINUX_DEVEL_DIR", SELINUX_DEVEL_DIR, 1);
+    for (int app = 0; rc == 0 && app < APPS; app++) {
+        rc = write_app_files(BENCH_DIR "/rules-make", app);
+        rc = rc ?: write_app_files(BENCH_DIR "/rules-engine", app);
+        if (rc < 0)
+            break;
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        rc = launch_compile_script(app);
+        script_ms += elapsed_ms(&start);
+        if (rc < 0) {
+            fprintf(stderr, "build-module.sh app%d failed\n", app);
+            break;
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        rc = compile_engine(app);
+        ms = elapsed_ms(&start);
+        if (rc < 0) {
+            fprintf(stderr, "compile_selinux_module app%d failed\n", app);
+            break;
+        }
+        if (app == 0)
+            first_ms = ms;
+        else
+            engine_ms += ms;
+    }
+
+    if (rc < 0) {
+        fprintf(stderr, "bench failed : %d %s\n", -rc, strerror(-rc));
+        return 1;
+    }
+
+    printf("%d modules, %d interface files of %d interfaces\n", APPS, INTERFACE_FILES, INTERFACES_PER_FILE);
+    printf("%-28s %10.3f ms per module\n", "build-module.sh + make", script_ms / APPS);
+    printf("%-28s %10.3f ms (expands the interfaces)\n", "compile_selinux_module first", first_ms);
+    printf("%-28s %10.3f ms per module\n", "compile_selinux_module next", engine_ms / (APPS - 1));
+
+    // up to the online processors, or to SELINUX_COMPILE_JOBS if set
+    const char *value = getenv("SELINUX_COMPILE_JOBS");
+    long cpus = value ? strtol(value, NULL, 10) : sysconf(_SC_NPROCESSORS_ONLN);
+    double single_ms = 0;
+    for (unsigned count = 1; count <= (unsigned)(cpus > 1 ? cpus : 1); count *= 2) {
+        ms = compile_threads(count);
+        if (ms < 0) {
+            fprintf(stderr, "compilation with %u threads failed\n", count);
+            return 1;
+        }
+        if (count == 1)
+            single_ms = ms;
+        printf("%2u compile jobs %21.3f ms for %d modules (speedup %.2f)\n", count, ms, APPS, single_ms / ms);
+    }
+    return 0;
+}
@@ -0,0 +1,206 @@
+/*
+ * Copyright (C) 2020-2021 IoT.bzh Company
+ * Author: Arthur Guyader <arthur.guyader@iot.bzh>
+ *
+ * $RP_BEGIN_LICENSE$
+ * Commercial License Usage
+ *  Licensees holding valid commercial IoT.bzh licenses may use this file in
+ *  accordance with the commercial license agreement provided with the
+ *  Software or, alternatively, in accordance with the terms contained in
+ *  a written agreement between you and The IoT.bzh Company. For licensing terms
+ *  and conditions see https://www.iot.bzh/terms-conditions. For further
+ *  information use the contact form at https://www.iot.bzh/contact.
+ *
+ * GNU General Public License Usage
+ *  Alternatively, this file may be used under the terms of the GNU General
+ *  Public license version 3. This license is as published by the Free Software
+ *  Foundation and appearing in the file LICENSE.GPLv3 included in the packaging
+ *  of this file. Please review the following information to ensure the GNU
+ *  General Public License requirements will be met
+ *  https://www.gnu.org/licenses/gpl-3.0.html.
+ * $RP_END_LICENSE$
+ */
+
+/*
+ * Benchmark of the smack labeling of the paths of an app (simulation)
+ *
+ * A tree of directories, data files and executables is written under
+ * BENCH_DIR, then each entry is labeled as the daemon did before, with access,
+ * stat, stat again and an lsetxattr per attribute, each resolving the path,
+ * and with label_path which opens the entry once, reads its type with one
+ * fstat and sets its attributes through the descriptor.
+ *
+ * The labels are written again at each run, except for the last one which
+ * relabels the tree as a reinstall does, reading the labels and skipping the
+ * ones already set.
+ */
+
+#define BENCH_DIR "/tmp/bench-smack-label"
+
+#if !defined(SIMULATE_SMACK)
+#define SIMULATE_SMACK
+#endif
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/xattr.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../arena.c"
+#include "../hash-index.c"
+#include "../log.c"
+#include "../paths.c"
+#include "../permissions.c"
+#include "../secure-app.c"
+#include "../simulation/smack/smack.c"
+#include "../smack-template.c"
+#include "../smack.c"
+#include "../template.c"
+#include "../utils.c"
+
+#define FILES_PER_DIR 100
+#define EXEC_EVERY 10
+
+static const size_t bench_counts[] = {1000, 10000};
+
+static const char *const bench_methods[] = {"path", "fd", "reinstall"};
+
+/**
+ * @brief Get the elapsed milliseconds since 'start'
+ */
+static double elapsed_ms(const struct timespec *start) {
+    struct timespec stop;
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+    return (double)(stop.tv_sec - start->tv_sec) * 1e3 + (double)(stop.tv_nsec - start->tv_nsec) * 1e-6;
+}
+
+/**
+ * @brief Get the path of the entry 'i' of the tree
+ * Every FILES_PER_DIR entries, the entry is the directory of the next ones
+ */
+static void entry_path(char *path, size_t size, size_t i) {
+    if (i % FILES_PER_DIR == 0)
+        snprintf(path, size, "%s/dir-%zu", BENCH_DIR, i / FILES_PER_DIR);
+    else
+        snprintf(path, size, "%s/dir-%zu/file-%zu", BENCH_DIR, i / FILES_PER_DIR, i);
+}
+
+/**
+ * @brief Write a tree of 'count' entries
+ */
+static int create_tree(size_t count) {
+    char path[SEC_LSM_MANAGER_MAX_SIZE_PATH];
+    int rc = mkdir(BENCH_DIR, 0755);
+    if (rc < 0 && errno != EEXIST)
+        return -errno;
+
+    for (size_t i = 0; i < count; i++) {
+        entry_path(path, sizeof(path), i);
+        if (i % FILES_PER_DIR == 0) {
+            rc = mkdir(path, 0755);
+            if (rc < 0 && errno != EEXIST)
+                return -errno;
+        } else {
+            rc = create_file(path);
+            if (rc < 0)
+                return rc;
+            if (i % EXEC_EVERY == 0 && chmod(path, 0755) < 0)
+                return -errno;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Remove the tree of 'count' entries
+ */
+static void remove_tree(size_t count) {
+    char path[SEC_LSM_MANAGER_MAX_SIZE_PATH];
+
+    for (size_t i = count; i-- > 0;) {
+        entry_path(path, sizeof(path), i);
+        remove(path);
+    }
+    rmdir(BENCH_DIR);
+}
+
+/**
+ * @brief Label a path as the daemon did before, resolving the path at each step
+ */
+static int path_label(const char *path, const char *label, int is_executable, int is_transmute) {
+    if (!check_file_exists(path))
+        return -EINVAL;
+
+    if (lsetxattr(path, XATTR_NAME_SMACK, label, strlen(label), 0) < 0)
+        return -errno;
+
+    if (is_executable && check_file_type(path, S_IFREG) && check_executable(path)) {
+        char *label_no_exec = strndupa(label, strlen(label) - strlen(suffix_exec));
+        if (lsetxattr(path, XATTR_NAME_SMACKEXEC, label_no_exec, strlen(label_no_exec), 0) < 0)
+            return -errno;
+    }
+
+    if (is_transmute && check_file_type(path, S_IFDIR)) {
+        if (lsetxattr(path, XATTR_NAME_SMACKTRANSMUTE, "TRUE", 4, 0) < 0)
+            return -errno;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Label the tree of 'count' entries
+ */
+static int label_tree(size_t count, int by_path, label_count_t *labels) {
+    char path[SEC_LSM_MANAGER_MAX_SIZE_PATH];
+    int rc = 0;
+
+    for (size_t i = 0; rc >= 0 && i < count; i++) {
+        entry_path(path, sizeof(path), i);
+        int is_dir = i % FILES_PER_DIR == 0;
+        int is_exec = !is_dir && i % EXEC_EVERY == 0;
+        const char *label = is_exec ? "App:bench:Exec" : "App:bench";
+        rc = by_path ? path_label(path, label, is_exec, is_dir) : label_path(path, label, is_exec, is_dir, labels);
+    }
+    return rc;
+}
+
+int main(void) {
+    struct timespec start;
+    double label_ms;
+    label_count_t labels;
+    int rc;
+
+    printf("%-8s %-10s %12s %12s %8s %8s\n", "entries", "method", "label ms", "us/entry", "written", "skipped");
+    for (size_t i = 0; i < sizeof(bench_counts) / sizeof(*bench_counts); i++) {
+        rc = create_tree(bench_counts[i]);
+        if (rc < 0) {
+            fprintf(stderr, "create tree failed : %d %s\n", -rc, strerror(-rc));
+            remove_tree(bench_counts[i]);
+            return 1;
+        }
+
+        for (size_t m = 0; m < sizeof(bench_methods) / sizeof(*bench_methods); m++) {
+            int reinstall = !strcmp(bench_methods[m], "reinstall");
+            setenv("LABEL_COMPARE", reinstall ? "1" : "0", 1);
+            labels.written = labels.skipped = 0;
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            rc = label_tree(bench_counts[i], m == 0, &labels);
+            label_ms = elapsed_ms(&start);
+            if (rc < 0) {
+                fprintf(stderr, "label failed : %d %s\n", -rc, strerror(-rc));
+                remove_tree(bench_counts[i]);
+                return 1;
+            }
+            printf("%-8zu %-10s %12.3f %12.3f %8u %8u\n", bench_counts[i], bench_methods[m], label_ms,
+                   label_ms * 1e3 / (double)bench_counts[i], labels.written, labels.skipped);
+        }
+
+        remove_tree(bench_counts[i]);
+    }
+    return 0;
+}
@@ -0,0 +1,197 @@
+/*
+ * Copyright (C) 2020-2021 IoT.bzh Company
+ * Author: Arthur Guyader <arthur.guyader@iot.bzh>
+ *
+ * $RP_BEGIN_LICENSE$
+ * Commercial License Usage
+ *  Licensees holding valid commercial IoT.bzh licenses may use this file in
+ *  accordance with the commercial license agreement provided with the
+ *  Software or, alternatively, in accordance with the terms contained in
+ *  a written agreement between you and The IoT.bzh Company. For licensing terms
+ *  and conditions see https://www.iot.bzh/terms-conditions. For further
+ *  information use the contact form at https://www.iot.bzh/contact.
+ *
+ * GNU General Public License Usage
+ *  Alternatively, this file may be used under the terms of the GNU General
+ *  Public license version 3. This license is as published by the Free Software
+ *  Foundation and appearing in the file LICENSE.GPLv3 included in the packaging
+ *  of this file. Please review the following information to ensure the GNU
+ *  General Public License requirements will be met
+ *  https://www.gnu.org/licenses/gpl-3.0.html.
+ * $RP_END_LICENSE$
+ */
+
+
+/*
+ * Benchmark of the rendering of templates
+ *
+ * A template of N blocks, each with replacements of id and id_underscore
+ * and a section on a permission the app has for half of the blocks, is
+ * rendered R times for an app. The former way reads the file and lets
+ * mustach scan its tags for each rendering. The compiled way reads and
+ * compiles the template once, then walks its instructions. The outputs are
+ * checked to be the same.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../arena.c"
+#include "../hash-index.c"
+#include "../log.c"
+#include "../mustach/mustach.c"
+#include "../paths.c"
+#include "../permissions.c"
+#include "../secure-app.c"
+#include "../template.c"
+#include "../utils.c"
+
+static const size_t bench_blocks[] = {10, 100, 1000};
+
+#define RENDERINGS 200
+
+/**
+ * @brief Get the elapsed milliseconds since 'start'
+ */
+static double elapsed_ms(const struct timespec *start) {
+    struct timespec stop;
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+    return (double)(stop.tv_sec - start->tv_sec) * 1e3 + (double)(stop.tv_nsec - start->tv_nsec) * 1e-6;
+}
+
+static int mustach_put(void *closure, const char *name, int escape, FILE *file) {
+    (void)escape;
+    secure_app_t *secure_app = (secure_app_t *)closure;
+    if (!strcmp(name, "id")) {
+        fputs(secure_app->id, file);
+    } else if (!strcmp(name, "id_underscore")) {
+        fputs(secure_app->id_underscore, file);
+    }
+    return 0;
+}
+
+static int mustach_enter(void *closure, const char *name) {
+    secure_app_t *secure_app = (secure_app_t *)closure;
+    return permission_set_has_permission(&(secure_app->permission_set), name, true);
+}
+
+static int mustach_next(void *closure) {
+    (void)closure;
+    return 0;
+}
+
+static struct mustach_itf mustach_itf = {
+    .enter = mustach_enter, .put = mustach_put, .next = mustach_next, .leave = mustach_next};
+
+/**
+ * @brief Render a template the former way: read it and run mustach
+ */
+static int mustach_render(const char *path, secure_app_t *secure_app, char **result, size_t *size) {
+    char *template = read_file(path);
+    if (template == NULL)
+        return -EINVAL;
+    int rc = mustach(template, &mustach_itf, secure_app, result, size);
+    free(template);
+    return rc < 0 ? -EINVAL : 0;
+}
+
+/**
+ * @brief Write a template of 'blocks' blocks
+ */
+static int write_template(const char *path, size_t blocks) {
+    FILE *file = fopen(path, "w");
+    if (file == NULL)
+        return -errno;
+    for (size_t i = 0; i < blocks; i++) {
+        fprintf(file,
+                "type {{id_underscore}}_%zu_t;\n"
+                "allow {{id_underscore}}_t {{id_underscore}}_%zu_t:file { read getattr open };\n"
+                "{{#urn:AGL:permission:bench:%zu}}\n"
+                "allow {{id_underscore}}_t {{id_underscore}}_%zu_t:dir { search };\n"
+                "App:{{id}} App:{{id}}:%zu rwx\n"
+                "{{/urn:AGL:permission:bench:%zu}}\n",
+                i, i, i, i, i, i);
+    }
+    return fclose(file) ? -errno : 0;
+}
+
+int main(void) {
+    char path[] = "/tmp/bench-template-XXXXXX";
+    secure_app_t *secure_app = NULL;
+    struct timespec start;
+    char *result = NULL;
+    char *expected = NULL;
+    size_t size = 0;
+    size_t expected_size = 0;
+    double first_ms, render_ms;
+    int rc;
+
+    int fd = mkstemp(path);
+    if (fd < 0)
+        return 1;
+    close(fd);
+
+    printf("%-8s %-10s %10s %12s %14s\n", "blocks", "method", "size", "first ms", "render us");
+    for (size_t i = 0; i < sizeof(bench_blocks) / sizeof(*bench_blocks); i++) {
+        rc = create_secure_app(&secure_app);
+        if (rc >= 0)
+            rc = secure_app_set_id(secure_app, "bench-app");
+        for (size_t j = 0; rc >= 0 && j < bench_blocks[i]; j += 2) {
+            char permission[64];
+            snprintf(permission, sizeof(permission), "urn:AGL:permission:bench:%zu", j);
+            rc = secure_app_add_permission(secure_app, permission);
+        }
+        if (rc >= 0)
+            rc = write_template(path, bench_blocks[i]);
+        if (rc < 0)
+            goto error;
+
+        for (int compiled = 0; compiled <= 1; compiled++) {
+            render_ms = 0;
+            first_ms = 0;
+            for (size_t r = 0; r < RENDERINGS; r++) {
+                clock_gettime(CLOCK_MONOTONIC, &start);
+                rc = compiled ? render_template(path, secure_app, &result, &size)
+                              : mustach_render(path, secure_app, &result, &size);
+                double ms = elapsed_ms(&start);
+                if (rc < 0)
+                    goto error;
+                if (r == 0)
+                    first_ms = ms;
+                else
+                    render_ms += ms;
+
+                if (expected == NULL) {
+                    expected = result;
+                    expected_size = size;
+                    continue;
+                }
+                if (size != expected_size || memcmp(result, expected, size)) {
+                    fprintf(stderr, "bench failed : renderings differ\n");
+                    free(result);
+                    goto error;
+                }
+                free(result);
+            }
+            printf("%-8zu %-10s %10zu %12.3f %14.2f\n", bench_blocks[i], compiled ? "compiled" : "mustach",
+                   expected_size, first_ms, render_ms * 1e3 / (RENDERINGS - 1));
+        }
+
+        free(expected);
+        expected = NULL;
+        destroy_secure_app(secure_app);
+    }
+
+    unlink(path);
+    return 0;
+
+error:
+    fprintf(stderr, "bench failed : %d\n", rc);
+    free(expected);
+    destroy_secure_app(secure_app);
+    unlink(path);
+    return 1;
+}
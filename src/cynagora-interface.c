@@ -38,21 +38,33 @@
 #include <errno.h>
 #include <string.h>
 
+#include "arena.h"
 #include "log.h"
 
-/**********************/
-/*** PUBLIC METHODS ***/
-/**********************/
+/**
+ * @brief Policies of an id read from cynagora
+ */
+typedef struct current_policies {
+    permission_set_t authorized; /**< permissions authorized as set by cynagora_set_policies */
+    permission_set_t others;     /**< permissions with other sessions, users, values or expirations */
+    int rc;                      /**< status of the read */
+} current_policies_t;
 
-/* see cynagora-interface.h */
-int cynagora_set_policies(cynagora_t *cynagora, const char *id, const permission_set_t *permission_set) {
-    // enter to modify policies cynagora
-    int rc = cynagora_enter(cynagora);
-    if (rc < 0) {
-        ERROR("cynagora_enter : %d %s", -rc, strerror(-rc));
-        return rc;
-    }
+/***********************/
+/*** PRIVATE METHODS ***/
+/***********************/
 
+/**
+ * @brief Set the permissions of an id, inside a transaction
+ *
+ * @param[in] cynagora cynagora admin client
+ * @param[in] id id of the application
+ * @param[in] permission_set the permissions
+ * @return 0 in case of success or a negative -errno value
+ */
+__nonnull() __wur static int set_policies(cynagora_t *cynagora, const char *id,
+                                          const permission_set_t *permission_set) {
+    int rc = 0;
     size_t i = 0;
     cynagora_key_t k = {
         .client = id,
@@ -73,16 +85,184 @@ int cynagora_set_policies(cynagora_t *cynagora, const char *id, const permission
         i++;
     }
 
-    // leave and apply modification
+    return rc;
+}
+
+/**
+ * @brief Drop the permissions of an id, inside a transaction
+ *
+ * @param[in] cynagora cynagora admin client
+ * @param[in] id id of the application
+ * @return 0 in case of success or a negative -errno value
+ */
+__nonnull() __wur static int drop_policies(cynagora_t *cynagora, const char *id) {
+    cynagora_key_t key = {
+        .client = id,
+        .session = CYNAGORA_SELECT_ALL,
+        .user = CYNAGORA_SELECT_ALL,
+        .permission = CYNAGORA_SELECT_ALL};
+    int rc = cynagora_drop(cynagora, &key);
+    if (rc < 0)
+        ERROR("cynagora_drop : %d %s", -rc, strerror(-rc));
+    return rc;
+}
+
+/**
+ * @brief Drop the permission of an id, inside a transaction
+ *
+ * @param[in] cynagora cynagora admin client
+ * @param[in] id id of the application
+ * @param[in] permission the permission
+ * @return 0 in case of success or a negative -errno value
+ */
+__nonnull() __wur static int drop_policy(cynagora_t *cynagora, const char *id, const char *permission) {
+    cynagora_key_t key = {
+        .client = id,
+        .session = CYNAGORA_SELECT_ALL,
+        .user = CYNAGORA_SELECT_ALL,
+        .permission = permission};
+    int rc = cynagora_drop(cynagora, &key);
+    if (rc < 0)
+        ERROR("cynagora_drop %s : %d %s", permission, -rc, strerror(-rc));
+    return rc;
+}
+
+/**
+ * @brief Record a policy read from cynagora (callback of cynagora_get)
+ *
+ * @param[in] closure the current policies
+ * @param[in] key the key of the policy
+ * @param[in] value the value of the policy
+ */
+static void get_policy(void *closure, const cynagora_key_t *key, const cynagora_value_t *value) {
+    current_policies_t *current = closure;
+    permission_set_t *set = &current->others;
+
+    if (!strcmp(key->session, CYNAGORA_INSERT_ALL) && !strcmp(key->user, CYNAGORA_INSERT_ALL) &&
+        !strcmp(value->value, CYNAGORA_AUTHORIZED) && value->expire == 0 &&
+        !permission_set_has_permission(&current->authorized, key->permission, false)) {
+        set = &current->authorized;
+    }
+
+    if (current->rc == 0 && !permission_set_has_permission(set, key->permission, false)) {
+        current->rc = permission_set_add_permission(set, key->permission);
+    }
+}
+
+/**
+ * @brief Read the policies of an id, inside a transaction
+ *
+ * @param[in] cynagora cynagora admin client
+ * @param[in] id id of the application
+ * @param[in,out] current initialized policies receiving the ones read
+ * @return 0 in case of success or a negative -errno value
+ */
+__nonnull() __wur static int get_policies(cynagora_t *cynagora, const char *id, current_policies_t *current) {
+    cynagora_key_t key = {
+        .client = id,
+        .session = CYNAGORA_SELECT_ALL,
+        .user = CYNAGORA_SELECT_ALL,
+        .permission = CYNAGORA_SELECT_ALL};
+
+    current->rc = 0;
+    int rc = cynagora_get(cynagora, &key, get_policy, current);
+    if (rc < 0 || current->rc < 0) {
+        rc = rc < 0 ? rc : current->rc;
+        ERROR("cynagora_get %s : %d %s", id, -rc, strerror(-rc));
+    }
+    return rc;
+}
+
+/**
+ * @brief Change the policies of an id to the permissions, inside a transaction
+ * The current policies of the id are compared with the permissions through
+ * their hashed sets: only the permissions added are set and only the ones
+ * removed are dropped. A permission set in another way is dropped and set.
+ *
+ * @param[in] cynagora cynagora admin client
+ * @param[in] id id of the application
+ * @param[in] current the policies read by get_policies
+ * @param[in] permission_set the permissions
+ * @return the count of changes in case of success or a negative -errno value
+ */
+__nonnull() __wur static int sync_policies(cynagora_t *cynagora, const char *id, const current_policies_t *current,
+                                           const permission_set_t *permission_set) {
+    int rc = 0;
+    int changes = 0;
+    cynagora_key_t k = {
+        .client = id,
+        .session = CYNAGORA_INSERT_ALL,
+        .user = CYNAGORA_INSERT_ALL,
+        .permission = NULL};
+    cynagora_value_t v = {
+        .value = CYNAGORA_AUTHORIZED,
+        .expire = 0 /* infinite */};
+
+    // drop first, a drop selects all the sessions and users of the permission
+    for (size_t i = 0; rc >= 0 && i < current->others.size; i++) {
+        rc = drop_policy(cynagora, id, current->others.permissions[i]);
+        changes++;
+    }
+    for (size_t i = 0; rc >= 0 && i < current->authorized.size; i++) {
+        const char *permission = current->authorized.permissions[i];
+        if (!permission_set_has_permission(permission_set, permission, false) &&
+            !permission_set_has_permission(&current->others, permission, false)) {
+            rc = drop_policy(cynagora, id, permission);
+            changes++;
+        }
+    }
+
+    for (size_t i = 0; rc >= 0 && i < permission_set->size; i++) {
+        k.permission = permission_set->permissions[i];
+        if (permission_set_has_permission(&current->authorized, k.permission, false) &&
+            !permission_set_has_permission(&current->others, k.permission, false)) {
+            continue;
+        }
+        rc = cynagora_set(cynagora, &k, &v);
+        if (rc < 0) {
+            ERROR("cynagora_set : %d %s", -rc, strerror(-rc));
+        }
+        changes++;
+    }
+
+    return rc < 0 ? rc : changes;
+}
+
+/**
+ * @brief Leave a transaction, committing it if 'rc' is 0
+ *
+ * @param[in] cynagora cynagora admin client
+ * @param[in] rc the status of the transaction
+ * @return 0 in case of success or a negative -errno value
+ */
+__nonnull() __wur static int leave_transaction(cynagora_t *cynagora, int rc) {
     int rc2 = cynagora_leave(cynagora, rc == 0);
     if (rc2 < 0)
-        ERROR("cynagora_leave : %d %s", -rc, strerror(-rc));
+        ERROR("cynagora_leave : %d %s", -rc2, strerror(-rc2));
     if (rc == 0)
         rc = rc2;
-
     return rc;
 }
 
+/**********************/
+/*** PUBLIC METHODS ***/
+/**********************/
+
+/* see cynagora-interface.h */
+int cynagora_set_policies(cynagora_t *cynagora, const char *id, const permission_set_t *permission_set) {
+    // enter to modify policies cynagora
+    int rc = cynagora_enter(cynagora);
+    if (rc < 0) {
+        ERROR("cynagora_enter : %d %s", -rc, strerror(-rc));
+        return rc;
+    }
+
+    rc = set_policies(cynagora, id, permission_set);
+
+    // leave and apply modification
+    return leave_transaction(cynagora, rc);
+}
+
 /* see cynagora-interface.h */
 int cynagora_drop_policies(cynagora_t *cynagora, const char *id) {
     // enter to modify policies cynagora
@@ -92,21 +272,48 @@ int cynagora_drop_policies(cynagora_t *cynagora, const char *id) {
         return rc;
     }
 
-    cynagora_key_t key = {
-        .client = id,
-        .session = CYNAGORA_SELECT_ALL,
-        .user = CYNAGORA_SELECT_ALL,
-        .permission = CYNAGORA_SELECT_ALL};
-    rc = cynagora_drop(cynagora, &key);
-    if (rc < 0)
-        ERROR("cynagora_drop : %d %s", -rc, strerror(-rc));
+    rc = drop_policies(cynagora, id);
 
     // leave and apply modification
-    int rc2 = cynagora_leave(cynagora, rc == 0);
-    if (rc2 < 0)
-        ERROR("cynagora_leave : %d %s", -rc2, strerror(-rc2));
-    if (rc == 0)
-        rc = rc2;
+    return leave_transaction(cynagora, rc);
+}
 
-    return rc;
+/* see cynagora-interface.h */
+int cynagora_replace_policies(cynagora_t *cynagora, const char *id, const permission_set_t *permission_set) {
+    // enter to modify policies cynagora
+    int rc = cynagora_enter(cynagora);
+    if (rc < 0) {
+        ERROR("cynagora_enter : %d %s", -rc, strerror(-rc));
+        return rc;
+    }
+
+    arena_t arena;
+    current_policies_t current;
+    init_arena(&arena);
+    init_permission_set(&current.authorized, &arena);
+    init_permission_set(&current.others, &arena);
+
+    int changes = get_policies(cynagora, id, &current);
+    if (changes < 0) {
+        // the old policies can't be read: all are dropped and the new ones set
+        changes = drop_policies(cynagora, id);
+        if (changes == 0)
+            changes = set_policies(cynagora, id, permission_set);
+        if (changes == 0)
+            changes = (int)permission_set->size + 1;
+    } else {
+        // only the changes are sent, nothing is committed without change
+        changes = sync_policies(cynagora, id, &current, permission_set);
+    }
+    free_arena(&arena);
+    DEBUG("cynagora policies of %s : %d changes", id, changes);
+
+    // leave and apply modification, a failed write cancels the transaction
+    rc = cynagora_leave(cynagora, changes > 0);
+    if (rc < 0) {
+        ERROR("cynagora_leave : %d %s", -rc, strerror(-rc));
+        return rc;
+    }
+
+    return changes < 0 ? changes : 0;
 }
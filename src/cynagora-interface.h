@@ -52,4 +52,18 @@ extern int cynagora_set_policies(cynagora_t *cynagora, const char *id, const per
  */
 extern int cynagora_drop_policies(cynagora_t *cynagora, const char *id) __wur __nonnull();
 
+/**
+ * @brief Replace the policies of cynagora for an id (client)
+ * The current policies are read and only the permissions added or removed
+ * are changed, in a single transaction committed only if something changed.
+ * The application never appears without its permissions.
+ *
+ * @param[in] cynagora cynagora admin client
+ * @param[in] id id of the application
+ * @param[in] permission_set the new permissions
+ * @return 0 in case of success or a negative -errno value
+ */
+extern int cynagora_replace_policies(cynagora_t *cynagora, const char *id, const permission_set_t *permission_set)
+    __wur __nonnull();
+
 #endif
@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2018-2021 IoT.bzh Company
+ * Author: José Bollo <jose.bollo@iot.bzh>
+ * Author: Arthur Guyader <arthur.guyader@iot.bzh>
+ *
+ * $RP_BEGIN_LICENSE$
+ * Commercial License Usage
+ *  Licensees holding valid commercial IoT.bzh licenses may use this file in
+ *  accordance with the commercial license agreement provided with the
+ *  Software or, alternatively, in accordance with the terms contained in
+ *  a written agreement between you and The IoT.bzh Company. For licensing terms
+ *  and conditions see https://www.iot.bzh/terms-conditions. For further
+ *  information use the contact form at https://www.iot.bzh/contact.
+ *
+ * GNU General Public License Usage
+ *  Alternatively, this file may be used under the terms of the GNU General
+ *  Public license version 3. This license is as published by the Free Software
+ *  Foundation and appearing in the file LICENSE.GPLv3 included in the packaging
+ *  of this file. Please review the following information to ensure the GNU
+ *  General Public License requirements will be met
+ *  https://www.gnu.org/licenses/gpl-3.0.html.
+ * $RP_END_LICENSE$
+ */
+
+#include "hash-index.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <string.h>
+#include <strings.h>
+
+#include "log.h"
+
+#define MIN_HASH_INDEX_SIZE 16
+
+/***********************/
+/*** PRIVATE METHODS ***/
+/***********************/
+
+/**
+ * @brief Compute the hash of a key ignoring its case (FNV-1a)
+ *
+ * @param[in] key the key
+ * @return the hash
+ */
+__nonnull() __wur static size_t hash_key(const char *key) {
+    size_t hash = (size_t)2166136261u;
+    while (*key) {
+        hash ^= (unsigned char)tolower((unsigned char)*key++);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * @brief Put a position in the first free slot of its probing sequence
+ *
+ * @param[in] slots the slots
+ * @param[in] size the count of slots (a power of 2)
+ * @param[in] hash the hash of the key of the entry
+ * @param[in] position the position of the entry
+ */
+__nonnull() static void put_slot(size_t *slots, size_t size, size_t hash, size_t position) {
+    size_t mask = size - 1;
+    size_t i = hash & mask;
+    while (slots[i]) i = (i + 1) & mask;
+    slots[i] = position + 1;
+}
+
+/**********************/
+/*** PUBLIC METHODS ***/
+/**********************/
+
+/* see hash-index.h */
+void init_hash_index(hash_index_t *hash_index) {
+    hash_index->slots = NULL;
+    hash_index->size = 0;
+}
+
+/* see hash-index.h */
+bool hash_index_search(const hash_index_t *hash_index, const void *set, hash_index_key_t get_key, const char *key,
+                       bool ignore_case, size_t *position) {
+    size_t mask, i, slot;
+
+    if (hash_index->size == 0)
+        return false;
+
+    mask = hash_index->size - 1;
+    for (i = hash_key(key) & mask; (slot = hash_index->slots[i]) != 0; i = (i + 1) & mask) {
+        if (!(ignore_case ? strcasecmp : strcmp)(key, get_key(set, slot - 1))) {
+            if (position)
+                *position = slot - 1;
+            return true;
+        }
+    }
+    return false;
+}
+
+/* see hash-index.h */
+int hash_index_add(hash_index_t *hash_index, arena_t *arena, const void *set, hash_index_key_t get_key,
+                   size_t position) {
+    size_t size, i, *slots;
+
+    /* keep the load under 1/2 */
+    if (2 * (position + 1) > hash_index->size) {
+        size = hash_index->size ? 2 * hash_index->size : MIN_HASH_INDEX_SIZE;
+        while (2 * (position + 1) > size) size *= 2;
+        slots = arena_alloc(arena, size * sizeof(size_t));
+        if (slots == NULL) {
+            ERROR("arena_alloc slots");
+            return -ENOMEM;
+        }
+        memset(slots, 0, size * sizeof(size_t));
+        for (i = 0; i < position; i++) put_slot(slots, size, hash_key(get_key(set, i)), i);
+        hash_index->slots = slots;
+        hash_index->size = size;
+    }
+
+    put_slot(hash_index->slots, hash_index->size, hash_key(get_key(set, position)), position);
+    return 0;
+}
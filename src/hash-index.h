@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2018-2021 IoT.bzh Company
+ * Author: José Bollo <jose.bollo@iot.bzh>
+ * Author: Arthur Guyader <arthur.guyader@iot.bzh>
+ *
+ * $RP_BEGIN_LICENSE$
+ * Commercial License Usage
+ *  Licensees holding valid commercial IoT.bzh licenses may use this file in
+ *  accordance with the commercial license agreement provided with the
+ *  Software or, alternatively, in accordance with the terms contained in
+ *  a written agreement between you and The IoT.bzh Company. For licensing terms
+ *  and conditions see https://www.iot.bzh/terms-conditions. For further
+ *  information use the contact form at https://www.iot.bzh/contact.
+ *
+ * GNU General Public License Usage
+ *  Alternatively, this file may be used under the terms of the GNU General
+ *  Public license version 3. This license is as published by the Free Software
+ *  Foundation and appearing in the file LICENSE.GPLv3 included in the packaging
+ *  of this file. Please review the following information to ensure the GNU
+ *  General Public License requirements will be met
+ *  https://www.gnu.org/licenses/gpl-3.0.html.
+ * $RP_END_LICENSE$
+ */
+
+#ifndef SEC_LSM_MANAGER_HASH_INDEX_H
+#define SEC_LSM_MANAGER_HASH_INDEX_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/cdefs.h>
+
+#include "arena.h"
+
+/**
+ * @brief Get the key of the entry at 'position' in 'set'
+ */
+typedef const char *(*hash_index_key_t)(const void *set, size_t position);
+
+/**
+ * @brief Open addressing index of the string keys of the entries of a set
+ * The slots record the position of the entries plus one, 0 for empty slots.
+ * They are allocated in the arena of the indexed set.
+ * The hash of the keys ignores the case so that a same index serves both
+ * case sensitive and case insensitive searches.
+ *
+ */
+typedef struct hash_index {
+    size_t *slots;
+    size_t size;
+} hash_index_t;
+
+/**
+ * @brief Initialize the fields 'slots' and 'size'
+ *
+ * @param[in] hash_index hash_index handler
+ */
+extern void init_hash_index(hash_index_t *hash_index) __nonnull();
+
+/**
+ * @brief Search the entry of a set matching a key
+ *
+ * @param[in] hash_index hash_index handler
+ * @param[in] set the indexed set
+ * @param[in] get_key function getting the keys of the set
+ * @param[in] key the key to search
+ * @param[in] ignore_case true to compare the keys ignoring the case
+ * @param[out] position where to store the position of the found entry (can be NULL)
+ * @return true if found or false otherwise
+ */
+extern bool hash_index_search(const hash_index_t *hash_index, const void *set, hash_index_key_t get_key,
+                              const char *key, bool ignore_case, size_t *position) __wur __nonnull((1, 2, 3, 4));
+
+/**
+ * @brief Index the entry at 'position' of a set of 'position + 1' entries
+ * The index grows as needed, its previous entries being rehashed.
+ *
+ * @param[in] hash_index hash_index handler
+ * @param[in] arena the arena where to allocate the slots
+ * @param[in] set the indexed set
+ * @param[in] get_key function getting the keys of the set
+ * @param[in] position the position of the entry to index
+ * @return 0 in case of success or a negative -errno value
+ */
+extern int hash_index_add(hash_index_t *hash_index, arena_t *arena, const void *set, hash_index_key_t get_key,
+                          size_t position) __wur __nonnull();
+
+#endif
@@ -123,6 +123,16 @@ static const char help_permission_text[] =
     "Example : permission urn:AGL:permission::partner:scope-platform\n"
     "\n";
 
+static const char help_manifest_text[] =
+    "\n"
+    "Command: manifest app_id [path path path_type]... [permission permission]...\n"
+    "\n"
+    "Set the id, the paths and the permissions of the application in one request\n"
+    "The previous id, paths and permissions are cleared\n"
+    "\n"
+    "Example : manifest demo-app path /tmp/file data permission urn:AGL:permission::partner:scope-platform\n"
+    "\n";
+
 static const char help_install_text[] =
     "\n"
     "Command: install\n"
@@ -141,7 +151,8 @@ static const char help_uninstall_text[] =
 
 static const char help__text[] =
     "\n"
-    "Commands are: log, clear, display, id, path, permission, install, uninstall, quit, help\n"
+    "Commands are: log, clear, display, id, path, permission, manifest, install, uninstall, quit,\n"
+    "help\n"
     "Type 'help command' to get help on the command\n"
     "\n"
     "Example 'help log' to get help on log\n"
@@ -160,7 +171,8 @@ static const char help_help_text[] =
     "\n"
     "Gives help on the command.\n"
     "\n"
-    "Available commands: log, clear, display, id, path, permission, install, uninstall, quit, help\n"
+    "Available commands: log, clear, display, id, path, permission, manifest, install, uninstall, quit,\n"
+    "help\n"
     "\n";
 
 static sec_lsm_manager_t *sec_lsm_manager = NULL;
@@ -313,6 +325,58 @@ int do_permission(int ac, char **av) {
     return uc;
 }
 
+int do_manifest(int ac, char **av) {
+    int uc, rc, i;
+    unsigned npaths = 0, npermissions = 0;
+    const char **paths = NULL, **path_types = NULL, **permissions = NULL;
+    int n = plink(ac, av, &uc, ac);
+
+    if (n < 2) {
+        ERROR("not enough arguments");
+        last_status = -EINVAL;
+        return uc;
+    }
+
+    paths = malloc((size_t)n * sizeof *paths);
+    path_types = malloc((size_t)n * sizeof *path_types);
+    permissions = malloc((size_t)n * sizeof *permissions);
+    if (paths == NULL || path_types == NULL || permissions == NULL) {
+        ERROR("malloc failed");
+        last_status = -ENOMEM;
+        goto end;
+    }
+
+    for (i = 2; i < n;) {
+        if (!strcmp(av[i], "path") && i + 2 < n) {
+            paths[npaths] = av[i + 1];
+            path_types[npaths++] = av[i + 2];
+            i += 3;
+        } else if (!strcmp(av[i], "permission") && i + 1 < n) {
+            permissions[npermissions++] = av[i + 1];
+            i += 2;
+        } else {
+            ERROR("bad argument %s", av[i]);
+            last_status = -EINVAL;
+            goto end;
+        }
+    }
+
+    last_status = rc =
+        sec_lsm_manager_set_manifest(sec_lsm_manager, av[1], npaths, paths, path_types, npermissions, permissions);
+
+    if (rc < 0) {
+        ERROR("sec_lsm_manager_set_manifest : %d %s", -rc, strerror(-rc));
+    } else {
+        LOG("manifest of '%s' set with %u paths and %u permissions", av[1], npaths, npermissions);
+    }
+
+end:
+    free(paths);
+    free(path_types);
+    free(permissions);
+    return uc;
+}
+
 int do_install(int ac, char **av) {
     int uc, rc;
     int n = plink(ac, av, &uc, 1);
@@ -328,7 +392,9 @@ int do_install(int ac, char **av) {
     if (rc < 0) {
         ERROR("sec_lsm_manager_install : %d %s", -rc, strerror(-rc));
     } else {
-        LOG("install success");
+        unsigned written, skipped;
+        sec_lsm_manager_install_labels(sec_lsm_manager, &written, &skipped);
+        LOG("install success (%u labels written, %u skipped)", written, skipped);
     }
 
     return uc;
@@ -395,6 +461,8 @@ int do_help(int ac, char **av) {
         fprintf(stdout, "%s", help_path_text);
     else if (ac > 1 && !strcmp(av[1], "permission"))
         fprintf(stdout, "%s", help_permission_text);
+    else if (ac > 1 && !strcmp(av[1], "manifest"))
+        fprintf(stdout, "%s", help_manifest_text);
     else if (ac > 1 && !strcmp(av[1], "install"))
         fprintf(stdout, "%s", help_install_text);
     else if (ac > 1 && !strcmp(av[1], "uninstall"))
@@ -428,6 +496,9 @@ int do_any(int ac, char **av) {
     if (!strcmp(av[0], "permission"))
         return do_permission(ac, av);
 
+    if (!strcmp(av[0], "manifest"))
+        return do_manifest(ac, av);
+
     if (!strcmp(av[0], "install"))
         return do_install(ac, av);
 
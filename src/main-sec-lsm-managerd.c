@@ -45,6 +45,10 @@
 #include "sec-lsm-manager-protocol.h"
 #include "sec-lsm-manager-server.h"
 
+#if defined(WITH_SMACK)
+#include "smack-template.h"
+#endif
+
 #if !defined(SEC_LSM_MANAGER_USER)
 #define SEC_LSM_MANAGER_USER NULL
 #endif
@@ -64,29 +68,50 @@
 
 #define CAP_COUNT (sizeof cap_vector / sizeof cap_vector[0])
 
+#define _EVENTS_ 'E'
 #define _GROUP_ 'g'
 #define _GROUPS_ 'G'
 #define _HELP_ 'h'
 #define _LOG_ 'l'
+#define _LOADRULES_ 'L'
 #define _MAKESOCKDIR_ 'M'
 #define _OWNSOCKDIR_ 'O'
 #define _OWNDBDIR_ 'o'
+#define _LOADRULESONLY_ 'R'
 #define _SOCKETDIR_ 'S'
 #define _SYSTEMD_ 's'
 #define _USER_ 'u'
 #define _VERSION_ 'v'
+#define _WORKERS_ 'w'
+
+#if defined(WITH_SMACK)
+#define SMACK_SHORTOPTS "LR"
+#define SMACK_HELPTXT                                                       \
+    "    -L, --load-rules      load the smack rules of all apps at start\n" \
+    "    -R, --load-rules-only load the smack rules of all apps and exit\n"  \
+    "\n"
+#else
+#define SMACK_SHORTOPTS ""
+#define SMACK_HELPTXT ""
+#endif
 
-static const char shortopts[] = "d:g:hi:lmMOoS:u:v";
+static const char shortopts[] = "d:E:g:hi:lmMOoS:u:vw:" SMACK_SHORTOPTS;
 
-static const struct option longopts[] = {{"group", 1, NULL, _GROUP_},
+static const struct option longopts[] = {{"events", 1, NULL, _EVENTS_},
+                                         {"group", 1, NULL, _GROUP_},
                                          {"groups", 1, NULL, _GROUPS_},
                                          {"help", 0, NULL, _HELP_},
                                          {"log", 0, NULL, _LOG_},
+#if defined(WITH_SMACK)
+                                         {"load-rules", 0, NULL, _LOADRULES_},
+                                         {"load-rules-only", 0, NULL, _LOADRULESONLY_},
+#endif
                                          {"make-socket-dir", 0, NULL, _MAKESOCKDIR_},
                                          {"own-socket-dir", 0, NULL, _OWNSOCKDIR_},
                                          {"socketdir", 1, NULL, _SOCKETDIR_},
                                          {"user", 1, NULL, _USER_},
                                          {"version", 0, NULL, _VERSION_},
+                                         {"workers", 1, NULL, _WORKERS_},
                                          {NULL, 0, NULL, 0}};
 
 static const char helptxt[] =
@@ -98,12 +123,16 @@ static const char helptxt[] =
     "    -g, --group xxx       set the group\n"
     "    -G  --groups xxx,yyy  set additional groups\n"
     "    -l, --log             activate log of transactions\n"
+    "    -w, --workers n       set the count of threads running installs\n"
+    "                            (default: %u, 0 runs them in the main loop)\n"
+    "    -E, --events n        set the count of events dispatched per wait\n"
+    "                            (default: %u)\n"
     "\n"
     "    -S, --socketdir xxx   set the base directory xxx for sockets\n"
     "                            (default: %s)\n"
     "    -M, --make-socket-dir make the socket directory\n"
     "    -O, --own-socket-dir  set user and group on socket directory\n"
-    "\n"
+    "\n" SMACK_HELPTXT
     "    -h, --help            print this help and exit\n"
     "    -v, --version         print the version and exit\n"
     "\n";
@@ -119,6 +148,11 @@ int main(int ac, char **av) {
     int makesockdir = 0;
     int ownsockdir = 0;
     int flog = 0;
+#if defined(WITH_SMACK)
+    int loadrules = 0;
+#endif
+    int workers = -1;
+    int events = -1;
     int help = 0;
     int version = 0;
     int error = 0;
@@ -142,6 +176,11 @@ int main(int ac, char **av) {
     setlinebuf(stdout);
     setlinebuf(stderr);
 
+    /* one worker per online processor, so that bulk installs compile in parallel */
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus > 1)
+        sec_lsm_manager_server_workers = (unsigned)cpus;
+
     /* scan arguments */
     for (;;) {
         opt = getopt_long(ac, av, shortopts, longopts, NULL);
@@ -149,6 +188,13 @@ int main(int ac, char **av) {
             break;
 
         switch (opt) {
+            case _EVENTS_:
+                events = isid(optarg);
+                if (events <= 0) {
+                    fprintf(stderr, "invalid count of events '%s'\n", optarg);
+                    error = 1;
+                }
+                break;
             case _GROUP_:
                 group = optarg;
                 break;
@@ -161,6 +207,14 @@ int main(int ac, char **av) {
             case _LOG_:
                 flog = 1;
                 break;
+#if defined(WITH_SMACK)
+            case _LOADRULES_:
+                loadrules = loadrules ?: 1;
+                break;
+            case _LOADRULESONLY_:
+                loadrules = 2;
+                break;
+#endif
             case _MAKESOCKDIR_:
                 makesockdir = 1;
                 break;
@@ -176,6 +230,13 @@ int main(int ac, char **av) {
             case _VERSION_:
                 version = 1;
                 break;
+            case _WORKERS_:
+                workers = isid(optarg);
+                if (workers < 0) {
+                    fprintf(stderr, "invalid count of workers '%s'\n", optarg);
+                    error = 1;
+                }
+                break;
             default:
                 error = 1;
                 break;
@@ -184,7 +245,8 @@ int main(int ac, char **av) {
 
     /* handles help, version, error */
     if (help) {
-        fprintf(stdout, helptxt, sec_lsm_manager_default_socket_dir);
+        fprintf(stdout, helptxt, sec_lsm_manager_server_workers, sec_lsm_manager_server_max_events,
+                sec_lsm_manager_default_socket_dir);
         return 0;
     }
     if (version) {
@@ -319,9 +381,33 @@ int main(int ac, char **av) {
     // unset flag
     prctl(PR_SET_KEEPCAPS, 0);
 
+#if defined(WITH_SMACK)
+    /* load the rules of the installed apps */
+    if (loadrules) {
+        smack_load_stats_t stats;
+        const char *policy_dir = get_smack_policy_dir(NULL);
+        rc = policy_dir ? load_smack_rules(policy_dir, &stats) : -EINVAL;
+        if (policy_dir) {
+            printf("smack rules loaded: %zu files, %zu rules, %zu duplicates, %zu writes in %.3f ms\n", stats.files,
+                   stats.rules, stats.duplicates, stats.writes, stats.time_ms);
+        }
+        if (rc < 0) {
+            fprintf(stderr, "can not load smack rules: %s\n", strerror(-rc));
+            if (loadrules == 2)
+                return 1;
+        }
+        if (loadrules == 2)
+            return 0;
+    }
+#endif
+
     /* initialize server */
     setvbuf(stderr, NULL, _IOLBF, 1000);
     sec_lsm_manager_server_log = (bool)flog;
+    if (workers >= 0)
+        sec_lsm_manager_server_workers = (unsigned)workers;
+    if (events > 0)
+        sec_lsm_manager_server_max_events = (unsigned)events;
 
     printf("LOG = %d\n", sec_lsm_manager_server_log);
 
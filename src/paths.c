@@ -30,23 +30,34 @@
 #include "log.h"
 #include "utils.h"
 
+/***********************/
+/*** PRIVATE METHODS ***/
+/***********************/
+
+/**
+ * @brief Get the path at 'position' of a path_set (for the index)
+ */
+__nonnull() __wur static const char *get_path(const void *set, size_t position) {
+    return ((const path_set_t *)set)->paths[position]->path;
+}
+
 /**********************/
 /*** PUBLIC METHODS ***/
 /**********************/
 
 /* see paths.h */
-void init_path_set(path_set_t *path_set) {
+void init_path_set(path_set_t *path_set, arena_t *arena) {
     path_set->size = 0;
+    path_set->capacity = 0;
     path_set->paths = NULL;
+    init_hash_index(&path_set->index);
+    path_set->arena = arena;
 }
 
 /* see paths.h */
 void free_path_set(path_set_t *path_set) {
     if (path_set) {
-        while(path_set->size)
-            free(path_set->paths[--path_set->size]);
-        free(path_set->paths);
-        path_set->paths = NULL;
+        init_path_set(path_set, path_set->arena);
     }
 }
 
@@ -64,30 +75,48 @@ int path_set_add_path(path_set_t *path_set, const char *path, enum path_type pat
         return -EINVAL;
     }
 
-    path_t **path_set_tmp = (path_t **)realloc(path_set->paths, sizeof(path_t*) * (path_set->size + 1));
-    if (path_set_tmp == NULL) {
-        ERROR("realloc path_set_t");
-        return -ENOMEM;
+    if (path_set->size == path_set->capacity) {
+        size_t capacity = path_set->capacity ? 2 * path_set->capacity : 8;
+        path_t **path_set_tmp = (path_t **)arena_alloc(path_set->arena, sizeof(path_t *) * capacity);
+        if (path_set_tmp == NULL) {
+            ERROR("arena_alloc path_set_t");
+            return -ENOMEM;
+        }
+        if (path_set->size)
+            memcpy(path_set_tmp, path_set->paths, sizeof(path_t *) * path_set->size);
+        path_set->paths = path_set_tmp;
+        path_set->capacity = capacity;
     }
-    path_set->paths = path_set_tmp;
 
-    path_t *path_item = (path_t *)malloc(sizeof(path_t) + path_len + 1);
+    path_t *path_item = (path_t *)arena_alloc(path_set->arena, sizeof(path_t) + path_len + 1);
     if (path_item == NULL) {
-        ERROR("malloc path_item");
+        ERROR("arena_alloc path_item");
         return -ENOMEM;
     }
-    
+
     secure_strncpy(path_item->path, path, path_len + 1);
     if (path_item->path[path_len - 1] == '/') {
         path_item->path[path_len - 1] = '\0';
     }
 
     path_item->path_type = path_type;
-    path_set->paths[path_set->size++] = path_item;
+    path_set->paths[path_set->size] = path_item;
+
+    int rc = hash_index_add(&path_set->index, path_set->arena, path_set, get_path, path_set->size);
+    if (rc < 0) {
+        ERROR("hash_index_add : %d %s", -rc, strerror(-rc));
+        return rc;
+    }
+    path_set->size++;
 
     return 0;
 }
 
+/* see paths.h */
+bool path_set_has_path(const path_set_t *path_set, const char *path) {
+    return hash_index_search(&path_set->index, path_set, get_path, path, false, NULL);
+}
+
 /* see paths.h */
 bool valid_path_type(enum path_type path_type) {
     if (path_type > type_none && path_type < number_path_type)
@@ -28,6 +28,7 @@
 #include <stddef.h>
 #include <sys/cdefs.h>
 
+#include "hash-index.h"
 #include "limits.h"
 
 /**
@@ -70,23 +71,28 @@ typedef struct path {
 /**
  * @brief Structure of path_set
  * path_set contains several path
+ * Its memory is allocated in the arena given at initialization
  *
  */
 typedef struct path_set {
     path_t **paths;
     size_t size;
+    size_t capacity;
+    hash_index_t index;
+    arena_t *arena;
 } path_set_t;
 
 /**
  * @brief Initialize the fields 'size' and 'paths'
  *
  * @param[in] path_set path_set handler
+ * @param[in] arena The arena where the paths are allocated
  */
-extern void init_path_set(path_set_t *path_set) __nonnull();
+extern void init_path_set(path_set_t *path_set, arena_t *arena) __nonnull();
 
 /**
- * @brief Free paths that have been added
- * The pointer is not free
+ * @brief Forget paths that have been added
+ * The pointer is not free, the memory is released with the arena
  *
  * @param[in] path_set path_set handler
  */
@@ -102,6 +108,15 @@ extern void free_path_set(path_set_t *path_set) __nonnull();
  */
 extern int path_set_add_path(path_set_t *path_set, const char *path, enum path_type path_type) __wur __nonnull();
 
+/**
+ * @brief Check if a path is in paths
+ *
+ * @param[in] path_set path_set handler
+ * @param[in] path The path to search
+ * @return true if found or false otherwise
+ */
+extern bool path_set_has_path(const path_set_t *path_set, const char *path) __wur __nonnull();
+
 /**
  * @brief Check if path_type is valid
  *
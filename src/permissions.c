@@ -24,23 +24,34 @@
 #include "log.h"
 #include "utils.h"
 
+/***********************/
+/*** PRIVATE METHODS ***/
+/***********************/
+
+/**
+ * @brief Get the permission at 'position' of a permission_set (for the index)
+ */
+__nonnull() __wur static const char *get_permission(const void *set, size_t position) {
+    return ((const permission_set_t *)set)->permissions[position];
+}
+
 /**********************/
 /*** PUBLIC METHODS ***/
 /**********************/
 
 /* see permissions.h */
-void init_permission_set(permission_set_t *permission_set) {
+void init_permission_set(permission_set_t *permission_set, arena_t *arena) {
     permission_set->size = 0;
+    permission_set->capacity = 0;
     permission_set->permissions = NULL;
+    init_hash_index(&permission_set->index);
+    permission_set->arena = arena;
 }
 
 /* see permissions.h */
 void free_permission_set(permission_set_t *permission_set) {
     if (permission_set) {
-        while (permission_set->size)
-            free(permission_set->permissions[--permission_set->size]);
-        free(permission_set->permissions);
-        permission_set->permissions = NULL;
+        init_permission_set(permission_set, permission_set->arena);
     }
 }
 
@@ -52,22 +63,38 @@ int permission_set_add_permission(permission_set_t *permission_set, const char *
         return -EINVAL;
     }
 
-    size_t size = (permission_set->size + 1) * (sizeof(char*) * SEC_LSM_MANAGER_MAX_SIZE_PERMISSION);
-
-    char **permissions_tmp = realloc(permission_set->permissions, size);
-    if (permissions_tmp == NULL) {
-        ERROR("realloc permissions_tmp");
-        return -ENOMEM;
+    if (permission_set->size == permission_set->capacity) {
+        size_t capacity = permission_set->capacity ? 2 * permission_set->capacity : 8;
+        char **permissions_tmp = arena_alloc(permission_set->arena, capacity * sizeof(char *));
+        if (permissions_tmp == NULL) {
+            ERROR("arena_alloc permissions_tmp");
+            return -ENOMEM;
+        }
+        if (permission_set->size)
+            memcpy(permissions_tmp, permission_set->permissions, permission_set->size * sizeof(char *));
+        permission_set->permissions = permissions_tmp;
+        permission_set->capacity = capacity;
     }
-    permission_set->permissions = permissions_tmp;
 
-    char *perm_tmp = malloc(1 + permission_len);
+    char *perm_tmp = arena_strndup(permission_set->arena, permission, permission_len);
     if (perm_tmp == NULL) {
-        ERROR("malloc perm_tmp");
+        ERROR("arena_strndup perm_tmp");
         return -ENOMEM;
     }
-    secure_strncpy(perm_tmp, permission, 1 + permission_len);
-    permission_set->permissions[permission_set->size++] = perm_tmp;
+    permission_set->permissions[permission_set->size] = perm_tmp;
+
+    int rc = hash_index_add(&permission_set->index, permission_set->arena, permission_set, get_permission,
+                            permission_set->size);
+    if (rc < 0) {
+        ERROR("hash_index_add : %d %s", -rc, strerror(-rc));
+        return rc;
+    }
+    permission_set->size++;
 
     return 0;
 }
+
+/* see permissions.h */
+bool permission_set_has_permission(const permission_set_t *permission_set, const char *permission, bool ignore_case) {
+    return hash_index_search(&permission_set->index, permission_set, get_permission, permission, ignore_case, NULL);
+}
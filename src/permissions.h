@@ -18,32 +18,39 @@
 #ifndef SEC_LSM_MANAGER_POLICIES_H
 #define SEC_LSM_MANAGER_POLICIES_H
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <time.h>
 
+#include "hash-index.h"
 #include "limits.h"
 
 /**
  * @brief Structure of permission_set
  * permission_set contains several permission
+ * Its memory is allocated in the arena given at initialization
  *
  */
 typedef struct permission_set {
     char **permissions;
     size_t size;
+    size_t capacity;
+    hash_index_t index;
+    arena_t *arena;
 } permission_set_t;
 
 /**
  * @brief Initialize the fields 'size' and 'permissions'
  *
  * @param[in] permission_set The permission_set handler
+ * @param[in] arena The arena where the permissions are allocated
  */
-extern void init_permission_set(permission_set_t *permission_set) __nonnull();
+extern void init_permission_set(permission_set_t *permission_set, arena_t *arena) __nonnull();
 
 /**
- * @brief[in] Free permission_set that have been added
- * The pointer is not free
+ * @brief[in] Forget permission_set that have been added
+ * The pointer is not free, the memory is released with the arena
  * @param policies The permission_set handler
  */
 extern void free_permission_set(permission_set_t *permission_set) __nonnull();
@@ -58,4 +65,15 @@ extern void free_permission_set(permission_set_t *permission_set) __nonnull();
  */
 extern int permission_set_add_permission(permission_set_t *permission_set, const char *permission) __wur __nonnull();
 
+/**
+ * @brief Check if a permission is in permission_set
+ *
+ * @param[in] permission_set The permission_set handler
+ * @param[in] permission The permission to search
+ * @param[in] ignore_case true to ignore the case of the permission
+ * @return true if found or false otherwise
+ */
+extern bool permission_set_has_permission(const permission_set_t *permission_set, const char *permission,
+                                          bool ignore_case) __wur __nonnull();
+
 #endif
\ No newline at end of file
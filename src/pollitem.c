@@ -27,8 +27,32 @@
 /******************************************************************************/
 #include "pollitem.h"
 
+#include <stddef.h>
 #include <sys/epoll.h>
 
+/**
+ * Structure recording a batch of events being dispatched
+ */
+struct batch {
+    /** the received events */
+    struct epoll_event *events;
+
+    /** index of the next event to dispatch */
+    int index;
+
+    /** count of received events */
+    int count;
+
+    /** file descriptor of the epoll */
+    int pollfd;
+
+    /** batch being dispatched by a calling dispatcher */
+    struct batch *previous;
+};
+
+/** the batch being dispatched */
+static struct batch *current_batch = NULL;
+
 /**
  * @brief Wraps the call to epoll_ctl for operation 'op'
  *
@@ -54,18 +78,49 @@ int pollitem_mod(pollitem_t *pollitem, uint32_t events, int pollfd) {
 }
 
 /* see pollitem.h */
-int pollitem_del(pollitem_t *pollitem, int pollfd) { return pollitem_do(pollitem, 0, pollfd, EPOLL_CTL_DEL); }
+int pollitem_del(pollitem_t *pollitem, int pollfd) {
+    struct batch *batch;
+    int i;
+
+    /* forget the pending events of the pollitem */
+    for (batch = current_batch; batch; batch = batch->previous)
+        if (batch->pollfd == pollfd)
+            for (i = batch->index; i < batch->count; i++)
+                if (batch->events[i].data.ptr == pollitem)
+                    batch->events[i].data.ptr = NULL;
+
+    return pollitem_do(pollitem, 0, pollfd, EPOLL_CTL_DEL);
+}
 
 /* see pollitem.h */
 int pollitem_wait_dispatch(int pollfd, int timeout) {
-    int rc;
     struct epoll_event ev;
+
+    return pollitem_wait_dispatch_batch(pollfd, timeout, &ev, 1);
+}
+
+/* see pollitem.h */
+int pollitem_wait_dispatch_batch(int pollfd, int timeout, struct epoll_event *events, int maxevents) {
+    int rc;
+    struct batch batch;
+    struct epoll_event *ev;
     pollitem_t *pi;
 
-    rc = epoll_wait(pollfd, &ev, 1, timeout);
-    if (rc == 1) {
-        pi = ev.data.ptr;
-        pi->handler(pi, ev.events, pollfd);
+    rc = epoll_wait(pollfd, events, maxevents, timeout);
+    if (rc > 0) {
+        batch.events = events;
+        batch.index = 0;
+        batch.count = rc;
+        batch.pollfd = pollfd;
+        batch.previous = current_batch;
+        current_batch = &batch;
+        while (batch.index < batch.count) {
+            ev = &events[batch.index++];
+            pi = ev->data.ptr;
+            if (pi)
+                pi->handler(pi, ev->events, pollfd);
+        }
+        current_batch = batch.previous;
     }
     return rc;
 }
@@ -31,6 +31,8 @@
 /******************************************************************************/
 
 #include <stdint.h>
+#include <sys/epoll.h>
+
 /** structure for using epoll easily */
 typedef struct pollitem pollitem_t;
 
@@ -70,6 +72,8 @@ extern int pollitem_mod(pollitem_t *pollitem, uint32_t events, int pollfd);
 
 /**
  * @brief Delete a pollitem from epoll
+ * The events of the pollitem not yet dispatched in the current batch
+ * are discarded, so the pollitem can be released after this call
  *
  * @param pollitem the pollitem to delete
  * @param pollfd file descriptor of the epoll
@@ -88,4 +92,17 @@ extern int pollitem_del(pollitem_t *pollitem, int pollfd);
  */
 extern int pollitem_wait_dispatch(int pollfd, int timeout);
 
+/**
+ * @brief Wait up to 'maxevents' events on epoll and dispatch them to their pollitem callbacks
+ *
+ * @param pollfd file descriptor of the epoll
+ * @param timeout time to wait
+ * @param events array receiving the events
+ * @param maxevents count of events of the array
+ * @return 0 on timeout
+ *         the count of events received
+ *         -1 with errno set accordingly to epoll_wait
+ */
+extern int pollitem_wait_dispatch_batch(int pollfd, int timeout, struct epoll_event *events, int maxevents);
+
 #endif
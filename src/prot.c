@@ -38,36 +38,85 @@
 
 #include "limits.h"
 
-#define MAX_FIELDS 20
+#define MIN_FIELDS 20
+#define MAX_FIELDS 65536
 #define MAX_BUFFER_LENGTH 2000
+#define MIN_INPUT_LENGTH 2048
+#define MAX_INPUT_LENGTH (1024 * 1024)
+#define MAX_OUTPUT_BLOCKS (MAX_INPUT_LENGTH / MAX_BUFFER_LENGTH + 1)
+#define MAX_OUTPUT_IOVECS 16
 #define FIELD_SEPARATOR ' '
 #define RECORD_SEPARATOR '\n'
 #define ESCAPE '\\'
 
 /**
- * the structure buf is generic the meaning of pos/count is not fixed
+ * the input buffer, growing on demand up to MAX_INPUT_LENGTH
+ * and released when all its records are processed
  */
 struct buf {
-    /** a position */
+    /** start of the current record */
+    unsigned start;
+
+    /** scanning position */
     unsigned pos;
 
-    /** a count */
+    /** count of received bytes */
     unsigned count;
 
-    /* TODO: add a 3rd unsigned for improving management of read and write */
+    /** allocated size of content */
+    unsigned size;
 
-    /** a fixed size content */
-    char content[MAX_BUFFER_LENGTH];
+    /** the content (NULL when size is 0) */
+    char *content;
 };
 typedef struct buf buf_t;
 
-/** structure for recording received fields */
+/**
+ * block of the output queue
+ */
+struct block {
+    /** next block of the queue */
+    struct block *next;
+
+    /** position of the first byte to be written */
+    unsigned pos;
+
+    /** count of bytes put in content */
+    unsigned count;
+
+    /** the content */
+    char content[MAX_BUFFER_LENGTH];
+};
+typedef struct block block_t;
+
+/**
+ * the output queue, a list of blocks
+ */
+struct queue {
+    /** first block, the one to be written */
+    block_t *head;
+
+    /** last block, the one to be filled */
+    block_t *tail;
+
+    /** count of blocks */
+    unsigned count;
+
+    /** maximum count of blocks, raised by prot_grow_output until the queue is written */
+    unsigned max;
+};
+typedef struct queue queue_t;
+
+/** structure for recording received fields, growing up to MAX_FIELDS */
 struct fields {
     /** count of field (negative if invalid) */
     int count;
 
+    /** allocated count of fields */
+    unsigned size;
+
     /** the fields as strings */
-    const char *fields[MAX_FIELDS];
+    const char **fields;
 };
 typedef struct fields fields_t;
 
@@ -75,16 +124,19 @@ typedef struct fields fields_t;
  * structure for handling the protocol
  */
 struct prot {
-    /** input buf, pos is the scanning position */
+    /** input buf */
     buf_t inbuf;
 
-    /** output buf, pos is to be written position */
-    buf_t outbuf;
+    /** output queue */
+    queue_t outq;
 
     /** count of pending output fields */
     unsigned outfields;
 
-    /** cancel index when putting values */
+    /** cancel block when putting values */
+    block_t *cancelblk;
+
+    /** cancel index in the cancel block when putting values */
     unsigned cancelidx;
 
     /** the fields */
@@ -92,96 +144,125 @@ struct prot {
 };
 
 /**
- * Put the 'car' into the 'buf'
+ * Remove the blocks following 'block' (all blocks if 'block' is NULL)
+ * and set the count of 'block' to 'count'
+ */
+static void queue_truncate(queue_t *queue, block_t *block, unsigned count) {
+    block_t *next;
+
+    next = block ? block->next : queue->head;
+    while (next) {
+        block_t *blk = next;
+        next = blk->next;
+        free(blk);
+        queue->count--;
+    }
+    if (block) {
+        block->next = NULL;
+        block->count = count;
+    } else {
+        queue->head = NULL;
+        queue->max = MAX_OUTPUT_BLOCKS;
+    }
+    queue->tail = block;
+}
+
+/**
+ * Ensure that the tail of 'queue' has room for at least one char
  * returns:
  *  - 0 on success
- *  - -ECANCELED if there is not enought space in the buffer
+ *  - -ECANCELED if the queue is full or can't grow
  */
-static int buf_put_car(buf_t *buf, char car) {
-    unsigned pos;
+static int queue_reserve(queue_t *queue) {
+    block_t *block;
+
+    if (queue->tail && queue->tail->count < MAX_BUFFER_LENGTH)
+        return 0;
 
-    pos = buf->count;
-    if (pos >= MAX_BUFFER_LENGTH)
+    if (queue->count >= queue->max)
         return -ECANCELED;
 
-    buf->count = pos + 1;
-    pos += buf->pos;
-    if (pos >= MAX_BUFFER_LENGTH)
-        pos -= MAX_BUFFER_LENGTH;
-    buf->content[pos] = car;
+    block = malloc(sizeof *block);
+    if (block == NULL)
+        return -ECANCELED;
+
+    block->next = NULL;
+    block->pos = block->count = 0;
+    if (queue->tail)
+        queue->tail->next = block;
+    else
+        queue->head = block;
+    queue->tail = block;
+    queue->count++;
     return 0;
 }
 
 /**
- * Put the 'string' into the 'buf' escaping it at need
+ * Put the 'car' into the 'queue'
  * returns:
  *  - 0 on success
- *  - -ECANCELED if there is not enought space in the buffer
+ *  - -ECANCELED if there is not enought space in the queue
  */
-static int buf_put_string(buf_t *buf, const char *string) {
-    unsigned pos, remain;
-    char c;
+static int queue_put_car(queue_t *queue, char car) {
+    int rc;
 
-    remain = buf->count;
-    pos = buf->pos + remain;
-    if (pos >= MAX_BUFFER_LENGTH)
-        pos -= MAX_BUFFER_LENGTH;
-    remain = MAX_BUFFER_LENGTH - remain;
+    rc = queue_reserve(queue);
+    if (rc == 0)
+        queue->tail->content[queue->tail->count++] = car;
+    return rc;
+}
+
+/**
+ * Put the 'string' into the 'queue' escaping it at need
+ * returns:
+ *  - 0 on success
+ *  - -ECANCELED if there is not enought space in the queue
+ */
+static int queue_put_string(queue_t *queue, const char *string) {
+    int rc = 0;
+    char c;
 
     /* put all chars of the string */
-    while ((c = *string++)) {
+    while (rc == 0 && (c = *string++)) {
         /* escape special characters */
-        if (c == FIELD_SEPARATOR || c == RECORD_SEPARATOR || c == ESCAPE) {
-            if (!remain--)
-                goto cancel;
-            buf->content[pos++] = ESCAPE;
-            if (pos == MAX_BUFFER_LENGTH)
-                pos = 0;
-        }
+        if (c == FIELD_SEPARATOR || c == RECORD_SEPARATOR || c == ESCAPE)
+            rc = queue_put_car(queue, ESCAPE);
         /* put the char */
-        if (!remain--)
-            goto cancel;
-        buf->content[pos++] = c;
-        if (pos == MAX_BUFFER_LENGTH)
-            pos = 0;
+        if (rc == 0)
+            rc = queue_put_car(queue, c);
     }
-
-    /* record the new values */
-    buf->count = MAX_BUFFER_LENGTH - remain;
-    return 0;
-
-cancel:
-    return -ECANCELED;
+    return rc;
 }
 
 /**
- * write the content of 'buf' to 'fd'
+ * Is there something to write in 'queue'?
  */
-static int buf_write(buf_t *buf, int fd) {
+static int queue_has_data(queue_t *queue) { return queue->head && queue->head->pos < queue->head->count; }
+
+/**
+ * write the content of 'queue' to 'fd'
+ */
+static int queue_write(queue_t *queue, int fd) {
     int n;
-    unsigned count;
     ssize_t rc;
-    struct iovec vec[2];
+    size_t len;
+    block_t *block;
+    struct iovec vec[MAX_OUTPUT_IOVECS];
 
-    /* get the count of byte to write (avoid int overflow) */
-    count = buf->count > INT_MAX ? INT_MAX : buf->count;
+    /* prepare the iovec */
+    n = 0;
+    for (block = queue->head; block && n < MAX_OUTPUT_IOVECS; block = block->next) {
+        if (block->pos < block->count) {
+            vec[n].iov_base = block->content + block->pos;
+            vec[n].iov_len = block->count - block->pos;
+            n++;
+        }
+    }
 
     /* calling it with nothing to write is an error */
-    if (count == 0)
+    if (n == 0)
         return -ENODATA;
 
-    /* prepare the iovec */
-    vec[0].iov_base = buf->content + buf->pos;
-    if (buf->pos + count <= MAX_BUFFER_LENGTH) {
-        vec[0].iov_len = count;
-        n = 1;
-    } else {
-        vec[0].iov_len = MAX_BUFFER_LENGTH - buf->pos;
-        vec[1].iov_base = buf->content;
-        vec[1].iov_len = count - vec[0].iov_len;
-        n = 2;
-    }
-
     /* write the buffers */
     do {
         rc = writev(fd, vec, n);
@@ -189,20 +270,54 @@ static int buf_write(buf_t *buf, int fd) {
 
     /* check error */
     if (rc < 0)
-        rc = -errno;
-    else {
-        /* update the state */
-        buf->count -= (unsigned)rc;
-        buf->pos += (unsigned)rc;
-        if (buf->pos >= MAX_BUFFER_LENGTH)
-            buf->pos -= MAX_BUFFER_LENGTH;
+        return -errno;
+
+    /* update the state, releasing every written block and resetting the queue once empty */
+    len = (size_t)rc;
+    for (;;) {
+        block = queue->head;
+        if (len < block->count - block->pos) {
+            block->pos += (unsigned)len;
+            break;
+        }
+        len -= block->count - block->pos;
+        queue->head = block->next;
+        queue->count--;
+        free(block);
+        if (!queue->head) {
+            queue->tail = NULL;
+            queue->max = MAX_OUTPUT_BLOCKS;
+            break;
+        }
     }
 
-    return (int)rc;
+    return rc > INT_MAX ? INT_MAX : (int)rc;
+}
+
+/**
+ * Ensure that 'fields' can record one more field
+ * return 1 if it can or 0 if it can't
+ */
+static int fields_make_room(fields_t *fields) {
+    const char **array;
+    unsigned size;
+
+    if ((unsigned)fields->count + 1 < fields->size)
+        return 1;
+    if (fields->size >= MAX_FIELDS)
+        return 0;
+    size = fields->size << 1;
+    array = realloc(fields->fields, size * sizeof *array);
+    if (array == NULL)
+        return 0;
+    fields->fields = array;
+    fields->size = size;
+    return 1;
 }
 
 /**
  * get the 'fields' from 'buf'
+ * records having too many fields are truncated
  */
 static void buf_get_fields(buf_t *buf, fields_t *fields) {
     char c;
@@ -213,20 +328,20 @@ static void buf_get_fields(buf_t *buf, fields_t *fields) {
     buf->pos++;
 
     /* init first field */
-    fields->fields[fields->count = 0] = buf->content;
-    read = write = 0;
+    fields->fields[fields->count = 0] = &buf->content[buf->start];
+    read = write = buf->start;
     for (;;) {
         c = buf->content[read++];
         switch (c) {
             case FIELD_SEPARATOR: /* field separator */
                 buf->content[write++] = 0;
-                if (fields->count >= MAX_FIELDS)
+                if (!fields_make_room(fields))
                     return;
                 fields->fields[++fields->count] = &buf->content[write];
                 break;
             case RECORD_SEPARATOR: /* end of line (record separator) */
                 buf->content[write] = 0;
-                fields->count += (write > 0);
+                fields->count += (write > buf->start);
                 return;
             case ESCAPE: /* escaping */
                 c = buf->content[read++];
@@ -253,7 +368,7 @@ static int buf_scan_end_record(buf_t *buf) {
         if (buf->content[buf->pos] == RECORD_SEPARATOR) {
             /* check whether RS is escaped */
             nesc = 0;
-            while (buf->pos > nesc && buf->content[buf->pos - (nesc + 1)] == ESCAPE) nesc++;
+            while (buf->pos - nesc > buf->start && buf->content[buf->pos - (nesc + 1)] == ESCAPE) nesc++;
             if ((nesc & 1) == 0)
                 return 1; /* not escaped */
         }
@@ -263,27 +378,77 @@ static int buf_scan_end_record(buf_t *buf) {
 }
 
 /**
- * remove chars of 'buf' until pos
+ * release the content of 'buf'
+ */
+static void buf_release(buf_t *buf) {
+    free(buf->content);
+    buf->content = NULL;
+    buf->start = buf->pos = buf->count = buf->size = 0;
+}
+
+/**
+ * skip the current record of 'buf', releasing it when empty
  */
-static void buf_crop(buf_t *buf) {
-    buf->count -= buf->pos;
-    if (buf->count)
-        memmove(buf->content, buf->content + buf->pos, buf->count);
-    buf->pos = 0;
+static void buf_next(buf_t *buf) {
+    buf->start = buf->pos;
+    if (buf->start == buf->count)
+        buf_release(buf);
+}
+
+/**
+ * make room at the end of 'buf', by moving the pending record to
+ * the beginning when 'movable' or else by growing the buffer
+ * returns:
+ *  - 0 on success
+ *  - -ENOBUFS if the buffer is full
+ *  - -ENOMEM if allocation failed
+ */
+static int buf_make_room(buf_t *buf, int movable) {
+    unsigned size;
+    char *content;
+
+    if (buf->count < buf->size)
+        return 0;
+
+    if (!movable)
+        return -ENOBUFS;
+
+    /* moving is enough */
+    if (buf->start > 0) {
+        buf->count -= buf->start;
+        buf->pos -= buf->start;
+        memmove(buf->content, buf->content + buf->start, buf->count);
+        buf->start = 0;
+        return 0;
+    }
+
+    /* grow */
+    if (buf->size >= MAX_INPUT_LENGTH)
+        return -ENOBUFS;
+    size = buf->size ? 2 * buf->size : MIN_INPUT_LENGTH;
+    if (size > MAX_INPUT_LENGTH)
+        size = MAX_INPUT_LENGTH;
+    content = realloc(buf->content, size);
+    if (content == NULL)
+        return -ENOMEM;
+    buf->content = content;
+    buf->size = size;
+    return 0;
 }
 
 /**
  * read input 'buf' from 'fd'
  */
-static int inbuf_read(buf_t *buf, int fd) {
+static int inbuf_read(buf_t *buf, int fd, int movable) {
     ssize_t szr;
     int rc;
 
-    if (buf->count == MAX_BUFFER_LENGTH)
-        return -ENOBUFS;
+    rc = buf_make_room(buf, movable);
+    if (rc < 0)
+        return rc;
 
     do {
-        szr = read(fd, buf->content + buf->count, MAX_BUFFER_LENGTH - buf->count);
+        szr = read(fd, buf->content + buf->count, buf->size - buf->count);
     } while (szr < 0 && errno == EINTR);
     if (szr >= 0)
         buf->count += (unsigned)(rc = (int)szr);
@@ -303,6 +468,17 @@ int prot_create(prot_t **prot) {
         return -ENOMEM;
 
     /* initialisation of the structure */
+    p->fields.fields = malloc(MIN_FIELDS * sizeof *p->fields.fields);
+    if (p->fields.fields == NULL) {
+        free(p);
+        *prot = NULL;
+        return -ENOMEM;
+    }
+    p->fields.size = MIN_FIELDS;
+    p->inbuf.content = NULL;
+    p->outq.head = p->outq.tail = NULL;
+    p->outq.count = 0;
+    p->outq.max = MAX_OUTPUT_BLOCKS;
     prot_reset(p);
 
     /* terminate */
@@ -310,24 +486,26 @@ int prot_create(prot_t **prot) {
 }
 
 /* see prot.h */
-void prot_destroy(prot_t *prot) { free(prot); }
+void prot_destroy(prot_t *prot) {
+    buf_release(&prot->inbuf);
+    queue_truncate(&prot->outq, NULL, 0);
+    free(prot->fields.fields);
+    free(prot);
+}
 
 /* see prot.h */
 void prot_reset(prot_t *prot) {
     /* initialisation of the structure */
-    prot->inbuf.pos = prot->inbuf.count = 0;
-    prot->outbuf.pos = prot->outbuf.count = 0;
+    buf_release(&prot->inbuf);
+    queue_truncate(&prot->outq, NULL, 0);
     prot->outfields = 0;
     prot->fields.count = -1;
 }
 
 /* see prot.h */
 void prot_put_cancel(prot_t *prot) {
-    unsigned count;
-
     if (prot->outfields) {
-        count = prot->cancelidx - prot->outbuf.pos;
-        prot->outbuf.count = count > MAX_BUFFER_LENGTH ? count - MAX_BUFFER_LENGTH : count;
+        queue_truncate(&prot->outq, prot->cancelblk, prot->cancelidx);
         prot->outfields = 0;
     }
 }
@@ -339,7 +517,7 @@ int prot_put_end(prot_t *prot) {
     if (!prot->outfields)
         rc = 0;
     else {
-        rc = buf_put_car(&prot->outbuf, RECORD_SEPARATOR);
+        rc = queue_put_car(&prot->outq, RECORD_SEPARATOR);
         if (rc == 0)
             prot->outfields = 0;
     }
@@ -351,13 +529,14 @@ int prot_put_field(prot_t *prot, const char *field) {
     int rc;
 
     if (prot->outfields++)
-        rc = buf_put_car(&prot->outbuf, FIELD_SEPARATOR);
+        rc = queue_put_car(&prot->outq, FIELD_SEPARATOR);
     else {
-        prot->cancelidx = prot->outbuf.pos + prot->outbuf.count;
+        prot->cancelblk = prot->outq.tail;
+        prot->cancelidx = prot->outq.tail ? prot->outq.tail->count : 0;
         rc = 0;
     }
     if (rc >= 0 && field)
-        rc = buf_put_string(&prot->outbuf, field);
+        rc = queue_put_string(&prot->outq, field);
 
     return rc;
 }
@@ -413,16 +592,22 @@ int prot_putx(prot_t *prot, ...) {
 }
 
 /* see prot.h */
-int prot_should_write(prot_t *prot) { return prot->outbuf.count > 0; }
+void prot_grow_output(prot_t *prot) { prot->outq.max = prot->outq.count + MAX_OUTPUT_BLOCKS; }
 
 /* see prot.h */
-int prot_write(prot_t *prot, int fdout) { return buf_write(&prot->outbuf, fdout); }
+int prot_should_write(prot_t *prot) { return queue_has_data(&prot->outq); }
 
 /* see prot.h */
-int prot_can_read(prot_t *prot) { return prot->inbuf.count < MAX_BUFFER_LENGTH; }
+int prot_write(prot_t *prot, int fdout) { return queue_write(&prot->outq, fdout); }
+
+/* see prot.h */
+int prot_can_read(prot_t *prot) {
+    return prot->inbuf.count < prot->inbuf.size ||
+           (prot->fields.count < 0 && (prot->inbuf.start > 0 || prot->inbuf.size < MAX_INPUT_LENGTH));
+}
 
 /* see prot.h */
-int prot_read(prot_t *prot, int fdin) { return inbuf_read(&prot->inbuf, fdin); }
+int prot_read(prot_t *prot, int fdin) { return inbuf_read(&prot->inbuf, fdin, prot->fields.count < 0); }
 
 /* see prot.h */
 int prot_get(prot_t *prot, const char ***fields) {
@@ -439,7 +624,7 @@ int prot_get(prot_t *prot, const char ***fields) {
 /* see prot.h */
 void prot_next(prot_t *prot) {
     if (prot->fields.count >= 0) {
-        buf_crop(&prot->inbuf);
+        buf_next(&prot->inbuf);
         prot->fields.count = -1;
     }
 }
@@ -113,6 +113,14 @@ extern int prot_put(prot_t *prot, unsigned count, const char **fields);
  */
 extern int prot_putx(prot_t *prot, ...);
 
+/**
+ * @brief Let the send buffer grow beyond its limit until it is written entirely
+ * It is for replies that must be queued while the send buffer is full.
+ *
+ * @param prot the protocol handler
+ */
+extern void prot_grow_output(prot_t *prot);
+
 /**
  * @brief Check whether write should be done or not
  *
@@ -144,10 +152,12 @@ extern int prot_can_read(prot_t *prot);
 
 /**
  * Read data from the input file fdin
+ * The input buffer grows as needed up to a hard limit
  *
  * @param prot the protocol handler
  * @param fdin the file to read
  * @return the count of bytes read or a negative -errno error code
+ *         (-ENOBUFS when a record exceeds the limit)
  */
 extern int prot_read(prot_t *prot, int fdin);
 
@@ -30,7 +30,7 @@
 const char _sec_lsm_manager_[] = "sec-lsm-manager", _done_[] = "done", _error_[] = "error", _log_[] = "log",
            _id_[] = "id", _permission_[] = "permission", _path_[] = "path", _install_[] = "install",
            _uninstall_[] = "uninstall", _display_[] = "display", _clear_[] = "clear", _on_[] = "on", _off_[] = "off",
-           _string_[] = "string";
+           _string_[] = "string", _manifest_[] = "manifest";
 
 #if !defined(SEC_LSM_MANAGER_SOCKET_SCHEME)
 #define SEC_LSM_MANAGER_SOCKET_SCHEME "unix"
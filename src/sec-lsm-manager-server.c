@@ -26,7 +26,8 @@
 
 #include <errno.h>
 #include <fcntl.h>
-#include <poll.h>
+#include <limits.h>
+#include <pthread.h>
 #include <stdarg.h>
 #include <stdbool.h>
 #include <stdio.h>
@@ -43,7 +44,9 @@
 #include "sec-lsm-manager-protocol.h"
 #include "secure-app.h"
 #include "socket.h"
+#include "template.h"
 #include "utils.h"
+#include "workers.h"
 
 typedef struct client client_t;
 
@@ -52,6 +55,12 @@ typedef struct client client_t;
 /** should log? */
 int sec_lsm_manager_server_log = 0;
 
+/** count of threads for install and uninstall (0: run them in the main loop) */
+unsigned sec_lsm_manager_server_workers = 1;
+
+/** count of events dispatched per wait */
+unsigned sec_lsm_manager_server_max_events = 64;
+
 /** structure that represents a client */
 struct client {
     /** a protocol structure */
@@ -69,6 +78,33 @@ struct client {
     /** is the actual link invalid or valid */
     unsigned invalid : 1;
 
+    /** is an install or uninstall running in a worker */
+    unsigned busy : 1;
+
+    /** has the link been closed while busy */
+    unsigned closing : 1;
+
+    /** is output waiting for the link to be writable */
+    unsigned writing : 1;
+
+    /** has a reply been lost, the link must be closed */
+    unsigned broken : 1;
+
+    /** is the running job an uninstall */
+    unsigned job_uninstall : 1;
+
+    /** status of the last job */
+    int job_rc;
+
+    /** next client whose job is running (list of the server) or waiting (list of the running job) */
+    client_t *job_next;
+
+    /** clients waiting for the end of this job to run one for the same id */
+    client_t *job_waiting;
+
+    /** count of the labels written or skipped by the last install */
+    label_count_t job_labels;
+
     /** polling callback */
     pollitem_t pollitem;
 
@@ -81,6 +117,12 @@ struct sec_lsm_manager_server {
     /** the pollfd to use */
     int pollfd;
 
+    /** events received by a wait */
+    struct epoll_event *events;
+
+    /** count of events */
+    int max_events;
+
     /** number of client */
     int count;
 
@@ -90,18 +132,43 @@ struct sec_lsm_manager_server {
     /** cynagora client used by all client */
     cynagora_t *cynagora_admin_client;
 
+    /** lock of the cynagora client shared by the workers */
+    pthread_mutex_t cynagora_mutex;
+
+    /** clients whose job is queued or running, one per application id */
+    client_t *jobs;
+
+    /** workers running install and uninstall (NULL if none) */
+    workers_t *workers;
+
     /** the server socket */
     pollitem_t socket;
+
+    /** the watch of the templates (fd -1 if not watched) */
+    pollitem_t templates;
+
+    /** a reload of the templates is queued or running */
+    bool templates_reloading;
+
+    /** the templates changed during their reload */
+    bool templates_changed;
 };
 
 #ifdef WITH_SMACK
+#include "smack-template.h"
 #include "smack.h"
-static int (*install_mac)(const secure_app_t *secure_app) = install_smack;
+static int (*install_mac)(const secure_app_t *secure_app, label_count_t *labels) = install_smack;
 static int (*uninstall_mac)(const secure_app_t *secure_app) = uninstall_smack;
+static void (*release_mac)(void) = NULL;
+static const char *(*const templates_mac[])(const char *value) = {get_smack_template_file};
 #elif WITH_SELINUX
+#include "selinux-template.h"
 #include "selinux.h"
-static int (*install_mac)(const secure_app_t *secure_app) = install_selinux;
+static int (*install_mac)(const secure_app_t *secure_app, label_count_t *labels) = install_selinux;
 static int (*uninstall_mac)(const secure_app_t *secure_app) = uninstall_selinux;
+static void (*release_mac)(void) = release_selinux;
+static const char *(*const templates_mac[])(const char *value) = {
+    get_selinux_te_template_file, get_selinux_if_template_file, get_selinux_cil_template_file};
 #endif
 
 /***********************/
@@ -145,38 +212,57 @@ __nonnull() __wur static bool ckarg(const char *arg, const char *value, unsigned
     return true;
 }
 
+/**
+ * @brief Set the events polled for the client according to its state
+ * Input is not read while busy or while output is pending.
+ *
+ * @param[in] cli client handler
+ */
+__nonnull() static void update_events(client_t *cli) {
+    uint32_t events = 0;
+
+    if (!cli->busy && !cli->writing)
+        events |= EPOLLIN;
+    if (cli->writing)
+        events |= EPOLLOUT;
+    pollitem_mod(&cli->pollitem, events, cli->sec_lsm_manager_server->pollfd);
+}
+
 /**
  * @brief Flush the write buffer
+ * When the link is full, the remaining output is kept in the queue of the
+ * client and written later when the link becomes writable.
  *
  * @param[in] cli client handler
  * @return 0 in case of success or a negative -errno value
  */
 __nonnull() __wur static int flushw(client_t *cli) {
-    int rc;
-    struct pollfd pfd;
+    int rc = 0;
+    bool writing = false;
 
-    for (;;) {
-        rc = prot_should_write(cli->prot);
-        if (!rc)
-            break;
+    while (prot_should_write(cli->prot)) {
         rc = prot_write(cli->prot, cli->pollitem.fd);
         if (rc == -EAGAIN) {
-            pfd.fd = cli->pollitem.fd;
-            pfd.events = POLLOUT;
-            do {
-                rc = poll(&pfd, 1, 0);
-            } while (rc < 0 && errno == EINTR);
-            if (rc < 0)
-                rc = -errno;
+            writing = true;
+            rc = 0;
+            break;
         }
         if (rc < 0)
             break;
+        rc = 0;
+    }
+
+    /* wait writability only when needed */
+    if (cli->writing != writing) {
+        cli->writing = writing;
+        update_events(cli);
     }
     return rc;
 }
 
 /**
  * @brief Send a reply to client
+ * The reply is queued, it is written by flushw
  *
  * @param[in] cli client handler
  * @param[in] ... strings to send or NULL
@@ -202,18 +288,31 @@ __nonnull((1)) __wur static int putx(client_t *cli, ...) {
 
     dolog_protocol(cli, 0, n, fields);
 
+    /* no reply after a lost one, the client would take them for the replies of other requests */
+    if (cli->broken)
+        return -EPIPE;
+
     /* send now */
     rc = prot_put(cli->prot, n, fields);
     if (rc == -ECANCELED) {
         rc = flushw(cli);
         if (rc == 0)
             rc = prot_put(cli->prot, n, fields);
+        /* the link is full: the queue grows for the replies of the current request */
+        if (rc == -ECANCELED) {
+            prot_grow_output(cli->prot);
+            rc = prot_put(cli->prot, n, fields);
+        }
+    }
+    if (rc < 0) {
+        ERROR("reply lost, the client is closed : %d %s", -rc, strerror(-rc));
+        cli->broken = 1;
     }
     return rc;
 }
 
 /**
- * @brief emit a simple done reply and flush
+ * @brief emit a simple done reply
  *
  * @param[in] cli client handler
  */
@@ -222,14 +321,10 @@ __nonnull() static void send_done(client_t *cli) {
     if (rc < 0) {
         ERROR("putx : %d %s", -rc, strerror(-rc));
     }
-    rc = flushw(cli);
-    if (rc < 0) {
-        ERROR("flushw : %d %s", -rc, strerror(-rc));
-    }
 }
 
 /**
- * @brief emit a simple error reply and flush
+ * @brief emit a simple error reply
  *
  * @param[in] cli client handler
  * @param[in] errorstr string error to send
@@ -240,10 +335,6 @@ __nonnull((1)) static void send_error(client_t *cli, const char *errorstr) {
     if (rc < 0) {
         ERROR("putx : %d %s", -rc, strerror(-rc));
     }
-    rc = flushw(cli);
-    if (rc < 0) {
-        ERROR("flushw : %d %s", -rc, strerror(-rc));
-    }
 }
 
 /**
@@ -284,23 +375,67 @@ __nonnull() __wur static int send_display_secure_app(client_t *cli) {
 }
 
 /**
- * @brief Update the policy (drop the old and set the new)
+ * @brief Get a count of items from an argument of the protocol
  *
- * @param[in] sm_handle sec_lsm_manager_handle handler
+ * @param[in] arg the argument
+ * @param[out] count the count read
+ * @return true if arg is a valid count
+ * @return false if not
+ */
+__nonnull() __wur static bool get_count(const char *arg, unsigned *count) {
+    char *end;
+    unsigned long value;
+
+    if (*arg < '0' || *arg > '9')
+        return false;
+    errno = 0;
+    value = strtoul(arg, &end, 10);
+    if (*end || errno || value > UINT_MAX)
+        return false;
+    *count = (unsigned)value;
+    return true;
+}
+
+/**
+ * @brief Set the secure app from a manifest request
+ * The request is: manifest ID NPATHS NPERMISSIONS (PATH TYPE)... PERMISSION...
+ * The previous content of the secure app is cleared.
+ *
+ * @param[in] cli client handler
+ * @param[in] count The number or arguments
+ * @param[in] args Arguments
  * @return 0 in case of success or a negative -errno value
  */
-__nonnull() __wur static int update_policy(secure_app_t *secure_app, cynagora_t *cynagora_admin_client) {
-    // drop old policies
-    int rc = cynagora_drop_policies(cynagora_admin_client, secure_app->id);
-    if (rc < 0) {
-        ERROR("cynagora_drop_policies %s : %d %s", secure_app->id, -rc, strerror(-rc));
-        return rc;
+__nonnull() __wur static int set_manifest(client_t *cli, unsigned count, const char *args[]) {
+    unsigned npaths, npermissions, i;
+    int rc;
+
+    if (count < 4 || !get_count(args[2], &npaths) || !get_count(args[3], &npermissions) ||
+        npaths > (count - 4) / 2 || npermissions != count - 4 - 2 * npaths) {
+        ERROR("invalid manifest");
+        return -EINVAL;
     }
 
-    // apply new policies
-    rc = cynagora_set_policies(cynagora_admin_client, secure_app->id, &(secure_app->permission_set));
+    free_secure_app(cli->secure_app);
+    rc = secure_app_set_id(cli->secure_app, args[1]);
+    args += 4;
+    for (i = 0; rc >= 0 && i < npaths; i++, args += 2)
+        rc = secure_app_add_path(cli->secure_app, args[0], get_path_type(args[1]));
+    for (i = 0; rc >= 0 && i < npermissions; i++, args++) rc = secure_app_add_permission(cli->secure_app, args[0]);
+
+    return rc < 0 ? rc : 0;
+}
+
+/**
+ * @brief Update the policy (drop the old and set the new in one transaction)
+ *
+ * @param[in] sm_handle sec_lsm_manager_handle handler
+ * @return 0 in case of success or a negative -errno value
+ */
+__nonnull() __wur static int update_policy(secure_app_t *secure_app, cynagora_t *cynagora_admin_client) {
+    int rc = cynagora_replace_policies(cynagora_admin_client, secure_app->id, &(secure_app->permission_set));
     if (rc < 0) {
-        ERROR("cynagora_set_policies %s : %d %s", secure_app->id, -rc, strerror(-rc));
+        ERROR("cynagora_replace_policies %s : %d %s", secure_app->id, -rc, strerror(-rc));
         return rc;
     }
 
@@ -313,7 +448,9 @@ __nonnull() __wur static int install(client_t *cli) {
         return -EPERM;
     }
 
+    pthread_mutex_lock(&cli->sec_lsm_manager_server->cynagora_mutex);
     int rc = update_policy(cli->secure_app, cli->sec_lsm_manager_server->cynagora_admin_client);
+    pthread_mutex_unlock(&cli->sec_lsm_manager_server->cynagora_mutex);
     if (rc < 0) {
         ERROR("update_policy : %d %s", -rc, strerror(-rc));
         return rc;
@@ -321,10 +458,12 @@ __nonnull() __wur static int install(client_t *cli) {
 
     DEBUG("update_policy success");
 
-    rc = install_mac(cli->secure_app);
+    rc = install_mac(cli->secure_app, &cli->job_labels);
     if (rc < 0) {
         ERROR("install_mac : %d %s", -rc, strerror(-rc));
+        pthread_mutex_lock(&cli->sec_lsm_manager_server->cynagora_mutex);
         int rc2 = cynagora_drop_policies(cli->sec_lsm_manager_server->cynagora_admin_client, cli->secure_app->id);
+        pthread_mutex_unlock(&cli->sec_lsm_manager_server->cynagora_mutex);
         if (rc2 < 0) {
             ERROR("cannot delete policy : %d %s", -rc2, strerror(-rc2));
         }
@@ -342,7 +481,9 @@ __nonnull() __wur static int uninstall(client_t *cli) {
         return -EPERM;
     }
 
+    pthread_mutex_lock(&cli->sec_lsm_manager_server->cynagora_mutex);
     int rc = cynagora_drop_policies(cli->sec_lsm_manager_server->cynagora_admin_client, cli->secure_app->id);
+    pthread_mutex_unlock(&cli->sec_lsm_manager_server->cynagora_mutex);
 
     if (rc < 0) {
         ERROR("cynagora_drop_policies : %d %s", -rc, strerror(-rc));
@@ -361,6 +502,143 @@ __nonnull() __wur static int uninstall(client_t *cli) {
     return 0;
 }
 
+/**
+ * @brief emit the done reply of an install with the count of labels written and skipped
+ *
+ * @param[in] cli client handler
+ */
+__nonnull() static void send_install_done(client_t *cli) {
+    char written[12], skipped[12];
+    snprintf(written, sizeof(written), "%u", cli->job_labels.written);
+    snprintf(skipped, sizeof(skipped), "%u", cli->job_labels.skipped);
+    int rc = putx(cli, _done_, written, skipped, NULL);
+    if (rc < 0) {
+        ERROR("putx : %d %s", -rc, strerror(-rc));
+    }
+}
+
+/**
+ * @brief emit the reply of an install or uninstall job
+ *
+ * @param[in] cli client handler
+ */
+__nonnull() static void send_job_result(client_t *cli) {
+    if (cli->job_rc >= 0 && !cli->job_uninstall) {
+        send_install_done(cli);
+    } else if (cli->job_rc >= 0) {
+        send_done(cli);
+    } else if (cli->job_uninstall) {
+        ERROR("sec_lsm_manager_handle_uninstall : %d %s", -cli->job_rc, strerror(-cli->job_rc));
+        send_error(cli, "sec_lsm_manager_handle_uninstall");
+    } else {
+        ERROR("sec_lsm_manager_handle_install : %d %s", -cli->job_rc, strerror(-cli->job_rc));
+        send_error(cli, "sec_lsm_manager_handle_install");
+    }
+}
+
+/**
+ * @brief run an install or uninstall job (called by a worker)
+ *
+ * @param[in] closure the client handler
+ */
+static void on_job_run(void *closure) {
+    client_t *cli = closure;
+    cli->job_rc = cli->job_uninstall ? uninstall(cli) : install(cli);
+}
+
+static void on_job_done(void *closure);
+
+/**
+ * @brief Search the client whose job is queued or running for the id of the client
+ *
+ * @param[in] cli client handler
+ * @return the client of the job or NULL if none
+ */
+__nonnull() static client_t *search_job(client_t *cli) {
+    client_t *iter = cli->sec_lsm_manager_server->jobs;
+
+    while (iter && strcmp(iter->secure_app->id, cli->secure_app->id))
+        iter = iter->job_next;
+    return iter;
+}
+
+/**
+ * @brief Remove the job of the client from the running ones and queue the first job waiting for the same id
+ * The other waiting jobs then wait for the end of that one.
+ *
+ * @param[in] cli client handler
+ */
+__nonnull() static void leave_job(client_t *cli) {
+    sec_lsm_manager_server_t *server = cli->sec_lsm_manager_server;
+    client_t **prev, *next;
+    int rc;
+
+    prev = &server->jobs;
+    while (*prev != cli)
+        prev = &(*prev)->job_next;
+    *prev = cli->job_next;
+
+    next = cli->job_waiting;
+    cli->job_waiting = NULL;
+    if (next == NULL)
+        return;
+
+    next->job_waiting = next->job_next;
+    next->job_next = server->jobs;
+    server->jobs = next;
+    rc = workers_queue(server->workers, on_job_run, on_job_done, next);
+    if (rc < 0) {
+        ERROR("workers_queue : %d %s", -rc, strerror(-rc));
+        on_job_run(next);
+        on_job_done(next);
+    }
+}
+
+/**
+ * @brief start an install or uninstall job
+ * When workers are available the job is run by them and the client
+ * stays busy until its completion, otherwise it is run immediately.
+ *
+ * @param[in] cli client handler
+ * @param[in] uninstalling true for uninstall, false for install
+ */
+__nonnull() static void start_job(client_t *cli, bool uninstalling) {
+    sec_lsm_manager_server_t *server = cli->sec_lsm_manager_server;
+    client_t *running, **prev;
+    int rc;
+
+    cli->job_uninstall = uninstalling;
+    cli->job_labels.written = 0;
+    cli->job_labels.skipped = 0;
+    if (server->workers) {
+        /* jobs of a same application share files and policies, they must not overlap */
+        running = search_job(cli);
+        if (running) {
+            /* wait without holding a worker, the job is queued by leave_job */
+            prev = &running->job_waiting;
+            while (*prev)
+                prev = &(*prev)->job_next;
+            cli->job_next = NULL;
+            *prev = cli;
+            rc = 0;
+        } else {
+            rc = workers_queue(server->workers, on_job_run, on_job_done, cli);
+            if (rc >= 0) {
+                cli->job_next = server->jobs;
+                server->jobs = cli;
+            }
+        }
+        if (rc >= 0) {
+            cli->busy = 1;
+            update_events(cli);
+            return;
+        }
+        ERROR("workers_queue : %d %s", -rc, strerror(-rc));
+    }
+    on_job_run(cli);
+    send_job_result(cli);
+}
+
 /**
  * @brief handle a request
  *
@@ -392,10 +670,6 @@ __nonnull((1)) static void onrequest(client_t *cli, unsigned count, const char *
             if (rc < 0) {
                 ERROR("putx : %d %s", -rc, strerror(-rc));
             }
-            rc = flushw(cli);
-            if (rc < 0) {
-                ERROR("flushw : %d %s", -rc, strerror(-rc));
-            }
             cli->version = 1;
             return;
         }
@@ -435,13 +709,7 @@ __nonnull((1)) static void onrequest(client_t *cli, unsigned count, const char *
                 return;
             }
             if (ckarg(args[0], _install_, 1) && count == 1) {
-                rc = install(cli);
-                if (rc >= 0) {
-                    send_done(cli);
-                } else {
-                    ERROR("sec_lsm_manager_handle_install : %d %s", -rc, strerror(-rc));
-                    send_error(cli, "sec_lsm_manager_handle_install");
-                }
+                start_job(cli, false);
                 return;
             }
             break;
@@ -457,14 +725,22 @@ __nonnull((1)) static void onrequest(client_t *cli, unsigned count, const char *
                 if (rc < 0) {
                     ERROR("putx : %d %s", -rc, strerror(-rc));
                 }
-                rc = flushw(cli);
-                if (rc < 0) {
-                    ERROR("flushw : %d %s", -rc, strerror(-rc));
-                }
                 sec_lsm_manager_server_log = nextlog;
                 return;
             }
             break;
+        case 'm':
+            if (ckarg(args[0], _manifest_, 1)) {
+                rc = set_manifest(cli, count, args);
+                if (rc >= 0) {
+                    send_done(cli);
+                } else {
+                    ERROR("sec_lsm_manager_handle_manifest : %d %s", -rc, strerror(-rc));
+                    send_error(cli, "sec_lsm_manager_handle_manifest");
+                }
+                return;
+            }
+            break;
         case 'p':
             if (ckarg(args[0], _path_, 1) && count == 3) {
                 rc = secure_app_add_path(cli->secure_app, args[1], get_path_type(args[2]));
@@ -473,10 +749,6 @@ __nonnull((1)) static void onrequest(client_t *cli, unsigned count, const char *
                     if (rc < 0) {
                         ERROR("putx : %d %s", -rc, strerror(-rc));
                     }
-                    rc = flushw(cli);
-                    if (rc < 0) {
-                        ERROR("flushw : %d %s", -rc, strerror(-rc));
-                    }
                 } else {
                     ERROR("sec_lsm_manager_handle_add_path : %d %s", -rc, strerror(-rc));
                     send_error(cli, "sec_lsm_manager_handle_add_path");
@@ -490,10 +762,6 @@ __nonnull((1)) static void onrequest(client_t *cli, unsigned count, const char *
                     if (rc < 0) {
                         ERROR("putx : %d %s", -rc, strerror(-rc));
                     }
-                    rc = flushw(cli);
-                    if (rc < 0) {
-                        ERROR("flushw : %d %s", -rc, strerror(-rc));
-                    }
                 } else {
                     ERROR("sec_lsm_manager_handle_add_permission : %d %s", -rc, strerror(-rc));
                     send_error(cli, "sec_lsm_manager_handle_add_permission");
@@ -503,13 +771,7 @@ __nonnull((1)) static void onrequest(client_t *cli, unsigned count, const char *
             break;
         case 'u':
             if (ckarg(args[0], _uninstall_, 1) && count == 1) {
-                rc = uninstall(cli);
-                if (rc >= 0) {
-                    send_done(cli);
-                } else {
-                    ERROR("sec_lsm_manager_handle_uninstall : %d %s", -rc, strerror(-rc));
-                    send_error(cli, "sec_lsm_manager_handle_uninstall");
-                }
+                start_job(cli, true);
                 return;
             }
     }
@@ -538,6 +800,66 @@ __nonnull((1)) static void destroy_client(client_t *cli, bool closefds) {
     free(cli);
 }
 
+/**
+ * @brief process the received requests of a client
+ * The processing stops when the client becomes busy or when its
+ * output is pending, it is resumed when that state ends.
+ *
+ * @param[in] cli client handler
+ * @return true if the client session must be terminated
+ */
+__nonnull() __wur static bool process_requests(client_t *cli) {
+    int nargs;
+    const char **args;
+
+    while (!cli->broken && !cli->busy && !cli->writing) {
+        nargs = prot_get(cli->prot, &args);
+        if (nargs < 0) {
+            break;
+        }
+        onrequest(cli, (unsigned)nargs, args);
+        if (cli->invalid && !cli->relax) {
+            return true;
+        }
+        prot_next(cli->prot);
+    }
+    return cli->broken;
+}
+
+/**
+ * @brief handle the end of an install or uninstall job
+ *
+ * @param[in] closure the client handler
+ */
+static void on_job_done(void *closure) {
+    client_t *cli = closure;
+    int pollfd = cli->sec_lsm_manager_server->pollfd;
+    int rc;
+
+    leave_job(cli);
+    cli->busy = 0;
+    if (cli->closing) {
+        destroy_client(cli, true);
+        return;
+    }
+
+    send_job_result(cli);
+
+    /* process the requests received meanwhile */
+    if (process_requests(cli)) {
+        pollitem_del(&cli->pollitem, pollfd);
+        destroy_client(cli, true);
+        return;
+    }
+
+    /* send the replies at once */
+    rc = flushw(cli);
+    if (rc < 0) {
+        ERROR("flushw : %d %s", -rc, strerror(-rc));
+    }
+    update_events(cli);
+}
+
 /**
  * @brief handle client requests
  *
@@ -546,8 +868,7 @@ __nonnull((1)) static void destroy_client(client_t *cli, bool closefds) {
  * @param[in] pollfd pollfd of the client
  */
 static void on_client_event(pollitem_t *pollitem, uint32_t events, int pollfd) {
-    int nargs, nr;
-    const char **args;
+    int nr, rc;
     client_t *cli = pollitem->closure;
 
     /* is it a hangup? */
@@ -555,28 +876,43 @@ static void on_client_event(pollitem_t *pollitem, uint32_t events, int pollfd) {
         goto terminate;
     }
 
-    /* possible input */
-    if (events & EPOLLIN) {
+    /* pending output */
+    if (events & EPOLLOUT) {
+        if (flushw(cli) < 0) {
+            goto terminate;
+        }
+    }
+
+    /* possible input, paused while busy or writing */
+    if ((events & EPOLLIN) && !cli->busy && !cli->writing) {
         nr = prot_read(cli->prot, cli->pollitem.fd);
         if (nr <= 0) {
             goto terminate;
         }
+    }
 
-        nargs = prot_get(cli->prot, &args);
-        while (nargs >= 0) {
-            onrequest(cli, (unsigned)nargs, args);
-            if (cli->invalid && !cli->relax) {
-                goto terminate;
-            }
-            prot_next(cli->prot);
-            nargs = prot_get(cli->prot, &args);
-        }
+    /* process the received requests */
+    if (process_requests(cli)) {
+        goto terminate;
+    }
+
+    /* send the replies at once */
+    rc = flushw(cli);
+    if (rc < 0) {
+        ERROR("flushw : %d %s", -rc, strerror(-rc));
     }
     return;
 
     /* terminate the client session */
 terminate:
     pollitem_del(&cli->pollitem, pollfd);
+    if (cli->busy) {
+        /* the worker still uses the client, destroy it at the end of the job */
+        cli->closing = 1;
+        /* nobody waits for the result: stop the job as soon as possible */
+        __atomic_store_n(&cli->secure_app->cancelled, true, __ATOMIC_RELAXED);
+        return;
+    }
     destroy_client(cli, true);
 }
 
@@ -685,20 +1021,119 @@ static void on_server_event(pollitem_t *pollitem, uint32_t events, int pollfd) {
     }
 }
 
+/**
+ * @brief Reload the changed templates (called by a worker)
+ *
+ * @param[in] closure the server handler
+ */
+static void on_templates_reload_run(void *closure) {
+    (void)closure;
+    reload_templates();
+}
+
+static void on_templates_reload_done(void *closure);
+
+/**
+ * @brief Reload the changed templates off the main loop, one reload at a time
+ *
+ * @param[in] server the server handler
+ */
+__nonnull() static void queue_templates_reload(sec_lsm_manager_server_t *server) {
+    if (server->templates_reloading) {
+        server->templates_changed = true;
+        return;
+    }
+    if (server->workers) {
+        int rc = workers_queue(server->workers, on_templates_reload_run, on_templates_reload_done, server);
+        if (rc >= 0) {
+            server->templates_reloading = true;
+            return;
+        }
+        ERROR("workers_queue : %d %s", -rc, strerror(-rc));
+    }
+    reload_templates();
+}
+
+/**
+ * @brief handle the end of a reload of the templates
+ *
+ * @param[in] closure the server handler
+ */
+static void on_templates_reload_done(void *closure) {
+    sec_lsm_manager_server_t *server = closure;
+    server->templates_reloading = false;
+    if (server->templates_changed) {
+        server->templates_changed = false;
+        queue_templates_reload(server);
+    }
+}
+
+/**
+ * @brief handle the changes of the templates
+ *
+ * @param[in] pollitem pollitem of the templates
+ * @param[in] events events received
+ * @param[in] pollfd file descriptor of the epoll
+ */
+static void on_templates_event(pollitem_t *pollitem, uint32_t events, int pollfd) {
+    (void)events;
+    (void)pollfd;
+    sec_lsm_manager_server_t *server = (sec_lsm_manager_server_t *)pollitem->closure;
+    int rc = read_templates_changes(pollitem->fd);
+    if (rc > 0) {
+        queue_templates_reload(server);
+    }
+}
+
+/**
+ * @brief Watch the templates of the mac, they are checked at each use when this fails
+ *
+ * @param[in] server the server handler
+ */
+__nonnull() static void watch_mac_templates(sec_lsm_manager_server_t *server) {
+    const char *templates[sizeof(templates_mac) / sizeof(*templates_mac)];
+
+    for (size_t i = 0; i < sizeof(templates_mac) / sizeof(*templates_mac); i++) {
+        templates[i] = templates_mac[i](NULL);
+    }
+
+    int fd = watch_templates(templates, sizeof(templates_mac) / sizeof(*templates_mac));
+    if (fd < 0) {
+        ERROR("watch_templates : %d %s", -fd, strerror(-fd));
+        return;
+    }
+
+    server->templates.handler = on_templates_event;
+    server->templates.closure = server;
+    server->templates.fd = fd;
+    if (pollitem_add(&server->templates, EPOLLIN, server->pollfd) < 0) {
+        ERROR("pollitem_add templates : %d %s", errno, strerror(errno));
+        unwatch_templates(fd);
+        server->templates.fd = -1;
+    }
+}
+
 /**********************/
 /*** PUBLIC METHODS ***/
 /**********************/
 
 /* see sec-lsm-manager-server.h */
 void sec_lsm_manager_server_destroy(sec_lsm_manager_server_t *server) {
+    if (server->workers)
+        workers_destroy(server->workers);
+    if (server->templates.fd >= 0)
+        unwatch_templates(server->templates.fd);
+    if (release_mac)
+        release_mac();
     if (server->pollfd >= 0)
         close(server->pollfd);
     if (server->socket.fd >= 0)
         close(server->socket.fd);
+    if (server->cynagora_admin_client)
+        cynagora_destroy(server->cynagora_admin_client);
+    pthread_mutex_destroy(&server->cynagora_mutex);
+    free(server->events);
     free(server);
-    server = NULL;
-    cynagora_destroy(server->cynagora_admin_client);
-    server->cynagora_admin_client = NULL;
 }
 
 /* see sec-lsm-manager-server.h */
@@ -714,9 +1149,11 @@ __wur int sec_lsm_manager_server_create(sec_lsm_manager_server_t **server, const
         goto ret;
     }
     memset(*server, 0, sizeof(sec_lsm_manager_server_t));
+    pthread_mutex_init(&(*server)->cynagora_mutex, NULL);
 
     /* create the polling fd */
     (*server)->socket.fd = -1;
+    (*server)->templates.fd = -1;
     (*server)->pollfd = epoll_create1(EPOLL_CLOEXEC);
     if ((*server)->pollfd < 0) {
         rc = -errno;
@@ -724,6 +1161,15 @@ __wur int sec_lsm_manager_server_create(sec_lsm_manager_server_t **server, const
         goto error;
     }
 
+    /* create the events of a wait */
+    (*server)->max_events = (int)(sec_lsm_manager_server_max_events ?: 1);
+    (*server)->events = calloc((size_t)(*server)->max_events, sizeof(struct epoll_event));
+    if ((*server)->events == NULL) {
+        ERROR("calloc failed");
+        rc = -ENOMEM;
+        goto error;
+    }
+
     /* create the admin server socket */
     socket_spec = sec_lsm_manager_get_socket(socket_spec);
 
@@ -755,6 +1201,19 @@ __wur int sec_lsm_manager_server_create(sec_lsm_manager_server_t **server, const
         goto error;
     }
 
+    /* create the workers running install and uninstall */
+    if (sec_lsm_manager_server_workers > 0) {
+        rc = workers_create(&((*server)->workers), sec_lsm_manager_server_workers, (*server)->pollfd);
+        if (rc < 0) {
+            ERROR("workers_create : %d %s", -rc, strerror(-rc));
+            (*server)->workers = NULL;
+            goto error;
+        }
+    }
+
+    /* compile the templates and reload them when they change */
+    watch_mac_templates(*server);
+
     goto ret;
 
 error:
@@ -774,7 +1233,7 @@ __wur int sec_lsm_manager_server_serve(sec_lsm_manager_server_t *server) {
     /* process inputs */
     server->stopped = 0;
     while (!server->stopped) {
-        pollitem_wait_dispatch(server->pollfd, -1);
+        pollitem_wait_dispatch_batch(server->pollfd, -1, server->events, server->max_events);
     }
     return server->stopped == INT_MIN ? 0 : server->stopped;
 }
@@ -34,6 +34,18 @@ typedef struct sec_lsm_manager_server sec_lsm_manager_server_t;
  */
 extern int sec_lsm_manager_server_log;
 
+/**
+ * @brief Count of threads running the installs and uninstalls (0 to run them in the main loop)
+ * Must be set before calling sec_lsm_manager_server_create
+ */
+extern unsigned sec_lsm_manager_server_workers;
+
+/**
+ * @brief Count of events received and dispatched by one wait of the main loop
+ * Must be set before calling sec_lsm_manager_server_create
+ */
+extern unsigned sec_lsm_manager_server_max_events;
+
 /**
  * @brief Create a security manager server
  *
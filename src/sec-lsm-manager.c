@@ -27,6 +27,7 @@
 #include "sec-lsm-manager.h"
 
 #include <errno.h>
+#include <limits.h>
 #include <poll.h>
 #include <stdarg.h>
 #include <stdbool.h>
@@ -62,6 +63,21 @@ struct sec_lsm_manager {
     /** synchronous lock */
     bool synclock;
 
+    /** are the requests pipelined */
+    bool pipelining;
+
+    /** count of pipelined requests waiting their reply */
+    unsigned pending;
+
+    /** status of the pipelined requests */
+    int pending_status;
+
+    /** count of the labels written by the last install */
+    unsigned labels_written;
+
+    /** count of the labels already set and skipped by the last install */
+    unsigned labels_skipped;
+
     /** protocol manager object */
     prot_t *prot;
 
@@ -82,6 +98,8 @@ struct sec_lsm_manager {
 /*** PRIVATE METHODS ***/
 /***********************/
 
+__nonnull() __wur static int read_pending_replies(sec_lsm_manager_t *sec_lsm_manager, bool block);
+
 /**
  * @brief Flush the write buffer of the client
  *
@@ -99,13 +117,16 @@ __nonnull() __wur static int flushw(sec_lsm_manager_t *sec_lsm_manager) {
             break;
         rc = prot_write(sec_lsm_manager->prot, sec_lsm_manager->fd);
         if (rc == -EAGAIN) {
+            /* the server doesn't read while its replies are not read */
             pfd.fd = sec_lsm_manager->fd;
-            pfd.events = POLLOUT;
+            pfd.events = sec_lsm_manager->pending ? POLLOUT | POLLIN : POLLOUT;
             do {
                 rc = poll(&pfd, 1, -1);
             } while (rc < 0 && errno == EINTR);
             if (rc < 0)
                 rc = -errno;
+            else if (pfd.revents & POLLIN)
+                rc = read_pending_replies(sec_lsm_manager, false);
         }
         if (rc < 0) {
             break;
@@ -133,11 +154,10 @@ __nonnull() __wur static int send_reply(sec_lsm_manager_t *sec_lsm_manager, cons
         /* fill the fields */
         for (i = rc = 0; i < count && rc == 0; i++) rc = prot_put_field(prot, fields[i]);
 
-        /* send if done */
+        /* queued if done, it is sent when waiting the reply */
         if (rc == 0) {
             rc = prot_put_end(prot);
             if (rc == 0) {
-                rc = flushw(sec_lsm_manager);
                 break;
             }
         }
@@ -231,7 +251,7 @@ __nonnull() __wur static int get_reply(sec_lsm_manager_t *sec_lsm_manager) {
 }
 
 /**
- * @brief Wait for a reply
+ * @brief Read a reply
  *
  * @param[in] sec_lsm_manager  the handler of the client
  * @param[in] block
@@ -240,7 +260,7 @@ __nonnull() __wur static int get_reply(sec_lsm_manager_t *sec_lsm_manager) {
  *          or -EAGAIN if nothing and block == false
  *          or -EPIPE if broken link
  */
-__nonnull() __wur static int wait_reply(sec_lsm_manager_t *sec_lsm_manager, bool block) {
+__nonnull() __wur static int read_reply(sec_lsm_manager_t *sec_lsm_manager, bool block) {
     for (;;) {
         /* get the next reply if any */
         int rc = get_reply(sec_lsm_manager);
@@ -264,6 +284,67 @@ __nonnull() __wur static int wait_reply(sec_lsm_manager_t *sec_lsm_manager, bool
     return -1;
 }
 
+/**
+ * @brief Read the replies of the pipelined requests
+ * The first error is recorded in pending_status
+ *
+ * @param[in] sec_lsm_manager  the handler of the client
+ * @param[in] block            wait all the replies if true
+ *
+ * @return  0 in case of success or a negative -errno value
+ */
+__nonnull() __wur static int read_pending_replies(sec_lsm_manager_t *sec_lsm_manager, bool block) {
+    int rc;
+
+    while (sec_lsm_manager->pending) {
+        rc = read_reply(sec_lsm_manager, block);
+        if (rc == -EAGAIN && !block)
+            break;
+        if (rc < 0)
+            return rc;
+        sec_lsm_manager->pending--;
+        if (strcmp(sec_lsm_manager->reply.fields[0], _done_) && sec_lsm_manager->pending_status == 0) {
+            if (!strcmp(sec_lsm_manager->reply.fields[0], _error_) && rc > 1)
+                ERROR("%s", sec_lsm_manager->reply.fields[1]);
+            sec_lsm_manager->pending_status = -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Send the queued requests and wait for a reply
+ *
+ * @param[in] sec_lsm_manager  the handler of the client
+ * @param[in] block
+ *
+ * @return  the count of fields greater than 0 or a negative -errno value
+ *          or -EAGAIN if nothing and block == false
+ *          or -EPIPE if broken link
+ */
+__nonnull() __wur static int wait_reply(sec_lsm_manager_t *sec_lsm_manager, bool block) {
+    int rc = flushw(sec_lsm_manager);
+    return rc < 0 ? rc : read_reply(sec_lsm_manager, block);
+}
+
+/**
+ * @brief Wait the replies of all the pipelined requests
+ *
+ * @param[in] sec_lsm_manager  the handler of the client
+ *
+ * @return  0 in case of success or a negative -errno value
+ *          -1 if one of the pipelined requests failed
+ */
+__nonnull() __wur static int sync_pending(sec_lsm_manager_t *sec_lsm_manager) {
+    int rc = flushw(sec_lsm_manager);
+    if (rc >= 0)
+        rc = read_pending_replies(sec_lsm_manager, true);
+    if (rc >= 0)
+        rc = sec_lsm_manager->pending_status;
+    sec_lsm_manager->pending_status = 0;
+    return rc;
+}
+
 /**
  * @brief Wait for a reply
  *
@@ -305,6 +386,22 @@ __nonnull() __wur static int wait_done_or_error(sec_lsm_manager_t *sec_lsm_manag
     return rc;
 }
 
+/**
+ * @brief Wait the reply "done" or "error" of the last request
+ * When pipelining, the reply is read later and the function returns at once
+ *
+ * @param[in] sec_lsm_manager  the handler of the client
+ *
+ * @return  0 in case of success or a negative -errno value
+ */
+__nonnull() __wur static int wait_or_pipeline(sec_lsm_manager_t *sec_lsm_manager) {
+    if (sec_lsm_manager->pipelining) {
+        sec_lsm_manager->pending++;
+        return 0;
+    }
+    return wait_done_or_error(sec_lsm_manager);
+}
+
 /**
  * @brief Disconnect the client
  *
@@ -315,6 +412,11 @@ __nonnull() static void disconnection(sec_lsm_manager_t *sec_lsm_manager) {
         close(sec_lsm_manager->fd);
         sec_lsm_manager->fd = -1;
     }
+    /* the replies of pipelined requests are lost */
+    if (sec_lsm_manager->pending) {
+        sec_lsm_manager->pending = 0;
+        sec_lsm_manager->pending_status = sec_lsm_manager->pending_status ?: -EPIPE;
+    }
 }
 
 /**
@@ -358,7 +460,8 @@ __nonnull() __wur static int connection(sec_lsm_manager_t *sec_lsm_manager) {
  * @return  0 in case of success or a negative -errno value
  */
 __nonnull() __wur static int ensure_opened(sec_lsm_manager_t *sec_lsm_manager) {
-    if (sec_lsm_manager->fd >= 0 && write(sec_lsm_manager->fd, NULL, 0) < 0)
+    /* when pipelining, a broken link is detected when reading the replies */
+    if (sec_lsm_manager->fd >= 0 && !sec_lsm_manager->pending && write(sec_lsm_manager->fd, NULL, 0) < 0)
         disconnection(sec_lsm_manager);
     return sec_lsm_manager->fd < 0 ? connection(sec_lsm_manager) : 0;
 }
@@ -426,6 +529,21 @@ void sec_lsm_manager_disconnect(sec_lsm_manager_t *sec_lsm_manager) {
     disconnection(sec_lsm_manager);
 }
 
+/* see sec-lsm-manager.h */
+int sec_lsm_manager_set_pipelining(sec_lsm_manager_t *sec_lsm_manager, int on) {
+    CHECK_NO_NULL(sec_lsm_manager, "sec_lsm_manager");
+
+    if (sec_lsm_manager->synclock)
+        return -EBUSY;
+
+    sec_lsm_manager->synclock = true;
+    sec_lsm_manager->pipelining = !!on;
+    int rc = on ? 0 : sync_pending(sec_lsm_manager);
+    sec_lsm_manager->synclock = false;
+
+    return rc;
+}
+
 /* see sec-lsm-manager.h */
 int sec_lsm_manager_set_id(sec_lsm_manager_t *sec_lsm_manager, const char *id) {
     CHECK_NO_NULL(sec_lsm_manager, "sec_lsm_manager");
@@ -446,7 +564,7 @@ int sec_lsm_manager_set_id(sec_lsm_manager_t *sec_lsm_manager, const char *id) {
         goto ret;
     }
 
-    rc = wait_done_or_error(sec_lsm_manager);
+    rc = wait_or_pipeline(sec_lsm_manager);
 
 ret:
     sec_lsm_manager->synclock = false;
@@ -472,7 +590,7 @@ int sec_lsm_manager_add_path(sec_lsm_manager_t *sec_lsm_manager, const char *pat
         goto ret;
     }
 
-    rc = wait_done_or_error(sec_lsm_manager);
+    rc = wait_or_pipeline(sec_lsm_manager);
 
 ret:
     sec_lsm_manager->synclock = false;
@@ -498,13 +616,74 @@ int sec_lsm_manager_add_permission(sec_lsm_manager_t *sec_lsm_manager, const cha
         goto ret;
     }
 
-    rc = wait_done_or_error(sec_lsm_manager);
+    rc = wait_or_pipeline(sec_lsm_manager);
 
 ret:
     sec_lsm_manager->synclock = false;
     return rc;
 }
 
+/* see sec-lsm-manager.h */
+int sec_lsm_manager_set_manifest(sec_lsm_manager_t *sec_lsm_manager, const char *id, unsigned npaths,
+                                 const char *const *paths, const char *const *path_types, unsigned npermissions,
+                                 const char *const *permissions) {
+    char spaths[16], spermissions[16];
+    const char **fields;
+    unsigned i, count;
+
+    CHECK_NO_NULL(sec_lsm_manager, "sec_lsm_manager");
+    CHECK_NO_NULL(id, "id");
+    if (npaths) {
+        CHECK_NO_NULL(paths, "paths");
+        CHECK_NO_NULL(path_types, "path_types");
+    }
+    if (npermissions) {
+        CHECK_NO_NULL(permissions, "permissions");
+    }
+
+    if (sec_lsm_manager->synclock)
+        return -EBUSY;
+
+    /* prepare fields: manifest ID NPATHS NPERMISSIONS (PATH TYPE)... PERMISSION... */
+    if (npaths > (INT_MAX - 4) / 2 || npermissions > INT_MAX - 4 - 2 * npaths)
+        return -EINVAL;
+    count = 4 + 2 * npaths + npermissions;
+    fields = malloc(count * sizeof *fields);
+    if (fields == NULL) {
+        ERROR("malloc failed");
+        return -ENOMEM;
+    }
+    snprintf(spaths, sizeof(spaths), "%u", npaths);
+    snprintf(spermissions, sizeof(spermissions), "%u", npermissions);
+    fields[0] = _manifest_;
+    fields[1] = id;
+    fields[2] = spaths;
+    fields[3] = spermissions;
+    for (i = 0; i < npaths; i++) {
+        fields[4 + 2 * i] = paths[i];
+        fields[5 + 2 * i] = path_types[i];
+    }
+    for (i = 0; i < npermissions; i++) fields[4 + 2 * npaths + i] = permissions[i];
+
+    sec_lsm_manager->synclock = true;
+
+    int rc = ensure_opened(sec_lsm_manager);
+    if (rc < 0) {
+        goto ret;
+    }
+    rc = send_reply(sec_lsm_manager, fields, (int)count);
+    if (rc < 0) {
+        goto ret;
+    }
+
+    rc = wait_or_pipeline(sec_lsm_manager);
+
+ret:
+    sec_lsm_manager->synclock = false;
+    free(fields);
+    return rc;
+}
+
 /* see sec-lsm-manager.h */
 int sec_lsm_manager_clear(sec_lsm_manager_t *sec_lsm_manager) {
     CHECK_NO_NULL(sec_lsm_manager, "sec_lsm_manager");
@@ -523,7 +702,7 @@ int sec_lsm_manager_clear(sec_lsm_manager_t *sec_lsm_manager) {
         goto ret;
     }
 
-    rc = wait_done_or_error(sec_lsm_manager);
+    rc = wait_or_pipeline(sec_lsm_manager);
 
 ret:
     sec_lsm_manager->synclock = false;
@@ -543,18 +722,37 @@ int sec_lsm_manager_install(sec_lsm_manager_t *sec_lsm_manager) {
     if (rc < 0) {
         goto ret;
     }
+
+    /* get the status of the pipelined requests */
+    rc = sync_pending(sec_lsm_manager);
+    if (rc < 0) {
+        goto ret;
+    }
+
     rc = putxkv(sec_lsm_manager, _install_, NULL);
     if (rc < 0) {
         goto ret;
     }
 
+    sec_lsm_manager->labels_written = 0;
+    sec_lsm_manager->labels_skipped = 0;
     rc = wait_done_or_error(sec_lsm_manager);
+    if (rc >= 0 && sec_lsm_manager->reply.count >= 3) {
+        sec_lsm_manager->labels_written = (unsigned)strtoul(sec_lsm_manager->reply.fields[1], NULL, 10);
+        sec_lsm_manager->labels_skipped = (unsigned)strtoul(sec_lsm_manager->reply.fields[2], NULL, 10);
+    }
 
 ret:
     sec_lsm_manager->synclock = false;
     return rc;
 }
 
+/* see sec-lsm-manager.h */
+void sec_lsm_manager_install_labels(const sec_lsm_manager_t *sec_lsm_manager, unsigned *written, unsigned *skipped) {
+    *written = sec_lsm_manager->labels_written;
+    *skipped = sec_lsm_manager->labels_skipped;
+}
+
 /* see sec-lsm-manager.h */
 int sec_lsm_manager_uninstall(sec_lsm_manager_t *sec_lsm_manager) {
     CHECK_NO_NULL(sec_lsm_manager, "sec_lsm_manager");
@@ -568,6 +766,13 @@ int sec_lsm_manager_uninstall(sec_lsm_manager_t *sec_lsm_manager) {
     if (rc < 0) {
         goto ret;
     }
+
+    /* get the status of the pipelined requests */
+    rc = sync_pending(sec_lsm_manager);
+    if (rc < 0) {
+        goto ret;
+    }
+
     rc = putxkv(sec_lsm_manager, _uninstall_, NULL);
     if (rc < 0) {
         goto ret;
@@ -589,6 +794,8 @@ int sec_lsm_manager_log(sec_lsm_manager_t *sec_lsm_manager, int on, int off) {
 
     sec_lsm_manager->synclock = true;
     int rc = ensure_opened(sec_lsm_manager);
+    if (rc >= 0)
+        rc = sync_pending(sec_lsm_manager);
     if (rc >= 0) {
         rc = putxkv(sec_lsm_manager, _log_, off ? _off_ : on ? _on_ : 0, NULL);
         if (rc >= 0) {
@@ -616,6 +823,12 @@ int sec_lsm_manager_display(sec_lsm_manager_t *sec_lsm_manager) {
         goto ret;
     }
 
+    /* get the status of the pipelined requests */
+    rc = sync_pending(sec_lsm_manager);
+    if (rc < 0) {
+        goto ret;
+    }
+
     rc = putxkv(sec_lsm_manager, _display_, NULL);
 
     if (rc < 0) {
@@ -60,6 +60,22 @@ extern void sec_lsm_manager_destroy(sec_lsm_manager_t *sec_lsm_manager) __nonnul
  */
 extern void sec_lsm_manager_disconnect(sec_lsm_manager_t *sec_lsm_manager) __nonnull();
 
+/**
+ * @brief Set or unset the pipelining of the requests
+ * When pipelining, sec_lsm_manager_set_id, sec_lsm_manager_add_path,
+ * sec_lsm_manager_add_permission, sec_lsm_manager_set_manifest and
+ * sec_lsm_manager_clear don't wait their
+ * reply and return 0 at once. Their replies are read by the next call to
+ * sec_lsm_manager_install, sec_lsm_manager_uninstall, sec_lsm_manager_display,
+ * sec_lsm_manager_log or sec_lsm_manager_set_pipelining(..., 0) that fails
+ * if one of the pipelined requests failed.
+ *
+ * @param[in] sec_lsm_manager sec_lsm_manager client handler
+ * @param[in] on not zero to pipeline, zero to stop pipelining
+ * @return 0 in case of success or a negative -errno value
+ */
+extern int sec_lsm_manager_set_pipelining(sec_lsm_manager_t *sec_lsm_manager, int on) __nonnull() __wur;
+
 /**
  * @brief Set id of sec_lsm_manager client handler
  *
@@ -89,6 +105,26 @@ extern int sec_lsm_manager_add_path(sec_lsm_manager_t *sec_lsm_manager, const ch
  */
 extern int sec_lsm_manager_add_permission(sec_lsm_manager_t *sec_lsm_manager, const char *permission) __nonnull() __wur;
 
+/**
+ * @brief Set the whole description of the application in one request
+ * The previous id, paths and permissions are cleared. This is equivalent to
+ * sec_lsm_manager_clear, sec_lsm_manager_set_id, sec_lsm_manager_add_path for
+ * each path and sec_lsm_manager_add_permission for each permission but it costs
+ * only one round-trip.
+ *
+ * @param[in] sec_lsm_manager sec_lsm_manager client handler
+ * @param[in] id The id to set
+ * @param[in] npaths The count of paths
+ * @param[in] paths The paths to add
+ * @param[in] path_types The path types of the paths
+ * @param[in] npermissions The count of permissions
+ * @param[in] permissions The permissions to add
+ * @return 0 in case of success or a negative -errno value
+ */
+extern int sec_lsm_manager_set_manifest(sec_lsm_manager_t *sec_lsm_manager, const char *id, unsigned npaths,
+                                        const char *const *paths, const char *const *path_types,
+                                        unsigned npermissions, const char *const *permissions) __nonnull((1, 2)) __wur;
+
 /**
  * @brief Clear the sec_lsm_manager client handler
  * Return in the create state
@@ -107,6 +143,17 @@ extern int sec_lsm_manager_clear(sec_lsm_manager_t *sec_lsm_manager) __nonnull()
  */
 extern int sec_lsm_manager_install(sec_lsm_manager_t *sec_lsm_manager) __nonnull() __wur;
 
+/**
+ * @brief Get the count of labels of the last install
+ * The labels already set on the files are not written again
+ *
+ * @param[in] sec_lsm_manager sec_lsm_manager client handler
+ * @param[out] written count of labels written
+ * @param[out] skipped count of labels already set
+ */
+extern void sec_lsm_manager_install_labels(const sec_lsm_manager_t *sec_lsm_manager, unsigned *written,
+                                           unsigned *skipped) __nonnull();
+
 /**
  * @brief Uninstall an application (cynagora permissions, paths)
  * You need at least to set the id
@@ -36,16 +36,18 @@
 /***********************/
 
 /**
- * @brief Initialize the fields 'id', 'id_underscore', 'permission_set', 'path_set' and error_flag
+ * @brief Initialize the fields 'id', 'id_underscore', 'permission_set', 'path_set', error_flag, cancelled and arena
  *
  * @param[in] secure_app handler
  */
 __nonnull() static void init_secure_app(secure_app_t *secure_app) {
     memset(secure_app->id, '\0', SEC_LSM_MANAGER_MAX_SIZE_ID);
     memset(secure_app->id_underscore, '\0', SEC_LSM_MANAGER_MAX_SIZE_ID);
-    init_path_set(&(secure_app->path_set));
-    init_permission_set(&(secure_app->permission_set));
+    init_arena(&(secure_app->arena));
+    init_path_set(&(secure_app->path_set), &(secure_app->arena));
+    init_permission_set(&(secure_app->permission_set), &(secure_app->arena));
     secure_app->error_flag = false;
+    secure_app->cancelled = false;
 }
 
 /**
@@ -83,13 +85,18 @@ void free_secure_app(secure_app_t *secure_app) {
     if (secure_app) {
         free_permission_set(&(secure_app->permission_set));
         free_path_set(&(secure_app->path_set));
+        arena_reset(&(secure_app->arena));
+        secure_app->id[0] = '\0';
+        secure_app->id_underscore[0] = '\0';
         secure_app->error_flag = false;
+        secure_app->cancelled = false;
     }
 }
 
 /* see secure-app.h */
 void destroy_secure_app(secure_app_t *secure_app) {
     free_secure_app(secure_app);
+    free_arena(&(secure_app->arena));
     free(secure_app);
 }
 
@@ -131,11 +138,9 @@ int secure_app_add_permission(secure_app_t *secure_app, const char *permission)
         return -EPERM;
     }
 
-    for (size_t i = 0; i < secure_app->permission_set.size; i++) {
-        if (!strcmp(secure_app->permission_set.permissions[i], permission)) {
-            ERROR("permission already defined");
-            return -EINVAL;
-        }
+    if (permission_set_has_permission(&(secure_app->permission_set), permission, false)) {
+        ERROR("permission already defined");
+        return -EINVAL;
     }
 
     int rc = permission_set_add_permission(&(secure_app->permission_set), permission);
@@ -159,11 +164,9 @@ int secure_app_add_path(secure_app_t *secure_app, const char *path, enum path_ty
         return -EPERM;
     }
 
-    for (size_t i = 0; i < secure_app->path_set.size; i++) {
-        if (!strcmp(secure_app->path_set.paths[i]->path, path)) {
-            ERROR("path already defined");
-            return -EINVAL;
-        }
+    if (path_set_has_path(&(secure_app->path_set), path)) {
+        ERROR("path already defined");
+        return -EINVAL;
     }
 
     int rc = path_set_add_path(&(secure_app->path_set), path, path_type);
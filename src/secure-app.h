@@ -26,16 +26,24 @@
 
 #include <sys/types.h>
 
+#include "arena.h"
 #include "cynagora-interface.h"
 #include "limits.h"
 #include "paths.h"
 
+/**
+ * @brief Structure of secure_app
+ * The paths and permissions are allocated in the arena of the secure app
+ *
+ */
 typedef struct secure_app {
     char id[SEC_LSM_MANAGER_MAX_SIZE_ID];
     char id_underscore[SEC_LSM_MANAGER_MAX_SIZE_ID];
     permission_set_t permission_set;
     path_set_t path_set;
     bool error_flag;
+    bool cancelled; // the requester is gone (read and written atomically)
+    arena_t arena;
 } secure_app_t;
 
 /**
@@ -51,7 +59,7 @@ extern int create_secure_app(secure_app_t **pointer) __wur;
 
 /**
  * @brief Free id, paths and permissions
- * The pointer is not free
+ * The pointer is not free, the memory of the arena is kept for reuse
  *
  * @param[in] secure_app handler
  */
@@ -0,0 +1,204 @@
+/*
+ * Copyright (C) 2020-2021 IoT.bzh Company
+ * Author: Arthur Guyader <arthur.guyader@iot.bzh>
+ *
+ * $RP_BEGIN_LICENSE$
+ * Commercial License Usage
+ *  Licensees holding valid commercial IoT.bzh licenses may use this file in
+ *  accordance with the commercial license agreement provided with the
+ *  Software or, alternatively, in accordance with the terms contained in
+ *  a written agreement between you and The IoT.bzh Company. For licensing terms
+ *  and conditions see https://www.iot.bzh/terms-conditions. For further
+ *  information use the contact form at https://www.iot.bzh/contact.
+ *
+ * GNU General Public License Usage
+ *  Alternatively, this file may be used under the terms of the GNU General
+ *  Public license version 3. This license is as published by the Free Software
+ *  Foundation and appearing in the file LICENSE.GPLv3 included in the packaging
+ *  of this file. Please review the following information to ensure the GNU
+ *  General Public License requirements will be met
+ *  https://www.gnu.org/licenses/gpl-3.0.html.
+ * $RP_END_LICENSE$
+ */
+
+
+#include "selinux-compile-jobs.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "log.h"
+#include "utils.h"
+
+/** period of the checks of the cancellation of waiting jobs (ms) */
+#define CHECK_PERIOD 100
+
+/** lock of the scheduler */
+static pthread_mutex_t scheduler_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/** condition signaling a released slot or an ended job */
+static pthread_cond_t scheduler_cond = PTHREAD_COND_INITIALIZER;
+
+/** submitted jobs, in submission order */
+static compile_job_t *submitted_jobs = NULL;
+
+/** tail of the submitted jobs */
+static compile_job_t **submitted_tail = &submitted_jobs;
+
+/** count of jobs holding a slot */
+static unsigned running_jobs = 0;
+
+/** count of slots (0 until computed) */
+static unsigned max_running_jobs = 0;
+
+/***********************/
+/*** PRIVATE METHODS ***/
+/***********************/
+
+/**
+ * @brief Get the count of compilation slots, computed at the first call
+ *
+ * @return the count of slots
+ */
+__wur static unsigned get_max_running_jobs(void) {
+    if (max_running_jobs == 0) {
+        max_running_jobs = get_env_count("SELINUX_COMPILE_JOBS", SELINUX_COMPILE_JOBS);
+        DEBUG("%u selinux compilations at most", max_running_jobs);
+    }
+    return max_running_jobs;
+}
+
+/**
+ * @brief Wait for a change in the scheduler, at most CHECK_PERIOD ms
+ * The scheduler lock must be held
+ */
+static void wait_scheduler(void) {
+    struct timespec timeout;
+    clock_gettime(CLOCK_REALTIME, &timeout);
+    timeout.tv_nsec += CHECK_PERIOD * 1000000L;
+    timeout.tv_sec += timeout.tv_nsec / 1000000000L;
+    timeout.tv_nsec %= 1000000000L;
+    pthread_cond_timedwait(&scheduler_cond, &scheduler_mutex, &timeout);
+}
+
+/**
+ * @brief Release the slot of the job, the scheduler lock must be held
+ *
+ * @param[in] job the job
+ */
+__nonnull() static void release_slot(compile_job_t *job) {
+    if (job->running) {
+        job->running = false;
+        running_jobs--;
+        pthread_cond_broadcast(&scheduler_cond);
+    }
+}
+
+/**********************/
+/*** PUBLIC METHODS ***/
+/**********************/
+
+/* see selinux-compile-jobs.h */
+void compile_job_submit(compile_job_t *job, const bool *cancelled) {
+    clock_gettime(CLOCK_MONOTONIC, &job->deadline);
+    job->deadline.tv_nsec += (SELINUX_COMPILE_TIMEOUT % 1000) * 1000000L;
+    job->deadline.tv_sec += SELINUX_COMPILE_TIMEOUT / 1000 + job->deadline.tv_nsec / 1000000000L;
+    job->deadline.tv_nsec %= 1000000000L;
+    job->cancelled = cancelled;
+    job->running = false;
+    job->queued = true;
+    job->next = NULL;
+
+    pthread_mutex_lock(&scheduler_mutex);
+    *submitted_tail = job;
+    submitted_tail = &job->next;
+    pthread_mutex_unlock(&scheduler_mutex);
+}
+
+/* see selinux-compile-jobs.h */
+int compile_job_start(compile_job_t *job) {
+    int rc = 0;
+
+    pthread_mutex_lock(&scheduler_mutex);
+    unsigned max = get_max_running_jobs();
+    while (running_jobs >= max) {
+        rc = compile_job_check(job);
+        if (rc < 0) {
+            goto end;
+        }
+        wait_scheduler();
+    }
+    job->running = true;
+    running_jobs++;
+end:
+    pthread_mutex_unlock(&scheduler_mutex);
+    return rc;
+}
+
+/* see selinux-compile-jobs.h */
+void compile_job_stop(compile_job_t *job) {
+    pthread_mutex_lock(&scheduler_mutex);
+    release_slot(job);
+    pthread_mutex_unlock(&scheduler_mutex);
+}
+
+/* see selinux-compile-jobs.h */
+int compile_job_wait_turn(compile_job_t *job) {
+    int rc = 0;
+
+    pthread_mutex_lock(&scheduler_mutex);
+    while (submitted_jobs != job) {
+        if (job->cancelled != NULL && __atomic_load_n(job->cancelled, __ATOMIC_RELAXED)) {
+            rc = -ECANCELED;
+            break;
+        }
+        wait_scheduler();
+    }
+    pthread_mutex_unlock(&scheduler_mutex);
+    return rc;
+}
+
+/* see selinux-compile-jobs.h */
+void compile_job_end(compile_job_t *job) {
+    pthread_mutex_lock(&scheduler_mutex);
+    release_slot(job);
+    if (job->queued) {
+        compile_job_t **prev = &submitted_jobs;
+        while (*prev != job) {
+            prev = &(*prev)->next;
+        }
+        *prev = job->next;
+        if (submitted_tail == &job->next) {
+            submitted_tail = prev;
+        }
+        job->queued = false;
+        pthread_cond_broadcast(&scheduler_cond);
+    }
+    pthread_mutex_unlock(&scheduler_mutex);
+}
+
+/* see selinux-compile-jobs.h */
+bool compile_jobs_pending(void) {
+    pthread_mutex_lock(&scheduler_mutex);
+    bool pending = submitted_jobs != NULL;
+    pthread_mutex_unlock(&scheduler_mutex);
+    return pending;
+}
+
+/* see selinux-compile-jobs.h */
+int compile_job_check(const compile_job_t *job) {
+    if (job->cancelled != NULL && __atomic_load_n(job->cancelled, __ATOMIC_RELAXED)) {
+        return -ECANCELED;
+    }
+    return compile_job_time_left(job) > 0 ? 0 : -ETIMEDOUT;
+}
+
+/* see selinux-compile-jobs.h */
+int compile_job_time_left(const compile_job_t *job) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    long ms = (job->deadline.tv_sec - now.tv_sec) * 1000L + (job->deadline.tv_nsec - now.tv_nsec) / 1000000L;
+    return ms > 0 ? (int)ms : 0;
+}
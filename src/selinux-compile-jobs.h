@@ -0,0 +1,131 @@
+/*
+ * Copyright (C) 2020-2021 IoT.bzh Company
+ * Author: Arthur Guyader <arthur.guyader@iot.bzh>
+ *
+ * $RP_BEGIN_LICENSE$
+ * Commercial License Usage
+ *  Licensees holding valid commercial IoT.bzh licenses may use this file in
+ *  accordance with the commercial license agreement provided with the
+ *  Software or, alternatively, in accordance with the terms contained in
+ *  a written agreement between you and The IoT.bzh Company. For licensing terms
+ *  and conditions see https://www.iot.bzh/terms-conditions. For further
+ *  information use the contact form at https://www.iot.bzh/contact.
+ *
+ * GNU General Public License Usage
+ *  Alternatively, this file may be used under the terms of the GNU General
+ *  Public license version 3. This license is as published by the Free Software
+ *  Foundation and appearing in the file LICENSE.GPLv3 included in the packaging
+ *  of this file. Please review the following information to ensure the GNU
+ *  General Public License requirements will be met
+ *  https://www.gnu.org/licenses/gpl-3.0.html.
+ * $RP_END_LICENSE$
+ */
+
+
+#ifndef SEC_LSM_MANAGER_SELINUX_COMPILE_JOBS_H
+#define SEC_LSM_MANAGER_SELINUX_COMPILE_JOBS_H
+
+#if !defined(SELINUX_COMPILE_JOBS)
+#define SELINUX_COMPILE_JOBS 0 // count of online processors
+#endif
+
+#if !defined(SELINUX_COMPILE_TIMEOUT)
+#define SELINUX_COMPILE_TIMEOUT 120000 // ms
+#endif
+
+#include <stdbool.h>
+#include <sys/cdefs.h>
+#include <time.h>
+
+typedef struct compile_job compile_job_t;
+
+/**
+ * @brief Structure of a compilation job
+ * It lives in the stack of the thread installing the module
+ */
+struct compile_job {
+    /** next job in the submission order */
+    compile_job_t *next;
+
+    /** deadline of the job (CLOCK_MONOTONIC) */
+    struct timespec deadline;
+
+    /** flag raised when the requester is gone (may be NULL) */
+    const bool *cancelled;
+
+    /** does the job hold a compilation slot */
+    bool running;
+
+    /** is the job in the submission order */
+    bool queued;
+};
+
+/**
+ * @brief Submit a job
+ * The job is ordered after the jobs already submitted and its deadline starts.
+ * It must be ended with compile_job_end.
+ *
+ * @param[in] job the job
+ * @param[in] cancelled flag raised when the requester is gone (may be NULL)
+ */
+extern void compile_job_submit(compile_job_t *job, const bool *cancelled) __nonnull((1));
+
+/**
+ * @brief Wait for a compilation slot
+ * At most SELINUX_COMPILE_JOBS jobs hold a slot at the same time (default is
+ * the count of online processors, it can be changed with the SELINUX_COMPILE_JOBS
+ * environment variable)
+ *
+ * @param[in] job the job
+ * @return 0 in case of success, -ETIMEDOUT or -ECANCELED
+ */
+extern int compile_job_start(compile_job_t *job) __wur __nonnull();
+
+/**
+ * @brief Release the compilation slot of the job
+ *
+ * @param[in] job the job
+ */
+extern void compile_job_stop(compile_job_t *job) __nonnull();
+
+/**
+ * @brief Wait until the jobs submitted before have ended
+ * It lets the compiled modules be installed in the submission order.
+ *
+ * @param[in] job the job
+ * @return 0 in case of success or -ECANCELED
+ */
+extern int compile_job_wait_turn(compile_job_t *job) __wur __nonnull();
+
+/**
+ * @brief End the job: release its slot and leave the submission order
+ * Ending an ended job does nothing.
+ *
+ * @param[in] job the job
+ */
+extern void compile_job_end(compile_job_t *job) __nonnull();
+
+/**
+ * @brief Tell if submitted jobs are not ended
+ *
+ * @return true if jobs are submitted and not ended
+ */
+extern bool compile_jobs_pending(void) __wur;
+
+/**
+ * @brief Check if the job can continue
+ *
+ * @param[in] job the job
+ * @return 0 if it can, -ETIMEDOUT if its deadline is over or -ECANCELED
+ */
+extern int compile_job_check(const compile_job_t *job) __wur __nonnull();
+
+/**
+ * @brief Get the time left before the deadline of the job
+ *
+ * @param[in] job the job
+ * @return the time left in milliseconds (0 if over)
+ */
+extern int compile_job_time_left(const compile_job_t *job) __wur __nonnull();
+
+#endif
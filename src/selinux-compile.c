@@ -24,50 +24,821 @@
 #include "selinux-compile.h"
 
 #include <errno.h>
+#include <fcntl.h>
+#include <glob.h>
+#include <poll.h>
+#include <pthread.h>
 #include <signal.h>
+#include <spawn.h>
+#include <stdbool.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
+#ifndef SIMULATE_SELINUX
+#include <sepol/module.h>
+#include <sepol/policydb.h>
+#else
+#include "simulation/selinux/selinux.h"
+#endif
+
+#include "limits.h"
 #include "log.h"
+#include "utils.h"
 
-/**********************/
-/*** PUBLIC METHODS ***/
-/**********************/
+#define WORK_DIR "tmp"
+#define INTERFACES_FILE "all_interfaces.conf"
+#define IFERROR_FILE "iferror.m4"
+#define BUILD_CONF_FILE "build.conf"
 
-/* see selinux-compile.h */
-int launch_compile(const char *id) {
+/** period of the checks of the deadline and cancellation of a compilation (ms) */
+#define CHECK_PERIOD 100
+
+#define MAX_DEFINES 16
+#define MAX_SIZE_DEFINE 128
+
+extern char **environ;
+
+const char default_selinux_devel_dir[] = SELINUX_DEVEL_DIR;
+
+/**
+ * @brief Settings of the policy development headers, shared by all the compilations
+ * They are read at the first compilation, which also prepares the interfaces file,
+ * and again after a change of the headers
+ */
+typedef struct compiler {
+    /** true once the compiler is prepared */
+    bool prepared;
+    /** the m4 support macro files */
+    glob_t support;
+    /** the m4 definitions of the policy build options */
+    char defines[MAX_DEFINES][MAX_SIZE_DEFINE];
+    /** count of definitions */
+    size_t defines_count;
+    /** true if the policy is mls or mcs */
+    bool mls;
+    /** the interfaces of the installed policy, expanded once */
+    char interfaces_file[SEC_LSM_MANAGER_MAX_SIZE_PATH];
+    /** the m4 file stopping an expansion of interfaces in error */
+    char iferror_file[SEC_LSM_MANAGER_MAX_SIZE_PATH];
+    /** true once the policy development headers are hashed */
+    bool hashed;
+    /** hash of the policy development headers */
+    uint64_t devel_hash;
+    /** stamp of the policy development headers when prepared or hashed */
+    uint64_t devel_stamp;
+} compiler_t;
+
+static compiler_t compiler = {.prepared = false, .hashed = false, .devel_stamp = 0};
+
+/** lock of the compiler: read by the compilations, written to prepare it again */
+static pthread_rwlock_t compiler_lock = PTHREAD_RWLOCK_INITIALIZER;
+
+/** files of the policy development headers, relative to their directory */
+static const char *const devel_patterns[] = {"include/" BUILD_CONF_FILE, "include/support/*.spt", "include/*/*.if"};
+
+/***********************/
+/*** PRIVATE METHODS ***/
+/***********************/
+
+/**
+ * @brief Wait for the end of a program
+ * With a job, the program is killed when the job is cancelled or its deadline is over
+ *
+ * @param[in] pid the process of the program
+ * @param[in] job the compilation job or NULL to wait without limit
+ * @param[out] status the status of the program
+ * @return 0 in case of success or a negative -errno value
+ */
+__nonnull((3)) __wur static int wait_program(pid_t pid, const compile_job_t *job, int *status) {
+    int pidfd = -1;
     int rc = 0;
+
+#if defined(SYS_pidfd_open)
+    if (job != NULL)
+        pidfd = (int)syscall(SYS_pidfd_open, pid, 0);
+#endif
+
+    for (;;) {
+        pid_t ended = waitpid(pid, status, job != NULL ? WNOHANG : 0);
+        if (ended == pid) {
+            rc = 0;
+            break;
+        }
+        if (ended < 0) {
+            if (errno == EINTR)
+                continue;
+            rc = -errno;
+            break;
+        }
+
+        rc = compile_job_check(job);
+        if (rc < 0) {
+            kill(pid, SIGKILL);
+            while (waitpid(pid, status, 0) < 0 && errno == EINTR)
+                ;
+            break;
+        }
+
+        // sleep until the end of the program or the next check
+        int timeout = compile_job_time_left(job);
+        if (timeout > CHECK_PERIOD)
+            timeout = CHECK_PERIOD;
+        if (pidfd >= 0) {
+            struct pollfd pollfd = {.fd = pidfd, .events = POLLIN, .revents = 0};
+            poll(&pollfd, 1, timeout);
+        } else {
+            // kernel without pidfd
+            struct timespec delay = {.tv_sec = 0, .tv_nsec = 1000000L};
+            nanosleep(&delay, NULL);
+        }
+    }
+
+    if (pidfd >= 0)
+        close(pidfd);
+    return rc;
+}
+
+/**
+ * @brief Run a program and wait for its end, without shell
+ *
+ * @param[in] argv arguments of the program (argv[0] is its path), NULL terminated
+ * @param[in] output file receiving the standard output or NULL to keep it
+ * @param[in] job the compilation job or NULL to wait without limit
+ * @return 0 if the program exits with status 0 or a negative -errno value
+ */
+__nonnull((1)) __wur static int run_program(const char *const argv[], const char *output, const compile_job_t *job) {
+    posix_spawn_file_actions_t actions;
     pid_t pid = 0;
     int status = 0;
+    int rc = posix_spawn_file_actions_init(&actions);
+    if (rc != 0) {
+        ERROR("posix_spawn_file_actions_init : %d %s", rc, strerror(rc));
+        return -rc;
+    }
+
+    if (output != NULL) {
+        rc = posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, output, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (rc != 0) {
+            ERROR("posix_spawn_file_actions_addopen %s : %d %s", output, rc, strerror(rc));
+            goto end;
+        }
+    }
+
+    DEBUG("run %s", argv[0]);
+    rc = posix_spawn(&pid, argv[0], &actions, NULL, (char *const *)argv, environ);
+    if (rc != 0) {
+        ERROR("posix_spawn %s : %d %s", argv[0], rc, strerror(rc));
+        goto end;
+    }
+
+    rc = -wait_program(pid, job, &status);
+    if (rc != 0) {
+        ERROR("wait_program %s : %d %s", argv[0], rc, strerror(rc));
+        goto end;
+    }
+
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        ERROR("%s failed : status %d", argv[0], status);
+        rc = ECHILD;
+    }
+
+end:
+    posix_spawn_file_actions_destroy(&actions);
+    return -rc;
+}
+
+/**
+ * @brief Read the build options of the policy development headers
+ * They are translated in the m4 definitions used by the reference policy Makefile
+ *
+ * @param[in] build_conf path of the build.conf file
+ * @return 0 in case of success or a negative -errno value
+ */
+__nonnull() __wur static int read_build_conf(const char *build_conf) {
+    char line[SEC_LSM_MANAGER_MAX_SIZE_PATH];
+    char key[64];
+    char value[64];
+    int rc = 0;
+
+    FILE *f = fopen(build_conf, "r");
+    if (f == NULL) {
+        rc = -errno;
+        ERROR("fopen %s : %d %s", build_conf, -rc, strerror(-rc));
+        return rc;
+    }
+
+    compiler.defines_count = 0;
+    compiler.mls = false;
+    snprintf(compiler.defines[compiler.defines_count++], MAX_SIZE_DEFINE, "-Dhide_broken_symptoms");
+
+    while (fgets(line, (int)sizeof(line), f) != NULL && compiler.defines_count < MAX_DEFINES) {
+        char *define = compiler.defines[compiler.defines_count];
+        if (sscanf(line, " %63[A-Z_] = %63s", key, value) != 2) {
+            continue;
+        }
+
+        if (!strcmp(key, "TYPE") && (!strcmp(value, "mls") || !strcmp(value, "mcs"))) {
+            snprintf(define, MAX_SIZE_DEFINE, "-Denable_%s", value);
+            compiler.mls = true;
+        } else if (!strcmp(key, "DISTRO")) {
+            snprintf(define, MAX_SIZE_DEFINE, "-Ddistro_%s", value);
+        } else if (!strcmp(key, "UBAC") && !strcmp(value, "y")) {
+            snprintf(define, MAX_SIZE_DEFINE, "-Denable_ubac");
+        } else if (!strcmp(key, "DIRECT_INITRC") && !strcmp(value, "y")) {
+            snprintf(define, MAX_SIZE_DEFINE, "-Ddirect_sysadm_daemon");
+        } else if (!strcmp(key, "MLS_SENS")) {
+            snprintf(define, MAX_SIZE_DEFINE, "-Dmls_num_sens=%s", value);
+        } else if (!strcmp(key, "MLS_CATS")) {
+            snprintf(define, MAX_SIZE_DEFINE, "-Dmls_num_cats=%s", value);
+        } else if (!strcmp(key, "MCS_CATS")) {
+            snprintf(define, MAX_SIZE_DEFINE, "-Dmcs_num_cats=%s", value);
+        } else {
+            continue;
+        }
+        compiler.defines_count++;
+    }
+
+    fclose(f);
+    return 0;
+}
+
+/**
+ * @brief Write the interfaces file from the m4 expansion of the interfaces
+ * As done by the reference policy Makefile, the expansion is put in a diversion
+ * and 'dollarsstar' is replaced by '$*'
+ *
+ * @param[in] expanded path of the m4 expansion of the interfaces
+ * @param[in] interfaces_file path of the interfaces file to write
+ * @return 0 in case of success or a negative -errno value
+ */
+__nonnull() __wur static int write_interfaces_file(const char *expanded, const char *interfaces_file) {
+    static const char pattern[] = "dollarsstar";
+    int rc = 0;
+    char *content = read_file(expanded);
+    if (content == NULL) {
+        ERROR("read_file %s", expanded);
+        return -ENOENT;
+    }
+
+    FILE *f = fopen(interfaces_file, "w");
+    if (f == NULL) {
+        rc = -errno;
+        ERROR("fopen %s : %d %s", interfaces_file, -rc, strerror(-rc));
+        goto end;
+    }
+
+    fputs("divert(-1)\n", f);
+    char *begin = content;
+    for (char *found = strstr(begin, pattern); found != NULL; found = strstr(begin, pattern)) {
+        fwrite(begin, 1, (size_t)(found - begin), f);
+        fputs("$*", f);
+        begin = found + sizeof(pattern) - 1;
+    }
+    fputs(begin, f);
+    fputs("divert\n", f);
+
+    if (fclose(f) != 0) {
+        rc = -errno;
+        ERROR("fclose %s : %d %s", interfaces_file, -rc, strerror(-rc));
+    }
+
+end:
+    free(content);
+    return rc;
+}
+
+/**
+ * @brief Hash the names and contents of the files matching a pattern (FNV-1a 64 bits)
+ * No file matching is not an error
+ *
+ * @param[in] pattern the glob pattern of the files
+ * @param[in,out] hash the hash to update
+ * @return 0 in case of success or a negative -errno value
+ */
+__nonnull() __wur static int hash_files(const char *pattern, uint64_t *hash) {
+    glob_t files = {0};
+    uint64_t h = *hash;
+    int rc = glob(pattern, 0, NULL, &files);
+    if (rc == GLOB_NOMATCH) {
+        return 0;
+    }
+    if (rc != 0) {
+        ERROR("glob %s failed", pattern);
+        return -ENOMEM;
+    }
+
+    rc = 0;
+    for (size_t i = 0; i < files.gl_pathc && rc >= 0; i++) {
+        char *content = read_file(files.gl_pathv[i]);
+        if (content == NULL) {
+            ERROR("read_file %s", files.gl_pathv[i]);
+            rc = -ENOENT;
+            break;
+        }
+        // the terminating nuls separate the names and the contents
+        for (const char *c = files.gl_pathv[i];; c++) {
+            h = (h ^ (unsigned char)*c) * 1099511628211ULL;
+            if (*c == '\0')
+                break;
+        }
+        for (const char *c = content;; c++) {
+            h = (h ^ (unsigned char)*c) * 1099511628211ULL;
+            if (*c == '\0')
+                break;
+        }
+        free(content);
+    }
+
+    globfree(&files);
+    *hash = h;
+    return rc;
+}
+
+/**
+ * @brief Expand interface files with the m4 support macros into an interfaces file
+ *
+ * @param[in] files the interface files
+ * @param[in] count the count of interface files
+ * @param[in] interfaces_file path of the interfaces file to write
+ * @param[in] job the compilation job or NULL
+ * @return 0 in case of success or a negative -errno value
+ */
+__nonnull((1, 3)) __wur static int expand_interfaces(const char *const *files, size_t count,
+                                                     const char *interfaces_file, const compile_job_t *job) {
+    char expanded[SEC_LSM_MANAGER_MAX_SIZE_PATH];
+    size_t argc = 0;
+    int rc = 0;
+
+    if (snprintf(expanded, sizeof(expanded), "%s.m4", interfaces_file) >= (int)sizeof(expanded)) {
+        ERROR("interfaces file name too long %s", interfaces_file);
+        return -ENAMETOOLONG;
+    }
+
+    // m4 support... interfaces... iferror NULL
+    const char **argv = malloc((compiler.support.gl_pathc + count + 3) * sizeof(*argv));
+    if (argv == NULL) {
+        ERROR("malloc failed");
+        return -ENOMEM;
+    }
+    argv[argc++] = SELINUX_M4;
+    for (size_t i = 0; i < compiler.support.gl_pathc; i++)
+        argv[argc++] = compiler.support.gl_pathv[i];
+    for (size_t i = 0; i < count; i++)
+        argv[argc++] = files[i];
+    argv[argc++] = compiler.iferror_file;
+    argv[argc] = NULL;
+
+    rc = run_program(argv, expanded, job);
+    if (rc < 0) {
+        ERROR("run_program %s : %d %s", SELINUX_M4, -rc, strerror(-rc));
+        goto end;
+    }
+
+    rc = write_interfaces_file(expanded, interfaces_file);
+    if (rc < 0) {
+        ERROR("write_interfaces_file : %d %s", -rc, strerror(-rc));
+    }
+
+end:
+    remove(expanded);
+    free(argv);
+    return rc;
+}
+
+/**
+ * @brief Prepare the compiler: read the build options and expand the interfaces of the
+ * installed policy once, instead of at each compilation
+ *
+ * @param[in] work_dir directory of the intermediate files
+ * @param[in] job the compilation job or NULL
+ * @return 0 in case of success or a negative -errno value
+ */
+__nonnull((1)) __wur static int prepare_compiler(const char *work_dir, const compile_job_t *job) {
+    const char *devel_dir = get_selinux_devel_dir(NULL);
+    char path[SEC_LSM_MANAGER_MAX_SIZE_PATH];
+    glob_t interfaces = {0};
+    int rc = 0;
+
+    if (snprintf(compiler.iferror_file, sizeof(compiler.iferror_file), "%s/%s", work_dir, IFERROR_FILE) >=
+            (int)sizeof(compiler.iferror_file) ||
+        snprintf(compiler.interfaces_file, sizeof(compiler.interfaces_file), "%s/%s", work_dir, INTERFACES_FILE) >=
+            (int)sizeof(compiler.interfaces_file)) {
+        ERROR("work directory too long %s", work_dir);
+        return -ENAMETOOLONG;
+    }
+
+    snprintf(path, sizeof(path), "%s/include/%s", devel_dir, BUILD_CONF_FILE);
+    rc = read_build_conf(path);
+    if (rc < 0) {
+        ERROR("read_build_conf : %d %s", -rc, strerror(-rc));
+        return rc;
+    }
+
+    snprintf(path, sizeof(path), "%s/include/support/*.spt", devel_dir);
+    if (glob(path, 0, NULL, &compiler.support) != 0) {
+        ERROR("no m4 support files in %s", devel_dir);
+        return -ENOENT;
+    }
+
+    snprintf(path, sizeof(path), "%s/include/*/*.if", devel_dir);
+    if (glob(path, 0, NULL, &interfaces) != 0) {
+        ERROR("no interface files in %s", devel_dir);
+        rc = -ENOENT;
+        goto error;
+    }
+
+    FILE *f = fopen(compiler.iferror_file, "w");
+    if (f == NULL) {
+        rc = -errno;
+        ERROR("fopen %s : %d %s", compiler.iferror_file, -rc, strerror(-rc));
+        goto error2;
+    }
+    fputs("ifdef(`__if_error',`m4exit(1)')\n", f);
+    fclose(f);
+
+    rc = expand_interfaces((const char *const *)interfaces.gl_pathv, interfaces.gl_pathc, compiler.interfaces_file,
+                           job);
+    if (rc < 0) {
+        ERROR("expand_interfaces %s : %d %s", devel_dir, -rc, strerror(-rc));
+        goto error2;
+    }
+
+    DEBUG("interfaces of %s expanded in %s", devel_dir, compiler.interfaces_file);
+    globfree(&interfaces);
+    return 0;
+
+error2:
+    globfree(&interfaces);
+error:
+    globfree(&compiler.support);
+    return rc;
+}
+
+/**
+ * @brief Expand a te or fc file with the m4 macros of the policy
+ *
+ * @param[in] input the file to expand
+ * @param[in] module_interfaces the interfaces file of the module to also expand with
+ *                              the interfaces of the policy (te file) or NULL (fc file)
+ * @param[in] output the expanded file
+ * @param[in] job the compilation job or NULL
+ * @return 0 in case of success or a negative -errno value
+ */
+__nonnull((1, 3)) __wur static int expand_file(const char *input, const char *module_interfaces,
+                                               const char *output, const compile_job_t *job) {
+    size_t argc = 0;
+    int rc = 0;
+
+    // m4 defines... -s support... interfaces module_interfaces input NULL
+    const char **argv = malloc((compiler.defines_count + compiler.support.gl_pathc + 6) * sizeof(*argv));
+    if (argv == NULL) {
+        ERROR("malloc failed");
+        return -ENOMEM;
+    }
+
+    argv[argc++] = SELINUX_M4;
+    for (size_t i = 0; i < compiler.defines_count; i++)
+        argv[argc++] = compiler.defines[i];
+    if (module_interfaces != NULL)
+        argv[argc++] = "-s";
+    for (size_t i = 0; i < compiler.support.gl_pathc; i++)
+        argv[argc++] = compiler.support.gl_pathv[i];
+    if (module_interfaces != NULL) {
+        argv[argc++] = compiler.interfaces_file;
+        argv[argc++] = module_interfaces;
+    }
+    argv[argc++] = input;
+    argv[argc] = NULL;
+
+    rc = run_program(argv, output, job);
+    if (rc < 0) {
+        ERROR("run_program %s %s : %d %s", SELINUX_M4, input, -rc, strerror(-rc));
+    }
+
+    free(argv);
+    return rc;
+}
 
-    pid = vfork();
-    if (pid == 0) {
-        DEBUG("Launch : %s %s", COMPILE_SCRIPT_NAME, id);
-        execl(COMPILE_SCRIPT, COMPILE_SCRIPT_NAME, id, NULL);
-        _exit(EXIT_FAILURE);
+/**
+ * @brief Write the module package from the module and its file contexts
+ *
+ * @param[in] mod_file path of the module compiled by checkmodule
+ * @param[in] fc_file path of the expanded file contexts
+ * @param[in] pp_file path of the module package to write
+ * @return 0 in case of success or a negative -errno value
+ */
+__nonnull() __wur static int package_module(const char *mod_file, const char *fc_file, const char *pp_file) {
+    sepol_module_package_t *package = NULL;
+    sepol_policy_file_t *policy_file = NULL;
+    char *file_contexts = NULL;
+    FILE *f = NULL;
+    int rc = 0;
+
+    if (sepol_module_package_create(&package) < 0 || sepol_policy_file_create(&policy_file) < 0) {
+        rc = -ENOMEM;
+        ERROR("sepol create failed");
+        goto end;
     }
 
-    if (pid < 0) {
+    f = fopen(mod_file, "r");
+    if (f == NULL) {
         rc = -errno;
-        ERROR("vfork failed : %d %s", -rc, strerror(-rc));
+        ERROR("fopen %s : %d %s", mod_file, -rc, strerror(-rc));
+        goto end;
+    }
+    sepol_policy_file_set_fp(policy_file, f);
+    rc = sepol_policydb_read(sepol_module_package_get_policy(package), policy_file);
+    fclose(f);
+    if (rc < 0) {
+        rc = -EINVAL;
+        ERROR("sepol_policydb_read %s failed", mod_file);
+        goto end;
+    }
+
+    file_contexts = read_file(fc_file);
+    if (file_contexts == NULL) {
+        rc = -ENOENT;
+        ERROR("read_file %s", fc_file);
+        goto end;
+    }
+    if (sepol_module_package_set_file_contexts(package, file_contexts, strlen(file_contexts)) < 0) {
+        rc = -ENOMEM;
+        ERROR("sepol_module_package_set_file_contexts failed");
+        goto end;
+    }
+
+    f = fopen(pp_file, "w");
+    if (f == NULL) {
+        rc = -errno;
+        ERROR("fopen %s : %d %s", pp_file, -rc, strerror(-rc));
+        goto end;
+    }
+    sepol_policy_file_set_fp(policy_file, f);
+    if (sepol_module_package_write(package, policy_file) < 0) {
+        rc = -EIO;
+        ERROR("sepol_module_package_write %s failed", pp_file);
+    }
+    if (fclose(f) != 0 && rc == 0) {
+        rc = -errno;
+        ERROR("fclose %s : %d %s", pp_file, -rc, strerror(-rc));
+    }
+    if (rc < 0) {
+        remove(pp_file);
+    }
+
+end:
+    free(file_contexts);
+    if (policy_file != NULL) {
+        sepol_policy_file_free(policy_file);
+    }
+    if (package != NULL) {
+        sepol_module_package_free(package);
+    }
+    return rc;
+}
+
+/**
+ * @brief Compute a stamp of the policy development headers from the names, inodes,
+ * sizes and modification times of their files, cheaper than their hash
+ *
+ * @param[out] stamp the stamp of the policy development headers
+ * @return 0 in case of success or a negative -errno value
+ */
+__nonnull() __wur static int get_devel_stamp(uint64_t *stamp) {
+    const char *devel_dir = get_selinux_devel_dir(NULL);
+    char pattern[SEC_LSM_MANAGER_MAX_SIZE_PATH];
+    uint64_t h = 14695981039346656037ULL;
+    struct stat st;
+
+    for (size_t i = 0; i < sizeof(devel_patterns) / sizeof(*devel_patterns); i++) {
+        glob_t files = {0};
+        snprintf(pattern, sizeof(pattern), "%s/%s", devel_dir, devel_patterns[i]);
+        int rc = glob(pattern, 0, NULL, &files);
+        if (rc == GLOB_NOMATCH)
+            continue;
+        if (rc != 0) {
+            ERROR("glob %s failed", pattern);
+            return -ENOMEM;
+        }
+        for (size_t j = 0; j < files.gl_pathc; j++) {
+            uint64_t values[4] = {0, 0, 0, 0};
+            if (stat(files.gl_pathv[j], &st) == 0) {
+                values[0] = (uint64_t)st.st_ino;
+                values[1] = (uint64_t)st.st_size;
+                values[2] = (uint64_t)st.st_mtim.tv_sec;
+                values[3] = (uint64_t)st.st_mtim.tv_nsec;
+            }
+            for (const char *c = files.gl_pathv[j];; c++) {
+                h = (h ^ (unsigned char)*c) * 1099511628211ULL;
+                if (*c == '\0')
+                    break;
+            }
+            for (size_t k = 0; k < sizeof(values); k++)
+                h = (h ^ ((const unsigned char *)values)[k]) * 1099511628211ULL;
+        }
+        globfree(&files);
+    }
+
+    *stamp = h;
+    return 0;
+}
+
+/**
+ * @brief Hash the policy development headers
+ *
+ * @param[out] hash the hash of the policy development headers
+ * @return 0 in case of success or a negative -errno value
+ */
+__nonnull() __wur static int hash_devel(uint64_t *hash) {
+    const char *devel_dir = get_selinux_devel_dir(NULL);
+    char pattern[SEC_LSM_MANAGER_MAX_SIZE_PATH];
+    uint64_t h = 14695981039346656037ULL;
+
+    for (size_t i = 0; i < sizeof(devel_patterns) / sizeof(*devel_patterns); i++) {
+        snprintf(pattern, sizeof(pattern), "%s/%s", devel_dir, devel_patterns[i]);
+        int rc = hash_files(pattern, &h);
+        if (rc < 0) {
+            ERROR("hash_files %s : %d %s", pattern, -rc, strerror(-rc));
+            return rc;
+        }
+    }
+
+    DEBUG("policy development headers of %s hashed", devel_dir);
+    *hash = h;
+    return 0;
+}
+
+/**
+ * @brief Lock the compiler for reading, once prepared (with a work directory) or hashed
+ * (without) for the current policy development headers. The compiler is reset when
+ * the stamp of the headers changed since it was prepared or hashed.
+ *
+ * @param[in] work_dir directory of the intermediate files or NULL to only hash the headers
+ * @param[in] job the compilation job or NULL
+ * @return 0 in case of success or a negative -errno value
+ */
+__wur static int lock_compiler(const char *work_dir, const compile_job_t *job) {
+    uint64_t stamp;
+    int rc = get_devel_stamp(&stamp);
+    if (rc < 0) {
+        ERROR("get_devel_stamp : %d %s", -rc, strerror(-rc));
         return rc;
     }
 
-    rc = waitpid(pid, &status, 0);
+    pthread_rwlock_rdlock(&compiler_lock);
+    while (compiler.devel_stamp != stamp || !(work_dir ? compiler.prepared : compiler.hashed)) {
+        pthread_rwlock_unlock(&compiler_lock);
+        pthread_rwlock_wrlock(&compiler_lock);
+        // the stamp is read again in the lock, so that concurrent callers agree on it
+        rc = get_devel_stamp(&stamp);
+        if (rc >= 0 && compiler.devel_stamp != stamp) {
+            if (compiler.prepared)
+                globfree(&compiler.support);
+            if (compiler.prepared || compiler.hashed)
+                DEBUG("policy development headers changed");
+            compiler.prepared = false;
+            compiler.hashed = false;
+            compiler.devel_stamp = stamp;
+        }
+        if (rc >= 0 && work_dir != NULL && !compiler.prepared) {
+            rc = prepare_compiler(work_dir, job);
+            compiler.prepared = rc >= 0;
+        }
+        if (rc >= 0 && work_dir == NULL && !compiler.hashed) {
+            rc = hash_devel(&compiler.devel_hash);
+            compiler.hashed = rc >= 0;
+        }
+        pthread_rwlock_unlock(&compiler_lock);
+        if (rc < 0)
+            return rc;
+        // another writer may change the compiler meanwhile, it is checked again
+        pthread_rwlock_rdlock(&compiler_lock);
+    }
+    return 0;
+}
+
+/**********************/
+/*** PUBLIC METHODS ***/
+/**********************/
+
+/* see selinux-compile.h */
+int compile_selinux_module(const char *te_file, const char *if_file, const char *fc_file, const char *pp_file,
+                           const compile_job_t *job) {
+    char work_dir[SEC_LSM_MANAGER_MAX_SIZE_PATH];
+    char if_conf_file[SEC_LSM_MANAGER_MAX_SIZE_PATH];
+    char tmp_file[SEC_LSM_MANAGER_MAX_SIZE_PATH];
+    char mod_file[SEC_LSM_MANAGER_MAX_SIZE_PATH];
+    char mod_fc_file[SEC_LSM_MANAGER_MAX_SIZE_PATH];
+    int rc = 0;
 
-    if (rc == -1) {
+    // intermediate files are named as by the reference policy Makefile: tmp/<name>.{tmp,mod,mod.fc}
+    // the interfaces of the module are expanded apart in tmp/<name>.if.conf
+    const char *name = strrchr(pp_file, '/');
+    int dir_length = name ? (int)(name - pp_file) : 1;
+    const char *dir = name ? pp_file : ".";
+    name = name ? name + 1 : pp_file;
+    int name_length = (int)strlen(name) - (int)strlen(".pp");
+    if (name_length <= 0 || strcmp(name + name_length, ".pp")) {
+        ERROR("bad name of module package %s", pp_file);
+        return -EINVAL;
+    }
+
+    if (snprintf(work_dir, sizeof(work_dir), "%.*s/%s", dir_length, dir, WORK_DIR) >= (int)sizeof(work_dir) ||
+        snprintf(if_conf_file, sizeof(if_conf_file), "%s/%.*s.if.conf", work_dir, name_length, name) >=
+            (int)sizeof(if_conf_file) ||
+        snprintf(tmp_file, sizeof(tmp_file), "%s/%.*s.tmp", work_dir, name_length, name) >= (int)sizeof(tmp_file) ||
+        snprintf(mod_file, sizeof(mod_file), "%s/%.*s.mod", work_dir, name_length, name) >= (int)sizeof(mod_file) ||
+        snprintf(mod_fc_file, sizeof(mod_fc_file), "%s/%.*s.mod.fc", work_dir, name_length, name) >=
+            (int)sizeof(mod_fc_file)) {
+        ERROR("name of module package too long %s", pp_file);
+        return -ENAMETOOLONG;
+    }
+
+    if (mkdir(work_dir, 0755) < 0 && errno != EEXIST) {
         rc = -errno;
-        ERROR("error wait pid : %d %s", -rc, strerror(-rc));
+        ERROR("mkdir %s : %d %s", work_dir, -rc, strerror(-rc));
+        return rc;
+    }
+
+    // the compiler is kept prepared until the end of the compilation
+    rc = lock_compiler(work_dir, job);
+    if (rc < 0) {
+        ERROR("lock_compiler : %d %s", -rc, strerror(-rc));
         return rc;
     }
 
-    if (!WIFEXITED(status)) {
-        ERROR("error during compile : child return %d", WEXITSTATUS(status));
-        return status;
+    // as the local interfaces of the devel Makefile, those of the module can be used by its te file
+    rc = expand_interfaces(&if_file, 1, if_conf_file, job);
+    if (rc < 0) {
+        ERROR("expand_interfaces %s : %d %s", if_file, -rc, strerror(-rc));
+        goto end;
+    }
+
+    rc = expand_file(te_file, if_conf_file, tmp_file, job);
+    if (rc < 0) {
+        ERROR("expand_file %s : %d %s", te_file, -rc, strerror(-rc));
+        goto end;
+    }
+
+    // checkmodule [-M] -m tmp -o mod
+    const char *checkmodule[7];
+    size_t argc = 0;
+    checkmodule[argc++] = SELINUX_CHECKMODULE;
+    if (compiler.mls)
+        checkmodule[argc++] = "-M";
+    checkmodule[argc++] = "-m";
+    checkmodule[argc++] = tmp_file;
+    checkmodule[argc++] = "-o";
+    checkmodule[argc++] = mod_file;
+    checkmodule[argc] = NULL;
+    rc = run_program(checkmodule, NULL, job);
+    if (rc < 0) {
+        ERROR("run_program %s : %d %s", SELINUX_CHECKMODULE, -rc, strerror(-rc));
+        goto end;
+    }
+
+    rc = expand_file(fc_file, NULL, mod_fc_file, job);
+    if (rc < 0) {
+        ERROR("expand_file %s : %d %s", fc_file, -rc, strerror(-rc));
+        goto end;
+    }
+
+    rc = package_module(mod_file, mod_fc_file, pp_file);
+    if (rc < 0) {
+        ERROR("package_module %s : %d %s", pp_file, -rc, strerror(-rc));
+        goto end;
     }
 
+    DEBUG("success compile %s", pp_file);
+
+end:
+    pthread_rwlock_unlock(&compiler_lock);
+    remove(if_conf_file);
+    remove(tmp_file);
+    remove(mod_file);
+    remove(mod_fc_file);
+    return rc;
+}
+
+/* see selinux-compile.h */
+int get_selinux_devel_hash(uint64_t *hash) {
+    int rc = lock_compiler(NULL, NULL);
+    if (rc < 0) {
+        ERROR("lock_compiler : %d %s", -rc, strerror(-rc));
+        return rc;
+    }
+    *hash = compiler.devel_hash;
+    pthread_rwlock_unlock(&compiler_lock);
     return 0;
 }
+
+/* see selinux-compile.h */
+const char *get_selinux_devel_dir(const char *value) {
+    return value ?: secure_getenv("SELINUX_DEVEL_DIR") ?: default_selinux_devel_dir;
+}
@@ -24,24 +24,59 @@
 #ifndef SEC_LSM_MANAGER_SELINUX_COMPILE_H
 #define SEC_LSM_MANAGER_SELINUX_COMPILE_H
 
-#if !defined(COMPILE_SCRIPT_DIR)
-#define COMPILE_SCRIPT_DIR "/usr/share/sec-lsm-manager/script"
+#if !defined(SELINUX_DEVEL_DIR)
+#define SELINUX_DEVEL_DIR "/usr/share/selinux/devel"
 #endif
 
-#if !defined(COMPILE_SCRIPT_NAME)
-#define COMPILE_SCRIPT_NAME "build-module.sh"
+#if !defined(SELINUX_M4)
+#define SELINUX_M4 "/usr/bin/m4"
 #endif
 
-#define COMPILE_SCRIPT COMPILE_SCRIPT_DIR "/" COMPILE_SCRIPT_NAME
+#if !defined(SELINUX_CHECKMODULE)
+#define SELINUX_CHECKMODULE "/usr/bin/checkmodule"
+#endif
 
+#include <stdint.h>
 #include <sys/cdefs.h>
 
+#include "selinux-compile-jobs.h"
+
 /**
- * @brief Launch COMPILE_SCRIPT
+ * @brief Compile a selinux module package from its te, if and fc files
+ * The m4 macros of the policy development headers and the interfaces of the
+ * module are expanded, the module
+ * is checked by checkmodule and the package is written by libsepol.
+ * Intermediate files are written in the tmp directory beside the pp file.
+ * With a job, the programs run are killed when the job is cancelled or late.
  *
- * @param[in] id id of module to compile
+ * @param[in] te_file path of the te file
+ * @param[in] if_file path of the if file
+ * @param[in] fc_file path of the fc file
+ * @param[in] pp_file path of the pp file to write
+ * @param[in] job the compilation job or NULL to wait without limit
  * @return 0 in case of success or a negative -errno value
  */
-extern int launch_compile(const char* id) __wur;
+extern int compile_selinux_module(const char *te_file, const char *if_file, const char *fc_file, const char *pp_file,
+                                  const compile_job_t *job) __wur __nonnull((1, 2, 3, 4));
+
+/**
+ * @brief Get the hash of the policy development headers the modules are compiled against
+ * It covers the build options, the m4 support macros and the interfaces of the policy,
+ * so that a module compiled before an update of the policy is not taken for current.
+ * It is computed at the first call and again when the names, sizes or modification
+ * times of the files of the headers change.
+ *
+ * @param[out] hash the hash of the policy development headers
+ * @return 0 in case of success or a negative -errno value
+ */
+extern int get_selinux_devel_hash(uint64_t *hash) __wur __nonnull();
+
+/**
+ * @brief Get the directory of the policy development headers
+ *
+ * @param[in] value some value or NULL for getting default
+ * @return the directory of the policy development headers
+ */
+extern const char *get_selinux_devel_dir(const char *value) __wur;
 
 #endif
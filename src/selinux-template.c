@@ -24,10 +24,15 @@
 #include "selinux-template.h"
 
 #include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
+#include "arena.h"
+#include "hash-index.h"
 #include "limits.h"
 #include "log.h"
 #include "selinux-compile.h"
@@ -42,6 +47,8 @@
 #define FC_EXTENSION "fc"
 #define IF_EXTENSION "if"
 #define PP_EXTENSION "pp"
+#define CIL_EXTENSION "cil"
+#define HASH_EXTENSION "hash"
 
 #if !defined(TE_TEMPLATE_FILE)
 #define TE_TEMPLATE_FILE "app-template.te"
@@ -51,6 +58,10 @@
 #define IF_TEMPLATE_FILE "app-template.if"
 #endif
 
+#if !defined(CIL_TEMPLATE_FILE)
+#define CIL_TEMPLATE_FILE "app-template.cil"
+#endif
+
 #if !defined(SELINUX_TE_TEMPLATE_FILE)
 #define SELINUX_TE_TEMPLATE_FILE SEC_LSM_MANAGER_DATADIR "/" TE_TEMPLATE_FILE
 #endif
@@ -59,6 +70,18 @@
 #define SELINUX_IF_TEMPLATE_FILE SEC_LSM_MANAGER_DATADIR "/" IF_TEMPLATE_FILE
 #endif
 
+#if !defined(SELINUX_CIL_TEMPLATE_FILE)
+#define SELINUX_CIL_TEMPLATE_FILE SEC_LSM_MANAGER_DATADIR "/" CIL_TEMPLATE_FILE
+#endif
+
+#if !defined(SELINUX_CIL)
+#define SELINUX_CIL 0 /* 1 to write the modules in CIL instead of compiling te, if and fc files */
+#endif
+
+#if !defined(SELINUX_GROUP_COMMIT_DELAY)
+#define SELINUX_GROUP_COMMIT_DELAY 50 /* milliseconds (0 commits each operation alone) */
+#endif
+
 #if !defined(SELINUX_RULES_DIR)
 #define SELINUX_RULES_DIR SEC_LSM_MANAGER_DATADIR "/selinux-rules"
 #endif
@@ -66,15 +89,19 @@
 const char default_selinux_rules_dir[] = SELINUX_RULES_DIR;
 const char default_selinux_te_template_file[] = SELINUX_TE_TEMPLATE_FILE;
 const char default_selinux_if_template_file[] = SELINUX_IF_TEMPLATE_FILE;
+const char default_selinux_cil_template_file[] = SELINUX_CIL_TEMPLATE_FILE;
 
 typedef struct selinux_module {
     char selinux_te_file[SEC_LSM_MANAGER_MAX_SIZE_PATH];           ///////////////////
     char selinux_if_file[SEC_LSM_MANAGER_MAX_SIZE_PATH];           //   PATH MODULE //
     char selinux_fc_file[SEC_LSM_MANAGER_MAX_SIZE_PATH];           //      FILE     //
-    char selinux_pp_file[SEC_LSM_MANAGER_MAX_SIZE_PATH];           ///////////////////
-    char selinux_rules_dir[SEC_LSM_MANAGER_MAX_SIZE_DIR];          // Store te, if, fc, pp files
+    char selinux_pp_file[SEC_LSM_MANAGER_MAX_SIZE_PATH];           //               //
+    char selinux_cil_file[SEC_LSM_MANAGER_MAX_SIZE_PATH];          //               //
+    char selinux_hash_file[SEC_LSM_MANAGER_MAX_SIZE_PATH];         ///////////////////
+    char selinux_rules_dir[SEC_LSM_MANAGER_MAX_SIZE_DIR];          // Store te, if, fc, pp, cil files
     char selinux_te_template_file[SEC_LSM_MANAGER_MAX_SIZE_PATH];  // te base template
     char selinux_if_template_file[SEC_LSM_MANAGER_MAX_SIZE_PATH];  // if base template
+    char selinux_cil_template_file[SEC_LSM_MANAGER_MAX_SIZE_PATH]; // cil base template
 } selinux_module_t;
 
 char suffix_id[] = "_t";
@@ -86,6 +113,68 @@ char suffix_data[] = "_data_t";
 char suffix_http[] = "_http_t";
 char public_app[] = "redpesk_public_t";
 
+/** the semanage session shared by the selinux operations, connected on demand */
+static semanage_handle_t *semanage_session = NULL;
+
+/** lock of the semanage session */
+static pthread_mutex_t semanage_session_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief Operation staged in the semanage session, waiting for a group commit
+ */
+typedef struct commit_request {
+    /** function staging the operation */
+    int (*stage)(semanage_handle_t *, const char *);
+    /** argument of the operation */
+    const char *arg;
+    /** result of the operation */
+    int result;
+    /** true when the result is known */
+    bool done;
+    /** next request of the group */
+    struct commit_request *next;
+} commit_request_t;
+
+/** requests of the group waiting for its commit (NULL if no group is open) */
+static commit_request_t *staged_requests = NULL;
+
+/** signaled when a group has been committed or when an operation joined the open group */
+static pthread_cond_t commit_cond = PTHREAD_COND_INITIALIZER;
+
+/** count of the operations entering group_commit, not yet staged */
+static unsigned joining_operations = 0;
+
+/**
+ * @brief Module of the policy known by the index
+ * The entries are never removed, a removed module is only marked as not installed
+ */
+typedef struct module_entry {
+    bool installed;
+    char name[];
+} module_entry_t;
+
+/**
+ * @brief Index of the modules installed in the policy, locked with the semanage session
+ * It is loaded from semanage at the first check, then updated by the commits of the
+ * daemon. It is loaded again when another process loads a policy.
+ */
+typedef struct module_index {
+    module_entry_t **modules;
+    size_t size;
+    size_t capacity;
+    hash_index_t index;
+    arena_t arena;
+    /** true when the index is loaded */
+    bool loaded;
+    /** count of policy loads seen by the index (-1 if unknown) */
+    int policyload;
+} module_index_t;
+
+static module_index_t module_index = {.modules = NULL, .size = 0, .capacity = 0, .loaded = false, .policyload = -1};
+
+/** is the status page of selinux opened */
+static bool selinux_status_opened = false;
+
 /***********************/
 /*** PRIVATE METHODS ***/
 /***********************/
@@ -108,6 +197,9 @@ __nonnull() static void init_selinux_module(selinux_module_t *selinux_module, co
     secure_strncpy(selinux_module->selinux_if_template_file, get_selinux_if_template_file(NULL),
                    SEC_LSM_MANAGER_MAX_SIZE_PATH);
 
+    secure_strncpy(selinux_module->selinux_cil_template_file, get_selinux_cil_template_file(NULL),
+                   SEC_LSM_MANAGER_MAX_SIZE_PATH);
+
     snprintf(selinux_module->selinux_te_file, SEC_LSM_MANAGER_MAX_SIZE_PATH, "%s/%s.%s",
              selinux_module->selinux_rules_dir, secure_app->id, TE_EXTENSION);
 
@@ -119,6 +211,12 @@ __nonnull() static void init_selinux_module(selinux_module_t *selinux_module, co
 
     snprintf(selinux_module->selinux_pp_file, SEC_LSM_MANAGER_MAX_SIZE_PATH, "%s/%s.%s",
              selinux_module->selinux_rules_dir, secure_app->id, PP_EXTENSION);
+
+    snprintf(selinux_module->selinux_cil_file, SEC_LSM_MANAGER_MAX_SIZE_PATH, "%s/%s.%s",
+             selinux_module->selinux_rules_dir, secure_app->id, CIL_EXTENSION);
+
+    snprintf(selinux_module->selinux_hash_file, SEC_LSM_MANAGER_MAX_SIZE_PATH, "%s/%s.%s",
+             selinux_module->selinux_rules_dir, secure_app->id, HASH_EXTENSION);
 }
 
 /**
@@ -218,13 +316,170 @@ ret:
 }
 
 /**
- * @brief Check te, fc, if file exists
+ * @brief Generate the cil file: the cil template followed by the file contexts of the paths
+ *
+ * @param[in] selinux_module selinux module handler
+ * @param[in] secure_app secure app handler
+ * @param[in] path_type_definitions labels of the path types
+ * @return 0 in case of success or a negative -errno value
+ */
+__nonnull() __wur static int generate_app_module_cil(const selinux_module_t *selinux_module,
+                                                     const secure_app_t *secure_app,
+                                                     path_type_definitions_t path_type_definitions[number_path_type]) {
+    int rc = 0;
+    int rc2 = 0;
+
+    rc = process_template(selinux_module->selinux_cil_template_file, selinux_module->selinux_cil_file, secure_app);
+    if (rc < 0) {
+        ERROR("process_template %s -> %s : %d %s", selinux_module->selinux_cil_template_file,
+              selinux_module->selinux_cil_file, -rc, strerror(-rc));
+        goto ret;
+    }
+
+    FILE *f_module_cil = fopen(selinux_module->selinux_cil_file, "a");
+    if (f_module_cil == NULL) {
+        rc = -errno;
+        ERROR("fopen %s : %d %s", selinux_module->selinux_cil_file, -rc, strerror(-rc));
+        goto remove_cil;
+    }
+
+    path_t *path;
+    const char *type;
+    for (size_t i = 0; i < secure_app->path_set.size; i++) {
+        path = secure_app->path_set.paths[i];
+        if (strpbrk(path->path, "\"\n") != NULL) {
+            rc = -EINVAL;
+            ERROR("path not allowed in cil %s", path->path);
+            goto error;
+        }
+
+        // the label is user:role:type, only the type is needed
+        type = strrchr(path_type_definitions[path->path_type].label, ':');
+        type = type ? type + 1 : path_type_definitions[path->path_type].label;
+        if (fprintf(f_module_cil, "(filecon \"%s(/.*)?\" any (system_u object_r %s ((s0) (s0))))\n", path->path,
+                    type) < 0) {
+            rc = -errno;
+            ERROR("fprintf : %d %s", -rc, strerror(-rc));
+            goto error;
+        }
+    }
+
+    DEBUG("success generate selinux cil module");
+
+error:
+    rc2 = fclose(f_module_cil);
+    if (rc2 < 0 && rc >= 0) {
+        rc = -errno;
+        ERROR("fclose : %d %s", -rc, strerror(-rc));
+    }
+    if (rc >= 0) {
+        goto ret;
+    }
+remove_cil:
+    rc2 = remove_file(selinux_module->selinux_cil_file);
+    if (rc2 < 0) {
+        ERROR("remove file %s : %d %s", selinux_module->selinux_cil_file, -rc2, strerror(-rc2));
+    }
+ret:
+    return rc;
+}
+
+/**
+ * @brief Hash the content of the sources of a module (FNV-1a 64 bits)
+ * The sources are rendered from the templates, so the hash also changes with the templates
+ *
+ * @param[in] backend the backend compiling the sources
+ * @param[in] policy hash of the policy the module is compiled against (0 if not compiled)
+ * @param[in] files the sources of the module
+ * @param[in] count count of sources
+ * @param[out] hash the hash of the sources
+ * @return 0 in case of success or a negative -errno value
+ */
+__nonnull() __wur static int hash_module_sources(const char *backend, uint64_t policy, const char *const files[],
+                                                 size_t count, uint64_t *hash) {
+    uint64_t h = 14695981039346656037ULL;
+
+    for (const char *c = backend; *c; c++) {
+        h = (h ^ (unsigned char)*c) * 1099511628211ULL;
+    }
+    for (unsigned i = 0; i < sizeof(policy); i++) {
+        h = (h ^ ((policy >> (8 * i)) & 0xff)) * 1099511628211ULL;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        char *content = read_file(files[i]);
+        if (content == NULL) {
+            ERROR("read_file %s", files[i]);
+            return -ENOENT;
+        }
+        // the terminating nul separates the files
+        for (const char *c = content;; c++) {
+            h = (h ^ (unsigned char)*c) * 1099511628211ULL;
+            if (*c == '\0')
+                break;
+        }
+        free(content);
+    }
+
+    *hash = h;
+    return 0;
+}
+
+/**
+ * @brief Read the hash of the sources of the installed module
+ *
+ * @param[in] selinux_module selinux module handler
+ * @param[out] hash the hash read
+ * @return true if a hash was read, false if not
+ */
+__nonnull() __wur static bool read_module_hash(const selinux_module_t *selinux_module, uint64_t *hash) {
+    unsigned long long value = 0;
+    bool found = false;
+
+    FILE *f = fopen(selinux_module->selinux_hash_file, "r");
+    if (f != NULL) {
+        found = fscanf(f, "%16llx", &value) == 1;
+        fclose(f);
+    }
+    *hash = value;
+    return found;
+}
+
+/**
+ * @brief Record the hash of the sources of the installed module
+ *
+ * @param[in] selinux_module selinux module handler
+ * @param[in] hash the hash to write
+ * @return 0 in case of success or a negative -errno value
+ */
+__nonnull() __wur static int write_module_hash(const selinux_module_t *selinux_module, uint64_t hash) {
+    int rc = 0;
+    FILE *f = fopen(selinux_module->selinux_hash_file, "w");
+    if (f == NULL) {
+        rc = -errno;
+        ERROR("fopen %s : %d %s", selinux_module->selinux_hash_file, -rc, strerror(-rc));
+        return rc;
+    }
+    fprintf(f, "%016llx\n", (unsigned long long)hash);
+    if (fclose(f) != 0) {
+        rc = -errno;
+        ERROR("fclose %s : %d %s", selinux_module->selinux_hash_file, -rc, strerror(-rc));
+        remove(selinux_module->selinux_hash_file);
+    }
+    return rc;
+}
+
+/**
+ * @brief Check te, fc, if files exist (or the cil file with the CIL backend)
  *
  * @param[in] selinux_module selinux module handler
  * @return true if all exist
  * @return false if not
  */
 __nonnull() __wur static bool check_app_module_files_exists(const selinux_module_t *selinux_module) {
+    if (get_env_flag("SELINUX_CIL", SELINUX_CIL))
+        return check_file_exists(selinux_module->selinux_cil_file);
+
     if (!check_file_exists(selinux_module->selinux_te_file))
         return false;
     if (!check_file_exists(selinux_module->selinux_fc_file))
@@ -309,7 +564,7 @@ __wur static int create_semanage_handle(semanage_handle_t **semanage_handle) {
     int rc2 = 0;
     *semanage_handle = semanage_handle_create();
 
-    if (semanage_handle == NULL) {
+    if (*semanage_handle == NULL) {
         rc = -errno;
         ERROR("semanage_handle_create : %d %s", -rc, strerror(-rc));
         goto ret;
@@ -343,33 +598,106 @@ ret:
 }
 
 /**
- * @brief Install selinux module
+ * @brief Get the semanage session, connecting it if needed
+ * The session stays locked until release_semanage_session is called
+ *
+ * @param[out] semanage_handle where to store the semanage handle of the session
+ * @param[out] fresh true if the session has just been connected
+ * @return 0 in case of success or a negative -errno value
+ */
+__nonnull() __wur static int acquire_semanage_session(semanage_handle_t **semanage_handle, bool *fresh) {
+    int rc = 0;
+
+    pthread_mutex_lock(&semanage_session_mutex);
+
+    if (semanage_session != NULL && !semanage_is_connected(semanage_session)) {
+        DEBUG("semanage session disconnected");
+        if (destroy_semanage_handle(semanage_session) < 0) {
+            ERROR("destroy_semanage_handle failed");
+        }
+        semanage_session = NULL;
+    }
+
+    *fresh = semanage_session == NULL;
+    if (*fresh) {
+        rc = create_semanage_handle(&semanage_session);
+        if (rc < 0) {
+            ERROR("create_semanage_handle : %d %s", -rc, strerror(-rc));
+            semanage_session = NULL;
+            pthread_mutex_unlock(&semanage_session_mutex);
+            return rc;
+        }
+    }
+
+    *semanage_handle = semanage_session;
+    return 0;
+}
+
+/**
+ * @brief Unlock the semanage session
+ * After a failure the session is dropped so that the next use reconnects
+ *
+ * @param[in] failed true if the operation on the session failed
+ */
+static void release_semanage_session(bool failed) {
+    if (failed && semanage_session != NULL) {
+        if (destroy_semanage_handle(semanage_session) < 0) {
+            ERROR("destroy_semanage_handle failed");
+        }
+        semanage_session = NULL;
+    }
+    pthread_mutex_unlock(&semanage_session_mutex);
+}
+
+/**
+ * @brief Run an operation on the semanage session
+ * An operation failing on a reused session is tried again on a new session
+ *
+ * @param[in] operation the operation to run
+ * @param[in] arg the argument of the operation
+ * @return the result of the operation or a negative -errno value
+ */
+__nonnull() __wur static int with_semanage_session(int (*operation)(semanage_handle_t *, const char *),
+                                                   const char *arg) {
+    semanage_handle_t *semanage_handle = NULL;
+    bool fresh = false;
+    int rc;
+
+    for (;;) {
+        rc = acquire_semanage_session(&semanage_handle, &fresh);
+        if (rc < 0) {
+            ERROR("acquire_semanage_session : %d %s", -rc, strerror(-rc));
+            return rc;
+        }
+
+        rc = operation(semanage_handle, arg);
+        release_semanage_session(rc < 0);
+        if (rc >= 0 || fresh) {
+            return rc;
+        }
+
+        DEBUG("retry on a new semanage session");
+    }
+}
+
+/**
+ * @brief Stage the install of a selinux module (effective at the next commit)
  *
  * @param[in] semanage_handle semanage_handle handler
  * @param[in] selinux_pp_file Path of the pp file
  * @return 0 in case of success or a negative -errno value
  */
-__nonnull((1)) __wur static int install_module(semanage_handle_t *semanage_handle, const char *selinux_pp_file) {
+__nonnull() __wur static int install_module(semanage_handle_t *semanage_handle, const char *selinux_pp_file) {
     int rc = semanage_module_install_file(semanage_handle, selinux_pp_file);
     if (rc < 0) {
         rc = -errno;
         ERROR("semanage_module_install_file %s : %d %s", selinux_pp_file, -rc, strerror(-rc));
-        goto end;
     }
-
-    rc = semanage_commit(semanage_handle);
-    if (rc < 0) {
-        rc = -errno;
-        ERROR("semanage_commit (install_module %s) : %d %s", selinux_pp_file, -rc, strerror(-rc));
-        goto end;
-    }
-
-end:
     return rc;
 }
 
 /**
- * @brief Remove module in the policy
+ * @brief Stage the removal of a module in the policy (effective at the next commit)
  *
  * @param[in] semanage_handle semanage handle handler
  * @param[in] module_name Module name in the selinux policy
@@ -391,17 +719,78 @@ __nonnull() __wur static int remove_module(semanage_handle_t *semanage_handle, c
         goto end;
     }
 
-    rc = semanage_commit(semanage_handle);
+end:
+    return rc;
+}
+
+/**
+ * @brief Commit the operations staged in the semanage session
+ *
+ * @param[in] semanage_handle semanage handle handler
+ * @return 0 in case of success or a negative -errno value
+ */
+__nonnull() __wur static int commit_session(semanage_handle_t *semanage_handle) {
+    int rc = semanage_commit(semanage_handle);
     if (rc < 0) {
         rc = -errno;
-        ERROR("semanage_commit (remove module %s) : %d %s", module_name_, -rc, strerror(-rc));
-        goto end;
+        ERROR("semanage_commit : %d %s", -rc, strerror(-rc));
+        return rc;
+    }
+    return 0;
+}
+
+/**
+ * @brief Replace the semanage session by a new one, discarding what is staged
+ * The session must be locked
+ *
+ * @return 0 in case of success or a negative -errno value
+ */
+__wur static int reset_semanage_session(void) {
+    int rc = 0;
+
+    if (semanage_session != NULL) {
+        if (destroy_semanage_handle(semanage_session) < 0) {
+            ERROR("destroy_semanage_handle failed");
+        }
+        semanage_session = NULL;
+    }
+
+    rc = create_semanage_handle(&semanage_session);
+    if (rc < 0) {
+        ERROR("create_semanage_handle : %d %s", -rc, strerror(-rc));
+        semanage_session = NULL;
     }
 
-end:
     return rc;
 }
 
+/**
+ * @brief Commit the requests of a group one by one
+ * Used when the commit of the whole group failed, to report the result of each request
+ * The session must be locked
+ *
+ * @param[in] requests the requests of the group
+ * @return 0 if the session is usable or a negative -errno value
+ */
+__nonnull() __wur static int commit_requests_alone(commit_request_t *requests) {
+    int rc = 0;
+
+    for (commit_request_t *request = requests; request != NULL; request = request->next) {
+        rc = reset_semanage_session();
+        if (rc < 0) {
+            request->result = rc;
+            continue;
+        }
+
+        request->result = request->stage(semanage_session, request->arg);
+        if (request->result >= 0) {
+            request->result = commit_session(semanage_session);
+        }
+    }
+
+    return reset_semanage_session();
+}
+
 /**
  * @brief Free semanage_module_info_list
  *
@@ -421,49 +810,354 @@ __nonnull() static void free_module_info_list(semanage_handle_t *semanage_handle
 }
 
 /**
- * @brief Check module in selinux policy
+ * @brief Get the count of policy loads
+ *
+ * @return the count of policy loads or -1 if unknown
+ */
+__wur static int get_policyload(void) {
+    if (!selinux_status_opened) {
+        selinux_status_opened = selinux_status_open(1) >= 0;
+        if (!selinux_status_opened) {
+            return -1;
+        }
+    }
+    return selinux_status_policyload();
+}
+
+/**
+ * @brief Get the name of the module at 'position' of the module index (for the hash index)
+ */
+__nonnull() __wur static const char *get_module_name(const void *set, size_t position) {
+    return ((const module_index_t *)set)->modules[position]->name;
+}
+
+/**
+ * @brief Forget the modules of the index, it will be loaded again at the next check
+ * The session must be locked
+ */
+static void invalidate_module_index(void) {
+    arena_reset(&module_index.arena);
+    module_index.modules = NULL;
+    module_index.size = 0;
+    module_index.capacity = 0;
+    init_hash_index(&module_index.index);
+    module_index.loaded = false;
+}
+
+/**
+ * @brief Record in the index that a module is installed or not
+ * The session must be locked
+ *
+ * @param[in] name name of the module
+ * @param[in] installed true if the module is installed
+ * @return 0 in case of success or a negative -errno value
+ */
+__nonnull() __wur static int set_module_installed(const char *name, bool installed) {
+    size_t position = 0;
+    if (hash_index_search(&module_index.index, &module_index, get_module_name, name, false, &position)) {
+        module_index.modules[position]->installed = installed;
+        return 0;
+    }
+
+    // removing a module unknown by the index changes nothing
+    if (!installed) {
+        return 0;
+    }
+
+    if (module_index.size == module_index.capacity) {
+        size_t capacity = module_index.capacity ? 2 * module_index.capacity : 64;
+        module_entry_t **modules = (module_entry_t **)arena_alloc(&module_index.arena, sizeof(*modules) * capacity);
+        if (modules == NULL) {
+            ERROR("arena_alloc module_entry_t");
+            return -ENOMEM;
+        }
+        if (module_index.size)
+            memcpy(modules, module_index.modules, sizeof(*modules) * module_index.size);
+        module_index.modules = modules;
+        module_index.capacity = capacity;
+    }
+
+    size_t length = strlen(name);
+    module_entry_t *module = (module_entry_t *)arena_alloc(&module_index.arena, sizeof(*module) + length + 1);
+    if (module == NULL) {
+        ERROR("arena_alloc module");
+        return -ENOMEM;
+    }
+    memcpy(module->name, name, length + 1);
+    module->installed = true;
+    module_index.modules[module_index.size] = module;
+
+    int rc = hash_index_add(&module_index.index, &module_index.arena, &module_index, get_module_name,
+                            module_index.size);
+    if (rc < 0) {
+        ERROR("hash_index_add : %d %s", -rc, strerror(-rc));
+        return rc;
+    }
+    module_index.size++;
+    return 0;
+}
+
+/**
+ * @brief Load the index from the list of the modules of semanage
+ * Nothing is done if the index is loaded and no other process loaded a policy since
+ * The session must be locked
  *
  * @param[in] semanage_handle semanage_handle handler
- * @param[in] id name of the module
- * @return true if exists, false else
+ * @return 0 in case of success or a negative -errno value
  */
-__nonnull() __wur static bool check_module(semanage_handle_t *semanage_handle, const char *id) {
-    bool ret = false;
+__nonnull() __wur static int load_module_index(semanage_handle_t *semanage_handle) {
+    int rc = 0;
+    int policyload = get_policyload();
     int semanage_module_info_len = 0;
-    semanage_module_info_t *semanage_module_info = NULL;
     semanage_module_info_t *semanage_module_info_list = NULL;
 
-    int rc = semanage_module_list(semanage_handle, &semanage_module_info_list, &semanage_module_info_len);
-    if (rc < 0) {
+    if (module_index.loaded && policyload == module_index.policyload) {
+        return 0;
+    }
+
+    invalidate_module_index();
+
+    if (semanage_module_list(semanage_handle, &semanage_module_info_list, &semanage_module_info_len) < 0) {
         rc = -errno;
         ERROR("semanage_module_list : %d %s", -rc, strerror(-rc));
         goto end;
     }
 
     for (int i = 0; i < semanage_module_info_len; i++) {
-        semanage_module_info = semanage_module_list_nth(semanage_module_info_list, i);
+        semanage_module_info_t *semanage_module_info = semanage_module_list_nth(semanage_module_info_list, i);
         const char *module_name = NULL;
-        rc = semanage_module_info_get_name(semanage_handle, semanage_module_info, &module_name);
-        if (rc < 0) {
+        if (semanage_module_info_get_name(semanage_handle, semanage_module_info, &module_name) < 0) {
             rc = -errno;
             ERROR("semanage_module_info_get_name : %d %s", -rc, strerror(-rc));
             goto end;
         }
 
-        if (!strcmp(module_name, id)) {
-            ret = true;
+        rc = set_module_installed(module_name, true);
+        if (rc < 0) {
+            ERROR("set_module_installed : %d %s", -rc, strerror(-rc));
             goto end;
         }
     }
+
+    module_index.loaded = true;
+    module_index.policyload = policyload;
+    DEBUG("%zu modules in the index", module_index.size);
+
 end:
+    if (rc < 0) {
+        invalidate_module_index();
+    }
     free_module_info_list(semanage_handle, semanage_module_info_list, semanage_module_info_len);
-    return ret;
+    return rc;
+}
+
+/**
+ * @brief Update the index after the commit of a group of requests
+ * The session must be locked
+ *
+ * @param[in] requests the committed requests
+ */
+static void update_module_index(const commit_request_t *requests) {
+    if (!module_index.loaded) {
+        return;
+    }
+
+    for (const commit_request_t *request = requests; request != NULL; request = request->next) {
+        if (request->result < 0) {
+            continue;
+        }
+
+        // the module installed from <dir>/<name>.<extension> is named <name>
+        const char *name = request->arg;
+        size_t length = strlen(name);
+        if (request->stage == install_module) {
+            const char *slash = strrchr(name, '/');
+            name = slash ? slash + 1 : name;
+            const char *dot = strrchr(name, '.');
+            length = dot ? (size_t)(dot - name) : strlen(name);
+        }
+
+        char module_name[SEC_LSM_MANAGER_MAX_SIZE_ID];
+        if (length >= sizeof(module_name)) {
+            invalidate_module_index();
+            return;
+        }
+        secure_strncpy(module_name, name, length + 1);
+        if (set_module_installed(module_name, request->stage == install_module) < 0) {
+            invalidate_module_index();
+            return;
+        }
+    }
+
+    // the policy loads of the commits are not changes of other processes
+    module_index.policyload = get_policyload();
+}
+
+/**
+ * @brief Tell if other operations are on their way to the open group
+ * These are the operations entering group_commit and the modules still compiled.
+ * The session must be locked
+ *
+ * @return true if operations may join the group
+ */
+__wur static bool group_joinable(void) {
+    return __atomic_load_n(&joining_operations, __ATOMIC_RELAXED) > 0 || compile_jobs_pending();
+}
+
+/**
+ * @brief Stage an operation in the semanage session and commit it with the group of operations
+ * staged by other workers
+ * The first operation of a group waits for the operations in progress, at most
+ * SELINUX_GROUP_COMMIT_DELAY, and commits the whole group at once, so that the policy
+ * is rebuilt only once for the group. An operation alone is committed at once.
+ *
+ * @param[in] stage function staging the operation
+ * @param[in] arg argument of the operation
+ * @param[in] job compilation job of the module ended once the operation is staged (may be NULL)
+ * @return 0 in case of success or a negative -errno value
+ */
+__nonnull((1, 2)) __wur static int group_commit(int (*stage)(semanage_handle_t *, const char *), const char *arg,
+                                               compile_job_t *job) {
+    semanage_handle_t *semanage_handle = NULL;
+    bool fresh = false;
+    unsigned count = 0;
+    int rc = 0;
+
+    __atomic_add_fetch(&joining_operations, 1, __ATOMIC_RELAXED);
+    for (;;) {
+        rc = acquire_semanage_session(&semanage_handle, &fresh);
+        if (rc < 0) {
+            ERROR("acquire_semanage_session : %d %s", -rc, strerror(-rc));
+            __atomic_sub_fetch(&joining_operations, 1, __ATOMIC_RELAXED);
+            return rc;
+        }
+
+        rc = stage(semanage_handle, arg);
+        if (rc >= 0) {
+            break;
+        }
+
+        // the session is kept while other operations of a group are staged in it
+        if (staged_requests != NULL || fresh) {
+            __atomic_sub_fetch(&joining_operations, 1, __ATOMIC_RELAXED);
+            if (job != NULL)
+                compile_job_end(job);
+            pthread_cond_broadcast(&commit_cond);
+            release_semanage_session(staged_requests == NULL);
+            return rc;
+        }
+
+        release_semanage_session(true);
+        DEBUG("retry on a new semanage session");
+    }
+
+    commit_request_t request = {.stage = stage, .arg = arg, .result = 0, .done = false, .next = staged_requests};
+    bool leader = staged_requests == NULL;
+    staged_requests = &request;
+    __atomic_sub_fetch(&joining_operations, 1, __ATOMIC_RELAXED);
+
+    // let the next compiled module be staged
+    if (job != NULL)
+        compile_job_end(job);
+
+    if (!leader) {
+        // the leader may wait for this operation
+        pthread_cond_broadcast(&commit_cond);
+        while (!request.done) {
+            pthread_cond_wait(&commit_cond, &semanage_session_mutex);
+        }
+        release_semanage_session(false);
+        return request.result;
+    }
+
+    // leave time to the operations in progress to join the group
+    if (SELINUX_GROUP_COMMIT_DELAY > 0 && group_joinable()) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += (SELINUX_GROUP_COMMIT_DELAY % 1000) * 1000000L;
+        deadline.tv_sec += SELINUX_GROUP_COMMIT_DELAY / 1000 + deadline.tv_nsec / 1000000000L;
+        deadline.tv_nsec %= 1000000000L;
+        while (group_joinable() &&
+               pthread_cond_timedwait(&commit_cond, &semanage_session_mutex, &deadline) != ETIMEDOUT)
+            ;
+    }
+
+    commit_request_t *requests = staged_requests;
+    staged_requests = NULL;
+    for (commit_request_t *r = requests; r != NULL; r = r->next) {
+        count++;
+    }
+
+    DEBUG("commit of %u staged operations", count);
+    rc = commit_session(semanage_session);
+    if (rc < 0 && count > 1) {
+        ERROR("group commit failed, committing the %u operations one by one", count);
+        rc = commit_requests_alone(requests);
+    } else {
+        for (commit_request_t *r = requests; r != NULL; r = r->next) {
+            r->result = rc;
+        }
+    }
+
+    update_module_index(requests);
+    for (commit_request_t *r = requests; r != NULL; r = r->next) {
+        r->done = true;
+    }
+    pthread_cond_broadcast(&commit_cond);
+    release_semanage_session(rc < 0);
+
+    return request.result;
+}
+
+/**
+ * @brief Check module in selinux policy
+ *
+ * @param[in] semanage_handle semanage_handle handler
+ * @param[in] id name of the module
+ * @return 1 if exists, 0 if not or a negative -errno value
+ */
+__nonnull() __wur static int check_module(semanage_handle_t *semanage_handle, const char *id) {
+    int rc = load_module_index(semanage_handle);
+    if (rc < 0) {
+        ERROR("load_module_index : %d %s", -rc, strerror(-rc));
+        return rc;
+    }
+
+    size_t position = 0;
+    return hash_index_search(&module_index.index, &module_index, get_module_name, id, false, &position) &&
+           module_index.modules[position]->installed;
 }
 
 /**********************/
 /*** PUBLIC METHODS ***/
 /**********************/
 
+/* see selinux-template.h */
+void close_semanage_session(void) {
+    pthread_mutex_lock(&semanage_session_mutex);
+    if (semanage_session != NULL) {
+        if (destroy_semanage_handle(semanage_session) < 0) {
+            ERROR("destroy_semanage_handle failed");
+        }
+        semanage_session = NULL;
+    }
+    invalidate_module_index();
+    free_arena(&module_index.arena);
+    if (selinux_status_opened) {
+        selinux_status_close();
+        selinux_status_opened = false;
+    }
+    pthread_mutex_unlock(&semanage_session_mutex);
+}
+
+/* see selinux-template.h */
+int get_selinux_policyload(void) {
+    pthread_mutex_lock(&semanage_session_mutex);
+    int policyload = get_policyload();
+    pthread_mutex_unlock(&semanage_session_mutex);
+    return policyload;
+}
+
 /* see selinux-template.h */
 const char *get_selinux_te_template_file(const char *value) {
     return value ?: secure_getenv("SELINUX_TE_TEMPLATE_FILE") ?: default_selinux_te_template_file;
@@ -474,6 +1168,11 @@ const char *get_selinux_if_template_file(const char *value) {
     return value ?: secure_getenv("SELINUX_IF_TEMPLATE_FILE") ?: default_selinux_if_template_file;
 }
 
+/* see selinux-template.h */
+const char *get_selinux_cil_template_file(const char *value) {
+    return value ?: secure_getenv("SELINUX_CIL_TEMPLATE_FILE") ?: default_selinux_cil_template_file;
+}
+
 /* see selinux-template.h */
 const char *get_selinux_rules_dir(const char *value) {
     value = value ?: secure_getenv("SELINUX_RULES_DIR") ?: default_selinux_rules_dir;
@@ -509,37 +1208,106 @@ int create_selinux_rules(const secure_app_t *secure_app,
                          path_type_definitions_t path_type_definitions[number_path_type]) {
     int rc = 0;
     int rc2 = 0;
+    uint64_t hash = 0;
+    uint64_t installed_hash = 0;
+    bool same_sources = false;
     selinux_module_t selinux_module;
     init_selinux_module(&selinux_module, secure_app);
 
-    semanage_handle_t *semanage_handle;
-    rc = create_semanage_handle(&semanage_handle);
-    if (rc < 0) {
-        ERROR("create_semanage_handle : %d %s", -rc, strerror(-rc));
-        goto ret;
+    if (get_env_flag("SELINUX_CIL", SELINUX_CIL)) {
+        // the cil module is installed as is: nothing to compile
+        rc = generate_app_module_cil(&selinux_module, secure_app, path_type_definitions);
+        if (rc < 0) {
+            ERROR("generate_app_module_cil : %d %s", -rc, strerror(-rc));
+            goto ret;
+        }
+
+        const char *const cil_sources[] = {selinux_module.selinux_cil_file};
+        rc = hash_module_sources(CIL_EXTENSION, 0, cil_sources, 1, &hash);
+        if (rc < 0) {
+            ERROR("hash_module_sources : %d %s", -rc, strerror(-rc));
+            goto error_cil;
+        }
+
+        // same sources already in the policy: nothing to install
+        if (read_module_hash(&selinux_module, &installed_hash) && installed_hash == hash &&
+            check_module_in_policy(secure_app)) {
+            DEBUG("cil module %s unchanged", secure_app->id);
+            goto ret;
+        }
+
+        rc = group_commit(install_module, selinux_module.selinux_cil_file, NULL);
+        if (rc < 0) {
+            ERROR("install_module : %d %s", -rc, strerror(-rc));
+            goto error_cil;
+        }
+
+        DEBUG("success install cil module");
+        goto write_hash;
     }
 
     // Generate files
     rc = generate_app_module_files(&selinux_module, secure_app, path_type_definitions);
     if (rc < 0) {
         ERROR("generate_app_module_files : %d %s", -rc, strerror(-rc));
-        goto end2;
+        goto ret;
     }
 
     DEBUG("success generate selinux files module");
 
-    // fc, if, te generated
-    rc = launch_compile(secure_app->id);
+    const char *const sources[] = {selinux_module.selinux_te_file, selinux_module.selinux_if_file,
+                                   selinux_module.selinux_fc_file};
+    // a module compiled against other policy development headers is not reused
+    uint64_t devel_hash = 0;
+    rc = get_selinux_devel_hash(&devel_hash);
     if (rc < 0) {
-        ERROR("launch_compile : %d %s", -rc, strerror(-rc));
+        ERROR("get_selinux_devel_hash : %d %s", -rc, strerror(-rc));
         goto error3;
     }
 
-    DEBUG("success compile selinux module");
+    rc = hash_module_sources(PP_EXTENSION, devel_hash, sources, 3, &hash);
+    if (rc < 0) {
+        ERROR("hash_module_sources : %d %s", -rc, strerror(-rc));
+        goto error3;
+    }
 
-    // pp generated
+    same_sources = read_module_hash(&selinux_module, &installed_hash) && installed_hash == hash &&
+                   check_file_exists(selinux_module.selinux_pp_file);
+
+    if (same_sources) {
+        // same sources already in the policy: nothing to install
+        if (check_module_in_policy(secure_app)) {
+            DEBUG("module %s unchanged", secure_app->id);
+            goto ret;
+        }
+        DEBUG("reuse compiled module %s", selinux_module.selinux_pp_file);
+        rc = group_commit(install_module, selinux_module.selinux_pp_file, NULL);
+    } else {
+        // fc, if, te generated, compiled concurrently with the modules of other workers
+        compile_job_t job;
+        compile_job_submit(&job, &secure_app->cancelled);
+        rc = compile_job_start(&job);
+        if (rc >= 0) {
+            rc = compile_selinux_module(selinux_module.selinux_te_file, selinux_module.selinux_if_file,
+                                        selinux_module.selinux_fc_file, selinux_module.selinux_pp_file, &job);
+            compile_job_stop(&job);
+        }
+        if (rc < 0) {
+            ERROR("compile_selinux_module : %d %s", -rc, strerror(-rc));
+            compile_job_end(&job);
+            goto error3;
+        }
+
+        DEBUG("success compile selinux module");
+
+        // pp generated, installed in the submission order
+        rc = compile_job_wait_turn(&job);
+        if (rc >= 0) {
+            rc = group_commit(install_module, selinux_module.selinux_pp_file, &job);
+        }
+        compile_job_end(&job);
+    }
 
-    rc = install_module(semanage_handle, selinux_module.selinux_pp_file);
     if (rc < 0) {
         ERROR("install_module : %d %s", -rc, strerror(-rc));
         goto error4;
@@ -547,8 +1315,21 @@ int create_selinux_rules(const secure_app_t *secure_app,
 
     DEBUG("success install module");
 
-    goto end2;
+write_hash:
+    // only a failure to reuse the module later
+    rc2 = write_module_hash(&selinux_module, hash);
+    if (rc2 < 0) {
+        ERROR("write_module_hash : %d %s", -rc2, strerror(-rc2));
+    }
+
+    goto ret;
 
+error_cil:
+    rc2 = remove_file(selinux_module.selinux_cil_file);
+    if (rc2 < 0) {
+        ERROR("remove_file %s : %d %s", selinux_module.selinux_cil_file, -rc2, strerror(-rc2));
+    }
+    goto error_hash;
 error4:
     rc2 = remove_pp_file(&selinux_module);
     if (rc2 < 0) {
@@ -559,11 +1340,8 @@ error3:
     if (rc2 < 0) {
         ERROR("remove_app_module_files : %d %s", -rc2, strerror(-rc2));
     }
-end2:
-    rc2 = destroy_semanage_handle(semanage_handle);
-    if (rc2 < 0) {
-        ERROR("destroy_semanage_handle : %d %s", -rc2, strerror(-rc2));
-    }
+error_hash:
+    remove(selinux_module.selinux_hash_file);
 ret:
     return rc;
 }
@@ -577,69 +1355,58 @@ bool check_module_files_exist(const secure_app_t *secure_app) {
 
 /* see selinux-template.h */
 bool check_module_in_policy(const secure_app_t *secure_app) {
-    bool ret = false;
-    semanage_handle_t *semanage_handle;
-    int rc = create_semanage_handle(&semanage_handle);
+    int rc = with_semanage_session(check_module, secure_app->id);
     if (rc < 0) {
-        ERROR("create_semanage_handle : %d %s", -rc, strerror(-rc));
-        goto end;
+        ERROR("check_module : %d %s", -rc, strerror(-rc));
     }
-
-    ret = check_module(semanage_handle, secure_app->id);
-
-    rc = destroy_semanage_handle(semanage_handle);
-    if (rc < 0) {
-        ERROR("destroy_semanage_handle : %d %s", -rc, strerror(-rc));
-    }
-
-end:
-    return ret;
+    return rc > 0;
 }
 
 /* see selinux-template.h */
 int remove_selinux_rules(const secure_app_t *secure_app) {
     int rc = 0;
-    int rc2 = 0;
     selinux_module_t selinux_module;
     init_selinux_module(&selinux_module, secure_app);
 
     // remove files
-    rc = remove_app_module_files(&selinux_module);
-    if (rc < 0) {
-        ERROR("remove_app_module_files : %d %s", -rc, strerror(-rc));
-        goto ret;
+    if (get_env_flag("SELINUX_CIL", SELINUX_CIL)) {
+        rc = remove_file(selinux_module.selinux_cil_file);
+        if (rc < 0) {
+            ERROR("remove_file %s : %d %s", selinux_module.selinux_cil_file, -rc, strerror(-rc));
+            goto ret;
+        }
+    } else {
+        rc = remove_app_module_files(&selinux_module);
+        if (rc < 0) {
+            ERROR("remove_app_module_files : %d %s", -rc, strerror(-rc));
+            goto ret;
+        }
+
+        rc = remove_pp_file(&selinux_module);
+        if (rc < 0) {
+            ERROR("remove_pp_file : %d %s", -rc, strerror(-rc));
+            goto ret;
+        }
     }
 
-    rc = remove_pp_file(&selinux_module);
-    if (rc < 0) {
-        ERROR("remove_pp_file : %d %s", -rc, strerror(-rc));
+    // the hash file is missing if the module was installed by an older version
+    if (remove(selinux_module.selinux_hash_file) < 0 && errno != ENOENT) {
+        rc = -errno;
+        ERROR("remove %s : %d %s", selinux_module.selinux_hash_file, -rc, strerror(-rc));
         goto ret;
     }
 
     DEBUG("success remove selinux files");
 
     // remove module in policy
-    semanage_handle_t *semanage_handle;
-    rc = create_semanage_handle(&semanage_handle);
-    if (rc < 0) {
-        ERROR("create_semanage_handle : %d %s", -rc, strerror(-rc));
-        goto ret;
-    }
-    rc = remove_module(semanage_handle, secure_app->id);
+    rc = group_commit(remove_module, secure_app->id, NULL);
     if (rc < 0) {
         ERROR("remove_module : %d %s", -rc, strerror(-rc));
-        goto end;
+        goto ret;
     }
 
     DEBUG("success remove selinux module");
 
-    goto end;
-
-end:
-    rc2 = destroy_semanage_handle(semanage_handle);
-    if (rc2 < 0) {
-        ERROR("destroy_semanage_handle : %d %s", -rc2, strerror(-rc2));
-    }
 ret:
     return rc;
 }
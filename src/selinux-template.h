@@ -27,6 +27,7 @@
 #include "secure-app.h"
 
 #ifndef SIMULATE_SELINUX
+#include <selinux/avc.h>
 #include <selinux/restorecon.h>
 #include <selinux/selinux.h>
 #include <semanage/semanage.h>
@@ -54,6 +55,14 @@ extern const char *get_selinux_te_template_file(const char *value) __wur;
  */
 extern const char *get_selinux_if_template_file(const char *value) __wur;
 
+/**
+ * @brief Get the selinux cil template file
+ *
+ * @param[in] value some value or NULL for getting default
+ * @return the selinux cil template file specification
+ */
+extern const char *get_selinux_cil_template_file(const char *value) __wur;
+
 /**
  * @brief Get the selinux rules directory
  *
@@ -98,6 +107,19 @@ extern bool check_module_files_exist(const secure_app_t *secure_app) __wur __non
  */
 extern bool check_module_in_policy(const secure_app_t *secure_app) __wur __nonnull();
 
+/**
+ * @brief Disconnect the semanage session shared by the selinux operations
+ * The session connects again when needed
+ */
+extern void close_semanage_session(void);
+
+/**
+ * @brief Get the count of policy loads, it changes when a commit loads the policy
+ *
+ * @return the count of policy loads or -1 if unknown
+ */
+extern int get_selinux_policyload(void) __wur;
+
 /**
  * @brief Remove selinux rules (in the selinux rules directory and in the policy)
  *
@@ -25,28 +25,53 @@
 
 #include <errno.h>
 #include <linux/xattr.h>
+#include <pthread.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <sys/xattr.h>
 
+#ifndef SIMULATE_SELINUX
+#include <selinux/label.h>
+#endif
+
 #include "log.h"
 #include "selinux-template.h"
 #include "utils.h"
 
+#if !defined(SELINUX_RELABEL)
+#define SELINUX_RELABEL 0
+#endif
+
+#if !defined(SELINUX_RELABEL_THREADS)
+#define SELINUX_RELABEL_THREADS 0 // count of online processors
+#endif
+
+/** file contexts handle given to restorecon (kept until the end of the daemon) */
+static struct selabel_handle *label_handle = NULL;
+
+/** count of policy loads when label_handle was opened */
+static int label_handle_policyload = -1;
+
+/** lock of label_handle and of restorecon, which keeps a process-wide state: one relabel runs at a time */
+static pthread_mutex_t label_handle_mutex = PTHREAD_MUTEX_INITIALIZER;
+
 /**
  * @brief Label file
  *
  * @param[in] path The path of the file
  * @param[in] label The label to set
+ * @param[in,out] labels count of the labels written or skipped
  * @return 0 in case of success or a negative -errno value
  */
-__nonnull() __wur static int label_file(const char *path, const char *label) {
+__nonnull() __wur static int label_file(const char *path, const char *label, label_count_t *labels) {
     if (!check_file_exists(path)) {
         DEBUG("%s not exist", path);
         return -ENOENT;
     }
 
-    int rc = set_label(path, XATTR_NAME_SELINUX, label);
+    int rc = set_label(path, XATTR_NAME_SELINUX, label, labels);
     if (rc < 0) {
         ERROR("set_label(%s,%s,%s) : %d %s", path, XATTR_NAME_SELINUX, label, -rc, strerror(-rc));
         return rc;
@@ -55,20 +80,94 @@ __nonnull() __wur static int label_file(const char *path, const char *label) {
     return 0;
 }
 
+/**
+ * @brief Lock the file contexts handle used by restorecon
+ * The handle is opened again when a policy has been loaded since it was opened,
+ * so that the file contexts of the modules just installed are known
+ *
+ * @return 0 in case of success or a negative -errno value
+ */
+__wur static int lock_label_handle(void) {
+    int policyload = get_selinux_policyload();
+
+    pthread_mutex_lock(&label_handle_mutex);
+    if (label_handle == NULL || policyload != label_handle_policyload || policyload < 0) {
+        struct selabel_handle *handle = selabel_open(SELABEL_CTX_FILE, NULL, 0);
+        if (handle == NULL) {
+            int rc = -errno;
+            ERROR("selabel_open : %d %s", -rc, strerror(-rc));
+            pthread_mutex_unlock(&label_handle_mutex);
+            return rc;
+        }
+        selinux_restorecon_set_sehandle(handle);
+        if (label_handle != NULL)
+            selabel_close(label_handle);
+        label_handle = handle;
+        label_handle_policyload = policyload;
+    }
+    return 0;
+}
+
+/**
+ * @brief Relabel the files under the directories of a secure app, as given by the file contexts
+ * The files relabeled are counted as written (not counted before libselinux 3.4)
+ *
+ * @param[in] secure_app secure app handler
+ * @param[in,out] labels count of the labels written or skipped
+ * @return 0 in case of success or a negative -errno value
+ */
+__nonnull() __wur static int selinux_relabel_trees(const secure_app_t *secure_app, label_count_t *labels) {
+    struct stat st;
+    int rc = lock_label_handle();
+    if (rc < 0) {
+        ERROR("lock_label_handle : %d %s", -rc, strerror(-rc));
+        return rc;
+    }
+
+    size_t threads = get_env_count("SELINUX_RELABEL_THREADS", SELINUX_RELABEL_THREADS);
+    for (size_t i = 0; i < secure_app->path_set.size; i++) {
+        const char *path = secure_app->path_set.paths[i]->path;
+        if (lstat(path, &st) < 0 || !S_ISDIR(st.st_mode)) {
+            continue;
+        }
+#if defined(NO_SELINUX_RESTORECON_PARALLEL)
+        (void)threads;
+        if (selinux_restorecon(path, SELINUX_RESTORECON_RECURSE | SELINUX_RESTORECON_IGNORE_DIGEST) < 0) {
+#else
+        if (selinux_restorecon_parallel(path, SELINUX_RESTORECON_RECURSE | SELINUX_RESTORECON_IGNORE_DIGEST,
+                                        threads) < 0) {
+#endif
+            rc = -errno;
+            ERROR("selinux_restorecon %s : %d %s", path, -rc, strerror(-rc));
+            break;
+        }
+#if !defined(NO_SELINUX_RESTORECON_PARALLEL)
+        // counted by the last restorecon, relabels don't overlap
+        labels->written += (unsigned)selinux_restorecon_get_relabeled_files();
+#endif
+    }
+
+    pthread_mutex_unlock(&label_handle_mutex);
+    return rc;
+}
+
 /**
  * @brief Apply selinux on a secure app
  *
  * @param[in] secure_app secure app handler
+ * @param[in] path_type_definitions the labels of the path types
+ * @param[in,out] labels count of the labels written or skipped
  * @return 0 in case of success or a negative -errno value
  */
 __nonnull() __wur static int selinux_process_paths(const secure_app_t *secure_app,
-                                                   path_type_definitions_t path_type_definitions[number_path_type]) {
+                                                   path_type_definitions_t path_type_definitions[number_path_type],
+                                                   label_count_t *labels) {
     path_t *path = NULL;
     char label[SEC_LSM_MANAGER_MAX_SIZE_LABEL + 3];
     for (size_t i = 0; i < secure_app->path_set.size; i++) {
         path = secure_app->path_set.paths[i];
         snprintf(label, SEC_LSM_MANAGER_MAX_SIZE_LABEL + 3, "%s:s0", path_type_definitions[path->path_type].label);
-        int rc = label_file(path->path, label);
+        int rc = label_file(path->path, label, labels);
         if (rc < 0) {
             ERROR("label_file((%s,%s),%s) : %d %s", path->path, get_path_type_string(path->path_type), secure_app->id,
                   -rc, strerror(-rc));
@@ -92,7 +191,7 @@ bool selinux_enabled() {
 }
 
 /* see selinux.h */
-int install_selinux(const secure_app_t *secure_app) {
+int install_selinux(const secure_app_t *secure_app, label_count_t *labels) {
     if (secure_app->id[0] == '\0') {
         ERROR("id undefined");
         return -EINVAL;
@@ -124,13 +223,23 @@ int install_selinux(const secure_app_t *secure_app) {
     DEBUG("success check module in policy");
 
     // force label
-    rc = selinux_process_paths(secure_app, path_type_definitions);
+    rc = selinux_process_paths(secure_app, path_type_definitions, labels);
     if (rc < 0) {
         ERROR("selinux_process_paths : %d %s", -rc, strerror(-rc));
         return rc;
     }
 
-    DEBUG("success apply selinux label");
+    DEBUG("success apply selinux label : %u written, %u skipped", labels->written, labels->skipped);
+
+    if (get_env_flag("SELINUX_RELABEL", SELINUX_RELABEL)) {
+        rc = selinux_relabel_trees(secure_app, labels);
+        if (rc < 0) {
+            ERROR("selinux_relabel_trees : %d %s", -rc, strerror(-rc));
+            return rc;
+        }
+
+        DEBUG("success relabel selinux trees : %u written", labels->written);
+    }
 
     return 0;
 }
@@ -180,3 +289,6 @@ int uninstall_selinux(const secure_app_t *secure_app) {
 
     return 0;
 }
+
+/* see selinux.h */
+void release_selinux(void) { close_semanage_session(); }
@@ -25,6 +25,7 @@
 #define SEC_LSM_MANAGER_SELINUX_H
 
 #include "secure-app.h"
+#include "utils.h"
 
 /**
  * @brief Check if selinux is enabled
@@ -38,9 +39,10 @@ extern bool selinux_enabled() __wur;
  * @brief Install a secure app for selinux
  *
  * @param[in] secure_app The handle of secure app
+ * @param[in,out] labels count of the labels written or skipped
  * @return 0 in case of success or a negative -errno value
  */
-extern int install_selinux(const secure_app_t *secure_app) __wur __nonnull();
+extern int install_selinux(const secure_app_t *secure_app, label_count_t *labels) __wur __nonnull();
 
 /**
  * @brief Uninstall a secure app for selinux
@@ -50,4 +52,9 @@ extern int install_selinux(const secure_app_t *secure_app) __wur __nonnull();
  */
 extern int uninstall_selinux(const secure_app_t *secure_app) __wur __nonnull();
 
+/**
+ * @brief Release the resources kept between installs, like the semanage session
+ */
+extern void release_selinux(void);
+
 #endif
@@ -27,6 +27,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <poll.h>
+#include <pthread.h>
 #include <stdarg.h>
 #include <stdbool.h>
 #include <stdint.h>
@@ -41,19 +42,68 @@
 
 #include "../../log.h"
 
+#if !defined(SIMULATE_CYNAGORA_LATENCY)
+#define SIMULATE_CYNAGORA_LATENCY 0
+#endif
+
 typedef struct asreq asreq_t;
 typedef struct ascb ascb_t;
 typedef struct agent agent_t;
 typedef struct query query_t;
 typedef struct cynagora cynagora_t;
 
+/**
+ * @brief Policy stored by the simulation
+ */
+typedef struct simulation_policy {
+    struct simulation_policy *next;
+    char *client;
+    char *session;
+    char *user;
+    char *permission;
+    char *value;
+    time_t expire;
+} simulation_policy_t;
+
+/** policies stored by the simulation, changed at once as transactions are not simulated */
+static simulation_policy_t *simulation_policies = NULL;
+
+/** lock of the policies */
+static pthread_mutex_t simulation_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/** count of the writes (set, drop and commit) received by the simulation */
+static unsigned long simulation_writes = 0;
+
+/**
+ * @brief Check if an item of a key matches an item of a selection key
+ */
+static bool simulation_match(const char *selection, const char *item) {
+    return !strcmp(selection, "#") || !strcmp(selection, item);
+}
+
+/**
+ * @brief Wait as a request to cynagora would
+ * The latency is SIMULATE_CYNAGORA_LATENCY microseconds, it can be changed
+ * with the SIMULATE_CYNAGORA_LATENCY environment variable
+ */
+static void request_latency(void) {
+    static long latency = -1;
+    if (latency < 0) {
+        const char *value = getenv("SIMULATE_CYNAGORA_LATENCY");
+        long us = value ? strtol(value, NULL, 10) : SIMULATE_CYNAGORA_LATENCY;
+        latency = us > 0 ? us : 0;
+    }
+    if (latency > 0)
+        usleep((useconds_t)latency);
+}
+
 /******************************************************************************/
 /*** PUBLIC COMMON METHODS                                                  ***/
 /******************************************************************************/
 
 /* see cynagora.h */
 int cynagora_create(cynagora_t **prcyn, cynagora_type_t type, uint32_t cache_size, const char *socketspec) {
-    printf("cynagora_create(%d, %d, %s)\n", type, cache_size, socketspec);
+    printf("cynagora_create(%d, %d, %s)\n", type, cache_size, socketspec ?: "(default)");
     *prcyn = (cynagora_t *)malloc(sizeof(int));
     if (*prcyn == NULL) {
         ERROR("malloc cynagora_t failed");
@@ -128,33 +178,40 @@ int cynagora_async_check(cynagora_t *cynagora, const cynagora_key_t *key, int fo
 /* see cynagora.h */
 int cynagora_get(cynagora_t *cynagora, const cynagora_key_t *key, cynagora_get_cb_t *callback, void *closure) {
     printf("cynagora_get(%p, %s,%s,%s,%s)\n", cynagora, key->client, key->session, key->user, key->permission);
-    cynagora_key_t k = {key->client, "*", key->user, "privilege"};
-    cynagora_value_t v = {"yes", 0};
-    callback(closure, &k, &v);
-    cynagora_key_t k2 = {key->client, "*", key->user, "privilege2"};
-    cynagora_value_t v2 = {"yes", 0};
-    callback(closure, &k2, &v2);
-    cynagora_key_t k3 = {key->client, "*", key->user, "privilege3"};
-    cynagora_value_t v3 = {"yes", 0};
-    callback(closure, &k3, &v3);
+    request_latency();
+    pthread_mutex_lock(&simulation_mutex);
+    for (simulation_policy_t *policy = simulation_policies; policy; policy = policy->next) {
+        if (simulation_match(key->client, policy->client) && simulation_match(key->session, policy->session) &&
+            simulation_match(key->user, policy->user) && simulation_match(key->permission, policy->permission)) {
+            cynagora_key_t k = {policy->client, policy->session, policy->user, policy->permission};
+            cynagora_value_t v = {policy->value, policy->expire};
+            callback(closure, &k, &v);
+        }
+    }
+    pthread_mutex_unlock(&simulation_mutex);
     return 0;
 }
 
 /* see cynagora.h */
 int cynagora_log(cynagora_t *cynagora, int on, int off) {
     printf("cynagora_log(%p, %d, %d)\n", cynagora, on, off);
+    request_latency();
     return 0;
 }
 
 /* see cynagora.h */
 int cynagora_enter(cynagora_t *cynagora) {
     printf("cynagora_enter(%p)\n", cynagora);
+    request_latency();
     return 0;
 }
 
 /* see cynagora.h */
 int cynagora_leave(cynagora_t *cynagora, int commit) {
     printf("cynagora_leave(%p, %d)\n", cynagora, commit);
+    request_latency();
+    if (commit)
+        __atomic_add_fetch(&simulation_writes, 1, __ATOMIC_RELAXED);
     return 0;
 }
 
@@ -162,11 +219,66 @@ int cynagora_leave(cynagora_t *cynagora, int commit) {
 int cynagora_set(cynagora_t *cynagora, const cynagora_key_t *key, const cynagora_value_t *value) {
     printf("cynagora_set(%p ,(%s,%s,%s,%s), (%s, %ld))\n", cynagora, key->client, key->session, key->user,
            key->permission, value->value, value->expire);
-    return 0;
+    request_latency();
+    __atomic_add_fetch(&simulation_writes, 1, __ATOMIC_RELAXED);
+
+    int rc = 0;
+    pthread_mutex_lock(&simulation_mutex);
+    simulation_policy_t *policy = simulation_policies;
+    while (policy && (strcmp(policy->client, key->client) || strcmp(policy->session, key->session) ||
+                      strcmp(policy->user, key->user) || strcmp(policy->permission, key->permission))) {
+        policy = policy->next;
+    }
+    if (policy == NULL) {
+        policy = calloc(1, sizeof(simulation_policy_t));
+        if (policy == NULL || (policy->client = strdup(key->client)) == NULL ||
+            (policy->session = strdup(key->session)) == NULL || (policy->user = strdup(key->user)) == NULL ||
+            (policy->permission = strdup(key->permission)) == NULL) {
+            if (policy) {
+                free(policy->client);
+                free(policy->session);
+                free(policy->user);
+            }
+            free(policy);
+            rc = -ENOMEM;
+            goto end;
+        }
+        policy->next = simulation_policies;
+        simulation_policies = policy;
+    }
+    free(policy->value);
+    policy->value = strdup(value->value);
+    policy->expire = value->expire;
+    if (policy->value == NULL)
+        rc = -ENOMEM;
+end:
+    pthread_mutex_unlock(&simulation_mutex);
+    return rc;
 }
 
 /* see cynagora.h */
 int cynagora_drop(cynagora_t *cynagora, const cynagora_key_t *key) {
     printf("cynagora_drop(%p ,(%s,%s,%s,%s))\n", cynagora, key->client, key->session, key->user, key->permission);
+    request_latency();
+    __atomic_add_fetch(&simulation_writes, 1, __ATOMIC_RELAXED);
+
+    pthread_mutex_lock(&simulation_mutex);
+    simulation_policy_t **prev = &simulation_policies;
+    while (*prev) {
+        simulation_policy_t *policy = *prev;
+        if (simulation_match(key->client, policy->client) && simulation_match(key->session, policy->session) &&
+            simulation_match(key->user, policy->user) && simulation_match(key->permission, policy->permission)) {
+            *prev = policy->next;
+            free(policy->client);
+            free(policy->session);
+            free(policy->user);
+            free(policy->permission);
+            free(policy->value);
+            free(policy);
+        } else {
+            prev = &policy->next;
+        }
+    }
+    pthread_mutex_unlock(&simulation_mutex);
     return 0;
 }
@@ -25,6 +25,12 @@
 
 static int ptr = 0;
 
+/** the handle currently connected (0 if none) */
+static semanage_handle_t *connected = 0;
+
+/** count of policy loads (one per commit) */
+static int simulated_policyload = 0;
+
 #if !defined(SEC_LSM_MANAGER_DATADIR)
 #define SEC_LSM_MANAGER_DATADIR "/usr/share/sec-lsm-manager"
 #endif
@@ -37,14 +43,24 @@ static int ptr = 0;
 #define SELINUX_POLICY_DIR SEC_LSM_MANAGER_DATADIR "selinux-simulation"
 #endif
 
+#if !defined(SIMULATE_SELINUX_COMMIT_LATENCY)
+#define SIMULATE_SELINUX_COMMIT_LATENCY 0
+#endif
+
 #include <dirent.h>
+#include <ftw.h>
 #include <libgen.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/xattr.h>
+#include <time.h>
+#include <unistd.h>
 
+#include "../../selinux-compile.h"
 #include "../../utils.h"
 
 struct semanage_module_info {
@@ -58,18 +74,85 @@ int is_selinux_enabled(void) {
     return 1;
 }
 
-int selinux_restorecon(const char *pathname, unsigned int restorecon_flags) {
-    printf("selinux_restorecon(%s, %u)\n", pathname, restorecon_flags);
+/** label of the root of the tree relabeled by simulate_restorecon */
+static char restorecon_label[SEC_LSM_MANAGER_MAX_SIZE_LABEL + 1];
+
+/** count of files relabeled by simulate_restorecon */
+static size_t restorecon_count;
+
+/** lock of the state of simulate_restorecon (nftw has no closure) */
+static pthread_mutex_t restorecon_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static int relabel_file(const char *path, const struct stat *st, int flag, struct FTW *ftw) {
+    (void)st;
+    (void)flag;
+    if (ftw->level > 0) {
+        if (lsetxattr(path, "security.selinux", restorecon_label, strlen(restorecon_label) + 1, 0) < 0)
+            return -1;
+        restorecon_count++;
+    }
     return 0;
 }
 
+/**
+ * @brief Simulate restorecon: the files of the tree get the label of its root,
+ * as done by the 'path(/.*)?' file contexts of the modules
+ */
+static int simulate_restorecon(const char *pathname, unsigned int restorecon_flags) {
+    restorecon_count = 0;
+    if (!(restorecon_flags & SELINUX_RESTORECON_RECURSE))
+        return 0;
+
+    ssize_t size = lgetxattr(pathname, "security.selinux", restorecon_label, SEC_LSM_MANAGER_MAX_SIZE_LABEL);
+    if (size <= 0)
+        return -1;
+    restorecon_label[size] = '\0';
+
+    return nftw(pathname, relabel_file, 16, FTW_PHYS);
+}
+
+int selinux_restorecon(const char *pathname, unsigned int restorecon_flags) {
+    pthread_mutex_lock(&restorecon_mutex);
+    int rc = simulate_restorecon(pathname, restorecon_flags);
+    printf("selinux_restorecon(%s, %u) %zu files\n", pathname, restorecon_flags, restorecon_count);
+    pthread_mutex_unlock(&restorecon_mutex);
+    return rc;
+}
+
+int selinux_restorecon_parallel(const char *pathname, unsigned int restorecon_flags, size_t nthreads) {
+    pthread_mutex_lock(&restorecon_mutex);
+    int rc = simulate_restorecon(pathname, restorecon_flags);
+    printf("selinux_restorecon_parallel(%s, %u, %zu) %zu files\n", pathname, restorecon_flags, nthreads,
+           restorecon_count);
+    pthread_mutex_unlock(&restorecon_mutex);
+    return rc;
+}
+
+unsigned long selinux_restorecon_get_relabeled_files(void) {
+    printf("selinux_restorecon_get_relabeled_files() %zu files\n", restorecon_count);
+    return restorecon_count;
+}
+
+void selinux_restorecon_set_sehandle(struct selabel_handle *hndl) {
+    printf("selinux_restorecon_set_sehandle(%p)\n", (void *)hndl);
+}
+
+struct selabel_handle *selabel_open(unsigned int backend, const struct selinux_opt *opts, unsigned nopt) {
+    printf("selabel_open(%u, %p, %u)\n", backend, (const void *)opts, nopt);
+    return (struct selabel_handle *)(intptr_t)(++ptr);
+}
+
+void selabel_close(struct selabel_handle *handle) { printf("selabel_close(%p)\n", (void *)handle); }
+
 int semanage_is_connected(semanage_handle_t *sh) {
     printf("semanage_is_connected(%p)\n", sh);
-    return 0;
+    return sh == connected;
 }
 
 int semanage_disconnect(semanage_handle_t *sh) {
     printf("semanage_disconnect(%p)\n", sh);
+    if (sh == connected)
+        connected = NULL;
     return 0;
 }
 
@@ -90,14 +173,42 @@ int semanage_set_default_priority(semanage_handle_t *sh, uint16_t priority) {
 
 int semanage_connect(semanage_handle_t *sh) {
     printf("semanage_connect(%p)\n", sh);
+    connected = sh;
     return 0;
 }
 
+/**
+ * @brief Simulate the rebuild of the policy by a commit
+ * The latency is SIMULATE_SELINUX_COMMIT_LATENCY microseconds, it can be changed
+ * with the SIMULATE_SELINUX_COMMIT_LATENCY environment variable
+ */
+static void commit_latency(void) {
+    static long latency = -1;
+    if (latency < 0) {
+        const char *value = getenv("SIMULATE_SELINUX_COMMIT_LATENCY");
+        long us = value ? strtol(value, NULL, 10) : SIMULATE_SELINUX_COMMIT_LATENCY;
+        latency = us > 0 ? us : 0;
+    }
+    if (latency > 0)
+        usleep((useconds_t)latency);
+}
+
 int semanage_commit(semanage_handle_t *sh) {
     printf("semanage_commit(%p)\n", sh);
+    commit_latency();
+    simulated_policyload++;
     return 0;
 }
 
+int selinux_status_open(int fallback) {
+    printf("selinux_status_open(%d)\n", fallback);
+    return 0;
+}
+
+void selinux_status_close(void) { printf("selinux_status_close()\n"); }
+
+int selinux_status_policyload(void) { return simulated_policyload; }
+
 void semanage_handle_destroy(semanage_handle_t *sh) { printf("semanage_handle_destroy(%p)\n", sh); }
 
 int semanage_module_install_file(semanage_handle_t *sh, const char *file_path) {
@@ -106,7 +217,9 @@ int semanage_module_install_file(semanage_handle_t *sh, const char *file_path) {
     char path[SEC_LSM_MANAGER_MAX_SIZE_PATH];
     char *f_tmp = strdup(file_path);
     char *b = basename(f_tmp);
-    b[strlen(b) - 3] = 0;
+    char *extension = strrchr(b, '.');
+    if (extension != NULL)
+        *extension = 0;
     snprintf(path, SEC_LSM_MANAGER_MAX_SIZE_PATH, "%s/%s", SELINUX_POLICY_DIR, b);
     int rc = create_file(path);
     return rc;
@@ -169,10 +282,29 @@ int semanage_module_info_destroy(semanage_handle_t *handle, semanage_module_info
     return 0;
 }
 
-int launch_compile(const char *id) {
-    printf("launch_compile(%s)\n", id);
-    char path[SEC_LSM_MANAGER_MAX_SIZE_PATH];
-    snprintf(path, SEC_LSM_MANAGER_MAX_SIZE_PATH, "%s/%s.pp", SELINUX_RULES_DIR, id);
-    int rc = create_file(path);
+int get_selinux_devel_hash(uint64_t *hash) {
+    printf("get_selinux_devel_hash()\n");
+    *hash = 0;
+    return 0;
+}
+
+int compile_selinux_module(const char *te_file, const char *if_file, const char *fc_file, const char *pp_file,
+                           const compile_job_t *job) {
+    printf("compile_selinux_module(%s, %s, %s, %s)\n", te_file, if_file, fc_file, pp_file);
+
+    // duration of a compilation in ms (for benchmarks)
+    const char *value = getenv("SIMULATION_SELINUX_COMPILE_DELAY");
+    long delay = value ? strtol(value, NULL, 10) : 0;
+    while (delay > 0) {
+        int rc = job != NULL ? compile_job_check(job) : 0;
+        if (rc < 0)
+            return rc;
+        long ms = delay < 10 ? delay : 10;
+        struct timespec ts = {.tv_sec = 0, .tv_nsec = ms * 1000000L};
+        nanosleep(&ts, NULL);
+        delay -= ms;
+    }
+
+    int rc = create_file(pp_file);
     return rc;
 }
@@ -25,17 +25,43 @@
 #define SEC_LSM_MANAGER_SIMULATION_SELINUX_H
 
 #include <stdint.h>
+#include <stdio.h>
 
 #define SELINUX_RESTORECON_SET_SPECFILE_CTX 1
 #define SELINUX_RESTORECON_IGNORE_DIGEST 2
+#define SELINUX_RESTORECON_RECURSE 4
+
+#define SELABEL_CTX_FILE 0
 
 typedef struct semanage_handle semanage_handle_t;
 typedef struct semanage_module_info semanage_module_info_t;
+typedef struct sepol_module_package sepol_module_package_t;
+typedef struct sepol_policy_file sepol_policy_file_t;
+typedef struct sepol_policydb sepol_policydb_t;
+
+struct selabel_handle;
+struct selinux_opt;
 
 extern int is_selinux_enabled(void);
 
 extern int selinux_restorecon(const char *pathname, unsigned int restorecon_flags);
 
+extern int selinux_restorecon_parallel(const char *pathname, unsigned int restorecon_flags, size_t nthreads);
+
+extern unsigned long selinux_restorecon_get_relabeled_files(void);
+
+extern void selinux_restorecon_set_sehandle(struct selabel_handle *hndl);
+
+extern struct selabel_handle *selabel_open(unsigned int backend, const struct selinux_opt *opts, unsigned nopt);
+
+extern void selabel_close(struct selabel_handle *handle);
+
+extern int selinux_status_open(int fallback);
+
+extern void selinux_status_close(void);
+
+extern int selinux_status_policyload(void);
+
 extern int semanage_is_connected(semanage_handle_t *sh);
 
 extern int semanage_disconnect(semanage_handle_t *);
@@ -64,6 +90,24 @@ extern int semanage_module_info_get_name(semanage_handle_t *sh, semanage_module_
 
 extern int semanage_module_info_destroy(semanage_handle_t *handle, semanage_module_info_t *modinfo);
 
-extern int launch_compile(const char *id);
+// libsepol packaging used by selinux-compile.c (not simulated by the daemon, see bench-selinux-compile.c)
+
+extern int sepol_module_package_create(sepol_module_package_t **p);
+
+extern void sepol_module_package_free(sepol_module_package_t *p);
+
+extern sepol_policydb_t *sepol_module_package_get_policy(sepol_module_package_t *p);
+
+extern int sepol_module_package_set_file_contexts(sepol_module_package_t *p, char *data, size_t len);
+
+extern int sepol_module_package_write(sepol_module_package_t *p, sepol_policy_file_t *file);
+
+extern int sepol_policy_file_create(sepol_policy_file_t **pf);
+
+extern void sepol_policy_file_set_fp(sepol_policy_file_t *pf, FILE *fp);
+
+extern void sepol_policy_file_free(sepol_policy_file_t *pf);
+
+extern int sepol_policydb_read(sepol_policydb_t *p, sepol_policy_file_t *pf);
 
 #endif
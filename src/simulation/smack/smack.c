@@ -59,6 +59,13 @@ int smack_accesses_add(struct smack_accesses *handle, const char *subject, const
     return 0;
 }
 
+int smack_accesses_add_modify(struct smack_accesses *handle, const char *subject, const char *object,
+                              const char *allow_access_type, const char *deny_access_type) {
+    printf("smack_accesses_add_modify(%p,%s,%s,%s,%s)\n", handle, subject, object, allow_access_type,
+           deny_access_type);
+    return 0;
+}
+
 int smack_accesses_apply(struct smack_accesses *handle) {
     printf("smack_accesses_apply(%p)\n", handle);
     return 0;
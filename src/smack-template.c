@@ -23,13 +23,18 @@
 
 #include "smack-template.h"
 
+#include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 
+#include "arena.h"
+#include "hash-index.h"
 #include "log.h"
 #include "template.h"
 #include "utils.h"
@@ -52,6 +57,14 @@
 #define SMACK_POLICY_DIR "/etc/smack/accesses.d"
 #endif
 
+#if !defined(SMACK_LOAD_THREADS)
+#define SMACK_LOAD_THREADS 0
+#endif
+
+#if !defined(SMACK_LOAD_BATCH_SIZE)
+#define SMACK_LOAD_BATCH_SIZE 4095
+#endif
+
 const char default_smack_template_file[] = SMACK_TEMPLATE_FILE;
 const char default_smack_policy_dir[] = SMACK_POLICY_DIR;
 
@@ -69,6 +82,60 @@ char public_app[] = "_";
 /*** PRIVATE METHODS ***/
 /***********************/
 
+/**
+ * @brief Rules file written beside the loading of the rules
+ */
+typedef struct rules_writer {
+    atomic_file_t file; /**< rules file written, put in place once the rules are loaded */
+    const char *path;   /**< path of the rules file */
+    const char *rules;  /**< rendered rules */
+    size_t size;        /**< size of the rendered rules */
+    int rc;             /**< status of the write */
+} rules_writer_t;
+
+/**
+ * @brief Smack rule parsed from a rules file
+ */
+typedef struct smack_rule {
+    const char *key;     /**< "subject object", the key of the rule */
+    const char *subject; /**< subject label */
+    const char *object;  /**< object label */
+    const char *access;  /**< access, or access allowed for a modification */
+    const char *deny;    /**< access denied for a modification or NULL */
+} smack_rule_t;
+
+/**
+ * @brief Set of the rules of an app indexed by their subject and object
+ */
+typedef struct smack_rule_set {
+    smack_rule_t *rules;
+    size_t size;
+    size_t capacity;
+    hash_index_t index;
+    arena_t *arena;
+} smack_rule_set_t;
+
+/**
+ * @brief Get the key of the rule at 'position' of a rule set (for the index)
+ */
+__nonnull() __wur static const char *get_rule_key(const void *set, size_t position) {
+    return ((const smack_rule_set_t *)set)->rules[position].key;
+}
+
+/**
+ * @brief Initialize a rule set
+ *
+ * @param[in] rule_set the rule set
+ * @param[in] arena the arena of the rules
+ */
+__nonnull() static void init_rule_set(smack_rule_set_t *rule_set, arena_t *arena) {
+    rule_set->rules = NULL;
+    rule_set->size = 0;
+    rule_set->capacity = 0;
+    init_hash_index(&rule_set->index);
+    rule_set->arena = arena;
+}
+
 /**
  * @brief Remove file and loaded rules
  *
@@ -115,6 +182,361 @@ ret:
     return rc;
 }
 
+/**
+ * @brief Put a rule in a rule set
+ * A rule of a pair already in the set replaces it, as it would when loaded.
+ *
+ * @param[in] rule_set the rule set
+ * @param[in] rule the rule, its strings are referenced by the set
+ * @return 0 if added, 1 if replaced or a negative -errno value
+ */
+__nonnull() __wur static int rule_set_put(smack_rule_set_t *rule_set, const smack_rule_t *rule) {
+    size_t position;
+
+    if (hash_index_search(&rule_set->index, rule_set, get_rule_key, rule->key, false, &position)) {
+        rule_set->rules[position] = *rule;
+        return 1;
+    }
+
+    if (rule_set->size == rule_set->capacity) {
+        size_t capacity = rule_set->capacity ? 2 * rule_set->capacity : 16;
+        smack_rule_t *rules_tmp = arena_alloc(rule_set->arena, sizeof(smack_rule_t) * capacity);
+        if (rules_tmp == NULL) {
+            ERROR("arena_alloc smack_rule_t");
+            return -ENOMEM;
+        }
+        if (rule_set->size)
+            memcpy(rules_tmp, rule_set->rules, sizeof(smack_rule_t) * rule_set->size);
+        rule_set->rules = rules_tmp;
+        rule_set->capacity = capacity;
+    }
+
+    rule_set->rules[rule_set->size] = *rule;
+    int rc = hash_index_add(&rule_set->index, rule_set->arena, rule_set, get_rule_key, rule_set->size);
+    if (rc < 0) {
+        ERROR("hash_index_add : %d %s", -rc, strerror(-rc));
+        return rc;
+    }
+    rule_set->size++;
+
+    return 0;
+}
+
+/**
+ * @brief Parse the rules of a buffer into a rule set
+ * A rule is a line "subject object access" or "subject object allow deny",
+ * empty lines and lines starting with '#' are ignored.
+ *
+ * @param[in] rule_set the rule set
+ * @param[in] rules the rules, modified by the parse and referenced by the set
+ * @return 0 in case of success or a negative -errno value
+ */
+__nonnull() __wur static int parse_rules(smack_rule_set_t *rule_set, char *rules) {
+    char *line_save = NULL;
+    char *field_save = NULL;
+    char *fields[5];
+
+    for (char *line = strtok_r(rules, "\n", &line_save); line; line = strtok_r(NULL, "\n", &line_save)) {
+        size_t count = 0;
+        for (char *field = strtok_r(line, " \t\r", &field_save); field && count < 5;
+             field = strtok_r(NULL, " \t\r", &field_save)) {
+            fields[count++] = field;
+        }
+
+        if (count == 0 || fields[0][0] == '#') {
+            continue;
+        }
+
+        if (count != 3 && count != 4) {
+            ERROR("invalid smack rule : %s", fields[0]);
+            return -EINVAL;
+        }
+
+        size_t subject_len = strlen(fields[0]);
+        size_t object_len = strlen(fields[1]);
+        char *key = arena_alloc(rule_set->arena, subject_len + object_len + 2);
+        if (key == NULL) {
+            ERROR("arena_alloc key");
+            return -ENOMEM;
+        }
+        memcpy(key, fields[0], subject_len);
+        key[subject_len] = ' ';
+        memcpy(key + subject_len + 1, fields[1], object_len + 1);
+
+        smack_rule_t rule = {.key = key,
+                             .subject = fields[0],
+                             .object = fields[1],
+                             .access = fields[2],
+                             .deny = count == 4 ? fields[3] : NULL};
+        int rc = rule_set_put(rule_set, &rule);
+        if (rc < 0) {
+            ERROR("rule_set_put : %d %s", -rc, strerror(-rc));
+            return rc;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Add a rule to smack accesses
+ *
+ * @param[in] smack_accesses the smack accesses
+ * @param[in] rule the rule
+ * @param[in] removed true to remove the access of the rule
+ * @return 0 in case of success or a negative -errno value
+ */
+__nonnull() __wur static int add_rule(struct smack_accesses *smack_accesses, const smack_rule_t *rule,
+                                      bool removed) {
+    int rc;
+    if (removed) {
+        rc = smack_accesses_add(smack_accesses, rule->subject, rule->object, "-");
+    } else if (rule->deny) {
+        rc = smack_accesses_add_modify(smack_accesses, rule->subject, rule->object, rule->access, rule->deny);
+    } else {
+        rc = smack_accesses_add(smack_accesses, rule->subject, rule->object, rule->access);
+    }
+
+    if (rc < 0) {
+        ERROR("smack_accesses_add(%s,%s,%s)", rule->subject, rule->object, removed ? "-" : rule->access);
+        return -EINVAL;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Compute the changes from the rules loaded to the new ones
+ * Only the pairs added, changed or removed are set in 'apply'. The
+ * accesses restoring the loaded rules are set in 'revert'.
+ *
+ * @param[in] loaded the rules loaded (can be NULL when none)
+ * @param[in] rules the new rules
+ * @param[in] apply the smack accesses changing the loaded rules to the new ones
+ * @param[in] revert the smack accesses changing the new rules back to the loaded ones
+ * @return the count of changes in case of success or a negative -errno value
+ */
+__nonnull((2, 3, 4)) __wur static int diff_rules(const smack_rule_set_t *loaded, const smack_rule_set_t *rules,
+                                                 struct smack_accesses *apply, struct smack_accesses *revert) {
+    int changes = 0;
+    int rc = 0;
+    size_t position;
+
+    for (size_t i = 0; i < rules->size; i++) {
+        const smack_rule_t *rule = &rules->rules[i];
+        if (loaded && hash_index_search(&loaded->index, loaded, get_rule_key, rule->key, false, &position)) {
+            const smack_rule_t *previous = &loaded->rules[position];
+            if (!strcmp(rule->access, previous->access) &&
+                (rule->deny == previous->deny ||
+                 (rule->deny && previous->deny && !strcmp(rule->deny, previous->deny)))) {
+                continue;
+            }
+            rc = add_rule(revert, previous, false);
+        } else {
+            rc = add_rule(revert, rule, true);
+        }
+        if (rc >= 0)
+            rc = add_rule(apply, rule, false);
+        if (rc < 0)
+            return rc;
+        changes++;
+    }
+
+    for (size_t i = 0; loaded && i < loaded->size; i++) {
+        const smack_rule_t *previous = &loaded->rules[i];
+        if (!hash_index_search(&rules->index, rules, get_rule_key, previous->key, false, NULL)) {
+            rc = add_rule(apply, previous, true);
+            if (rc >= 0)
+                rc = add_rule(revert, previous, false);
+            if (rc < 0)
+                return rc;
+            changes++;
+        }
+    }
+
+    return changes;
+}
+
+/**
+ * @brief Write the rendered rules of an app for its rules file (thread routine)
+ * The rules file keeps the loaded rules until the write is committed.
+ *
+ * @param[in] arg the rules writer
+ * @return NULL
+ */
+static void *write_rules_file(void *arg) {
+    rules_writer_t *writer = arg;
+    writer->rc = prepare_file_atomic(&writer->file, writer->path, writer->rules, writer->size);
+    return NULL;
+}
+
+/**
+ * @brief Rules file parsed by the bulk loader
+ */
+typedef struct rules_file {
+    char path[SEC_LSM_MANAGER_MAX_SIZE_PATH]; /**< path of the rules file */
+    char *content;                            /**< content, referenced by the rules */
+    arena_t arena;                            /**< arena of the rules */
+    smack_rule_set_t rule_set;                /**< rules of the file */
+    int rc;                                   /**< status of the parse */
+} rules_file_t;
+
+/**
+ * @brief Rules files shared by the parsing threads
+ */
+typedef struct rules_files {
+    rules_file_t *files; /**< the files */
+    size_t count;        /**< count of files */
+    size_t next;         /**< index of the next file to parse */
+} rules_files_t;
+
+/**
+ * @brief Parse rules files until none is left (thread routine)
+ *
+ * @param[in] arg the rules files
+ * @return NULL
+ */
+static void *parse_rules_files(void *arg) {
+    rules_files_t *rules_files = arg;
+
+    for (;;) {
+        size_t i = __atomic_fetch_add(&rules_files->next, 1, __ATOMIC_RELAXED);
+        if (i >= rules_files->count) {
+            break;
+        }
+        rules_file_t *file = &rules_files->files[i];
+        file->content = read_file(file->path);
+        if (file->content == NULL) {
+            ERROR("read_file %s", file->path);
+            file->rc = -EINVAL;
+        } else {
+            file->rc = parse_rules(&file->rule_set, file->content);
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Select the rules files of a policy directory (for scandir)
+ */
+__nonnull() __wur static int is_rules_file(const struct dirent *entry) {
+    const char *dot = strrchr(entry->d_name, '.');
+    return entry->d_name[0] != '.' && dot != NULL && !strcmp(dot + 1, SMACK_EXTENSION);
+}
+
+/**
+ * @brief Write a batch of rules to smackfs
+ *
+ * @param[in] fd the opened load file of smackfs
+ * @param[in] batch the rules, one per line
+ * @param[in] length the length of the batch
+ * @return 0 in case of success or a negative -errno value
+ */
+__nonnull() __wur static int write_rules_batch(int fd, const char *batch, size_t length) {
+    while (length > 0) {
+        ssize_t len = write(fd, batch, length);
+        if (len < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            int rc = -errno;
+            ERROR("write : %d %s", -rc, strerror(-rc));
+            return rc;
+        }
+        if (len == 0) {
+            ERROR("write : no rule loaded");
+            return -EIO;
+        }
+        batch += len;
+        length -= (size_t)len;
+    }
+    return 0;
+}
+
+/**
+ * @brief Load a rule set in smackfs with as few writes as possible
+ * The load2 interface of smackfs takes several long format rules per write,
+ * so the rules are written by batches of SMACK_LOAD_BATCH_SIZE bytes at most.
+ * The rules modifying accesses are applied through libsmack.
+ *
+ * @param[in] rule_set the rules
+ * @param[out] writes the count of writes
+ * @return 0 in case of success or a negative -errno value
+ */
+__nonnull() __wur static int load_rule_set(const smack_rule_set_t *rule_set, size_t *writes) {
+    int rc = 0;
+    char load_file[SEC_LSM_MANAGER_MAX_SIZE_PATH];
+    char batch[SMACK_LOAD_BATCH_SIZE];
+    size_t length = 0;
+    struct smack_accesses *modify = NULL;
+
+    snprintf(load_file, SEC_LSM_MANAGER_MAX_SIZE_PATH, "%s/load2", smack_smackfs_path());
+    int fd = open(load_file, O_WRONLY | O_CLOEXEC);
+    if (fd < 0) {
+        rc = -errno;
+        ERROR("open %s : %d %s", load_file, -rc, strerror(-rc));
+        return rc;
+    }
+
+    for (size_t i = 0; i < rule_set->size; i++) {
+        const smack_rule_t *rule = &rule_set->rules[i];
+        if (rule->deny) {
+            if (modify == NULL && smack_accesses_new(&modify) < 0) {
+                ERROR("smack_accesses_new");
+                rc = -ENOMEM;
+                goto end;
+            }
+            rc = add_rule(modify, rule, false);
+            if (rc < 0) {
+                goto end;
+            }
+            continue;
+        }
+
+        size_t left = SMACK_LOAD_BATCH_SIZE - length;
+        int len = snprintf(batch + length, left, "%s %s %s\n", rule->subject, rule->object, rule->access);
+        if (len >= 0 && (size_t)len >= left) {
+            rc = write_rules_batch(fd, batch, length);
+            if (rc < 0) {
+                goto end;
+            }
+            (*writes)++;
+            length = 0;
+            len = snprintf(batch, SMACK_LOAD_BATCH_SIZE, "%s %s %s\n", rule->subject, rule->object, rule->access);
+        }
+        if (len < 0 || len >= SMACK_LOAD_BATCH_SIZE) {
+            ERROR("smack rule too long : %s", rule->key);
+            rc = -EINVAL;
+            goto end;
+        }
+        length += (size_t)len;
+    }
+
+    if (length > 0) {
+        rc = write_rules_batch(fd, batch, length);
+        if (rc < 0) {
+            goto end;
+        }
+        (*writes)++;
+    }
+
+    if (modify) {
+        rc = smack_accesses_apply(modify);
+        if (rc < 0) {
+            ERROR("smack_accesses_apply");
+            rc = -EINVAL;
+            goto end;
+        }
+        (*writes)++;
+    }
+
+end:
+    close(fd);
+    smack_accesses_free(modify);
+    return rc;
+}
+
 /**********************/
 /*** PUBLIC METHODS ***/
 /**********************/
@@ -174,8 +596,19 @@ void init_path_type_definitions(path_type_definitions_t path_type_definitions[nu
 /* see smack-template.h */
 int create_smack_rules(const secure_app_t *secure_app) {
     int rc = 0;
-    int rc2 = 0;
-    struct smack_accesses *smack_accesses = NULL;
+    int changes = 0;
+    char *rules = NULL;
+    char *loaded_rules = NULL;
+    char *parsed_rules = NULL;
+    size_t size = 0;
+    arena_t arena;
+    smack_rule_set_t rule_set;
+    smack_rule_set_t loaded_set;
+    struct smack_accesses *apply = NULL;
+    struct smack_accesses *revert = NULL;
+    rules_writer_t writer;
+    pthread_t thread;
+    bool writing = false;
     char smack_policy_dir[SEC_LSM_MANAGER_MAX_SIZE_DIR];
     char smack_rules_file[SEC_LSM_MANAGER_MAX_SIZE_PATH];
     char smack_template_file[SEC_LSM_MANAGER_MAX_SIZE_PATH];
@@ -186,50 +619,119 @@ int create_smack_rules(const secure_app_t *secure_app) {
     snprintf(smack_rules_file, SEC_LSM_MANAGER_MAX_SIZE_PATH, "%s/%s.%s", smack_policy_dir, secure_app->id,
              SMACK_EXTENSION);
 
-    rc = process_template(smack_template_file, smack_rules_file, secure_app);
+    init_arena(&arena);
+    init_rule_set(&rule_set, &arena);
+    init_rule_set(&loaded_set, &arena);
+
+    rc = render_template(smack_template_file, secure_app, &rules, &size);
     if (rc < 0) {
-        ERROR("process_template : %d %s", -rc, strerror(-rc));
+        ERROR("render_template : %d %s", -rc, strerror(-rc));
         goto end;
     }
 
-    int fd = open(smack_rules_file, O_RDONLY);
-    if (fd < 0) {
-        rc = -errno;
-        ERROR("open file %s : %d %s", smack_rules_file, -rc, strerror(-rc));
+    // the rules loaded by a previous install are the ones of its rules file
+    if (check_file_exists(smack_rules_file)) {
+        loaded_rules = read_file(smack_rules_file);
+        if (loaded_rules == NULL) {
+            ERROR("read_file %s, all the rules are loaded", smack_rules_file);
+        }
+    }
+
+    // the rules are written while they are loaded, the rules file is replaced once they are
+    writer.path = smack_rules_file;
+    writer.rules = rules;
+    writer.size = size;
+    writer.rc = 0;
+    rc = -pthread_create(&thread, NULL, write_rules_file, &writer);
+    if (rc < 0) {
+        ERROR("pthread_create : %d %s", -rc, strerror(-rc));
+        write_rules_file(&writer);
+    } else {
+        writing = true;
+    }
+
+    // rules are parsed from copies, the writer still reads the rendered ones
+    parsed_rules = arena_strndup(&arena, rules, size);
+    if (parsed_rules == NULL) {
+        rc = -ENOMEM;
+        ERROR("arena_strndup : %d %s", -rc, strerror(-rc));
         goto error;
     }
 
-    rc = smack_accesses_new(&smack_accesses);
+    rc = parse_rules(&rule_set, parsed_rules);
     if (rc < 0) {
-        ERROR("smack_accesses_new");
+        ERROR("parse_rules : %d %s", -rc, strerror(-rc));
         goto error;
     }
 
-    rc = smack_accesses_add_from_file(smack_accesses, fd);
+    if (loaded_rules) {
+        parsed_rules = arena_strndup(&arena, loaded_rules, strlen(loaded_rules));
+        if (parsed_rules == NULL || parse_rules(&loaded_set, parsed_rules) < 0) {
+            ERROR("parse_rules %s, all the rules are loaded", smack_rules_file);
+            init_rule_set(&loaded_set, &arena);
+        }
+    }
+
+    rc = smack_accesses_new(&apply);
+    if (rc >= 0)
+        rc = smack_accesses_new(&revert);
     if (rc < 0) {
-        ERROR("smack_accesses_add_from_file");
+        ERROR("smack_accesses_new");
         goto error;
     }
 
-    if (smack_enabled()) {
-        rc = smack_accesses_apply(smack_accesses);
+    changes = diff_rules(loaded_rules ? &loaded_set : NULL, &rule_set, apply, revert);
+    if (changes < 0) {
+        rc = changes;
+        ERROR("diff_rules : %d %s", -rc, strerror(-rc));
+        goto error;
+    }
+
+    if (changes > 0 && smack_enabled()) {
+        rc = smack_accesses_apply(apply);
         if (rc < 0) {
             ERROR("smack_accesses_apply");
-            goto error;
+            rc = -EINVAL;
+            goto revert;
         }
     }
 
-    DEBUG("create_smack_rules success");
+    if (writing) {
+        pthread_join(thread, NULL);
+        writing = false;
+    }
+    rc = writer.rc;
+    if (rc >= 0)
+        rc = commit_file_atomic(&writer.file);
+    if (rc < 0) {
+        ERROR("write_rules_file %s : %d %s", smack_rules_file, -rc, strerror(-rc));
+        goto revert;
+    }
+
+    DEBUG("create_smack_rules success : %d rules changed", changes);
     goto end;
 
+revert:
+    // the rules file must tell the loaded rules, else it is removed to load all of them next time
+    if (changes > 0 && smack_enabled() && smack_accesses_apply(revert) < 0) {
+        ERROR("smack_accesses_apply revert, remove %s", smack_rules_file);
+        if (remove_file(smack_rules_file) < 0) {
+            ERROR("remove_file %s", smack_rules_file);
+        }
+    }
 error:
-    rc2 = remove(smack_rules_file);
-    if (rc2 < 0) {
-        ERROR("remove %s : %d %s", smack_rules_file, errno, strerror(errno));
+    if (writing) {
+        pthread_join(thread, NULL);
+        writing = false;
     }
+    if (writer.rc >= 0)
+        abort_file_atomic(&writer.file);
 end:
-    smack_accesses_free(smack_accesses);
-    smack_accesses = NULL;
+    smack_accesses_free(apply);
+    smack_accesses_free(revert);
+    free_arena(&arena);
+    free(loaded_rules);
+    free(rules);
     return rc;
 }
 
@@ -257,3 +759,106 @@ int remove_smack_rules(const secure_app_t *secure_app) {
 
     return rc;
 }
+
+/* see smack-template.h */
+int load_smack_rules(const char *policy_dir, smack_load_stats_t *stats) {
+    int rc = 0;
+    struct dirent **entries = NULL;
+    rules_files_t rules_files = {.files = NULL, .count = 0, .next = 0};
+    pthread_t *threads = NULL;
+    size_t started = 0;
+    arena_t arena;
+    smack_rule_set_t rule_set;
+    struct timespec start, stop;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    memset(stats, 0, sizeof(*stats));
+    init_arena(&arena);
+    init_rule_set(&rule_set, &arena);
+
+    int count = scandir(policy_dir, &entries, is_rules_file, alphasort);
+    if (count < 0) {
+        rc = -errno;
+        ERROR("scandir %s : %d %s", policy_dir, -rc, strerror(-rc));
+        goto ret;
+    }
+
+    rules_files.count = (size_t)count;
+    rules_files.files = calloc(rules_files.count ?: 1, sizeof(rules_file_t));
+    if (rules_files.files == NULL) {
+        rc = -ENOMEM;
+        ERROR("calloc rules_file_t");
+        goto end;
+    }
+
+    for (size_t i = 0; i < rules_files.count; i++) {
+        rules_file_t *file = &rules_files.files[i];
+        snprintf(file->path, SEC_LSM_MANAGER_MAX_SIZE_PATH, "%s/%s", policy_dir, entries[i]->d_name);
+        init_arena(&file->arena);
+        init_rule_set(&file->rule_set, &file->arena);
+    }
+
+    // parse the files in parallel, the current thread takes its share
+    size_t thread_count = get_env_count("SMACK_LOAD_THREADS", SMACK_LOAD_THREADS);
+    if (thread_count > rules_files.count) {
+        thread_count = rules_files.count ?: 1;
+    }
+    threads = calloc(thread_count, sizeof(pthread_t));
+    if (threads) {
+        for (; started + 1 < thread_count; started++) {
+            if (pthread_create(&threads[started], NULL, parse_rules_files, &rules_files) != 0) {
+                break;
+            }
+        }
+    }
+    parse_rules_files(&rules_files);
+    for (size_t i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    // merge in the order of the names, a later file overrides a pair as a later load would
+    for (size_t i = 0; i < rules_files.count; i++) {
+        rules_file_t *file = &rules_files.files[i];
+        if (file->rc < 0) {
+            ERROR("rules of %s not loaded : %d %s", file->path, -file->rc, strerror(-file->rc));
+            rc = file->rc;
+            continue;
+        }
+        stats->files++;
+        for (size_t j = 0; j < file->rule_set.size; j++) {
+            int rc2 = rule_set_put(&rule_set, &file->rule_set.rules[j]);
+            if (rc2 < 0) {
+                rc = rc2;
+                goto end;
+            }
+            stats->duplicates += (size_t)rc2;
+        }
+    }
+    stats->rules = rule_set.size;
+
+    if (smack_enabled()) {
+        int rc2 = load_rule_set(&rule_set, &stats->writes);
+        if (rc2 < 0) {
+            ERROR("load_rule_set : %d %s", -rc2, strerror(-rc2));
+            rc = rc2;
+        }
+    }
+
+end:
+    // rule_set references the strings of the files
+    free_arena(&arena);
+    for (size_t i = 0; i < rules_files.count; i++) {
+        if (rules_files.files) {
+            free_arena(&rules_files.files[i].arena);
+            free(rules_files.files[i].content);
+        }
+        free(entries[i]);
+    }
+    free(rules_files.files);
+    free(entries);
+    free(threads);
+ret:
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+    stats->time_ms = (double)(stop.tv_sec - start.tv_sec) * 1000.0 + (double)(stop.tv_nsec - start.tv_nsec) / 1e6;
+    return rc;
+}
@@ -24,6 +24,7 @@
 #ifndef SEC_LSM_MANAGER_SMACK_TEMPLATE_H
 #define SEC_LSM_MANAGER_SMACK_TEMPLATE_H
 
+#include <stddef.h>
 #include <sys/cdefs.h>
 
 #include "secure-app.h"
@@ -92,4 +93,27 @@ extern int create_smack_rules(const secure_app_t *secure_app) __wur __nonnull();
  */
 extern int remove_smack_rules(const secure_app_t *secure_app) __wur __nonnull();
 
+/**
+ * @brief Statistics of a bulk load of smack rules
+ */
+typedef struct smack_load_stats {
+    size_t files;      /**< count of rules files loaded */
+    size_t rules;      /**< count of rules loaded */
+    size_t duplicates; /**< count of rules of a pair already defined by a previous file */
+    size_t writes;     /**< count of writes to smackfs */
+    double time_ms;    /**< time taken in milliseconds */
+} smack_load_stats_t;
+
+/**
+ * @brief Load the rules of all the rules files of a policy directory
+ * The files are parsed in parallel, the rules are deduplicated, a later file
+ * overriding a pair of an earlier one, and loaded by large writes to smackfs.
+ * An invalid file is reported and skipped, the others are loaded.
+ *
+ * @param[in] policy_dir the policy directory
+ * @param[out] stats the statistics of the load
+ * @return 0 in case of success or a negative -errno value
+ */
+extern int load_smack_rules(const char *policy_dir, smack_load_stats_t *stats) __wur __nonnull();
+
 #endif
@@ -24,10 +24,13 @@
 #include "smack.h"
 
 #include <errno.h>
+#include <fcntl.h>
 #include <linux/xattr.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
+#include <unistd.h>
 
 #include "log.h"
 #include "smack-template.h"
@@ -38,21 +41,86 @@
 /***********************/
 
 /**
- * @brief Label file
+ * @brief Path opened once for labeling
+ * Its type is read once and its attributes are set through its descriptor, so the
+ * path is not resolved again and can't be replaced between the checks and the labeling
+ */
+typedef struct opened_path {
+    const char *path;
+    int fd;
+    struct stat stat;
+} opened_path_t;
+
+/**
+ * @brief Open a path for labeling, without following a final symbolic link
+ * The path is opened with O_PATH, that never runs the open of a device. Regular
+ * files and directories are then reopened for reading through their descriptor,
+ * their attributes being set faster with it, when they can be read
  *
+ * @param[out] opened the opened path
  * @param[in] path The path of the file
- * @param[in] label The label to set
  * @return 0 in case of success or a negative -errno value
  */
-__nonnull() __wur static int label_file(const char *path, const char *label) {
-    if (!check_file_exists(path)) {
-        DEBUG("%s not exist", path);
-        return -EINVAL;
+__nonnull() __wur static int open_path(opened_path_t *opened, const char *path) {
+    int rc = 0;
+    char fd_path[32];
+
+    opened->path = path;
+    opened->fd = open(path, O_PATH | O_NOFOLLOW | O_CLOEXEC);
+    if (opened->fd < 0) {
+        rc = -errno;
+        if (rc == -ENOENT) {
+            DEBUG("%s not exist", path);
+            return -EINVAL;
+        }
+        ERROR("open %s : %d %s", path, -rc, strerror(-rc));
+        return rc;
+    }
+
+    if (fstat(opened->fd, &opened->stat) < 0) {
+        rc = -errno;
+        ERROR("fstat %s : %d %s", path, -rc, strerror(-rc));
+        close(opened->fd);
+        opened->fd = -1;
+        return rc;
+    }
+
+    if (S_ISREG(opened->stat.st_mode) || S_ISDIR(opened->stat.st_mode)) {
+        snprintf(fd_path, sizeof(fd_path), "/proc/self/fd/%d", opened->fd);
+        int fd = open(fd_path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+        if (fd >= 0) {
+            close(opened->fd);
+            opened->fd = fd;
+        }
     }
 
-    int rc = set_label(path, XATTR_NAME_SMACK, label);
+    return 0;
+}
+
+/**
+ * @brief Close a path opened for labeling
+ *
+ * @param[in] opened the opened path
+ */
+__nonnull() static void close_path(opened_path_t *opened) {
+    if (opened->fd >= 0) {
+        close(opened->fd);
+        opened->fd = -1;
+    }
+}
+
+/**
+ * @brief Label file
+ *
+ * @param[in] opened The opened path of the file
+ * @param[in] label The label to set
+ * @param[in,out] labels count of the labels written or skipped
+ * @return 0 in case of success or a negative -errno value
+ */
+__nonnull() __wur static int label_file(const opened_path_t *opened, const char *label, label_count_t *labels) {
+    int rc = set_label_fd(opened->fd, XATTR_NAME_SMACK, label, labels);
     if (rc < 0) {
-        ERROR("set_smack(%s,%s,%s) : %d %s", path, XATTR_NAME_SMACK, label, -rc, strerror(-rc));
+        ERROR("set_smack(%s,%s,%s) : %d %s", opened->path, XATTR_NAME_SMACK, label, -rc, strerror(-rc));
         return rc;
     }
 
@@ -62,18 +130,19 @@ __nonnull() __wur static int label_file(const char *path, const char *label) {
 /**
  * @brief Label a directory to be transmute
  *
- * @param[in] path The path of the directory
+ * @param[in] opened The opened path of the directory
+ * @param[in,out] labels count of the labels written or skipped
  * @return 0 in case of success or a negative -errno value
  */
-__nonnull() __wur static int label_dir_transmute(const char *path) {
-    if (!check_file_type(path, __S_IFDIR)) {
-        DEBUG("%s not directory", path);
+__nonnull() __wur static int label_dir_transmute(const opened_path_t *opened, label_count_t *labels) {
+    if (!S_ISDIR(opened->stat.st_mode)) {
+        DEBUG("%s not directory", opened->path);
         return 0;
     }
 
-    int rc = set_label(path, XATTR_NAME_SMACKTRANSMUTE, "TRUE");
+    int rc = set_label_fd(opened->fd, XATTR_NAME_SMACKTRANSMUTE, "TRUE", labels);
     if (rc < 0) {
-        ERROR("set_smack(%s,%s,%s)", path, XATTR_NAME_SMACKTRANSMUTE, "TRUE");
+        ERROR("set_smack(%s,%s,%s)", opened->path, XATTR_NAME_SMACKTRANSMUTE, "TRUE");
         return rc;
     }
 
@@ -83,18 +152,19 @@ __nonnull() __wur static int label_dir_transmute(const char *path) {
 /**
  * @brief Label an executable file
  *
- * @param[in] path The path of the file
+ * @param[in] opened The opened path of the file
  * @param[in] label The label that will be used when exec
+ * @param[in,out] labels count of the labels written or skipped
  * @return 0 in case of success or a negative -errno value
  */
-__nonnull() __wur static int label_exec(const char *path, const char *label) {
-    if (!check_file_type(path, __S_IFREG)) {
-        DEBUG("%s not regular file", path);
+__nonnull() __wur static int label_exec(const opened_path_t *opened, const char *label, label_count_t *labels) {
+    if (!S_ISREG(opened->stat.st_mode)) {
+        DEBUG("%s not regular file", opened->path);
         return 0;
     }
 
-    if (!check_executable(path)) {
-        ERROR("%s not executable", path);
+    if (!(opened->stat.st_mode & S_IXUSR)) {
+        ERROR("%s not executable", opened->path);
         return 0;  // Check that it should not be restricted.
     }
 
@@ -105,16 +175,14 @@ __nonnull() __wur static int label_exec(const char *path, const char *label) {
     }
 
     // remove :Exec (SMACK64EXEC)
-    char *label_no_exec = strdupa(label);
+    char *label_no_exec = strndupa(label, (size_t)(test_exec - label));
     if (!label_no_exec) {
         return -ENOMEM;
     }
 
-    label_no_exec[strlen(label_no_exec) - strlen(suffix_exec)] = '\0';
-
-    int rc = set_label(path, XATTR_NAME_SMACKEXEC, label_no_exec);
+    int rc = set_label_fd(opened->fd, XATTR_NAME_SMACKEXEC, label_no_exec, labels);
     if (rc < 0) {
-        ERROR("set_smack(%s,%s,%s) : %d %s", path, XATTR_NAME_SMACKEXEC, label_no_exec, -rc, strerror(-rc));
+        ERROR("set_smack(%s,%s,%s) : %d %s", opened->path, XATTR_NAME_SMACKEXEC, label_no_exec, -rc, strerror(-rc));
         return rc;
     }
 
@@ -123,55 +191,69 @@ __nonnull() __wur static int label_exec(const char *path, const char *label) {
 
 /**
  * @brief Label a file
+ * The path is opened and its type read once for all its labels
  *
  * @param[in] path The path of the file
  * @param[in] label The label of the file
  * @param[in] is_executable The file is an executable
  * @param[in] is_transmute The directory is transmute
+ * @param[in,out] labels count of the labels written or skipped
  * @return 0 in case of success or a negative -errno value
  */
-__nonnull((1, 2)) __wur
-    static int label_path(const char *path, const char *label, int is_executable, int is_transmute) {
-    int rc = label_file(path, label);
+__nonnull() __wur static int label_path(const char *path, const char *label, int is_executable, int is_transmute,
+                                        label_count_t *labels) {
+    opened_path_t opened;
+    int rc = open_path(&opened, path);
     if (rc < 0) {
-        ERROR("label file : %d %s", -rc, strerror(-rc));
+        ERROR("open path : %d %s", -rc, strerror(-rc));
         return rc;
     }
 
+    rc = label_file(&opened, label, labels);
+    if (rc < 0) {
+        ERROR("label file : %d %s", -rc, strerror(-rc));
+        goto end;
+    }
+
     if (is_executable) {
-        rc = label_exec(path, label);
+        rc = label_exec(&opened, label, labels);
         if (rc < 0) {
             ERROR("label exec : %d %s", -rc, strerror(-rc));
-            return rc;
+            goto end;
         }
     }
 
     if (is_transmute) {
-        rc = label_dir_transmute(path);
+        rc = label_dir_transmute(&opened, labels);
         if (rc < 0) {
             ERROR("label dir : %d %s", -rc, strerror(-rc));
-            return rc;
+            goto end;
         }
     }
 
-    return 0;
+end:
+    close_path(&opened);
+    return rc;
 }
 
 /**
  * @brief Apply smack on a secure app
  *
  * @param[in] secure_app secure app handler
+ * @param[in] path_type_definitions the labels of the path types
+ * @param[in,out] labels count of the labels written or skipped
  * @return 0 in case of success or a negative -errno value
  */
 __nonnull() __wur static int smack_process_paths(const secure_app_t *secure_app,
-                                                 path_type_definitions_t path_type_definitions[number_path_type]) {
+                                                 path_type_definitions_t path_type_definitions[number_path_type],
+                                                 label_count_t *labels) {
     int rc = 0;
     path_t *path = NULL;
     for (size_t i = 0; i < secure_app->path_set.size; i++) {
         path = secure_app->path_set.paths[i];
         rc = label_path(path->path, path_type_definitions[path->path_type].label,
                         path_type_definitions[path->path_type].is_executable,
-                        path_type_definitions[path->path_type].is_transmute);
+                        path_type_definitions[path->path_type].is_transmute, labels);
 
         if (rc < 0) {
             ERROR("label_path((%s,%s),%s) : %d %s", secure_app->path_set.paths[i]->path,
@@ -188,7 +270,7 @@ __nonnull() __wur static int smack_process_paths(const secure_app_t *secure_app,
 /**********************/
 
 /* see smack.h */
-int install_smack(const secure_app_t *secure_app) {
+int install_smack(const secure_app_t *secure_app, label_count_t *labels) {
     if (secure_app->id[0] == '\0') {
         ERROR("id undefined");
         return -EINVAL;
@@ -203,13 +285,13 @@ int install_smack(const secure_app_t *secure_app) {
     path_type_definitions_t path_type_definitions[number_path_type];
     init_path_type_definitions(path_type_definitions, secure_app->id);
 
-    rc = smack_process_paths(secure_app, path_type_definitions);
+    rc = smack_process_paths(secure_app, path_type_definitions, labels);
     if (rc < 0) {
         ERROR("smack_process_paths : %d %s", -rc, strerror(-rc));
         goto error;
     }
 
-    DEBUG("install smack success");
+    DEBUG("install smack success : %u labels written, %u skipped", labels->written, labels->skipped);
 
     goto end;
 
@@ -25,14 +25,16 @@
 #define SEC_LSM_MANAGER_SMACK_H
 
 #include "secure-app.h"
+#include "utils.h"
 
 /**
  * @brief Install a secure app for smack
  *
  * @param[in] secure_app secure app handler
+ * @param[in,out] labels count of the labels written or skipped
  * @return 0 in case of success or a negative -errno value
  */
-extern int install_smack(const secure_app_t *secure_app) __wur __nonnull();
+extern int install_smack(const secure_app_t *secure_app, label_count_t *labels) __wur __nonnull();
 
 /**
  * @brief Uninstall a secure app for smack
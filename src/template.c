@@ -21,65 +21,552 @@
  * $RP_END_LICENSE$
  */
 
+#include "template.h"
+
+#if !defined(TEMPLATE_MAX_TAG_LENGTH)
+#define TEMPLATE_MAX_TAG_LENGTH 1024
+#endif
+
+#if !defined(TEMPLATE_MAX_DEPTH)
+#define TEMPLATE_MAX_DEPTH 256
+#endif
+
+#include <ctype.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/inotify.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
 
+#include "arena.h"
 #include "log.h"
-#include "mustach/mustach.h"
 #include "secure-app.h"
 #include "utils.h"
 
-static int put(void *closure, const char *name, int escape, FILE *file) {
-    (void)escape;
-    secure_app_t *secure_app = (secure_app_t *)closure;
-    // DEBUG("name : %s", name);
+/**
+ * @brief Kind of an instruction of a compiled template
+ */
+typedef enum template_op_kind {
+    op_text,              /**< copy a span of the template */
+    op_put_id,            /**< put the id of the app */
+    op_put_id_underscore, /**< put the id of the app with underscores */
+    op_section,           /**< render the section if the app has the permission */
+    op_inverted_section   /**< render the section if the app doesn't have the permission */
+} template_op_kind_t;
+
+/**
+ * @brief Instruction of a compiled template
+ */
+typedef struct template_op {
+    template_op_kind_t kind;
+    const char *text; /**< span of the template or permission of a section */
+    size_t length;    /**< length of the span */
+    size_t end;       /**< index of the instruction following a section */
+} template_op_t;
+
+/**
+ * @brief Template compiled once and kept while its file doesn't change
+ */
+typedef struct compiled_template {
+    struct compiled_template *next; /**< next template of the cache */
+    const char *path;               /**< path of the template */
+    dev_t dev;                      /**< device of the file compiled */
+    ino_t ino;                      /**< inode of the file compiled */
+    struct timespec mtime;          /**< modification time of the file compiled */
+    off_t size;                     /**< size of the file compiled */
+    char *source;                   /**< content of the file, referenced by the spans */
+    arena_t arena;                  /**< memory of the instructions and of the names */
+    template_op_t *ops;             /**< instructions */
+    size_t count;                   /**< count of instructions */
+    size_t capacity;                /**< capacity of instructions */
+    size_t hint;                    /**< size of the last rendering */
+    unsigned refcount;              /**< count of users, the cache included */
+    bool watched;                   /**< changes are notified, the file is not checked */
+} compiled_template_t;
+
+/**
+ * @brief Template whose directory is watched for changes
+ */
+typedef struct watched_template {
+    char *path;       /**< path of the template */
+    const char *name; /**< name of the template in its directory */
+    int wd;           /**< watch descriptor of the directory or -1 */
+    bool changed;     /**< changed since its last compilation */
+} watched_template_t;
+
+/** compiled templates */
+static compiled_template_t *template_cache = NULL;
+
+/** watched templates */
+static watched_template_t *watched_templates = NULL;
+
+/** count of watched templates */
+static size_t watched_count = 0;
+
+/** lock of the compiled templates and of the watched templates */
+static pthread_mutex_t template_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/***********************/
+/*** PRIVATE METHODS ***/
+/***********************/
+
+/**
+ * @brief Append an instruction to a compiled template
+ *
+ * @param[in] template the compiled template
+ * @param[in] kind the kind of the instruction
+ * @param[in] text the span or the name of the instruction
+ * @param[in] length the length of the span
+ * @return the index of the instruction or a negative -errno value
+ */
+__nonnull((1)) __wur static ssize_t add_op(compiled_template_t *template, template_op_kind_t kind, const char *text,
+                                            size_t length) {
+    if (template->count == template->capacity) {
+        size_t capacity = template->capacity ? 2 * template->capacity : 32;
+        template_op_t *ops_tmp = arena_alloc(&template->arena, sizeof(template_op_t) * capacity);
+        if (ops_tmp == NULL) {
+            ERROR("arena_alloc template_op_t");
+            return -ENOMEM;
+        }
+        if (template->count)
+            memcpy(ops_tmp, template->ops, sizeof(template_op_t) * template->count);
+        template->ops = ops_tmp;
+        template->capacity = capacity;
+    }
+
+    template->ops[template->count] = (template_op_t){.kind = kind, .text = text, .length = length, .end = 0};
+    return (ssize_t)template->count++;
+}
+
+/**
+ * @brief Compile the source of a template into instructions
+ * The tags are the ones of mustach as used by the templates: replacements
+ * of id and id_underscore (other names are empty), sections and inverted
+ * sections on permissions, comments and changes of delimiters. A partial
+ * is a replacement, as the values of replacements hold no tag.
+ *
+ * @param[in] template the compiled template, its source set
+ * @return 0 in case of success or a negative -errno value
+ */
+__nonnull() __wur static int compile_template(compiled_template_t *template) {
+    char opstr[TEMPLATE_MAX_TAG_LENGTH + 1] = "{{";
+    char clstr[TEMPLATE_MAX_TAG_LENGTH + 1] = "}}";
+    size_t oplen = 2;
+    size_t cllen = 2;
+    size_t stack[TEMPLATE_MAX_DEPTH];
+    size_t depth = 0;
+    const char *source = template->source;
+    ssize_t rc = 0;
 
-    if (!strcmp(name, "id")) {
-        fputs(secure_app->id, file);
-    } else if (!strcmp(name, "id_underscore")) {
-        fputs(secure_app->id_underscore, file);
+    for (;;) {
+        const char *beg = strstr(source, opstr);
+        if (beg == NULL) {
+            if (source[0]) {
+                rc = add_op(template, op_text, source, strlen(source));
+                if (rc < 0)
+                    return (int)rc;
+            }
+            break;
+        }
+        if (beg != source) {
+            rc = add_op(template, op_text, source, (size_t)(beg - source));
+            if (rc < 0)
+                return (int)rc;
+        }
+        beg += oplen;
+        const char *term = strstr(beg, clstr);
+        if (term == NULL) {
+            ERROR("%s : unexpected end", template->path);
+            return -EINVAL;
+        }
+        source = term + cllen;
+        size_t len = (size_t)(term - beg);
+        char c = *beg;
+
+        if (c == '!') {
+            continue;
+        }
+
+        if (c == '=') {
+            // {{=<% %>=}} defines the delimiters of the next tags
+            size_t l;
+            if (len < 5 || beg[len - 1] != '=') {
+                ERROR("%s : bad separators", template->path);
+                return -EINVAL;
+            }
+            beg++;
+            len -= 2;
+            for (l = 0; l < len && !isspace(beg[l]); l++)
+                ;
+            oplen = l;
+            while (l < len && isspace(beg[l])) l++;
+            if (oplen == 0 || l == len) {
+                ERROR("%s : bad separators", template->path);
+                return -EINVAL;
+            }
+            cllen = len - l;
+            memcpy(opstr, beg, oplen);
+            opstr[oplen] = 0;
+            memcpy(clstr, beg + l, cllen);
+            clstr[cllen] = 0;
+            continue;
+        }
+
+        if (c == '{') {
+            // {{{name}}} is {{&name}}
+            size_t l;
+            for (l = 0; clstr[l] == '}'; l++)
+                ;
+            if (clstr[l]) {
+                if (!len || beg[len - 1] != '}') {
+                    ERROR("%s : bad unescape tag", template->path);
+                    return -EINVAL;
+                }
+                len--;
+            } else {
+                if (term[l] != '}') {
+                    ERROR("%s : bad unescape tag", template->path);
+                    return -EINVAL;
+                }
+                source++;
+            }
+            c = '&';
+        }
+        if (c == '^' || c == '#' || c == '/' || c == '&' || c == '>' || c == ':') {
+            beg++;
+            len--;
+        }
+        while (len && isspace(beg[0])) {
+            beg++;
+            len--;
+        }
+        while (len && isspace(beg[len - 1])) len--;
+        if (len == 0 || len > TEMPLATE_MAX_TAG_LENGTH) {
+            ERROR("%s : bad tag length %zu", template->path, len);
+            return -EINVAL;
+        }
+
+        if (c == '#' || c == '^') {
+            if (depth == TEMPLATE_MAX_DEPTH) {
+                ERROR("%s : too deep", template->path);
+                return -EINVAL;
+            }
+            const char *name = arena_strndup(&template->arena, beg, len);
+            if (name == NULL) {
+                ERROR("arena_strndup");
+                return -ENOMEM;
+            }
+            rc = add_op(template, c == '#' ? op_section : op_inverted_section, name, len);
+            if (rc < 0)
+                return (int)rc;
+            stack[depth++] = (size_t)rc;
+        } else if (c == '/') {
+            if (depth == 0 || template->ops[stack[depth - 1]].length != len ||
+                memcmp(template->ops[stack[depth - 1]].text, beg, len)) {
+                ERROR("%s : bad closing of section", template->path);
+                return -EINVAL;
+            }
+            template->ops[stack[--depth]].end = template->count;
+        } else if (len == 2 && !memcmp(beg, "id", 2)) {
+            rc = add_op(template, op_put_id, NULL, 0);
+        } else if (len == 13 && !memcmp(beg, "id_underscore", 13)) {
+            rc = add_op(template, op_put_id_underscore, NULL, 0);
+        }
+        if (rc < 0)
+            return (int)rc;
+    }
+
+    if (depth) {
+        ERROR("%s : unexpected end", template->path);
+        return -EINVAL;
     }
 
     return 0;
 }
 
-static int enter(void *closure, const char *name) {
-    secure_app_t *secure_app = (secure_app_t *)closure;
-    for (size_t i = 0; i < secure_app->permission_set.size; i++) {
-        if (!strcasecmp(name, secure_app->permission_set.permissions[i])) {
-            return 1;
+/**
+ * @brief Free a compiled template
+ *
+ * @param[in] template the compiled template
+ */
+__nonnull() static void free_compiled_template(compiled_template_t *template) {
+    free_arena(&template->arena);
+    free(template->source);
+    free((char *)template->path);
+    free(template);
+}
+
+/**
+ * @brief Release a compiled template got by get_compiled_template
+ *
+ * @param[in] template the compiled template
+ */
+__nonnull() static void release_compiled_template(compiled_template_t *template) {
+    pthread_mutex_lock(&template_cache_mutex);
+    unsigned refcount = --template->refcount;
+    pthread_mutex_unlock(&template_cache_mutex);
+    if (refcount == 0)
+        free_compiled_template(template);
+}
+
+/**
+ * @brief Check if a compiled template is the one of a file status
+ */
+__nonnull() __wur static bool is_same_file(const compiled_template_t *template, const struct stat *st) {
+    return template->dev == st->st_dev && template->ino == st->st_ino && template->size == st->st_size &&
+           template->mtime.tv_sec == st->st_mtim.tv_sec && template->mtime.tv_nsec == st->st_mtim.tv_nsec;
+}
+
+/**
+ * @brief Read and compile a template
+ *
+ * @param[in] template_path the path of the template
+ * @param[in] st the status of the file
+ * @param[out] result the compiled template, not cached
+ * @return 0 in case of success or a negative -errno value
+ */
+__nonnull() __wur static int compile_template_file(const char *template_path, const struct stat *st,
+                                                   compiled_template_t **result) {
+    int rc = 0;
+    compiled_template_t *template = calloc(1, sizeof(compiled_template_t));
+    if (template == NULL) {
+        ERROR("calloc compiled_template_t");
+        return -ENOMEM;
+    }
+    init_arena(&template->arena);
+    template->path = strdup(template_path);
+    template->source = read_file(template_path);
+    if (template->path == NULL || template->source == NULL) {
+        ERROR("read_file : %s", template_path);
+        rc = -EINVAL;
+        goto error;
+    }
+    template->dev = st->st_dev;
+    template->ino = st->st_ino;
+    template->size = st->st_size;
+    template->mtime = st->st_mtim;
+    rc = compile_template(template);
+    if (rc < 0) {
+        ERROR("compile_template %s : %d %s", template_path, -rc, strerror(-rc));
+        goto error;
+    }
+    DEBUG("template %s compiled : %zu instructions", template_path, template->count);
+
+    *result = template;
+    return 0;
+
+error:
+    free_compiled_template(template);
+    return rc;
+}
+
+/**
+ * @brief Put a compiled template in the cache, the lock must be held
+ * The previous version of the template is held until its users release it.
+ *
+ * @param[in] template the compiled template, its reference is given to the cache
+ */
+__nonnull() static void cache_template(compiled_template_t *template) {
+    for (compiled_template_t **prev = &template_cache; *prev; prev = &(*prev)->next) {
+        if (!strcmp((*prev)->path, template->path)) {
+            compiled_template_t *previous = *prev;
+            *prev = previous->next;
+            if (--previous->refcount == 0)
+                free_compiled_template(previous);
+            break;
+        }
+    }
+    template->refcount++;
+    template->next = template_cache;
+    template_cache = template;
+}
+
+/**
+ * @brief Get the compiled template of a file
+ * The template is compiled once and kept in the cache. A watched template
+ * is used as is, it is replaced by reload_templates. Otherwise, it is compiled
+ * again when the inode, the size or the modification time of its file change.
+ *
+ * @param[in] template_path the path of the template
+ * @param[out] result the compiled template, to be released by release_compiled_template
+ * @return 0 in case of success or a negative -errno value
+ */
+__nonnull() __wur static int get_compiled_template(const char *template_path, compiled_template_t **result) {
+    int rc = 0;
+    struct stat st;
+    compiled_template_t *template;
+
+    pthread_mutex_lock(&template_cache_mutex);
+    for (template = template_cache; template; template = template->next) {
+        if (template->watched && !strcmp(template->path, template_path)) {
+            template->refcount++;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&template_cache_mutex);
+    if (template) {
+        *result = template;
+        return 0;
+    }
+
+    if (stat(template_path, &st) < 0) {
+        rc = -errno;
+        ERROR("stat %s : %d %s", template_path, -rc, strerror(-rc));
+        return rc;
+    }
+
+    pthread_mutex_lock(&template_cache_mutex);
+    for (template = template_cache; template; template = template->next) {
+        if (!strcmp(template->path, template_path) && is_same_file(template, &st)) {
+            template->refcount++;
+            break;
         }
     }
+    pthread_mutex_unlock(&template_cache_mutex);
+    if (template) {
+        *result = template;
+        return 0;
+    }
+
+    // compile outside of the lock
+    rc = compile_template_file(template_path, &st, &template);
+    if (rc < 0) {
+        return rc;
+    }
+
+    template->refcount = 1;
+    pthread_mutex_lock(&template_cache_mutex);
+    cache_template(template);
+    pthread_mutex_unlock(&template_cache_mutex);
+
+    *result = template;
     return 0;
 }
 
-static int leave(void *closure) {
-    (void)closure;
-    DEBUG("leave");
+/**
+ * @brief Forget that the templates of a watch descriptor are watched, the lock must be held
+ * Their compiled versions are checked again against their files.
+ *
+ * @param[in] wd the watch descriptor or -1 for all
+ */
+static void unwatch(int wd) {
+    for (size_t i = 0; i < watched_count; i++) {
+        if (wd >= 0 && watched_templates[i].wd != wd)
+            continue;
+        watched_templates[i].wd = -1;
+        for (compiled_template_t *template = template_cache; template; template = template->next) {
+            if (!strcmp(template->path, watched_templates[i].path))
+                template->watched = false;
+        }
+    }
+}
+
+/**
+ * @brief Append a span to a rendering
+ *
+ * @param[in] buffer the rendering, reallocated if needed
+ * @param[in] size the size of the rendering
+ * @param[in] capacity the capacity of the rendering
+ * @param[in] text the span
+ * @param[in] length the length of the span
+ * @return 0 in case of success or a negative -errno value
+ */
+__nonnull() __wur static int append(char **buffer, size_t *size, size_t *capacity, const char *text,
+                                    size_t length) {
+    if (*size + length >= *capacity) {
+        size_t new_capacity = *capacity ? *capacity : 256;
+        while (*size + length >= new_capacity) new_capacity *= 2;
+        char *buffer_tmp = realloc(*buffer, new_capacity);
+        if (buffer_tmp == NULL) {
+            ERROR("realloc");
+            return -ENOMEM;
+        }
+        *buffer = buffer_tmp;
+        *capacity = new_capacity;
+    }
+    memcpy(*buffer + *size, text, length);
+    *size += length;
     return 0;
 }
 
-static int next(void *closure) {
-    (void)closure;
-    DEBUG("next");
+/**
+ * @brief Render a compiled template for a secure app
+ * The instructions are walked once, a section not rendered is jumped over.
+ *
+ * @param[in] template the compiled template
+ * @param[in] secure_app the secure app
+ * @param[out] result the rendered text, nul terminated, to be freed by the caller
+ * @param[out] size the size of the rendered text
+ * @return 0 in case of success or a negative -errno value
+ */
+__nonnull() __wur static int render_compiled_template(compiled_template_t *template, const secure_app_t *secure_app,
+                                                      char **result, size_t *size) {
+    int rc = 0;
+    size_t id_length = strlen(secure_app->id);
+    size_t id_underscore_length = strlen(secure_app->id_underscore);
+    size_t capacity = __atomic_load_n(&template->hint, __ATOMIC_RELAXED) + 1;
+    char *buffer = malloc(capacity);
+    size_t length = 0;
+
+    if (buffer == NULL) {
+        ERROR("malloc");
+        return -ENOMEM;
+    }
+
+    for (size_t i = 0; i < template->count && rc >= 0;) {
+        const template_op_t *op = &template->ops[i++];
+        switch (op->kind) {
+            case op_text:
+                rc = append(&buffer, &length, &capacity, op->text, op->length);
+                break;
+            case op_put_id:
+                rc = append(&buffer, &length, &capacity, secure_app->id, id_length);
+                break;
+            case op_put_id_underscore:
+                rc = append(&buffer, &length, &capacity, secure_app->id_underscore, id_underscore_length);
+                break;
+            case op_section:
+            case op_inverted_section:
+                if (permission_set_has_permission(&secure_app->permission_set, op->text, true) !=
+                    (op->kind == op_section)) {
+                    i = op->end;
+                }
+                break;
+        }
+    }
+
+    if (rc < 0) {
+        free(buffer);
+        return rc;
+    }
+
+    buffer[length] = '\0';
+    __atomic_store_n(&template->hint, length, __ATOMIC_RELAXED);
+    *result = buffer;
+    *size = length;
     return 0;
 }
 
-static struct mustach_itf itf = {.enter = enter, .put = put, .next = next, .leave = leave};
+/**********************/
+/*** PUBLIC METHODS ***/
+/**********************/
 
-int process_template(const char *template_path, const char *dest, secure_app_t *secure_app) {
+/* see template.h */
+int process_template(const char *template_path, const char *dest, const secure_app_t *secure_app) {
     int rc = 0;
     int rc2 = 0;
-    char *template = read_file(template_path);
-    if (template == NULL) {
-        ERROR("read_file : %s", template_path);
-        return -EINVAL;
+    char *rendering = NULL;
+    size_t size = 0;
+
+    rc = render_template(template_path, secure_app, &rendering, &size);
+    if (rc < 0) {
+        ERROR("render_template %s : %d %s", template_path, -rc, strerror(-rc));
+        return rc;
     }
 
     FILE *f_dest = fopen(dest, "w");
@@ -89,17 +576,193 @@ int process_template(const char *template_path, const char *dest, secure_app_t *
         goto end;
     }
 
-    rc = fmustach(template, &itf, secure_app, f_dest);
-    if (rc < 0) {
-        ERROR("fmustach : %d %s", errno, strerror(errno));
+    if (size && fwrite(rendering, size, 1, f_dest) != 1) {
+        rc = -EIO;
+        ERROR("fwrite %s", dest);
     }
 
     rc2 = fclose(f_dest);
     if (rc2 < 0) {
+        rc = rc < 0 ? rc : -errno;
         ERROR("fclose %s : %d %s", dest, errno, strerror(errno));
     }
 
 end:
-    free(template);
+    free(rendering);
     return rc;
-}
\ No newline at end of file
+}
+
+/* see template.h */
+int render_template(const char *template_path, const secure_app_t *secure_app, char **result, size_t *size) {
+    compiled_template_t *template = NULL;
+
+    int rc = get_compiled_template(template_path, &template);
+    if (rc < 0) {
+        ERROR("get_compiled_template : %s", template_path);
+        return rc;
+    }
+
+    rc = render_compiled_template(template, secure_app, result, size);
+    if (rc < 0) {
+        ERROR("render_compiled_template : %d %s", -rc, strerror(-rc));
+    }
+
+    release_compiled_template(template);
+    return rc;
+}
+
+/* see template.h */
+int watch_templates(const char *const templates[], size_t count) {
+    int rc = 0;
+
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0) {
+        rc = -errno;
+        ERROR("inotify_init1 : %d %s", -rc, strerror(-rc));
+        return rc;
+    }
+
+    watched_template_t *watched = calloc(count ?: 1, sizeof(watched_template_t));
+    if (watched == NULL) {
+        ERROR("calloc watched_template_t");
+        close(fd);
+        return -ENOMEM;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        char dir[SEC_LSM_MANAGER_MAX_SIZE_PATH];
+        watched[i].path = strdup(templates[i]);
+        if (watched[i].path == NULL) {
+            rc = -ENOMEM;
+            ERROR("strdup");
+            goto error;
+        }
+        const char *slash = strrchr(watched[i].path, '/');
+        if (slash == NULL) {
+            watched[i].name = watched[i].path;
+            secure_strncpy(dir, ".", SEC_LSM_MANAGER_MAX_SIZE_PATH);
+        } else {
+            watched[i].name = slash + 1;
+            snprintf(dir, SEC_LSM_MANAGER_MAX_SIZE_PATH, "%.*s", (int)(slash - watched[i].path) ?: 1,
+                     watched[i].path);
+        }
+        // the directory is watched, so that a template replaced by a rename is seen
+        watched[i].wd = inotify_add_watch(fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO | IN_ATTRIB | IN_DELETE |
+                                                       IN_MOVED_FROM | IN_ONLYDIR);
+        if (watched[i].wd < 0) {
+            rc = -errno;
+            ERROR("inotify_add_watch %s : %d %s", dir, -rc, strerror(-rc));
+            goto error;
+        }
+        watched[i].changed = true;
+    }
+
+    pthread_mutex_lock(&template_cache_mutex);
+    unwatch(-1);
+    for (size_t i = 0; i < watched_count; i++) free(watched_templates[i].path);
+    free(watched_templates);
+    watched_templates = watched;
+    watched_count = count;
+    pthread_mutex_unlock(&template_cache_mutex);
+
+    reload_templates();
+    return fd;
+
+error:
+    for (size_t i = 0; i < count; i++) free(watched[i].path);
+    free(watched);
+    close(fd);
+    return rc;
+}
+
+/* see template.h */
+void unwatch_templates(int fd) {
+    pthread_mutex_lock(&template_cache_mutex);
+    unwatch(-1);
+    for (size_t i = 0; i < watched_count; i++) free(watched_templates[i].path);
+    free(watched_templates);
+    watched_templates = NULL;
+    watched_count = 0;
+    pthread_mutex_unlock(&template_cache_mutex);
+    close(fd);
+}
+
+/* see template.h */
+int read_templates_changes(int fd) {
+    int changes = 0;
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+
+    for (;;) {
+        ssize_t len = read(fd, buffer, sizeof(buffer));
+        if (len < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno != EAGAIN) {
+                int rc = -errno;
+                ERROR("read inotify : %d %s", -rc, strerror(-rc));
+                return rc;
+            }
+            break;
+        }
+
+        pthread_mutex_lock(&template_cache_mutex);
+        for (char *cursor = buffer; cursor < buffer + len;) {
+            const struct inotify_event *event = (const struct inotify_event *)cursor;
+            cursor += sizeof(struct inotify_event) + event->len;
+            if (event->mask & IN_IGNORED) {
+                // the directory is gone, its templates are checked by status again
+                unwatch(event->wd);
+                continue;
+            }
+            for (size_t i = 0; i < watched_count; i++) {
+                watched_template_t *watched = &watched_templates[i];
+                if ((event->mask & IN_Q_OVERFLOW) ||
+                    (watched->wd == event->wd && event->len && !strcmp(watched->name, event->name))) {
+                    if (!watched->changed)
+                        changes++;
+                    watched->changed = true;
+                }
+            }
+        }
+        pthread_mutex_unlock(&template_cache_mutex);
+    }
+
+    return changes;
+}
+
+/* see template.h */
+void reload_templates(void) {
+    struct stat st;
+    compiled_template_t *template;
+
+    pthread_mutex_lock(&template_cache_mutex);
+    for (size_t i = 0; i < watched_count; i++) {
+        if (!watched_templates[i].changed)
+            continue;
+        watched_templates[i].changed = false;
+        char *path = strdup(watched_templates[i].path);
+        bool watched = watched_templates[i].wd >= 0;
+        pthread_mutex_unlock(&template_cache_mutex);
+
+        // compile outside of the lock, the version in use is kept on error
+        int rc = path ? stat(path, &st) : -ENOMEM;
+        if (rc < 0) {
+            rc = path ? -errno : rc;
+            ERROR("stat %s : %d %s", path ?: "", -rc, strerror(-rc));
+        } else {
+            rc = compile_template_file(path, &st, &template);
+        }
+
+        pthread_mutex_lock(&template_cache_mutex);
+        if (rc < 0) {
+            ERROR("template %s not reloaded : %d %s", path ?: "", -rc, strerror(-rc));
+        } else {
+            // the watch may have been lost meanwhile
+            template->watched = watched && i < watched_count && watched_templates[i].wd >= 0;
+            cache_template(template);
+            DEBUG("template %s reloaded", path);
+        }
+        free(path);
+    }
+    pthread_mutex_unlock(&template_cache_mutex);
+}
@@ -21,4 +21,66 @@
  * $RP_END_LICENSE$
  */
 
-extern int process_template(const char *template, const char *dest, const secure_app_t *secure_app);
\ No newline at end of file
+#ifndef SEC_LSM_MANAGER_TEMPLATE_H
+#define SEC_LSM_MANAGER_TEMPLATE_H
+
+#include <stddef.h>
+
+#include "secure-app.h"
+
+/**
+ * @brief Render a template for a secure app into a file
+ *
+ * @param[in] template the path of the template
+ * @param[in] dest the path of the file to write
+ * @param[in] secure_app the secure app
+ * @return 0 in case of success or a negative -errno value
+ */
+extern int process_template(const char *template, const char *dest, const secure_app_t *secure_app);
+
+/**
+ * @brief Render a template for a secure app into memory
+ *
+ * @param[in] template the path of the template
+ * @param[in] secure_app the secure app
+ * @param[out] result the rendered text, to be freed by the caller
+ * @param[out] size the size of the rendered text
+ * @return 0 in case of success or a negative -errno value
+ */
+extern int render_template(const char *template, const secure_app_t *secure_app, char **result, size_t *size);
+
+/**
+ * @brief Compile templates and watch their directories for changes
+ * While watched, the compiled versions of the templates are used without
+ * checking their files: read_templates_changes and reload_templates update them.
+ *
+ * @param[in] templates the paths of the templates
+ * @param[in] count the count of templates
+ * @return the file descriptor to poll for changes or a negative -errno value
+ */
+extern int watch_templates(const char *const templates[], size_t count) __wur;
+
+/**
+ * @brief Stop watching the templates
+ * Their compiled versions are checked again against their files.
+ *
+ * @param[in] fd the file descriptor returned by watch_templates
+ */
+extern void unwatch_templates(int fd);
+
+/**
+ * @brief Read the changes notified on the file descriptor of watch_templates
+ *
+ * @param[in] fd the file descriptor returned by watch_templates
+ * @return the count of templates changed in case of success or a negative -errno value
+ */
+extern int read_templates_changes(int fd) __wur;
+
+/**
+ * @brief Compile again the changed templates and replace their versions in the cache
+ * A template that doesn't compile keeps its previous version. A rendering
+ * in progress keeps the version it started with.
+ */
+extern void reload_templates(void);
+
+#endif
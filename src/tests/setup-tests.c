@@ -18,7 +18,6 @@
 #include "setup-tests.h"
 
 #include "../log.c"
-#include "../mustach/mustach.c"
 #include "../template.c"
 
 Suite *suite;
@@ -75,14 +74,18 @@ bool compare_xattr(const char *path, const char *xattr, const char *value) {
     return false;
 }
 
+extern void test_arena();
+extern void test_cynagora();
+extern void test_hash_index();
 extern void test_paths();
+extern void test_pollitem();
+extern void test_prot();
 extern void test_permissions();
 extern void test_secure_app();
+extern void test_server();
+extern void test_template();
 extern void test_utils();
-
-#if !defined(SIMULATE_CYNAGORA)
-extern void test_cynagora();
-#endif
+extern void test_workers();
 
 #if defined(WITH_SMACK)
 extern void test_smack();
@@ -104,22 +107,41 @@ int main(int argc, char const *argv[]) {
 
     mksuite("tests");
 
+    addtcase("arena");
+    test_arena();
+
+    addtcase("hash_index");
+    test_hash_index();
+
     addtcase("paths");
     test_paths();
 
+    addtcase("pollitem");
+    test_pollitem();
+
     addtcase("permissions");
     test_permissions();
 
+    addtcase("prot");
+    test_prot();
+
     addtcase("secure_app");
     test_secure_app();
 
+    addtcase("server");
+    test_server();
+
+    addtcase("template");
+    test_template();
+
     addtcase("utils");
     test_utils();
 
-#if !defined(SIMULATE_CYNAGORA)
+    addtcase("workers");
+    test_workers();
+
     addtcase("cynagora");
     test_cynagora();
-#endif
 
 #if defined(WITH_SMACK)
     addtcase("smack");
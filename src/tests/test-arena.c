@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2018-2021 IoT.bzh Company
+ * Author: José Bollo <jose.bollo@iot.bzh>
+ * Author: Arthur Guyader <arthur.guyader@iot.bzh>
+ *
+ * $RP_BEGIN_LICENSE$
+ * Commercial License Usage
+ *  Licensees holding valid commercial IoT.bzh licenses may use this file in
+ *  accordance with the commercial license agreement provided with the
+ *  Software or, alternatively, in accordance with the terms contained in
+ *  a written agreement between you and The IoT.bzh Company. For licensing terms
+ *  and conditions see https://www.iot.bzh/terms-conditions. For further
+ *  information use the contact form at https://www.iot.bzh/contact.
+ *
+ * GNU General Public License Usage
+ *  Alternatively, this file may be used under the terms of the GNU General
+ *  Public license version 3. This license is as published by the Free Software
+ *  Foundation and appearing in the file LICENSE.GPLv3 included in the packaging
+ *  of this file. Please review the following information to ensure the GNU
+ *  General Public License requirements will be met
+ *  https://www.gnu.org/licenses/gpl-3.0.html.
+ * $RP_END_LICENSE$
+ */
+
+#include <stdint.h>
+
+#include "../arena.c"
+#include "setup-tests.h"
+
+START_TEST(test_arena_alloc) {
+    arena_t arena;
+    char *first, *second, *big;
+
+    init_arena(&arena);
+    ck_assert_ptr_eq(arena.first, NULL);
+
+    first = arena_alloc(&arena, 1);
+    second = arena_alloc(&arena, 3);
+    ck_assert_ptr_ne(first, NULL);
+    ck_assert_ptr_ne(second, NULL);
+    ck_assert_int_eq((int)((uintptr_t)second % alignof(max_align_t)), 0);
+    ck_assert_ptr_eq(arena.first, arena.current);
+
+    /* bigger than the current chunk */
+    big = arena_alloc(&arena, 3 * MIN_ARENA_CHUNK_SIZE);
+    ck_assert_ptr_ne(big, NULL);
+    memset(big, 'x', 3 * MIN_ARENA_CHUNK_SIZE);
+    ck_assert_ptr_ne(arena.first, arena.current);
+
+    ck_assert_str_eq(arena_strndup(&arena, "permission", 4), "perm");
+
+    free_arena(&arena);
+    ck_assert_ptr_eq(arena.first, NULL);
+    ck_assert_ptr_eq(arena.current, NULL);
+}
+END_TEST
+
+START_TEST(test_arena_reset) {
+    arena_t arena;
+    arena_chunk_t *first, *second;
+
+    init_arena(&arena);
+    for (int i = 0; i < 1000; i++) ck_assert_ptr_ne(arena_alloc(&arena, 64), NULL);
+    first = arena.first;
+    second = first->next;
+    ck_assert_ptr_ne(second, NULL);
+
+    /* the chunks are reused after a reset */
+    arena_reset(&arena);
+    ck_assert_ptr_eq(arena.current, first);
+    ck_assert_ptr_eq(arena_alloc(&arena, 64), first->memory);
+    for (int i = 0; i < 1000; i++) ck_assert_ptr_ne(arena_alloc(&arena, 64), NULL);
+    ck_assert_ptr_eq(arena.first, first);
+    ck_assert_ptr_eq(first->next, second);
+
+    free_arena(&arena);
+}
+END_TEST
+
+void test_arena() {
+    addtest(test_arena_alloc);
+    addtest(test_arena_reset);
+}
@@ -16,6 +16,9 @@
  */
 
 #include "../cynagora-interface.c"
+#if defined(SIMULATE_CYNAGORA)
+#include "../simulation/cynagora/cynagora.c"
+#endif
 #include "setup-tests.h"
 
 static void list(void *closure, const cynagora_key_t *key, const cynagora_value_t *value) {
@@ -24,8 +27,9 @@ static void list(void *closure, const cynagora_key_t *key, const cynagora_value_
     ck_assert_int_eq(permission_set_add_permission(permission_set, key->permission), 0);
 }
 
-int cynagora_get_policies(cynagora_t *cynagora, const char *client, permission_set_t *permission_set) {
-    init_permission_set(permission_set);
+int cynagora_get_policies(cynagora_t *cynagora, const char *client, permission_set_t *permission_set,
+                          arena_t *arena) {
+    init_permission_set(permission_set, arena);
     if (cynagora_enter(cynagora) < 0) {
         return -1;
     }
@@ -47,8 +51,10 @@ START_TEST(test_cynagora_set_policies) {
     char *id = "testid";
     ck_assert_int_eq(cynagora_create(&cynagora_admin_client, cynagora_Admin, 1, 0), 0);
 
+    arena_t arena;
     permission_set_t permission_set;
-    init_permission_set(&permission_set);
+    init_arena(&arena);
+    init_permission_set(&permission_set, &arena);
 
     ck_assert_int_eq(permission_set_add_permission(&permission_set, "perm1"), 0);
     ck_assert_int_eq(permission_set_add_permission(&permission_set, "perm2"), 0);
@@ -57,7 +63,7 @@ START_TEST(test_cynagora_set_policies) {
 
     int found = 0;
     permission_set_t permission_set2;
-    ck_assert_int_eq(cynagora_get_policies(cynagora_admin_client, id, &permission_set2), 0);
+    ck_assert_int_eq(cynagora_get_policies(cynagora_admin_client, id, &permission_set2, &arena), 0);
 
     for (size_t i = 0; i < permission_set.size; i++) {
         for (size_t j = 0; j < permission_set2.size; j++) {
@@ -75,6 +81,7 @@ START_TEST(test_cynagora_set_policies) {
     free_permission_set(&permission_set);
     free_permission_set(&permission_set2);
     cynagora_destroy(cynagora_admin_client);
+    free_arena(&arena);
 }
 END_TEST
 
@@ -83,8 +90,10 @@ START_TEST(test_cynagora_drop_policies) {
     char *id = "testid";
     ck_assert_int_eq(cynagora_create(&cynagora_admin_client, cynagora_Admin, 1, 0), 0);
 
+    arena_t arena;
     permission_set_t permission_set;
-    init_permission_set(&permission_set);
+    init_arena(&arena);
+    init_permission_set(&permission_set, &arena);
 
     ck_assert_int_eq(permission_set_add_permission(&permission_set, "perm1"), 0);
     ck_assert_int_eq(permission_set_add_permission(&permission_set, "perm2"), 0);
@@ -95,7 +104,7 @@ START_TEST(test_cynagora_drop_policies) {
 
     int found = 0;
     permission_set_t permission_set2;
-    ck_assert_int_eq(cynagora_get_policies(cynagora_admin_client, id, &permission_set2), 0);
+    ck_assert_int_eq(cynagora_get_policies(cynagora_admin_client, id, &permission_set2, &arena), 0);
 
     for (size_t i = 0; i < permission_set.size; i++) {
         for (size_t j = 0; j < permission_set2.size; j++) {
@@ -111,10 +120,71 @@ START_TEST(test_cynagora_drop_policies) {
     free_permission_set(&permission_set);
     free_permission_set(&permission_set2);
     cynagora_destroy(cynagora_admin_client);
+    free_arena(&arena);
+}
+END_TEST
+
+START_TEST(test_cynagora_replace_policies) {
+    cynagora_t *cynagora_admin_client = NULL;
+    char *id = "testid";
+    ck_assert_int_eq(cynagora_create(&cynagora_admin_client, cynagora_Admin, 1, 0), 0);
+
+    arena_t arena;
+    permission_set_t permission_set;
+    init_arena(&arena);
+    init_permission_set(&permission_set, &arena);
+
+    ck_assert_int_eq(permission_set_add_permission(&permission_set, "perm1"), 0);
+    ck_assert_int_eq(permission_set_add_permission(&permission_set, "perm2"), 0);
+    ck_assert_int_eq(cynagora_set_policies(cynagora_admin_client, id, &permission_set), 0);
+
+    // perm1 is replaced by perm3
+    permission_set_t permission_set2;
+    init_permission_set(&permission_set2, &arena);
+    ck_assert_int_eq(permission_set_add_permission(&permission_set2, "perm2"), 0);
+    ck_assert_int_eq(permission_set_add_permission(&permission_set2, "perm3"), 0);
+#if defined(SIMULATE_CYNAGORA)
+    unsigned long writes = simulation_writes;
+#endif
+    ck_assert_int_eq(cynagora_replace_policies(cynagora_admin_client, id, &permission_set2), 0);
+#if defined(SIMULATE_CYNAGORA)
+    // only the delta is written: drop of perm1, set of perm3 and commit
+    ck_assert_uint_eq(simulation_writes - writes, 3);
+#endif
+
+    permission_set_t permission_set3;
+    ck_assert_int_eq(cynagora_get_policies(cynagora_admin_client, id, &permission_set3, &arena), 0);
+    ck_assert_int_eq(permission_set3.size, 2);
+    ck_assert_int_eq(permission_set_has_permission(&permission_set3, "perm1", false), false);
+    ck_assert_int_eq(permission_set_has_permission(&permission_set3, "perm2", false), true);
+    ck_assert_int_eq(permission_set_has_permission(&permission_set3, "perm3", false), true);
+
+    // nothing changed
+#if defined(SIMULATE_CYNAGORA)
+    writes = simulation_writes;
+#endif
+    ck_assert_int_eq(cynagora_replace_policies(cynagora_admin_client, id, &permission_set2), 0);
+#if defined(SIMULATE_CYNAGORA)
+    // nothing is written, not even a commit
+    ck_assert_uint_eq(simulation_writes, writes);
+#endif
+    permission_set_t permission_set4;
+    ck_assert_int_eq(cynagora_get_policies(cynagora_admin_client, id, &permission_set4, &arena), 0);
+    ck_assert_int_eq(permission_set4.size, 2);
+
+    ck_assert_int_eq(cynagora_drop_policies(cynagora_admin_client, id), 0);
+
+    free_permission_set(&permission_set);
+    free_permission_set(&permission_set2);
+    free_permission_set(&permission_set3);
+    free_permission_set(&permission_set4);
+    cynagora_destroy(cynagora_admin_client);
+    free_arena(&arena);
 }
 END_TEST
 
 void test_cynagora() {
     addtest(test_cynagora_set_policies);
     addtest(test_cynagora_drop_policies);
+    addtest(test_cynagora_replace_policies);
 }
@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2018-2021 IoT.bzh Company
+ * Author: José Bollo <jose.bollo@iot.bzh>
+ * Author: Arthur Guyader <arthur.guyader@iot.bzh>
+ *
+ * $RP_BEGIN_LICENSE$
+ * Commercial License Usage
+ *  Licensees holding valid commercial IoT.bzh licenses may use this file in
+ *  accordance with the commercial license agreement provided with the
+ *  Software or, alternatively, in accordance with the terms contained in
+ *  a written agreement between you and The IoT.bzh Company. For licensing terms
+ *  and conditions see https://www.iot.bzh/terms-conditions. For further
+ *  information use the contact form at https://www.iot.bzh/contact.
+ *
+ * GNU General Public License Usage
+ *  Alternatively, this file may be used under the terms of the GNU General
+ *  Public license version 3. This license is as published by the Free Software
+ *  Foundation and appearing in the file LICENSE.GPLv3 included in the packaging
+ *  of this file. Please review the following information to ensure the GNU
+ *  General Public License requirements will be met
+ *  https://www.gnu.org/licenses/gpl-3.0.html.
+ * $RP_END_LICENSE$
+ */
+
+#include <stdio.h>
+
+#include "../hash-index.c"
+#include "setup-tests.h"
+
+static char keys[1000][16];
+
+static const char *get_key(const void *set, size_t position) { return ((const char(*)[16])set)[position]; }
+
+START_TEST(test_hash_index_search) {
+    hash_index_t hash_index;
+    arena_t arena;
+    size_t position = 0;
+
+    init_arena(&arena);
+    init_hash_index(&hash_index);
+    ck_assert_int_eq(hash_index_search(&hash_index, keys, get_key, "Key-0", false, NULL), false);
+
+    for (size_t i = 0; i < 1000; i++) {
+        snprintf(keys[i], sizeof(keys[i]), "Key-%d", (int)i);
+        ck_assert_int_eq(hash_index_add(&hash_index, &arena, keys, get_key, i), 0);
+    }
+    ck_assert_int_ge((int)hash_index.size, 2000);
+
+    for (size_t i = 0; i < 1000; i++) {
+        ck_assert_int_eq(hash_index_search(&hash_index, keys, get_key, keys[i], false, &position), true);
+        ck_assert_int_eq((int)position, (int)i);
+    }
+
+    ck_assert_int_eq(hash_index_search(&hash_index, keys, get_key, "key-42", false, NULL), false);
+    ck_assert_int_eq(hash_index_search(&hash_index, keys, get_key, "key-42", true, &position), true);
+    ck_assert_int_eq((int)position, 42);
+    ck_assert_int_eq(hash_index_search(&hash_index, keys, get_key, "Key-1000", true, NULL), false);
+
+    free_arena(&arena);
+}
+END_TEST
+
+void test_hash_index() { addtest(test_hash_index_search); }
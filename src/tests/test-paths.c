@@ -27,27 +27,35 @@
 #include "setup-tests.h"
 
 START_TEST(test_init_path_set) {
+    arena_t arena;
     path_set_t path_set;
-    init_path_set(&path_set);
+    init_arena(&arena);
+    init_path_set(&path_set, &arena);
     ck_assert_ptr_eq(path_set.paths, NULL);
     ck_assert_int_eq((int)path_set.size, 0);
     free_path_set(&path_set);
+    free_arena(&arena);
 }
 END_TEST
 
 START_TEST(test_free_path_set) {
+    arena_t arena;
     path_set_t path_set;
-    init_path_set(&path_set);
+    init_arena(&arena);
+    init_path_set(&path_set, &arena);
     ck_assert_int_eq(path_set_add_path(&path_set, "/test", type_data), 0);
     free_path_set(&path_set);
     ck_assert_ptr_eq(path_set.paths, NULL);
     ck_assert_int_eq((int)path_set.size, 0);
+    free_arena(&arena);
 }
 END_TEST
 
 START_TEST(test_path_set_add_path) {
+    arena_t arena;
     path_set_t paths;
-    init_path_set(&paths);
+    init_arena(&arena);
+    init_path_set(&paths, &arena);
 
     ck_assert_int_eq(path_set_add_path(&paths, "/test", 10000), -EINVAL);
 
@@ -77,7 +85,13 @@ START_TEST(test_path_set_add_path) {
     ck_assert_str_eq(paths.paths[52]->path, "/");
     ck_assert_int_eq((int)paths.paths[52]->path_type, type_data);
 
+    ck_assert_int_eq(path_set_has_path(&paths, "/test/n40"), true);
+    ck_assert_int_eq(path_set_has_path(&paths, "/test_slash"), true);
+    ck_assert_int_eq(path_set_has_path(&paths, "/TEST"), false);
+    ck_assert_int_eq(path_set_has_path(&paths, "/test/n50"), false);
+
     free_path_set(&paths);
+    free_arena(&arena);
 }
 END_TEST
 
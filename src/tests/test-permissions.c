@@ -19,33 +19,58 @@
 #include "setup-tests.h"
 
 START_TEST(test_init_permission_set) {
+    arena_t arena;
     permission_set_t permission_set;
-    init_permission_set(&permission_set);
+    init_arena(&arena);
+    init_permission_set(&permission_set, &arena);
     ck_assert_ptr_eq(permission_set.permissions, NULL);
     ck_assert_int_eq((int)permission_set.size, 0);
     free_permission_set(&permission_set);
+    free_arena(&arena);
 }
 END_TEST
 
 START_TEST(test_free_permission_set) {
+    arena_t arena;
     permission_set_t permission_set;
-    init_permission_set(&permission_set);
+    init_arena(&arena);
+    init_permission_set(&permission_set, &arena);
     ck_assert_int_eq(permission_set_add_permission(&permission_set, "perm"), 0);
     free_permission_set(&permission_set);
     ck_assert_ptr_eq(permission_set.permissions, NULL);
     ck_assert_int_eq((int)permission_set.size, 0);
+    free_arena(&arena);
 }
 END_TEST
 
 START_TEST(test_permission_set_add_permission) {
+    arena_t arena;
     permission_set_t permission_set;
-    init_permission_set(&permission_set);
+    init_arena(&arena);
+    init_permission_set(&permission_set, &arena);
     ck_assert_int_eq(permission_set_add_permission(&permission_set, "perm"), 0);
     ck_assert_int_eq((int)permission_set.size, 1);
     ck_assert_str_eq(permission_set.permissions[0], "perm");
     ck_assert_int_lt(permission_set_add_permission(&permission_set, "m"), 0);
     ck_assert_int_lt(permission_set_add_permission(&permission_set, ""), 0);
     free_permission_set(&permission_set);
+    free_arena(&arena);
+}
+END_TEST
+
+START_TEST(test_permission_set_has_permission) {
+    arena_t arena;
+    permission_set_t permission_set;
+    init_arena(&arena);
+    init_permission_set(&permission_set, &arena);
+    ck_assert_int_eq(permission_set_has_permission(&permission_set, "perm", false), false);
+    ck_assert_int_eq(permission_set_add_permission(&permission_set, "Perm"), 0);
+    ck_assert_int_eq(permission_set_has_permission(&permission_set, "Perm", false), true);
+    ck_assert_int_eq(permission_set_has_permission(&permission_set, "perm", false), false);
+    ck_assert_int_eq(permission_set_has_permission(&permission_set, "perm", true), true);
+    ck_assert_int_eq(permission_set_has_permission(&permission_set, "perm2", true), false);
+    free_permission_set(&permission_set);
+    free_arena(&arena);
 }
 END_TEST
 
@@ -53,4 +78,5 @@ void test_permissions() {
     addtest(test_init_permission_set);
     addtest(test_free_permission_set);
     addtest(test_permission_set_add_permission);
+    addtest(test_permission_set_has_permission);
 }
@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2020-2021 IoT.bzh Company
+ * Author: Arthur Guyader <arthur.guyader@iot.bzh>
+ *
+ * $RP_BEGIN_LICENSE$
+ * Commercial License Usage
+ *  Licensees holding valid commercial IoT.bzh licenses may use this file in
+ *  accordance with the commercial license agreement provided with the
+ *  Software or, alternatively, in accordance with the terms contained in
+ *  a written agreement between you and The IoT.bzh Company. For licensing terms
+ *  and conditions see https://www.iot.bzh/terms-conditions. For further
+ *  information use the contact form at https://www.iot.bzh/contact.
+ *
+ * GNU General Public License Usage
+ *  Alternatively, this file may be used under the terms of the GNU General
+ *  Public license version 3. This license is as published by the Free Software
+ *  Foundation and appearing in the file LICENSE.GPLv3 included in the packaging
+ *  of this file. Please review the following information to ensure the GNU
+ *  General Public License requirements will be met
+ *  https://www.gnu.org/licenses/gpl-3.0.html.
+ * $RP_END_LICENSE$
+ */
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "../pollitem.c"
+#include "setup-tests.h"
+
+static pollitem_t test_pollitems[2];
+static int test_pollitem_calls[2];
+
+static void test_pollitem_handler(pollitem_t *pollitem, uint32_t events, int pollfd) {
+    int index = (int)(pollitem - test_pollitems);
+    char c;
+
+    (void)events;
+    ck_assert_int_eq((int)read(pollitem->fd, &c, 1), 1);
+    test_pollitem_calls[index]++;
+    /* remove the other pollitem while its event may be pending */
+    pollitem_del(&test_pollitems[!index], pollfd);
+}
+
+START_TEST(test_pollitem_wait_dispatch_batch) {
+    int pollfd, fds[2][2];
+    struct epoll_event events[4];
+
+    pollfd = epoll_create1(EPOLL_CLOEXEC);
+    ck_assert_int_ge(pollfd, 0);
+
+    for (int i = 0; i < 2; i++) {
+        ck_assert_int_eq(socketpair(AF_UNIX, SOCK_STREAM, 0, fds[i]), 0);
+        test_pollitems[i].handler = test_pollitem_handler;
+        test_pollitems[i].fd = fds[i][0];
+        test_pollitem_calls[i] = 0;
+        ck_assert_int_eq(pollitem_add(&test_pollitems[i], EPOLLIN, pollfd), 0);
+        ck_assert_int_eq((int)write(fds[i][1], "x", 1), 1);
+    }
+
+    /* both are received but only the first is dispatched */
+    ck_assert_int_eq(pollitem_wait_dispatch_batch(pollfd, 1000, events, 4), 2);
+    ck_assert_int_eq(test_pollitem_calls[0] + test_pollitem_calls[1], 1);
+
+    /* nothing remains */
+    ck_assert_int_eq(pollitem_wait_dispatch_batch(pollfd, 0, events, 4), 0);
+
+    for (int i = 0; i < 2; i++) {
+        close(fds[i][0]);
+        close(fds[i][1]);
+    }
+    close(pollfd);
+}
+END_TEST
+
+void test_pollitem() { addtest(test_pollitem_wait_dispatch_batch); }
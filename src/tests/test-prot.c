@@ -0,0 +1,184 @@
+/*
+ * Copyright (C) 2020-2021 IoT.bzh Company
+ * Author: Arthur Guyader <arthur.guyader@iot.bzh>
+ *
+ * $RP_BEGIN_LICENSE$
+ * Commercial License Usage
+ *  Licensees holding valid commercial IoT.bzh licenses may use this file in
+ *  accordance with the commercial license agreement provided with the
+ *  Software or, alternatively, in accordance with the terms contained in
+ *  a written agreement between you and The IoT.bzh Company. For licensing terms
+ *  and conditions see https://www.iot.bzh/terms-conditions. For further
+ *  information use the contact form at https://www.iot.bzh/contact.
+ *
+ * GNU General Public License Usage
+ *  Alternatively, this file may be used under the terms of the GNU General
+ *  Public license version 3. This license is as published by the Free Software
+ *  Foundation and appearing in the file LICENSE.GPLv3 included in the packaging
+ *  of this file. Please review the following information to ensure the GNU
+ *  General Public License requirements will be met
+ *  https://www.gnu.org/licenses/gpl-3.0.html.
+ * $RP_END_LICENSE$
+ */
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "../prot.c"
+#include "setup-tests.h"
+
+START_TEST(test_prot_long_record) {
+    prot_t *prot = NULL;
+    const char **fields;
+    static char path[SEC_LSM_MANAGER_MAX_SIZE_PATH];
+    int fds[2], n;
+
+    /* a path longer than the initial buffer, with characters to escape */
+    memset(path, 'a', sizeof(path) - 1);
+    path[0] = '/';
+    path[100] = ' ';
+    path[200] = '\\';
+
+    ck_assert_int_eq(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    ck_assert_int_eq(prot_create(&prot), 0);
+    ck_assert_int_eq(prot_putx(prot, "path", path, "data", NULL), 0);
+    while (prot_should_write(prot)) ck_assert_int_gt(prot_write(prot, fds[1]), 0);
+
+    n = -EAGAIN;
+    while (n == -EAGAIN) {
+        ck_assert_int_gt(prot_read(prot, fds[0]), 0);
+        n = prot_get(prot, &fields);
+    }
+    ck_assert_int_eq(n, 3);
+    ck_assert_str_eq(fields[0], "path");
+    ck_assert_str_eq(fields[1], path);
+    ck_assert_str_eq(fields[2], "data");
+
+    /* the buffer is released once processed */
+    prot_next(prot);
+    ck_assert_int_eq(prot_get(prot, NULL), -EAGAIN);
+    ck_assert_ptr_eq(prot->inbuf.content, NULL);
+    ck_assert_int_eq(prot_should_write(prot), 0);
+    ck_assert_ptr_eq(prot->outq.head, NULL);
+
+    prot_destroy(prot);
+    close(fds[0]);
+    close(fds[1]);
+}
+END_TEST
+
+START_TEST(test_prot_pipelined_records) {
+    prot_t *prot = NULL;
+    const char **fields;
+    char id[32];
+    int fds[2], i, n;
+
+    ck_assert_int_eq(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    ck_assert_int_eq(prot_create(&prot), 0);
+    for (i = 0; i < 1000; i++) {
+        snprintf(id, sizeof(id), "%d", i);
+        ck_assert_int_eq(prot_putx(prot, "id", id, NULL), 0);
+    }
+    while (prot_should_write(prot)) ck_assert_int_gt(prot_write(prot, fds[1]), 0);
+
+    /* records are received in order across the reads */
+    for (i = 0; i < 1000; i++) {
+        while ((n = prot_get(prot, &fields)) == -EAGAIN) ck_assert_int_gt(prot_read(prot, fds[0]), 0);
+        snprintf(id, sizeof(id), "%d", i);
+        ck_assert_int_eq(n, 2);
+        ck_assert_str_eq(fields[1], id);
+        prot_next(prot);
+    }
+    ck_assert_ptr_eq(prot->inbuf.content, NULL);
+
+    /* an empty line after a record of the same read has no field */
+    ck_assert_int_eq(write(fds[1], "a b\n\nc\n", 7), 7);
+    ck_assert_int_gt(prot_read(prot, fds[0]), 0);
+    ck_assert_int_eq(prot_get(prot, &fields), 2);
+    prot_next(prot);
+    ck_assert_int_eq(prot_get(prot, &fields), 0);
+    prot_next(prot);
+    ck_assert_int_eq(prot_get(prot, &fields), 1);
+    ck_assert_str_eq(fields[0], "c");
+    prot_next(prot);
+
+    prot_destroy(prot);
+    close(fds[0]);
+    close(fds[1]);
+}
+END_TEST
+
+START_TEST(test_prot_many_fields) {
+    prot_t *prot = NULL;
+    const char **fields;
+    static const char *sent[1000];
+    static char values[1000][8];
+    int fds[2], i, n;
+
+    for (i = 0; i < 1000; i++) {
+        snprintf(values[i], sizeof(values[i]), "%d", i);
+        sent[i] = values[i];
+    }
+
+    ck_assert_int_eq(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    ck_assert_int_eq(prot_create(&prot), 0);
+    ck_assert_int_eq(prot_put(prot, 1000, sent), 0);
+    while (prot_should_write(prot)) ck_assert_int_gt(prot_write(prot, fds[1]), 0);
+
+    /* the array of fields grows to receive the whole record */
+    while ((n = prot_get(prot, &fields)) == -EAGAIN) ck_assert_int_gt(prot_read(prot, fds[0]), 0);
+    ck_assert_int_eq(n, 1000);
+    for (i = 0; i < 1000; i++) ck_assert_str_eq(fields[i], values[i]);
+    prot_next(prot);
+
+    prot_destroy(prot);
+    close(fds[0]);
+    close(fds[1]);
+}
+END_TEST
+
+START_TEST(test_prot_grow_output) {
+    prot_t *prot = NULL;
+    static char value[MAX_BUFFER_LENGTH];
+    int fds[2], rc;
+
+    memset(value, 'a', sizeof(value) - 1);
+
+    /* the send buffer is full */
+    ck_assert_int_eq(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    ck_assert_int_eq(prot_create(&prot), 0);
+    while ((rc = prot_putx(prot, value, NULL)) == 0) {
+    }
+    ck_assert_int_eq(rc, -ECANCELED);
+    ck_assert_int_eq(prot->outq.count, MAX_OUTPUT_BLOCKS);
+
+    /* it grows for the replies to queue */
+    prot_grow_output(prot);
+    ck_assert_int_eq(prot_putx(prot, value, NULL), 0);
+    ck_assert_int_gt(prot->outq.count, MAX_OUTPUT_BLOCKS);
+
+    /* its limit is restored once written */
+    ck_assert_int_eq(fcntl(fds[1], F_SETFL, O_NONBLOCK), 0);
+    while (prot_should_write(prot)) {
+        rc = prot_write(prot, fds[1]);
+        if (rc == -EAGAIN)
+            ck_assert_int_gt(read(fds[0], value, sizeof(value)), 0);
+        else
+            ck_assert_int_gt(rc, 0);
+    }
+    ck_assert_int_eq(prot->outq.max, MAX_OUTPUT_BLOCKS);
+
+    prot_destroy(prot);
+    close(fds[0]);
+    close(fds[1]);
+}
+END_TEST
+
+void test_prot() {
+    addtest(test_prot_long_record);
+    addtest(test_prot_pipelined_records);
+    addtest(test_prot_many_fields);
+    addtest(test_prot_grow_output);
+}
@@ -130,6 +130,8 @@ START_TEST(test_free_secure_app) {
     free_secure_app(secure_app);
     ck_assert_int_eq((int)secure_app->path_set.size, 0);
     ck_assert_int_eq((int)secure_app->permission_set.size, 0);
+    ck_assert_str_eq(secure_app->id, "");
+    ck_assert_int_eq(secure_app_set_id(secure_app, "id"), 0);
     destroy_secure_app(secure_app);
 }
 END_TEST
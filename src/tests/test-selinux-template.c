@@ -79,7 +79,158 @@ START_TEST(test_generate_app_module_files) {
 }
 END_TEST
 
+START_TEST(test_generate_app_module_cil) {
+    char tmp_dir[SEC_LSM_MANAGER_MAX_SIZE_DIR] = {'\0'};
+    create_tmp_dir(tmp_dir);
+
+    secure_app_t *secure_app = NULL;
+    ck_assert_int_eq(create_secure_app(&secure_app), 0);
+    ck_assert_int_eq(secure_app_set_id(secure_app, TESTID), 0);
+    ck_assert_int_eq(secure_app_add_path(secure_app, "/tmp/data", type_data), 0);
+
+    selinux_module_t selinux_module = {0};
+    path_type_definitions_t path_type_definitions[number_path_type];
+    init_path_type_definitions(path_type_definitions, TESTID_SELINUX);
+
+    snprintf(selinux_module.selinux_cil_template_file, SEC_LSM_MANAGER_MAX_SIZE_PATH, "%s/%s", tmp_dir, "template");
+    snprintf(selinux_module.selinux_cil_file, SEC_LSM_MANAGER_MAX_SIZE_PATH, "%s/%s", tmp_dir, "cilfile");
+    ck_assert_int_lt(generate_app_module_cil(&selinux_module, secure_app, path_type_definitions), 0);
+
+    FILE *f = fopen(selinux_module.selinux_cil_template_file, "w");
+    ck_assert_ptr_ne(f, NULL);
+    fputs("(type {{id_underscore}}_t)\n", f);
+    fclose(f);
+
+    ck_assert_int_eq(generate_app_module_cil(&selinux_module, secure_app, path_type_definitions), 0);
+    char *content = read_file(selinux_module.selinux_cil_file);
+    ck_assert_ptr_ne(content, NULL);
+    ck_assert_str_eq(content, "(type " TESTID_SELINUX "_t)\n"
+                              "(filecon \"/tmp/data(/.*)?\" any (system_u object_r " TESTID_SELINUX
+                              "_data_t ((s0) (s0))))\n");
+    free(content);
+
+    ck_assert_int_eq(secure_app_add_path(secure_app, "/tmp/bad\"path", type_data), 0);
+    ck_assert_int_lt(generate_app_module_cil(&selinux_module, secure_app, path_type_definitions), 0);
+    ck_assert(!check_file_exists(selinux_module.selinux_cil_file));
+
+    destroy_secure_app(secure_app);
+    remove(selinux_module.selinux_cil_template_file);
+    rmdir(tmp_dir);
+}
+END_TEST
+
+START_TEST(test_semanage_session) {
+    semanage_handle_t *first = NULL;
+    semanage_handle_t *second = NULL;
+    bool fresh = false;
+
+    close_semanage_session();
+
+    ck_assert_int_eq(acquire_semanage_session(&first, &fresh), 0);
+    ck_assert(fresh);
+    release_semanage_session(false);
+
+    ck_assert_int_eq(acquire_semanage_session(&second, &fresh), 0);
+    ck_assert(!fresh);
+    ck_assert_ptr_eq(first, second);
+    release_semanage_session(true);
+
+    ck_assert_int_eq(acquire_semanage_session(&second, &fresh), 0);
+    ck_assert(fresh);
+    release_semanage_session(false);
+
+    close_semanage_session();
+}
+END_TEST
+
+START_TEST(test_module_hash) {
+    char tmp_dir[SEC_LSM_MANAGER_MAX_SIZE_DIR] = {'\0'};
+    char file[SEC_LSM_MANAGER_MAX_SIZE_PATH] = {'\0'};
+    create_tmp_dir(tmp_dir);
+
+    selinux_module_t selinux_module = {0};
+    snprintf(selinux_module.selinux_hash_file, SEC_LSM_MANAGER_MAX_SIZE_PATH, "%s/%s", tmp_dir, "hashfile");
+    snprintf(file, SEC_LSM_MANAGER_MAX_SIZE_PATH, "%s/%s", tmp_dir, "source");
+    const char *const sources[] = {file};
+
+    uint64_t hash = 0;
+    uint64_t other = 0;
+    ck_assert_int_lt(hash_module_sources(PP_EXTENSION, 1, sources, 1, &hash), 0);
+
+    FILE *f = fopen(file, "w");
+    ck_assert_ptr_ne(f, NULL);
+    fputs("module " TESTID_SELINUX " 1.0;\n", f);
+    fclose(f);
+
+    ck_assert_int_eq(hash_module_sources(PP_EXTENSION, 1, sources, 1, &hash), 0);
+    ck_assert_int_eq(hash_module_sources(PP_EXTENSION, 1, sources, 1, &other), 0);
+    ck_assert(hash == other);
+    ck_assert_int_eq(hash_module_sources(CIL_EXTENSION, 0, sources, 1, &other), 0);
+    ck_assert(hash != other);
+    // the module compiled against another policy
+    ck_assert_int_eq(hash_module_sources(PP_EXTENSION, 2, sources, 1, &other), 0);
+    ck_assert(hash != other);
+
+    ck_assert(!read_module_hash(&selinux_module, &other));
+    ck_assert_int_eq(write_module_hash(&selinux_module, hash), 0);
+    ck_assert(read_module_hash(&selinux_module, &other));
+    ck_assert(hash == other);
+
+    f = fopen(file, "a");
+    ck_assert_ptr_ne(f, NULL);
+    fputs("type " TESTID_SELINUX "_t;\n", f);
+    fclose(f);
+
+    ck_assert_int_eq(hash_module_sources(PP_EXTENSION, 1, sources, 1, &other), 0);
+    ck_assert(hash != other);
+
+    remove(file);
+    remove(selinux_module.selinux_hash_file);
+    rmdir(tmp_dir);
+}
+END_TEST
+
+START_TEST(test_module_index) {
+    semanage_handle_t *semanage_handle = NULL;
+    bool fresh = false;
+
+    close_semanage_session();
+    ck_assert_int_eq(acquire_semanage_session(&semanage_handle, &fresh), 0);
+
+    ck_assert_int_eq(check_module(semanage_handle, TESTID), 0);
+    ck_assert(module_index.loaded);
+
+    ck_assert_int_eq(set_module_installed(TESTID, true), 0);
+    ck_assert_int_eq(check_module(semanage_handle, TESTID), 1);
+    ck_assert_int_eq(set_module_installed(TESTID, false), 0);
+    ck_assert_int_eq(check_module(semanage_handle, TESTID), 0);
+
+#if defined(SIMULATE_SELINUX)
+    // the index is loaded again after the policy load of another process
+    ck_assert_int_eq(set_module_installed(TESTID, true), 0);
+    policyload++;
+    ck_assert_int_eq(check_module(semanage_handle, TESTID), 0);
+#endif
+
+    // the commits of the daemon update the index
+    commit_request_t install = {.stage = install_module, .arg = "/tmp/" TESTID ".pp", .result = 0, .next = NULL};
+    commit_request_t remove = {.stage = remove_module, .arg = TESTID, .result = 0, .next = NULL};
+    update_module_index(&install);
+    ck_assert_int_eq(check_module(semanage_handle, TESTID), 1);
+    update_module_index(&remove);
+    ck_assert_int_eq(check_module(semanage_handle, TESTID), 0);
+
+    release_semanage_session(false);
+    close_semanage_session();
+    ck_assert(!module_index.loaded);
+}
+END_TEST
+
 void test_selinux_template() {
     addtest(test_generate_app_module_fc);
     addtest(test_generate_app_module_files);
+    addtest(test_generate_app_module_cil);
+    addtest(test_semanage_session);
+    addtest(test_module_hash);
+    addtest(test_module_index);
 }
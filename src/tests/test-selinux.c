@@ -21,6 +21,7 @@
 #include "../selinux-compile.c"
 #endif
 
+#include "../selinux-compile-jobs.c"
 #include "../selinux.c"
 #include "./test-selinux-template.c"
 #include "setup-tests.h"
@@ -31,18 +32,26 @@ START_TEST(test_selinux_process_paths) {
 
     path_type_definitions_t path_type_definitions[number_path_type];
     init_path_type_definitions(path_type_definitions, TESTID);
+    label_count_t labels = {0, 0};
 
     secure_app_t *secure_app = NULL;
     ck_assert_int_eq(create_secure_app(&secure_app), 0);
     ck_assert_int_eq(secure_app_add_path(secure_app, etc_tmp_file, type_id), 0);
 
-    ck_assert_int_eq(selinux_process_paths(secure_app, path_type_definitions), 0);
+    ck_assert_int_eq(selinux_process_paths(secure_app, path_type_definitions, &labels), 0);
 
     ck_assert_int_eq(compare_xattr(etc_tmp_file, XATTR_NAME_SELINUX, "system_u:object_r:testid-binding_t:s0"), true);
+    ck_assert_uint_eq(labels.written, 1);
+    ck_assert_uint_eq(labels.skipped, 0);
+
+    // the label already set is not written again
+    ck_assert_int_eq(selinux_process_paths(secure_app, path_type_definitions, &labels), 0);
+    ck_assert_uint_eq(labels.written, 1);
+    ck_assert_uint_eq(labels.skipped, 1);
 
     ck_assert_int_eq(secure_app_add_path(secure_app, "bad_path", type_id), 0);
 
-    ck_assert_int_eq(selinux_process_paths(secure_app, path_type_definitions), -ENOENT);
+    ck_assert_int_eq(selinux_process_paths(secure_app, path_type_definitions, &labels), -ENOENT);
 
     remove(etc_tmp_file);
 }
@@ -54,6 +63,7 @@ START_TEST(test_selinux_install) {
 
     char data_dir[SEC_LSM_MANAGER_MAX_SIZE_DIR];
     char data_file[SEC_LSM_MANAGER_MAX_SIZE_PATH];
+    char data_nested_file[SEC_LSM_MANAGER_MAX_SIZE_PATH];
     char exec_dir[SEC_LSM_MANAGER_MAX_SIZE_DIR];
     char exec_file[SEC_LSM_MANAGER_MAX_SIZE_PATH];
     char id_dir[SEC_LSM_MANAGER_MAX_SIZE_DIR];
@@ -63,6 +73,7 @@ START_TEST(test_selinux_install) {
 
     snprintf(data_dir, SEC_LSM_MANAGER_MAX_SIZE_DIR, "%s/data/", tmp_dir);
     snprintf(data_file, SEC_LSM_MANAGER_MAX_SIZE_PATH, "%s/data/data_file", tmp_dir);
+    snprintf(data_nested_file, SEC_LSM_MANAGER_MAX_SIZE_PATH, "%s/data/nested_file", tmp_dir);
 
     snprintf(exec_dir, SEC_LSM_MANAGER_MAX_SIZE_DIR, "%s/exec/", tmp_dir);
     snprintf(exec_file, SEC_LSM_MANAGER_MAX_SIZE_PATH, "%s/exec/exec_file", tmp_dir);
@@ -78,15 +89,17 @@ START_TEST(test_selinux_install) {
     ck_assert_int_eq(mkdir(id_dir, 0777), 0);
     ck_assert_int_eq(mkdir(public_dir, 0777), 0);
     ck_assert_int_eq(create_file(data_file), 0);
+    ck_assert_int_eq(create_file(data_nested_file), 0);
     ck_assert_int_eq(create_file(exec_file), 0);
     ck_assert_int_eq(create_file(id_file), 0);
     ck_assert_int_eq(create_file(public_file), 0);
 
     // create secure app
     secure_app_t *secure_app = NULL;
+    label_count_t labels = {0, 0};
     ck_assert_int_eq(create_secure_app(&secure_app), 0);
 
-    ck_assert_int_lt(install_selinux(secure_app), 0);
+    ck_assert_int_lt(install_selinux(secure_app, &labels), 0);
 
     ck_assert_int_eq(secure_app_add_path(secure_app, data_dir, type_data), 0);
     ck_assert_int_eq(secure_app_add_path(secure_app, data_file, type_data), 0);
@@ -99,12 +112,14 @@ START_TEST(test_selinux_install) {
     ck_assert_int_eq(secure_app_add_permission(secure_app, "perm1"), 0);
     ck_assert_int_eq(secure_app_add_permission(secure_app, "perm2"), 0);
     ck_assert_int_eq(secure_app_set_id(secure_app, "testid-binding"), 0);
-    ck_assert_int_eq(install_selinux(secure_app), 0);
+    ck_assert_int_eq(install_selinux(secure_app, &labels), 0);
 
     // test settings
 
     ck_assert_int_eq(compare_xattr(data_dir, XATTR_NAME_SELINUX, "system_u:object_r:testid_binding_data_t:s0"), true);
     ck_assert_int_eq(compare_xattr(data_file, XATTR_NAME_SELINUX, "system_u:object_r:testid_binding_data_t:s0"), true);
+    ck_assert_int_eq(
+        compare_xattr(data_nested_file, XATTR_NAME_SELINUX, "system_u:object_r:testid_binding_data_t:s0"), true);
     ck_assert_int_eq(compare_xattr(exec_dir, XATTR_NAME_SELINUX, "system_u:object_r:testid_binding_exec_t:s0"), true);
     ck_assert_int_eq(compare_xattr(exec_file, XATTR_NAME_SELINUX, "system_u:object_r:testid_binding_exec_t:s0"), true);
     ck_assert_int_eq(compare_xattr(id_dir, XATTR_NAME_SELINUX, "system_u:object_r:testid_binding_t:s0"), true);
@@ -115,6 +130,7 @@ START_TEST(test_selinux_install) {
     ck_assert_int_eq(uninstall_selinux(secure_app), 0);
 
     remove(data_file);
+    remove(data_nested_file);
     remove(exec_file);
     remove(id_file);
     remove(public_file);
@@ -126,7 +142,40 @@ START_TEST(test_selinux_install) {
 }
 END_TEST
 
+START_TEST(test_compile_jobs) {
+    compile_job_t first, second;
+    bool cancelled = false;
+
+    compile_job_submit(&first, NULL);
+    compile_job_submit(&second, &cancelled);
+    ck_assert_int_eq(compile_job_check(&second), 0);
+    ck_assert_int_gt(compile_job_time_left(&second), 0);
+
+    // the first submitted job is installed first
+    ck_assert_int_eq(compile_job_start(&second), 0);
+    compile_job_stop(&second);
+    ck_assert_int_eq(compile_job_wait_turn(&first), 0);
+
+    // the requester of the second job is gone
+    cancelled = true;
+    ck_assert_int_eq(compile_job_check(&second), -ECANCELED);
+    ck_assert_int_eq(compile_job_wait_turn(&second), -ECANCELED);
+    cancelled = false;
+
+    compile_job_end(&first);
+    ck_assert_int_eq(compile_job_wait_turn(&second), 0);
+    compile_job_end(&second);
+    compile_job_end(&second);
+
+    // the order is empty again
+    compile_job_submit(&first, NULL);
+    ck_assert_int_eq(compile_job_wait_turn(&first), 0);
+    compile_job_end(&first);
+}
+END_TEST
+
 void test_selinux() {
     addtest(test_selinux_process_paths);
     addtest(test_selinux_install);
+    addtest(test_compile_jobs);
 }
@@ -0,0 +1,173 @@
+/*
+ * Copyright (C) 2020-2021 IoT.bzh Company
+ * Author: Arthur Guyader <arthur.guyader@iot.bzh>
+ *
+ * $RP_BEGIN_LICENSE$
+ * Commercial License Usage
+ *  Licensees holding valid commercial IoT.bzh licenses may use this file in
+ *  accordance with the commercial license agreement provided with the
+ *  Software or, alternatively, in accordance with the terms contained in
+ *  a written agreement between you and The IoT.bzh Company. For licensing terms
+ *  and conditions see https://www.iot.bzh/terms-conditions. For further
+ *  information use the contact form at https://www.iot.bzh/contact.
+ *
+ * GNU General Public License Usage
+ *  Alternatively, this file may be used under the terms of the GNU General
+ *  Public license version 3. This license is as published by the Free Software
+ *  Foundation and appearing in the file LICENSE.GPLv3 included in the packaging
+ *  of this file. Please review the following information to ensure the GNU
+ *  General Public License requirements will be met
+ *  https://www.gnu.org/licenses/gpl-3.0.html.
+ * $RP_END_LICENSE$
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../prot.h"
+#include "../sec-lsm-manager-protocol.c"
+#include "../sec-lsm-manager-server.c"
+#include "../socket.c"
+#include "setup-tests.h"
+
+#define TEST_SERVER_CHUNK "log\nlog\nlog\nlog\nlog\nlog\nlog\nlog\nlog\nlog\n"
+
+/**
+ * @brief Dispatch the events of the server until none remains
+ */
+static void dispatch_server(sec_lsm_manager_server_t *server) {
+    while (pollitem_wait_dispatch_batch(server->pollfd, 0, server->events, server->max_events) > 0)
+        ;
+}
+
+/**
+ * @brief Count the replies received by a client
+ */
+static long read_replies(int fd) {
+    char buffer[4096];
+    long count = 0;
+    ssize_t n;
+
+    while ((n = recv(fd, buffer, sizeof(buffer), MSG_DONTWAIT)) > 0)
+        for (ssize_t i = 0; i < n; i++) count += buffer[i] == '\n';
+    return count;
+}
+
+START_TEST(test_server_stalled_reader) {
+    char tmp_dir[SEC_LSM_MANAGER_MAX_SIZE_DIR] = {'\0'};
+    char spec[SEC_LSM_MANAGER_MAX_SIZE_PATH] = {'\0'};
+    char reply[16] = {'\0'};
+    sec_lsm_manager_server_t *server = NULL;
+    struct timespec start, stop;
+    long sent = 0, received = 0, elapsed;
+    ssize_t n;
+    int slow, fast, i;
+
+    create_tmp_dir(tmp_dir);
+    snprintf(spec, sizeof(spec), "unix:%s/sock", tmp_dir);
+    ck_assert_int_eq(sec_lsm_manager_server_create(&server, spec), 0);
+
+    slow = socket_open(spec, 0);
+    fast = socket_open(spec, 0);
+    ck_assert_int_ge(slow, 0);
+    ck_assert_int_ge(fast, 0);
+    fcntl(slow, F_SETFL, O_NONBLOCK);
+    dispatch_server(server);
+
+    /* the slow client sends requests without reading the replies until it is blocked */
+    for (;;) {
+        n = write(slow, TEST_SERVER_CHUNK, sizeof(TEST_SERVER_CHUNK) - 1);
+        if (n < 0) {
+            ck_assert_int_eq(errno, EAGAIN);
+            break;
+        }
+        sent += n;
+        dispatch_server(server);
+    }
+
+    /* the fast client is still served immediately */
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    ck_assert_int_eq((int)write(fast, "log\n", 4), 4);
+    for (i = 0; i < 10 && !strchr(reply, '\n'); i++) {
+        ck_assert_int_ge(pollitem_wait_dispatch_batch(server->pollfd, 100, server->events, server->max_events), 0);
+        n = recv(fast, reply, sizeof(reply) - 1, MSG_DONTWAIT);
+        if (n > 0)
+            reply[n] = '\0';
+    }
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+    elapsed = (stop.tv_sec - start.tv_sec) * 1000 + (stop.tv_nsec - start.tv_nsec) / 1000000;
+    ck_assert_str_eq(reply, "done off\n");
+    ck_assert_int_lt(elapsed, 500);
+
+    /* nothing is polled while the slow client doesn't read: no busy loop */
+    ck_assert_int_eq(pollitem_wait_dispatch_batch(server->pollfd, 100, server->events, server->max_events), 0);
+
+    /* the slow client finally gets all its replies */
+    for (i = 0; i < 10000 && received < sent / 4; i++) {
+        received += read_replies(slow);
+        pollitem_wait_dispatch_batch(server->pollfd, 10, server->events, server->max_events);
+    }
+    ck_assert_int_eq(received, sent / 4);
+
+    close(slow);
+    close(fast);
+    dispatch_server(server);
+    sec_lsm_manager_server_destroy(server);
+    unlink(spec + strlen("unix:"));
+    rmdir(tmp_dir);
+}
+END_TEST
+
+START_TEST(test_server_manifest) {
+    char tmp_dir[SEC_LSM_MANAGER_MAX_SIZE_DIR] = {'\0'};
+    char spec[SEC_LSM_MANAGER_MAX_SIZE_PATH] = {'\0'};
+    char reply[512] = {'\0'};
+    const char *requests =
+        "manifest app-id 2 1 /tmp/a data /tmp/b exec urn:AGL:permission::partner:scope-platform\n"
+        "display\n"
+        "manifest other-id 1 0\n";
+    const char *expected =
+        "done\n"
+        "string id app-id\n"
+        "string path /tmp/a data\n"
+        "string path /tmp/b exec\n"
+        "string permission urn:AGL:permission::partner:scope-platform\n"
+        "done\n"
+        "error sec_lsm_manager_handle_manifest\n";
+    sec_lsm_manager_server_t *server = NULL;
+    size_t length = 0;
+    ssize_t n;
+    int fd, i;
+
+    create_tmp_dir(tmp_dir);
+    snprintf(spec, sizeof(spec), "unix:%s/sock", tmp_dir);
+    ck_assert_int_eq(sec_lsm_manager_server_create(&server, spec), 0);
+
+    fd = socket_open(spec, 0);
+    ck_assert_int_ge(fd, 0);
+    ck_assert_int_eq((int)write(fd, requests, strlen(requests)), (int)strlen(requests));
+    for (i = 0; i < 10 && length < strlen(expected); i++) {
+        pollitem_wait_dispatch_batch(server->pollfd, 100, server->events, server->max_events);
+        n = recv(fd, reply + length, sizeof(reply) - 1 - length, MSG_DONTWAIT);
+        if (n > 0)
+            length += (size_t)n;
+    }
+    reply[length] = '\0';
+    ck_assert_str_eq(reply, expected);
+
+    close(fd);
+    dispatch_server(server);
+    sec_lsm_manager_server_destroy(server);
+    unlink(spec + strlen("unix:"));
+    rmdir(tmp_dir);
+}
+END_TEST
+
+void test_server() {
+    addtest(test_server_stalled_reader);
+    addtest(test_server_manifest);
+}
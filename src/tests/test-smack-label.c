@@ -55,4 +55,77 @@ START_TEST(test_init_path_type_definitions) {
 }
 END_TEST
 
-void test_smack_label() { addtest(test_init_path_type_definitions); }
+START_TEST(test_diff_rules) {
+    arena_t arena;
+    smack_rule_set_t loaded, rules;
+    struct smack_accesses *apply = NULL;
+    struct smack_accesses *revert = NULL;
+    char loaded_rules[] = "# comment\n\nSystem App:testid rwxa\nApp:testid System wx\nApp:testid User:Home rx\n";
+    char new_rules[] = "System App:testid rwxa\n  App:testid System rwx\nApp:testid System:Shared rx -\n";
+    char same_rules[] = "App:testid User:Home rx\nApp:testid System wx\nSystem App:testid rwxa\n";
+    char bad_rules[] = "App:testid System\n";
+
+    init_arena(&arena);
+    init_rule_set(&loaded, &arena);
+    ck_assert_int_eq(parse_rules(&loaded, loaded_rules), 0);
+    ck_assert_int_eq(loaded.size, 3);
+    ck_assert_int_eq(smack_accesses_new(&apply), 0);
+    ck_assert_int_eq(smack_accesses_new(&revert), 0);
+
+    // everything is loaded without previous rules
+    ck_assert_int_eq(diff_rules(NULL, &loaded, apply, revert), 3);
+
+    // one changed, one added and one removed
+    init_rule_set(&rules, &arena);
+    ck_assert_int_eq(parse_rules(&rules, new_rules), 0);
+    ck_assert_int_eq(rules.size, 3);
+    ck_assert_int_eq(diff_rules(&loaded, &rules, apply, revert), 3);
+
+    // nothing changed
+    init_rule_set(&rules, &arena);
+    ck_assert_int_eq(parse_rules(&rules, same_rules), 0);
+    ck_assert_int_eq(diff_rules(&loaded, &rules, apply, revert), 0);
+
+    init_rule_set(&rules, &arena);
+    ck_assert_int_eq(parse_rules(&rules, bad_rules), -EINVAL);
+
+    smack_accesses_free(apply);
+    smack_accesses_free(revert);
+    free_arena(&arena);
+}
+END_TEST
+
+START_TEST(test_load_smack_rules) {
+    char tmp_dir[SEC_LSM_MANAGER_MAX_SIZE_PATH];
+    char files[3][SEC_LSM_MANAGER_MAX_SIZE_PATH];
+    const char *contents[3] = {"System App:a rwxa\nApp:a System wx\n", "App:a System rwx\nApp:b _ rx -\n",
+                               "App:c System\n"};
+    const char *names[3] = {"a." SMACK_EXTENSION, "b." SMACK_EXTENSION, "c." SMACK_EXTENSION};
+    smack_load_stats_t stats;
+
+    create_tmp_dir(tmp_dir);
+    for (size_t i = 0; i < 3; i++) {
+        snprintf(files[i], SEC_LSM_MANAGER_MAX_SIZE_PATH, "%s/%s", tmp_dir, names[i]);
+        ck_assert_int_eq(write_file_atomic(files[i], contents[i], strlen(contents[i])), 0);
+    }
+
+    // the invalid file is skipped, the pair of b overrides the one of a
+    setenv("SMACK_LOAD_THREADS", "2", 1);
+    ck_assert_int_lt(load_smack_rules(tmp_dir, &stats), 0);
+    ck_assert_int_eq(stats.files, 2);
+    ck_assert_int_eq(stats.rules, 3);
+    ck_assert_int_eq(stats.duplicates, 1);
+    unsetenv("SMACK_LOAD_THREADS");
+
+    for (size_t i = 0; i < 3; i++) {
+        ck_assert_int_eq(remove_file(files[i]), 0);
+    }
+    ck_assert_int_eq(rmdir(tmp_dir), 0);
+}
+END_TEST
+
+void test_smack_label() {
+    addtest(test_init_path_type_definitions);
+    addtest(test_diff_rules);
+    addtest(test_load_smack_rules);
+}
@@ -19,69 +19,104 @@
 #include "./test-smack-label.c"
 #include "setup-tests.h"
 
+START_TEST(test_open_path) {
+    opened_path_t opened;
+    char tmp_file[SEC_LSM_MANAGER_MAX_SIZE_PATH] = {'\0'};
+    // a regular file is opened for reading
+    create_tmp_file(tmp_file);
+    ck_assert_int_eq(open_path(&opened, tmp_file), 0);
+    ck_assert_int_eq(fcntl(opened.fd, F_GETFL) & O_PATH, 0);
+    close_path(&opened);
+    remove(tmp_file);
+    // a device is never opened
+    ck_assert_int_eq(open_path(&opened, "/dev/null"), 0);
+    ck_assert(S_ISCHR(opened.stat.st_mode));
+    ck_assert_int_eq(fcntl(opened.fd, F_GETFL) & O_PATH, O_PATH);
+    close_path(&opened);
+}
+END_TEST
+
 START_TEST(test_label_file) {
+    opened_path_t opened;
+    label_count_t labels = {0, 0};
     char label[SEC_LSM_MANAGER_MAX_SIZE_LABEL] = {'\0'};
     char tmp_file[SEC_LSM_MANAGER_MAX_SIZE_PATH] = {'\0'};
-    // path and label not set + file not created
-    ck_assert_int_lt(label_file(tmp_file, label), 0);
-    // set label
-    secure_strncpy(label, "label", SEC_LSM_MANAGER_MAX_SIZE_LABEL);
-    ck_assert_int_lt(label_file(tmp_file, label), 0);
+    // path not set + file not created
+    ck_assert_int_eq(open_path(&opened, tmp_file), -EINVAL);
     // create file
     create_tmp_file(tmp_file);
-    ck_assert_int_eq(label_file(tmp_file, label), 0);
-    // set label = ""
-    secure_strncpy(label, "", SEC_LSM_MANAGER_MAX_SIZE_LABEL);
-    ck_assert_int_lt(label_file(tmp_file, label), 0);
+    ck_assert_int_eq(open_path(&opened, tmp_file), 0);
+    // label not set
+    ck_assert_int_lt(label_file(&opened, label, &labels), 0);
+    // set label
+    secure_strncpy(label, "label", SEC_LSM_MANAGER_MAX_SIZE_LABEL);
+    ck_assert_int_eq(label_file(&opened, label, &labels), 0);
+    ck_assert_uint_eq(labels.written, 1);
+    // the label already set is not written again
+    ck_assert_int_eq(label_file(&opened, label, &labels), 0);
+    ck_assert_uint_eq(labels.written, 1);
+    ck_assert_uint_eq(labels.skipped, 1);
+    close_path(&opened);
+    ck_assert_int_eq(opened.fd, -1);
     remove(tmp_file);
 }
 END_TEST
 
 START_TEST(test_label_dir_transmute) {
+    opened_path_t opened;
+    label_count_t labels = {0, 0};
     char path[SEC_LSM_MANAGER_MAX_SIZE_PATH] = {'\0'};
     char tmp_dir[SEC_LSM_MANAGER_MAX_SIZE_DIR] = {'\0'};
     // path not set + dir not created
-    ck_assert_int_eq(label_dir_transmute(tmp_dir), 0);
+    ck_assert_int_eq(open_path(&opened, tmp_dir), -EINVAL);
     // create dir
     create_tmp_dir(tmp_dir);
-    // set path
-    snprintf(path, SEC_LSM_MANAGER_MAX_SIZE_PATH, "%s/test.txt", tmp_dir);
-    ck_assert_int_eq(label_dir_transmute(tmp_dir), 0);
-    ck_assert_int_eq(label_dir_transmute(path), 0);
+    ck_assert_int_eq(open_path(&opened, tmp_dir), 0);
+    ck_assert_int_eq(label_dir_transmute(&opened, &labels), 0);
+    close_path(&opened);
     // create file
+    snprintf(path, SEC_LSM_MANAGER_MAX_SIZE_PATH, "%s/test.txt", tmp_dir);
     ck_assert_int_eq(create_file(path), 0);
-    ck_assert_int_eq(label_dir_transmute(path), 0);
+    ck_assert_int_eq(open_path(&opened, path), 0);
+    ck_assert_int_eq(label_dir_transmute(&opened, &labels), 0);
+    close_path(&opened);
     remove(path);
     rmdir(tmp_dir);
 }
 END_TEST
 
 START_TEST(test_label_exec) {
+    opened_path_t opened;
+    label_count_t labels = {0, 0};
     char path[SEC_LSM_MANAGER_MAX_SIZE_PATH] = {'\0'};
     char label[SEC_LSM_MANAGER_MAX_SIZE_LABEL] = {'\0'};
     char tmp_dir[SEC_LSM_MANAGER_MAX_SIZE_DIR] = {'\0'};
-    // path and label not set + file not created
-    ck_assert_int_eq(label_exec(path, label), 0);
     // create dir
     create_tmp_dir(tmp_dir);
-    // set path
+    // a directory is not labeled exec
+    ck_assert_int_eq(open_path(&opened, tmp_dir), 0);
+    ck_assert_int_eq(label_exec(&opened, label, &labels), 0);
+    close_path(&opened);
+    // set path + file not created
     snprintf(path, 200, "%s/test.bin", tmp_dir);
-    ck_assert_int_eq(label_exec(path, label), 0);
-    // set label
-    secure_strncpy(label, "label", SEC_LSM_MANAGER_MAX_SIZE_LABEL);
-    ck_assert_int_eq(label_exec(path, label), 0);
+    ck_assert_int_eq(open_path(&opened, path), -EINVAL);
     // create file
     ck_assert_int_eq(create_file(path), 0);
-    ck_assert_int_eq(label_exec(path, label), -EINVAL);
+    ck_assert_int_eq(open_path(&opened, path), 0);
+    // set label
+    secure_strncpy(label, "label", SEC_LSM_MANAGER_MAX_SIZE_LABEL);
+    ck_assert_int_eq(label_exec(&opened, label, &labels), -EINVAL);
     // set label with suffix :Exec
     snprintf(label, SEC_LSM_MANAGER_MAX_SIZE_LABEL, "label%s", suffix_exec);
-    ck_assert_int_eq(label_exec(path, label), 0);
+    ck_assert_int_eq(label_exec(&opened, label, &labels), 0);
+    close_path(&opened);
     remove(path);
     rmdir(tmp_dir);
 }
 END_TEST
 
 START_TEST(test_label_path) {
+    label_count_t labels = {0, 0};
     char path[SEC_LSM_MANAGER_MAX_SIZE_PATH] = {'\0'};
     char path2[SEC_LSM_MANAGER_MAX_SIZE_PATH] = {'\0'};
     char label[SEC_LSM_MANAGER_MAX_SIZE_LABEL] = {'\0'};
@@ -89,8 +124,8 @@ START_TEST(test_label_path) {
 
     // path not set + file and dir not created
     secure_strncpy(label, "label", SEC_LSM_MANAGER_MAX_SIZE_LABEL);
-    ck_assert_int_lt(label_path(tmp_dir, label, 0, 1), 0);
-    ck_assert_int_lt(label_path(path, label, 1, 1), 0);
+    ck_assert_int_lt(label_path(tmp_dir, label, 0, 1, &labels), 0);
+    ck_assert_int_lt(label_path(path, label, 1, 1, &labels), 0);
 
     // create dir
     create_tmp_dir(tmp_dir);
@@ -99,22 +134,22 @@ START_TEST(test_label_path) {
     ck_assert_int_eq(create_file(path), 0);
 
     // label dir with label and transmute
-    ck_assert_int_eq(label_path(tmp_dir, label, 0, 1), 0);
+    ck_assert_int_eq(label_path(tmp_dir, label, 0, 1, &labels), 0);
     // label file with label
-    ck_assert_int_eq(label_path(path, label, 0, 0), 0);
+    ck_assert_int_eq(label_path(path, label, 0, 0, &labels), 0);
 
     snprintf(path2, SEC_LSM_MANAGER_MAX_SIZE_PATH, "%s/test.bin", tmp_dir);
     // create file 2
     ck_assert_int_eq(create_file(path2), 0);
 
     // label file 2 with label and executable
-    ck_assert_int_eq(label_path(path2, label, 1, 0), -EINVAL);
+    ck_assert_int_eq(label_path(path2, label, 1, 0, &labels), -EINVAL);
 
     // set label with suffix :Exec
     snprintf(label, SEC_LSM_MANAGER_MAX_SIZE_LABEL, "label%s", suffix_exec);
 
     // label file 2 with label+suffix and executable
-    ck_assert_int_eq(label_path(path2, label, 1, 0), 0);
+    ck_assert_int_eq(label_path(path2, label, 1, 0, &labels), 0);
 
     remove(path);
     remove(path2);
@@ -123,6 +158,7 @@ START_TEST(test_label_path) {
 END_TEST
 
 START_TEST(test_smack_install) {
+    label_count_t labels = {0, 0};
     char tmp_dir[SEC_LSM_MANAGER_MAX_SIZE_DIR] = {'\0'};
     create_tmp_dir(tmp_dir);
 
@@ -170,7 +206,7 @@ START_TEST(test_smack_install) {
     ck_assert_int_eq(secure_app_add_permission(secure_app, "perm1"), 0);
     ck_assert_int_eq(secure_app_add_permission(secure_app, "perm2"), 0);
     ck_assert_int_eq(secure_app_set_id(secure_app, "testid"), 0);
-    ck_assert_int_eq(install_smack(secure_app), 0);
+    ck_assert_int_eq(install_smack(secure_app, &labels), 0);
 
     // test settings
 
@@ -204,6 +240,7 @@ START_TEST(test_smack_install) {
 END_TEST
 
 START_TEST(test_smack_uninstall) {
+    label_count_t labels = {0, 0};
     char tmp_dir[SEC_LSM_MANAGER_MAX_SIZE_DIR] = {'\0'};
     create_tmp_dir(tmp_dir);
 
@@ -221,7 +258,7 @@ START_TEST(test_smack_uninstall) {
     ck_assert_int_eq(secure_app_add_path(secure_app, data_dir, type_data), 0);
     ck_assert_int_eq(secure_app_add_path(secure_app, data_file, type_data), 0);
     ck_assert_int_eq(secure_app_set_id(secure_app, "testid"), 0);
-    ck_assert_int_eq(install_smack(secure_app), 0);
+    ck_assert_int_eq(install_smack(secure_app, &labels), 0);
 
     ck_assert_int_eq(uninstall_smack(secure_app), 0);
 
@@ -236,6 +273,7 @@ END_TEST
 
 void test_smack() {
     // addtest(test_set_smack);
+    addtest(test_open_path);
     addtest(test_label_file);
     addtest(test_label_dir_transmute);
     addtest(test_label_exec);
@@ -0,0 +1,138 @@
+/*
+ * Copyright (C) 2020-2021 IoT.bzh Company
+ * Author: Arthur Guyader <arthur.guyader@iot.bzh>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../secure-app.h"
+#include "../template.h"
+#include "../utils.h"
+#include "setup-tests.h"
+
+#define TEMPLATE "{{! comment }}{{id}} {{id_underscore}}{{#perm}} perm{{^other}} !other{{/other}}{{/perm}}\n"
+
+START_TEST(test_render_template) {
+    char tmp_file[SEC_LSM_MANAGER_MAX_SIZE_PATH];
+    char dest[SEC_LSM_MANAGER_MAX_SIZE_PATH];
+    secure_app_t *secure_app = NULL;
+    char *result = NULL;
+    size_t size = 0;
+
+    ck_assert_int_eq(create_secure_app(&secure_app), 0);
+    ck_assert_int_eq(secure_app_set_id(secure_app, "test-id"), 0);
+    create_tmp_file(tmp_file);
+    ck_assert_int_eq(write_file_atomic(tmp_file, TEMPLATE, strlen(TEMPLATE)), 0);
+
+    ck_assert_int_eq(render_template(tmp_file, secure_app, &result, &size), 0);
+    ck_assert_str_eq(result, "test-id test_id\n");
+    ck_assert_int_eq(size, strlen(result));
+    free(result);
+
+    // compiled once, rendered for each app
+    ck_assert_int_eq(secure_app_add_permission(secure_app, "perm"), 0);
+    ck_assert_int_eq(render_template(tmp_file, secure_app, &result, &size), 0);
+    ck_assert_str_eq(result, "test-id test_id perm !other\n");
+    free(result);
+
+    // a changed file is compiled again
+    ck_assert_int_eq(write_file_atomic(tmp_file, "{{=<% %>=}}<%id%>{{id}}", 23), 0);
+    ck_assert_int_eq(render_template(tmp_file, secure_app, &result, &size), 0);
+    ck_assert_str_eq(result, "test-id{{id}}");
+    free(result);
+
+    snprintf(dest, SEC_LSM_MANAGER_MAX_SIZE_PATH, "%s.out", tmp_file);
+    ck_assert_int_eq(process_template(tmp_file, dest, secure_app), 0);
+    result = read_file(dest);
+    ck_assert_ptr_ne(result, NULL);
+    ck_assert_str_eq(result, "test-id{{id}}");
+    free(result);
+    ck_assert_int_eq(remove_file(dest), 0);
+
+    // invalid templates
+    ck_assert_int_eq(write_file_atomic(tmp_file, "{{#perm}}", 9), 0);
+    ck_assert_int_eq(render_template(tmp_file, secure_app, &result, &size), -EINVAL);
+    ck_assert_int_eq(write_file_atomic(tmp_file, "{{#perm}}{{/other}}", 19), 0);
+    ck_assert_int_eq(render_template(tmp_file, secure_app, &result, &size), -EINVAL);
+    ck_assert_int_eq(write_file_atomic(tmp_file, "{{id", 4), 0);
+    ck_assert_int_eq(render_template(tmp_file, secure_app, &result, &size), -EINVAL);
+
+    ck_assert_int_eq(remove_file(tmp_file), 0);
+    ck_assert_int_lt(render_template(tmp_file, secure_app, &result, &size), 0);
+    destroy_secure_app(secure_app);
+}
+END_TEST
+
+START_TEST(test_watch_templates) {
+    char tmp_dir[SEC_LSM_MANAGER_MAX_SIZE_PATH];
+    char tmp_file[SEC_LSM_MANAGER_MAX_SIZE_PATH];
+    const char *templates[1] = {tmp_file};
+    secure_app_t *secure_app = NULL;
+    char *result = NULL;
+    size_t size = 0;
+
+    ck_assert_int_eq(create_secure_app(&secure_app), 0);
+    ck_assert_int_eq(secure_app_set_id(secure_app, "test-id"), 0);
+    create_tmp_dir(tmp_dir);
+    snprintf(tmp_file, SEC_LSM_MANAGER_MAX_SIZE_PATH, "%s/template", tmp_dir);
+    ck_assert_int_eq(write_file_atomic(tmp_file, "first {{id}}", 12), 0);
+
+    int fd = watch_templates(templates, 1);
+    ck_assert_int_ge(fd, 0);
+    ck_assert_int_eq(read_templates_changes(fd), 0);
+
+    // the watched version is used until it is reloaded
+    ck_assert_int_eq(write_file_atomic(tmp_file, "second {{id}}", 13), 0);
+    ck_assert_int_eq(render_template(tmp_file, secure_app, &result, &size), 0);
+    ck_assert_str_eq(result, "first test-id");
+    free(result);
+
+    struct pollfd pfd = {.fd = fd, .events = POLLIN, .revents = 0};
+    ck_assert_int_eq(poll(&pfd, 1, 1000), 1);
+    ck_assert_int_eq(read_templates_changes(fd), 1);
+    reload_templates();
+    ck_assert_int_eq(render_template(tmp_file, secure_app, &result, &size), 0);
+    ck_assert_str_eq(result, "second test-id");
+    free(result);
+
+    // a template that doesn't compile keeps its previous version
+    ck_assert_int_eq(write_file_atomic(tmp_file, "{{#perm}}", 9), 0);
+    ck_assert_int_eq(poll(&pfd, 1, 1000), 1);
+    ck_assert_int_eq(read_templates_changes(fd), 1);
+    reload_templates();
+    ck_assert_int_eq(render_template(tmp_file, secure_app, &result, &size), 0);
+    ck_assert_str_eq(result, "second test-id");
+    free(result);
+
+    // not watched, the file is checked again
+    unwatch_templates(fd);
+    ck_assert_int_eq(render_template(tmp_file, secure_app, &result, &size), -EINVAL);
+
+    ck_assert_int_eq(remove_file(tmp_file), 0);
+    ck_assert_int_eq(rmdir(tmp_dir), 0);
+    destroy_secure_app(secure_app);
+}
+END_TEST
+
+void test_template() {
+    addtest(test_render_template);
+    addtest(test_watch_templates);
+}
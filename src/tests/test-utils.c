@@ -79,9 +79,59 @@ START_TEST(test_remove_file) {
 }
 END_TEST
 
+START_TEST(test_write_file_atomic) {
+    char tmp_dir[SEC_LSM_MANAGER_MAX_SIZE_DIR] = {'\0'};
+    char path[SEC_LSM_MANAGER_MAX_SIZE_PATH] = {'\0'};
+    create_tmp_dir(tmp_dir);
+    snprintf(path, SEC_LSM_MANAGER_MAX_SIZE_PATH, "%s/file", tmp_dir);
+    ck_assert_int_eq(write_file_atomic(path, "first", 5), 0);
+    char *content = read_file(path);
+    ck_assert_str_eq(content, "first");
+    free(content);
+    // replaced without temporary file left
+    ck_assert_int_eq(write_file_atomic(path, "second", 6), 0);
+    content = read_file(path);
+    ck_assert_str_eq(content, "second");
+    free(content);
+    ck_assert_int_eq(remove_file(path), 0);
+    ck_assert_int_eq(rmdir(tmp_dir), 0);
+    // directory not existing
+    ck_assert_int_lt(write_file_atomic(path, "third", 5), 0);
+}
+END_TEST
+
+START_TEST(test_prepare_file_atomic) {
+    char tmp_dir[SEC_LSM_MANAGER_MAX_SIZE_DIR] = {'\0'};
+    char path[SEC_LSM_MANAGER_MAX_SIZE_PATH] = {'\0'};
+    atomic_file_t file;
+    create_tmp_dir(tmp_dir);
+    snprintf(path, SEC_LSM_MANAGER_MAX_SIZE_PATH, "%s/file", tmp_dir);
+    ck_assert_int_eq(write_file_atomic(path, "first", 5), 0);
+    // the file keeps its content until the commit
+    ck_assert_int_eq(prepare_file_atomic(&file, path, "second", 6), 0);
+    char *content = read_file(path);
+    ck_assert_str_eq(content, "first");
+    free(content);
+    ck_assert_int_eq(commit_file_atomic(&file), 0);
+    content = read_file(path);
+    ck_assert_str_eq(content, "second");
+    free(content);
+    // an aborted write leaves the file and no temporary file
+    ck_assert_int_eq(prepare_file_atomic(&file, path, "third", 5), 0);
+    abort_file_atomic(&file);
+    content = read_file(path);
+    ck_assert_str_eq(content, "second");
+    free(content);
+    ck_assert_int_eq(remove_file(path), 0);
+    ck_assert_int_eq(rmdir(tmp_dir), 0);
+}
+END_TEST
+
 void test_utils() {
     addtest(test_check_file_exists);
     addtest(test_check_file_type);
     addtest(test_check_executable);
     addtest(test_remove_file);
+    addtest(test_write_file_atomic);
+    addtest(test_prepare_file_atomic);
 }
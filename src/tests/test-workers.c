@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2020-2021 IoT.bzh Company
+ * Author: Arthur Guyader <arthur.guyader@iot.bzh>
+ *
+ * $RP_BEGIN_LICENSE$
+ * Commercial License Usage
+ *  Licensees holding valid commercial IoT.bzh licenses may use this file in
+ *  accordance with the commercial license agreement provided with the
+ *  Software or, alternatively, in accordance with the terms contained in
+ *  a written agreement between you and The IoT.bzh Company. For licensing terms
+ *  and conditions see https://www.iot.bzh/terms-conditions. For further
+ *  information use the contact form at https://www.iot.bzh/contact.
+ *
+ * GNU General Public License Usage
+ *  Alternatively, this file may be used under the terms of the GNU General
+ *  Public license version 3. This license is as published by the Free Software
+ *  Foundation and appearing in the file LICENSE.GPLv3 included in the packaging
+ *  of this file. Please review the following information to ensure the GNU
+ *  General Public License requirements will be met
+ *  https://www.gnu.org/licenses/gpl-3.0.html.
+ * $RP_END_LICENSE$
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#include "../pollitem.h"
+#include "../workers.c"
+#include "setup-tests.h"
+
+#define TEST_WORKERS_JOBS 50
+
+struct test_job {
+    int index;
+    int run;
+    pthread_t thread;
+};
+
+static int test_workers_done[TEST_WORKERS_JOBS];
+static int test_workers_ndone;
+
+static void test_job_run(void *closure) {
+    struct test_job *job = closure;
+    job->run = 1;
+    job->thread = pthread_self();
+}
+
+static void test_job_done(void *closure) {
+    struct test_job *job = closure;
+    test_workers_done[test_workers_ndone++] = job->index;
+}
+
+START_TEST(test_workers_create) {
+    workers_t *workers = NULL;
+    int pollfd = epoll_create1(EPOLL_CLOEXEC);
+    ck_assert_int_ge(pollfd, 0);
+
+    ck_assert_int_eq(workers_create(&workers, 0, pollfd), -EINVAL);
+    ck_assert_int_eq(workers_create(&workers, 4, pollfd), 0);
+    ck_assert_ptr_ne(workers, NULL);
+    workers_destroy(workers);
+    close(pollfd);
+}
+END_TEST
+
+START_TEST(test_workers_queue) {
+    workers_t *workers = NULL;
+    struct test_job jobs[TEST_WORKERS_JOBS];
+    int pollfd = epoll_create1(EPOLL_CLOEXEC);
+    ck_assert_int_ge(pollfd, 0);
+    ck_assert_int_eq(workers_create(&workers, 1, pollfd), 0);
+
+    test_workers_ndone = 0;
+    for (int i = 0; i < TEST_WORKERS_JOBS; i++) {
+        jobs[i].index = i;
+        jobs[i].run = 0;
+        ck_assert_int_eq(workers_queue(workers, test_job_run, test_job_done, &jobs[i]), 0);
+    }
+
+    /* done callbacks are called in the polling thread in submission order */
+    while (test_workers_ndone < TEST_WORKERS_JOBS) ck_assert_int_ge(pollitem_wait_dispatch(pollfd, 5000), 1);
+
+    for (int i = 0; i < TEST_WORKERS_JOBS; i++) {
+        ck_assert_int_eq(jobs[i].run, 1);
+        ck_assert_int_eq(pthread_equal(jobs[i].thread, pthread_self()), 0);
+        ck_assert_int_eq(test_workers_done[i], i);
+    }
+
+    workers_destroy(workers);
+    close(pollfd);
+}
+END_TEST
+
+void test_workers() {
+    addtest(test_workers_create);
+    addtest(test_workers_queue);
+}
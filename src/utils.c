@@ -38,6 +38,169 @@
 
 static const size_t BLOCKSIZE = 8192;
 
+/***********************/
+/*** PRIVATE METHODS ***/
+/***********************/
+
+/**
+ * @brief Check if the value read from an attribute is the label
+ * The value read can end with a nul, as the kernel stores some labels
+ *
+ * @param[in] current the value read
+ * @param[in] length the length of the value read or a negative value on error
+ * @param[in] value the label
+ * @param[in] size the length of the label
+ * @return true if the attribute holds the label
+ */
+__wur static bool is_same_label(const char *current, ssize_t length, const char *value, size_t size) {
+    if (length < 0 || (size_t)length < size || (size_t)length > size + 1)
+        return false;
+    if ((size_t)length == size + 1 && current[size] != '\0')
+        return false;
+    return memcmp(current, value, size) == 0;
+}
+
+/**
+ * @brief Get the directory of a path
+ *
+ * @param[in] path the path
+ * @param[out] dir the directory of the path
+ * @param[in] size the size of dir
+ * @return 0 in case of success or a negative -errno value
+ */
+__nonnull() __wur static int get_dir(const char *path, char *dir, size_t size) {
+    const char *slash = strrchr(path, '/');
+
+    if (slash == NULL)
+        return snprintf(dir, size, ".") >= (int)size ? -ENAMETOOLONG : 0;
+    if (slash == path)
+        slash++;
+    if ((size_t)(slash - path) >= size)
+        return -ENAMETOOLONG;
+    memcpy(dir, path, (size_t)(slash - path));
+    dir[slash - path] = '\0';
+    return 0;
+}
+
+/**
+ * @brief Open a temporary file to write the content of 'path'
+ * The file is created unnamed in the directory of 'path' (O_TMPFILE) so that
+ * no partial content is ever visible in that directory. When the filesystem
+ * does not support it, a named temporary file is created and its path is
+ * returned in tmp_path, otherwise tmp_path is empty.
+ *
+ * @param[in] path the path of the file
+ * @param[out] tmp_path the path of the named temporary file or empty
+ * @param[in] size the size of tmp_path
+ * @return the file descriptor or a negative -errno value
+ */
+__nonnull() __wur static int open_tmp_file(const char *path, char *tmp_path, size_t size) {
+    int fd = -1;
+    int rc = get_dir(path, tmp_path, size);
+    if (rc >= 0) {
+        fd = open(tmp_path, O_TMPFILE | O_WRONLY | O_CLOEXEC, 0644);
+        rc = fd < 0 ? -errno : 0;
+    }
+    tmp_path[0] = '\0';
+    if (rc != -EOPNOTSUPP && rc != -EISDIR)
+        return fd >= 0 ? fd : rc;
+
+    if (snprintf(tmp_path, size, "%s.XXXXXX", path) >= (int)size) {
+        tmp_path[0] = '\0';
+        return -ENAMETOOLONG;
+    }
+    fd = mkostemp(tmp_path, O_CLOEXEC);
+    if (fd < 0) {
+        rc = -errno;
+        tmp_path[0] = '\0';
+        return rc;
+    }
+    if (fchmod(fd, 0644) < 0) {
+        rc = -errno;
+        close(fd);
+        unlink(tmp_path);
+        tmp_path[0] = '\0';
+        return rc;
+    }
+    return fd;
+}
+
+/**
+ * @brief Write and sync the whole content in a file
+ *
+ * @param[in] fd the file descriptor
+ * @param[in] data the content
+ * @param[in] size the size of the content
+ * @return 0 in case of success or a negative -errno value
+ */
+__wur static int write_all(int fd, const char *data, size_t size) {
+    size_t pos = 0;
+
+    while (pos < size) {
+        ssize_t len = write(fd, data + pos, size - pos);
+        if (len < 0) {
+            if (errno == EINTR)
+                continue;
+            return -errno;
+        }
+        pos += (size_t)len;
+    }
+    return fsync(fd) < 0 ? -errno : 0;
+}
+
+/**
+ * @brief Give a name to an unnamed temporary file, beside 'path'
+ * It is only named once complete and synced, to be renamed over 'path'
+ * (linkat cannot replace an existing file).
+ *
+ * @param[in] fd the file descriptor of the temporary file
+ * @param[in] path the path of the file
+ * @param[in,out] tmp_path the path of the temporary file, set if empty
+ * @param[in] size the size of tmp_path
+ * @return 0 in case of success or a negative -errno value
+ */
+__nonnull() __wur static int link_tmp_file(int fd, const char *path, char *tmp_path, size_t size) {
+    char fd_path[32];
+
+    if (tmp_path[0])
+        return 0;
+
+    snprintf(fd_path, sizeof(fd_path), "/proc/self/fd/%d", fd);
+    if (snprintf(tmp_path, size, "%s.%d.%d", path, (int)getpid(), fd) >= (int)size) {
+        tmp_path[0] = '\0';
+        return -ENAMETOOLONG;
+    }
+    // a stale name left by a crash is replaced
+    if (linkat(AT_FDCWD, fd_path, AT_FDCWD, tmp_path, AT_SYMLINK_FOLLOW) < 0 &&
+        (errno != EEXIST || unlink(tmp_path) < 0 ||
+         linkat(AT_FDCWD, fd_path, AT_FDCWD, tmp_path, AT_SYMLINK_FOLLOW) < 0)) {
+        int rc = -errno;
+        tmp_path[0] = '\0';
+        return rc;
+    }
+    return 0;
+}
+
+/**
+ * @brief Sync the directory of a path, so that its entries survive a power loss
+ *
+ * @param[in] path the path
+ * @return 0 in case of success or a negative -errno value
+ */
+__nonnull() __wur static int sync_dir(const char *path) {
+    char dir[SEC_LSM_MANAGER_MAX_SIZE_PATH];
+    int rc = get_dir(path, dir, sizeof(dir));
+    if (rc < 0)
+        return rc;
+
+    int fd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0)
+        return -errno;
+    rc = fsync(fd) < 0 ? -errno : 0;
+    close(fd);
+    return rc;
+}
+
 /**********************/
 /*** PUBLIC METHODS ***/
 /**********************/
@@ -68,15 +231,65 @@ bool valid_label(const char *s) {
 }
 
 /* see utils.h */
-int set_label(const char *path, const char *xattr, const char *value) {
-    int rc = lsetxattr(path, xattr, value, strlen(value), 0);
+int set_label(const char *path, const char *xattr, const char *value, label_count_t *count) {
+    size_t size = strlen(value);
+    if (get_env_flag("LABEL_COMPARE", LABEL_COMPARE)) {
+        char *current = alloca(size + 1);
+        if (is_same_label(current, lgetxattr(path, xattr, current, size + 1), value, size)) {
+            DEBUG("%s=%s already on %s", xattr, value, path);
+            if (count)
+                count->skipped++;
+            return 0;
+        }
+    }
+
+    int rc = lsetxattr(path, xattr, value, size, 0);
     if (rc < 0) {
         rc = -errno;
-        ERROR("lsetxattr('%s','%s','%s',%ld,%d) : %d %s", path, xattr, value, strlen(value), 0, -rc, strerror(-rc));
+        ERROR("lsetxattr('%s','%s','%s',%ld,%d) : %d %s", path, xattr, value, size, 0, -rc, strerror(-rc));
         return rc;
     }
 
     DEBUG("set %s=%s on %s", xattr, value, path);
+    if (count)
+        count->written++;
+
+    return 0;
+}
+
+/* see utils.h */
+int set_label_fd(int fd, const char *xattr, const char *value, label_count_t *count) {
+    char path[32];
+    size_t size = strlen(value);
+
+    // when opened with O_PATH, the magic link leads to the opened file, even a symbolic link
+    snprintf(path, sizeof(path), "/proc/self/fd/%d", fd);
+
+    if (get_env_flag("LABEL_COMPARE", LABEL_COMPARE)) {
+        char *current = alloca(size + 1);
+        ssize_t length = fgetxattr(fd, xattr, current, size + 1);
+        if (length < 0 && errno == EBADF)
+            length = getxattr(path, xattr, current, size + 1);
+        if (is_same_label(current, length, value, size)) {
+            DEBUG("%s=%s already on fd %d", xattr, value, fd);
+            if (count)
+                count->skipped++;
+            return 0;
+        }
+    }
+
+    int rc = fsetxattr(fd, xattr, value, size, 0);
+    if (rc < 0 && errno == EBADF)
+        rc = setxattr(path, xattr, value, size, 0);
+    if (rc < 0) {
+        rc = -errno;
+        ERROR("setxattr('%s','%s','%s',%ld,%d) : %d %s", path, xattr, value, size, 0, -rc, strerror(-rc));
+        return rc;
+    }
+
+    DEBUG("set %s=%s on fd %d", xattr, value, fd);
+    if (count)
+        count->written++;
 
     return 0;
 }
@@ -160,6 +373,85 @@ int remove_file(const char *path) {
     return 0;
 }
 
+/* see utils.h */
+int write_file_atomic(const char *path, const char *data, size_t size) {
+    atomic_file_t file;
+
+    int rc = prepare_file_atomic(&file, path, data, size);
+    if (rc < 0)
+        return rc;
+    return commit_file_atomic(&file);
+}
+
+/* see utils.h */
+int prepare_file_atomic(atomic_file_t *file, const char *path, const char *data, size_t size) {
+    file->fd = -1;
+    file->tmp_path[0] = '\0';
+    if (strlen(path) >= sizeof(file->path)) {
+        ERROR("path too long : %s", path);
+        return -ENAMETOOLONG;
+    }
+    secure_strncpy(file->path, path, sizeof(file->path));
+
+    file->fd = open_tmp_file(path, file->tmp_path, sizeof(file->tmp_path));
+    if (file->fd < 0) {
+        ERROR("open_tmp_file %s : %d %s", path, -file->fd, strerror(-file->fd));
+        return file->fd;
+    }
+
+    int rc = write_all(file->fd, data, size);
+    if (rc < 0) {
+        ERROR("write_all %s : %d %s", path, -rc, strerror(-rc));
+        abort_file_atomic(file);
+        return rc;
+    }
+    return 0;
+}
+
+/* see utils.h */
+int commit_file_atomic(atomic_file_t *file) {
+    int rc = link_tmp_file(file->fd, file->path, file->tmp_path, sizeof(file->tmp_path));
+    if (rc < 0) {
+        ERROR("link_tmp_file %s : %d %s", file->path, -rc, strerror(-rc));
+        goto error;
+    }
+
+    rc = close(file->fd) < 0 ? -errno : 0;
+    file->fd = -1;
+    if (rc < 0) {
+        ERROR("close %s : %d %s", file->tmp_path, -rc, strerror(-rc));
+        goto error;
+    }
+
+    if (rename(file->tmp_path, file->path) < 0) {
+        rc = -errno;
+        ERROR("rename %s -> %s : %d %s", file->tmp_path, file->path, -rc, strerror(-rc));
+        goto error;
+    }
+    file->tmp_path[0] = '\0';
+
+    // the file is in place even if not yet durable
+    rc = sync_dir(file->path);
+    if (rc < 0) {
+        ERROR("sync_dir %s : %d %s", file->path, -rc, strerror(-rc));
+    }
+    return 0;
+
+error:
+    abort_file_atomic(file);
+    return rc;
+}
+
+/* see utils.h */
+void abort_file_atomic(atomic_file_t *file) {
+    if (file->fd >= 0)
+        close(file->fd);
+    file->fd = -1;
+    if (file->tmp_path[0])
+        unlink(file->tmp_path);
+    file->tmp_path[0] = '\0';
+}
+
 /* see utils.h */
 char *read_file(const char *filename) {
     int f;
@@ -222,3 +514,19 @@ end2:
 end:
     return result;
 }
+
+/* see utils.h */
+unsigned get_env_count(const char *name, long value) {
+    const char *string = secure_getenv(name);
+    long count = string ? strtol(string, NULL, 10) : value;
+    if (count <= 0) {
+        count = sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    return count > 0 ? (unsigned)count : 1;
+}
+
+/* see utils.h */
+bool get_env_flag(const char *name, bool value) {
+    const char *string = secure_getenv(name);
+    return string ? strcmp(string, "0") != 0 : value;
+}
@@ -30,6 +30,27 @@
 
 #include "limits.h"
 
+#if !defined(LABEL_COMPARE)
+#define LABEL_COMPARE 1
+#endif
+
+/**
+ * @brief Count of the labels of an install
+ */
+typedef struct label_count {
+    unsigned written; /**< labels written */
+    unsigned skipped; /**< labels already set, not written again */
+} label_count_t;
+
+/**
+ * @brief File whose content is written but not yet put in place
+ */
+typedef struct atomic_file {
+    int fd;                                            /**< descriptor of the temporary file */
+    char path[SEC_LSM_MANAGER_MAX_SIZE_PATH];          /**< path of the file */
+    char tmp_path[SEC_LSM_MANAGER_MAX_SIZE_PATH + 24]; /**< path of the temporary file or empty if unnamed */
+} atomic_file_t;
+
 extern char *secure_strncpy(char *dest, const char *src, size_t n) __nonnull((1, 2));
 
 /**
@@ -41,13 +62,30 @@ extern bool valid_label(const char *s) __wur __nonnull();
 
 /**
  * @brief Set label attr on file
+ * Unless disabled by LABEL_COMPARE, the attribute is only written when its value differs
  *
  * @param[in] path the path of the file
  * @param[in] xattr name of the extended attribute
  * @param[in] value value of the extended attribute
+ * @param[in,out] count the count of labels written or skipped (can be NULL)
+ * @return 0 in case of success or a negative -errno value
+ */
+extern int set_label(const char *path, const char *xattr, const char *value, label_count_t *count) __wur
+    __nonnull((1, 2, 3));
+
+/**
+ * @brief Set label attr on an opened file
+ * fsetxattr refuses O_PATH descriptors, their attribute is set through /proc/self/fd.
+ * Unless disabled by LABEL_COMPARE, the attribute is only written when its value differs
+ *
+ * @param[in] fd the descriptor of the file
+ * @param[in] xattr name of the extended attribute
+ * @param[in] value value of the extended attribute
+ * @param[in,out] count the count of labels written or skipped (can be NULL)
  * @return 0 in case of success or a negative -errno value
  */
-extern int set_label(const char *path, const char *xattr, const char *value) __wur __nonnull();
+extern int set_label_fd(int fd, const char *xattr, const char *value, label_count_t *count) __wur
+    __nonnull((2, 3));
 
 /**
  * @brief Check if file exists
@@ -93,6 +131,49 @@ extern int create_file(const char *path) __wur __nonnull();
  */
 extern int remove_file(const char *path) __wur __nonnull();
 
+/**
+ * @brief Write a file atomically
+ * The content is written and synced in an unnamed temporary file of the directory
+ * (O_TMPFILE), that is then linked beside the file and renamed over it. The file is
+ * never seen partially written and no partial temporary file is left by a crash.
+ * The directory is synced so that the replacement survives a power loss.
+ *
+ * @param[in] path The path of the file
+ * @param[in] data The content to write
+ * @param[in] size The size of the content
+ * @return 0 in case of success or a negative -errno value
+ */
+extern int write_file_atomic(const char *path, const char *data, size_t size) __wur __nonnull();
+
+/**
+ * @brief Write the content of a file atomically without putting it in place
+ * The content is written and synced like by write_file_atomic, the file keeps
+ * its previous content until commit_file_atomic, the write is dropped by
+ * abort_file_atomic.
+ *
+ * @param[out] file The file written
+ * @param[in] path The path of the file
+ * @param[in] data The content to write
+ * @param[in] size The size of the content
+ * @return 0 in case of success or a negative -errno value
+ */
+extern int prepare_file_atomic(atomic_file_t *file, const char *path, const char *data, size_t size) __wur __nonnull();
+
+/**
+ * @brief Put in place the content written by prepare_file_atomic
+ *
+ * @param[in] file The file written
+ * @return 0 in case of success or a negative -errno value
+ */
+extern int commit_file_atomic(atomic_file_t *file) __wur __nonnull();
+
+/**
+ * @brief Drop the content written by prepare_file_atomic
+ *
+ * @param[in] file The file written
+ */
+extern void abort_file_atomic(atomic_file_t *file) __nonnull();
+
 /**
  * @brief Read content of a file
  *
@@ -101,4 +182,23 @@ extern int remove_file(const char *path) __wur __nonnull();
  */
 extern char *read_file(const char *path);
 
+/**
+ * @brief Get a count from an environment variable
+ * A count of 0 or less means the count of online processors
+ *
+ * @param[in] name the name of the environment variable
+ * @param[in] value the count when the variable is not set
+ * @return the count, at least 1
+ */
+extern unsigned get_env_count(const char *name, long value) __wur __nonnull();
+
+/**
+ * @brief Get a flag from an environment variable, set by any value but "0"
+ *
+ * @param[in] name the name of the environment variable
+ * @param[in] value the flag when the variable is not set
+ * @return the flag
+ */
+extern bool get_env_flag(const char *name, bool value) __wur __nonnull();
+
 #endif
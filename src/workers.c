@@ -0,0 +1,302 @@
+/*
+ * Copyright (C) 2018-2021 IoT.bzh Company
+ * Author: José Bollo <jose.bollo@iot.bzh>
+ * Author: Arthur Guyader <arthur.guyader@iot.bzh>
+ *
+ * $RP_BEGIN_LICENSE$
+ * Commercial License Usage
+ *  Licensees holding valid commercial IoT.bzh licenses may use this file in
+ *  accordance with the commercial license agreement provided with the
+ *  Software or, alternatively, in accordance with the terms contained in
+ *  a written agreement between you and The IoT.bzh Company. For licensing terms
+ *  and conditions see https://www.iot.bzh/terms-conditions. For further
+ *  information use the contact form at https://www.iot.bzh/contact.
+ *
+ * GNU General Public License Usage
+ *  Alternatively, this file may be used under the terms of the GNU General
+ *  Public license version 3. This license is as published by the Free Software
+ *  Foundation and appearing in the file LICENSE.GPLv3 included in the packaging
+ *  of this file. Please review the following information to ensure the GNU
+ *  General Public License requirements will be met
+ *  https://www.gnu.org/licenses/gpl-3.0.html.
+ * $RP_END_LICENSE$
+ */
+
+#include "workers.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "log.h"
+#include "pollitem.h"
+
+typedef struct job job_t;
+
+/** structure that represents a queued job */
+struct job {
+    /** next job of the list */
+    job_t *next;
+
+    /** function called in a worker thread */
+    void (*run)(void *closure);
+
+    /** function called in the main loop */
+    void (*done)(void *closure);
+
+    /** closure of the callbacks */
+    void *closure;
+};
+
+/** structure for pool of workers */
+struct workers {
+    /** lock of the lists */
+    pthread_mutex_t mutex;
+
+    /** condition signaling new jobs */
+    pthread_cond_t cond;
+
+    /** jobs waiting for a worker */
+    job_t *todo;
+
+    /** jobs run, waiting for their done callback */
+    job_t *finished;
+
+    /** tail of the finished list (keeps the completion order) */
+    job_t **finished_tail;
+
+    /** the threads */
+    pthread_t *threads;
+
+    /** number of started threads */
+    unsigned count;
+
+    /** are the threads stopping ? */
+    bool stopping;
+
+    /** the pollfd to use */
+    int pollfd;
+
+    /** eventfd polled for completions */
+    pollitem_t pollitem;
+};
+
+/***********************/
+/*** PRIVATE METHODS ***/
+/***********************/
+
+/**
+ * @brief Main routine of the worker threads
+ *
+ * @param[in] arg the pool of workers
+ * @return NULL
+ */
+static void *worker_main(void *arg) {
+    workers_t *workers = arg;
+    job_t *job;
+    uint64_t one = 1;
+    ssize_t rc;
+
+    pthread_mutex_lock(&workers->mutex);
+    for (;;) {
+        while (!workers->stopping && !workers->todo) pthread_cond_wait(&workers->cond, &workers->mutex);
+        if (workers->stopping)
+            break;
+
+        /* pick the first job */
+        job = workers->todo;
+        workers->todo = job->next;
+        pthread_mutex_unlock(&workers->mutex);
+
+        job->run(job->closure);
+
+        /* record its completion and wake up the main loop */
+        pthread_mutex_lock(&workers->mutex);
+        job->next = NULL;
+        *workers->finished_tail = job;
+        workers->finished_tail = &job->next;
+        do {
+            rc = write(workers->pollitem.fd, &one, sizeof(one));
+        } while (rc < 0 && errno == EINTR);
+    }
+    pthread_mutex_unlock(&workers->mutex);
+    return NULL;
+}
+
+/**
+ * @brief Call the done callbacks of the finished jobs
+ *
+ * @param[in] pollitem pollitem of the eventfd
+ * @param[in] events events receive
+ * @param[in] pollfd pollfd of the main loop
+ */
+static void on_workers_event(pollitem_t *pollitem, uint32_t events, int pollfd) {
+    workers_t *workers = pollitem->closure;
+    job_t *job, *next;
+    uint64_t value;
+    ssize_t rc;
+
+    (void)pollfd;
+
+    if (!(events & EPOLLIN))
+        return;
+
+    do {
+        rc = read(pollitem->fd, &value, sizeof(value));
+    } while (rc < 0 && errno == EINTR);
+
+    /* detach the finished jobs */
+    pthread_mutex_lock(&workers->mutex);
+    job = workers->finished;
+    workers->finished = NULL;
+    workers->finished_tail = &workers->finished;
+    pthread_mutex_unlock(&workers->mutex);
+
+    while (job) {
+        next = job->next;
+        job->done(job->closure);
+        free(job);
+        job = next;
+    }
+}
+
+/**
+ * @brief Free a list of jobs
+ *
+ * @param[in] job the head of the list
+ */
+static void free_jobs(job_t *job) {
+    job_t *next;
+    while (job) {
+        next = job->next;
+        free(job);
+        job = next;
+    }
+}
+
+/**********************/
+/*** PUBLIC METHODS ***/
+/**********************/
+
+/* see workers.h */
+int workers_create(workers_t **workers, unsigned count, int pollfd) {
+    int rc = 0;
+    unsigned i;
+
+    if (count == 0) {
+        rc = -EINVAL;
+        goto ret;
+    }
+
+    *workers = calloc(1, sizeof(**workers));
+    if (*workers == NULL) {
+        rc = -ENOMEM;
+        goto ret;
+    }
+
+    pthread_mutex_init(&(*workers)->mutex, NULL);
+    pthread_cond_init(&(*workers)->cond, NULL);
+    (*workers)->finished_tail = &(*workers)->finished;
+    (*workers)->pollfd = pollfd;
+
+    (*workers)->pollitem.fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if ((*workers)->pollitem.fd < 0) {
+        rc = -errno;
+        ERROR("eventfd : %d %s", -rc, strerror(-rc));
+        goto error1;
+    }
+
+    (*workers)->pollitem.handler = on_workers_event;
+    (*workers)->pollitem.closure = *workers;
+    rc = pollitem_add(&(*workers)->pollitem, EPOLLIN, pollfd);
+    if (rc < 0) {
+        rc = -errno;
+        ERROR("pollitem_add eventfd : %d %s", -rc, strerror(-rc));
+        goto error2;
+    }
+
+    (*workers)->threads = calloc(count, sizeof(pthread_t));
+    if ((*workers)->threads == NULL) {
+        rc = -ENOMEM;
+        goto error3;
+    }
+
+    for (i = 0; i < count; i++) {
+        rc = pthread_create(&(*workers)->threads[i], NULL, worker_main, *workers);
+        if (rc != 0) {
+            rc = -rc;
+            ERROR("pthread_create : %d %s", -rc, strerror(-rc));
+            workers_destroy(*workers);
+            *workers = NULL;
+            goto ret;
+        }
+        (*workers)->count++;
+    }
+
+    goto ret;
+
+error3:
+    pollitem_del(&(*workers)->pollitem, pollfd);
+error2:
+    close((*workers)->pollitem.fd);
+error1:
+    pthread_cond_destroy(&(*workers)->cond);
+    pthread_mutex_destroy(&(*workers)->mutex);
+    free(*workers);
+    *workers = NULL;
+ret:
+    return rc;
+}
+
+/* see workers.h */
+void workers_destroy(workers_t *workers) {
+    unsigned i;
+
+    pthread_mutex_lock(&workers->mutex);
+    workers->stopping = true;
+    pthread_cond_broadcast(&workers->cond);
+    pthread_mutex_unlock(&workers->mutex);
+
+    for (i = 0; i < workers->count; i++) pthread_join(workers->threads[i], NULL);
+
+    pollitem_del(&workers->pollitem, workers->pollfd);
+    close(workers->pollitem.fd);
+
+    free_jobs(workers->todo);
+    free_jobs(workers->finished);
+    free(workers->threads);
+    pthread_cond_destroy(&workers->cond);
+    pthread_mutex_destroy(&workers->mutex);
+    free(workers);
+}
+
+/* see workers.h */
+int workers_queue(workers_t *workers, void (*run)(void *closure), void (*done)(void *closure), void *closure) {
+    job_t *job, **prv;
+
+    job = malloc(sizeof(*job));
+    if (job == NULL) {
+        ERROR("malloc failed");
+        return -ENOMEM;
+    }
+    job->next = NULL;
+    job->run = run;
+    job->done = done;
+    job->closure = closure;
+
+    /* append to keep the submission order */
+    pthread_mutex_lock(&workers->mutex);
+    prv = &workers->todo;
+    while (*prv) prv = &(*prv)->next;
+    *prv = job;
+    pthread_cond_signal(&workers->cond);
+    pthread_mutex_unlock(&workers->mutex);
+
+    return 0;
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2018-2021 IoT.bzh Company
+ * Author: José Bollo <jose.bollo@iot.bzh>
+ * Author: Arthur Guyader <arthur.guyader@iot.bzh>
+ *
+ * $RP_BEGIN_LICENSE$
+ * Commercial License Usage
+ *  Licensees holding valid commercial IoT.bzh licenses may use this file in
+ *  accordance with the commercial license agreement provided with the
+ *  Software or, alternatively, in accordance with the terms contained in
+ *  a written agreement between you and The IoT.bzh Company. For licensing terms
+ *  and conditions see https://www.iot.bzh/terms-conditions. For further
+ *  information use the contact form at https://www.iot.bzh/contact.
+ *
+ * GNU General Public License Usage
+ *  Alternatively, this file may be used under the terms of the GNU General
+ *  Public license version 3. This license is as published by the Free Software
+ *  Foundation and appearing in the file LICENSE.GPLv3 included in the packaging
+ *  of this file. Please review the following information to ensure the GNU
+ *  General Public License requirements will be met
+ *  https://www.gnu.org/licenses/gpl-3.0.html.
+ * $RP_END_LICENSE$
+ */
+
+#ifndef SEC_LSM_MANAGER_WORKERS_H
+#define SEC_LSM_MANAGER_WORKERS_H
+
+#include <sys/cdefs.h>
+
+typedef struct workers workers_t;
+
+/**
+ * @brief Create a pool of worker threads
+ * The completion of the jobs is notified through a pollitem added to 'pollfd',
+ * so the 'done' callbacks are always called from the thread that dispatches the
+ * events of 'pollfd'.
+ *
+ * @param[out] workers where to store the handler of the pool
+ * @param[in] count number of threads of the pool (must not be 0)
+ * @param[in] pollfd file descriptor of the epoll
+ * @return 0 in case of success or a negative -errno value
+ */
+extern int workers_create(workers_t **workers, unsigned count, int pollfd) __wur __nonnull();
+
+/**
+ * @brief Stop the threads of the pool and release its resources
+ * Jobs not yet started are dropped without calling their callbacks.
+ *
+ * @param[in] workers the handler of the pool
+ */
+extern void workers_destroy(workers_t *workers) __nonnull();
+
+/**
+ * @brief Queue a job
+ * 'run' is called by a worker thread, then 'done' is called by the thread
+ * dispatching the events of the pollfd given at creation
+ *
+ * @param[in] workers the handler of the pool
+ * @param[in] run the function to call in a worker thread
+ * @param[in] done the function to call in the main loop when 'run' is finished
+ * @param[in] closure the closure given to 'run' and 'done'
+ * @return 0 in case of success or a negative -errno value
+ */
+extern int workers_queue(workers_t *workers, void (*run)(void *closure), void (*done)(void *closure),
+                         void *closure) __wur __nonnull((1, 2, 3));
+
+#endif